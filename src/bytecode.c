@@ -0,0 +1,554 @@
+/*
+ * Bytecode
+ * Compiles the AST to a compact register-based bytecode for the virtual
+ * machine.
+ */
+
+#include "bytecode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+
+enum { INITIAL_CODE_CAPACITY = 64 };
+
+// How each opcode is printed: its name, then one letter per operand, 'r'
+// for a register, 'k' for a constant, 't' for a jump target and 'f' for a
+// function.
+typedef struct opcode_info {
+  const char* name;
+  const char* operands;
+} opcode_info;
+
+static const opcode_info opcode_table[BYTECODE_OPCODE_COUNT] = {
+    [BYTECODE_CONSTANT] = {"constant", "rk"},
+    [BYTECODE_MOVE] = {"move", "rr"},
+    [BYTECODE_ADD] = {"add", "rrr"},
+    [BYTECODE_SUB] = {"sub", "rrr"},
+    [BYTECODE_MUL] = {"mul", "rrr"},
+    [BYTECODE_DIV] = {"div", "rrr"},
+    [BYTECODE_MOD] = {"mod", "rrr"},
+    [BYTECODE_EQ] = {"eq", "rrr"},
+    [BYTECODE_NE] = {"ne", "rrr"},
+    [BYTECODE_LT] = {"lt", "rrr"},
+    [BYTECODE_GT] = {"gt", "rrr"},
+    [BYTECODE_LE] = {"le", "rrr"},
+    [BYTECODE_GE] = {"ge", "rrr"},
+    [BYTECODE_NEGATE] = {"negate", "rr"},
+    [BYTECODE_ADD_CONSTANT] = {"add_constant", "rrk"},
+    [BYTECODE_JUMP] = {"jump", "t"},
+    [BYTECODE_JUMP_IF_ZERO] = {"jump_if_zero", "rt"},
+    [BYTECODE_JUMP_IF_NONZERO] = {"jump_if_nonzero", "rt"},
+    [BYTECODE_JUMP_IF_EQ] = {"jump_if_eq", "rrt"},
+    [BYTECODE_JUMP_IF_NE] = {"jump_if_ne", "rrt"},
+    [BYTECODE_JUMP_IF_LT] = {"jump_if_lt", "rrt"},
+    [BYTECODE_JUMP_IF_GT] = {"jump_if_gt", "rrt"},
+    [BYTECODE_JUMP_IF_LE] = {"jump_if_le", "rrt"},
+    [BYTECODE_JUMP_IF_GE] = {"jump_if_ge", "rrt"},
+    [BYTECODE_CALL] = {"call", "rfrk"},
+    [BYTECODE_RETURN] = {"return", "r"},
+};
+
+int get_bytecode_operand_count(bytecode_opcode opcode) {
+  return (int)strlen(opcode_table[opcode].operands);
+}
+
+// ───── Emitting Code ─────
+
+typedef struct bytecode_compiler {
+  const bytecode_program* program;
+  bytecode_function* function;
+  int next_register;  // Lowest register no live temporary uses.
+} bytecode_compiler;
+
+static void emit(bytecode_compiler* compiler, int word) {
+  bytecode_function* function = compiler->function;
+  if (function->code_size == function->code_capacity) {
+    function->code_capacity = function->code_capacity == 0
+                                  ? INITIAL_CODE_CAPACITY
+                                  : function->code_capacity * 2;
+    int* code = (int*)realloc(
+        function->code, sizeof(int) * (size_t)function->code_capacity);
+    if (code == NULL) {
+      error_and_exit("realloc failed");
+    }
+    function->code = code;
+  }
+  function->code[function->code_size++] = word;
+}
+
+static void emit_instruction(bytecode_compiler* compiler,
+                             bytecode_opcode opcode, int first, int second,
+                             int third) {
+  int operand_count = get_bytecode_operand_count(opcode);
+  const int operands[] = {first, second, third};
+  emit(compiler, (int)opcode);
+  for (int i = 0; i < operand_count; i++) {
+    emit(compiler, operands[i]);
+  }
+}
+
+// Emits a jump whose target is its last operand, left for patch_jump.
+// Returns where the target goes.
+static int emit_jump(bytecode_compiler* compiler, bytecode_opcode opcode,
+                     int first, int second) {
+  emit_instruction(compiler, opcode, first, second, 0);
+  return compiler->function->code_size - 1;
+}
+
+// Points a jump at the next instruction emitted.
+static void patch_jump(bytecode_compiler* compiler, int target_index) {
+  compiler->function->code[target_index] = compiler->function->code_size;
+}
+
+static void reserve_registers(bytecode_compiler* compiler, int count) {
+  compiler->next_register += count;
+  if (compiler->next_register > compiler->function->register_count) {
+    compiler->function->register_count = compiler->next_register;
+  }
+}
+
+// The register to compute a value into: the one asked for, or else a new
+// temporary.
+static int target_register(bytecode_compiler* compiler, int destination) {
+  if (destination >= 0) {
+    return destination;
+  }
+  reserve_registers(compiler, 1);
+  return compiler->next_register - 1;
+}
+
+// ───── Expressions ─────
+
+static int find_function(const bytecode_program* program, const Token* name) {
+  for (int i = 0; i < program->function_count; i++) {
+    const bytecode_function* function = &program->functions[i];
+    if (function->name_length == name->length &&
+        strncmp(function->name, name->lexeme, (size_t)name->length) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int is_literal(const ast_node* node) {
+  return node->type == AST_INT_LITERAL;
+}
+
+static int compile_expression(bytecode_compiler* compiler, ast_node* node,
+                              int destination);
+
+// Arguments are computed into consecutive registers above every live value,
+// which is where the callee's frame begins.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int compile_call(bytecode_compiler* compiler, ast_node* node,
+                        int destination) {
+  const Token* name = node->as.function_call.name;
+  int callee = find_function(compiler->program, name);
+  if (callee < 0) {
+    (void)fprintf(stderr, "Error: Call to undefined function '%.*s'\n",
+                  name->length, name->lexeme);
+    error_and_exit("");
+  }
+  int argument_count = node->as.function_call.param_count;
+  if (argument_count != compiler->program->functions[callee].parameter_count) {
+    (void)fprintf(stderr, "Error: Wrong number of arguments to '%.*s'\n",
+                  name->length, name->lexeme);
+    error_and_exit("");
+  }
+  int base = compiler->next_register;
+  reserve_registers(compiler, argument_count);
+  for (int i = 0; i < argument_count; i++) {
+    compile_expression(compiler, node->as.function_call.parameters[i],
+                       base + i);
+    compiler->next_register = base + argument_count;
+  }
+  compiler->next_register = base;
+  int result = target_register(compiler, destination);
+  emit(compiler, BYTECODE_CALL);
+  emit(compiler, result);
+  emit(compiler, callee);
+  emit(compiler, base);
+  emit(compiler, argument_count);
+  return result;
+}
+
+static bytecode_opcode get_binary_opcode(TokenType operator) {
+  switch (operator) {
+    case TOKEN_PLUS:
+      return BYTECODE_ADD;
+    case TOKEN_MINUS:
+      return BYTECODE_SUB;
+    case TOKEN_STAR:
+      return BYTECODE_MUL;
+    case TOKEN_SLASH:
+      return BYTECODE_DIV;
+    case TOKEN_PERCENT:
+      return BYTECODE_MOD;
+    case TOKEN_EQ:
+      return BYTECODE_EQ;
+    case TOKEN_NEQ:
+      return BYTECODE_NE;
+    case TOKEN_LT:
+      return BYTECODE_LT;
+    case TOKEN_GT:
+      return BYTECODE_GT;
+    case TOKEN_LEQ:
+      return BYTECODE_LE;
+    case TOKEN_GEQ:
+      return BYTECODE_GE;
+    default:
+      (void)fprintf(stderr, "Error: Unsupported operator '%s'\n",
+                    token_type_to_string(operator));
+      error_and_exit("");
+      return BYTECODE_ADD;
+  }
+}
+
+// Adds a constant to an expression in one instruction.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int compile_add_constant(bytecode_compiler* compiler, ast_node* node,
+                                int constant, int destination) {
+  int mark = compiler->next_register;
+  int source = compile_expression(compiler, node, -1);
+  compiler->next_register = mark;
+  int result = target_register(compiler, destination);
+  emit_instruction(compiler, BYTECODE_ADD_CONSTANT, result, source, constant);
+  return result;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static int compile_binary(bytecode_compiler* compiler, ast_node* node,
+                          int destination) {
+  TokenType operator = node->as.binary._operator;
+  ast_node* left = node->as.binary.left;
+  ast_node* right = node->as.binary.right;
+  if ((operator == TOKEN_PLUS || operator == TOKEN_MINUS) &&
+      is_literal(right)) {
+    unsigned int constant = (unsigned int)right->as.int_literal.int_literal;
+    if (operator == TOKEN_MINUS) {
+      constant = 0U - constant;
+    }
+    return compile_add_constant(compiler, left, (int)constant, destination);
+  }
+  if (operator == TOKEN_PLUS && is_literal(left)) {
+    return compile_add_constant(compiler, right,
+                                left->as.int_literal.int_literal, destination);
+  }
+
+  int mark = compiler->next_register;
+  int first = compile_expression(compiler, left, -1);
+  int second = compile_expression(compiler, right, -1);
+  compiler->next_register = mark;
+  int result = target_register(compiler, destination);
+  emit_instruction(compiler, get_binary_opcode(operator), result, first,
+                   second);
+  return result;
+}
+
+// Computes an expression and returns the register holding it. With a
+// destination of -1 the value may be left anywhere, so a variable is read
+// from its own register without a copy.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int compile_expression(bytecode_compiler* compiler, ast_node* node,
+                              int destination) {
+  switch (node->type) {
+    case AST_INT_LITERAL: {
+      int result = target_register(compiler, destination);
+      emit_instruction(compiler, BYTECODE_CONSTANT, result,
+                       node->as.int_literal.int_literal, 0);
+      return result;
+    }
+    case AST_VARIABLE:
+      if (destination < 0 || destination == node->slot) {
+        return node->slot;
+      }
+      emit_instruction(compiler, BYTECODE_MOVE, destination, node->slot, 0);
+      return destination;
+    case AST_BINARY:
+      return compile_binary(compiler, node, destination);
+    case AST_UNARY: {
+      if (node->as.unary._operator != '-') {
+        error_and_exit("Error: Unsupported unary operator\n");
+      }
+      int mark = compiler->next_register;
+      int operand = compile_expression(compiler, node->as.unary.operand, -1);
+      compiler->next_register = mark;
+      int result = target_register(compiler, destination);
+      emit_instruction(compiler, BYTECODE_NEGATE, result, operand, 0);
+      return result;
+    }
+    case AST_FUNCTION_CALL:
+      return compile_call(compiler, node, destination);
+    default:
+      error_and_exit("Error: Unsupported expression\n");
+      return -1;
+  }
+}
+
+// ───── Statements ─────
+
+// The fused jump taken when `operator` holds, or when it fails if negate is
+// set. Returns -1 if the operator is not a comparison.
+static int get_comparison_jump(TokenType operator, int negate) {
+  switch (operator) {
+    case TOKEN_EQ:
+      return negate ? BYTECODE_JUMP_IF_NE : BYTECODE_JUMP_IF_EQ;
+    case TOKEN_NEQ:
+      return negate ? BYTECODE_JUMP_IF_EQ : BYTECODE_JUMP_IF_NE;
+    case TOKEN_LT:
+      return negate ? BYTECODE_JUMP_IF_GE : BYTECODE_JUMP_IF_LT;
+    case TOKEN_GT:
+      return negate ? BYTECODE_JUMP_IF_LE : BYTECODE_JUMP_IF_GT;
+    case TOKEN_LEQ:
+      return negate ? BYTECODE_JUMP_IF_GT : BYTECODE_JUMP_IF_LE;
+    case TOKEN_GEQ:
+      return negate ? BYTECODE_JUMP_IF_LT : BYTECODE_JUMP_IF_GE;
+    default:
+      return -1;
+  }
+}
+
+// Emits a jump taken when the condition's truth equals when_true. Returns
+// where its target goes.
+static int compile_conditional_jump(bytecode_compiler* compiler,
+                                    ast_node* condition, int when_true) {
+  int mark = compiler->next_register;
+  int target_index = 0;
+  int fused = condition->type == AST_BINARY
+                  ? get_comparison_jump(condition->as.binary._operator,
+                                        !when_true)
+                  : -1;
+  if (fused >= 0) {
+    int first = compile_expression(compiler, condition->as.binary.left, -1);
+    int second = compile_expression(compiler, condition->as.binary.right, -1);
+    target_index =
+        emit_jump(compiler, (bytecode_opcode)fused, first, second);
+  } else {
+    int value = compile_expression(compiler, condition, -1);
+    target_index = emit_jump(
+        compiler,
+        when_true ? BYTECODE_JUMP_IF_NONZERO : BYTECODE_JUMP_IF_ZERO, value,
+        0);
+  }
+  compiler->next_register = mark;
+  return target_index;
+}
+
+static void compile_statement(bytecode_compiler* compiler, ast_node* node);
+
+static int is_else_arm(const ast_node* node) {
+  return node != NULL && (node->type == AST_ELSE_IF_STATEMENT ||
+                          node->type == AST_ELSE_STATEMENT);
+}
+
+// Compiles an if statement together with the else-if and else statements
+// that follow it in the same block. Returns how many statements it used.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int compile_if_chain(bytecode_compiler* compiler, ast_node** statements,
+                            int count) {
+  int* exits = (int*)malloc(sizeof(int) * ((size_t)count + 1));
+  if (exits == NULL) {
+    error_and_exit("malloc failed");
+  }
+  int exit_count = 0;
+  int used = 0;
+  while (used < count && (used == 0 || is_else_arm(statements[used]))) {
+    ast_node* arm = statements[used++];
+    if (arm->type == AST_ELSE_STATEMENT) {
+      compile_statement(compiler, arm->as.if_elif_else_statement.body);
+      break;
+    }
+    int skip = compile_conditional_jump(
+        compiler, arm->as.if_elif_else_statement.condition, 0);
+    compile_statement(compiler, arm->as.if_elif_else_statement.body);
+    if (used < count && is_else_arm(statements[used])) {
+      exits[exit_count++] = emit_jump(compiler, BYTECODE_JUMP, 0, 0);
+    }
+    patch_jump(compiler, skip);
+  }
+  for (int i = 0; i < exit_count; i++) {
+    patch_jump(compiler, exits[i]);
+  }
+  free(exits);
+  return used;
+}
+
+// The test sits after the body, so each iteration runs one jump.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void compile_while(bytecode_compiler* compiler, ast_node* node) {
+  int entry = emit_jump(compiler, BYTECODE_JUMP, 0, 0);
+  int body = compiler->function->code_size;
+  compile_statement(compiler, node->as.while_statement.body);
+  patch_jump(compiler, entry);
+  int back =
+      compile_conditional_jump(compiler, node->as.while_statement.condition, 1);
+  compiler->function->code[back] = body;
+}
+
+static void compile_return_zero(bytecode_compiler* compiler) {
+  int zero = target_register(compiler, -1);
+  emit_instruction(compiler, BYTECODE_CONSTANT, zero, 0, 0);
+  emit_instruction(compiler, BYTECODE_RETURN, zero, 0, 0);
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static void compile_statement(bytecode_compiler* compiler, ast_node* node) {
+  if (node == NULL) {
+    return;
+  }
+  int mark = compiler->next_register;
+  switch (node->type) {
+    case AST_DECLARATION:
+      compile_expression(compiler, node->as.declaration.expression,
+                         node->as.declaration.variable->slot);
+      break;
+    case AST_FUNCTION_CALL:
+      compile_call(compiler, node, -1);
+      break;
+    case AST_RETURN:
+      if (node->as._return.expression == NULL) {
+        compile_return_zero(compiler);
+      } else {
+        int value =
+            compile_expression(compiler, node->as._return.expression, -1);
+        emit_instruction(compiler, BYTECODE_RETURN, value, 0, 0);
+      }
+      break;
+    case AST_WHILE_STATEMENT:
+      compile_while(compiler, node);
+      break;
+    case AST_IF_STATEMENT:
+      compile_if_chain(compiler, &node, 1);
+      break;
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      error_and_exit("Error: else without a matching if\n");
+      break;
+    case AST_BLOCK:
+      for (int i = 0; i < node->as.block.count;) {
+        ast_node* statement = node->as.block.statements[i];
+        if (statement != NULL && statement->type == AST_IF_STATEMENT) {
+          i += compile_if_chain(compiler, &node->as.block.statements[i],
+                                node->as.block.count - i);
+        } else {
+          compile_statement(compiler, statement);
+          i++;
+        }
+      }
+      break;
+    default:
+      // Bare declarations need no code; every register starts at 0.
+      break;
+  }
+  compiler->next_register = mark;
+}
+
+// ───── Programs ─────
+
+void compile_bytecode_program(ast_node** nodes, int function_count,
+                              bytecode_program* program) {
+  program->functions = (bytecode_function*)calloc(
+      (size_t)function_count + 1, sizeof(bytecode_function));
+  if (program->functions == NULL) {
+    error_and_exit("malloc failed");
+  }
+  program->function_count = 0;
+  program->main_function = -1;
+  // Name every function first so calls can go forwards.
+  for (int i = 0; i < function_count; i++) {
+    ast_node* node = nodes[i];
+    if (node == NULL) {
+      continue;
+    }
+    if (node->type != AST_FUNCTION_DECLARATION) {
+      error_and_exit("Error: Not a function node\n");
+    }
+    if (node->as.function.slot_count < 0) {
+      resolve_function_variables(node);
+    }
+    const Token* name = node->as.function.name;
+    if (name->length == (int)strlen("main") &&
+        strncmp(name->lexeme, "main", strlen("main")) == 0) {
+      program->main_function = program->function_count;
+    }
+    bytecode_function* function =
+        &program->functions[program->function_count++];
+    function->name = name->lexeme;
+    function->name_length = name->length;
+    function->parameter_count = node->as.function.param_count;
+    // The resolver gives the parameters the first slots, in order.
+    function->register_count = node->as.function.slot_count;
+  }
+
+  int index = 0;
+  for (int i = 0; i < function_count; i++) {
+    if (nodes[i] == NULL) {
+      continue;
+    }
+    bytecode_compiler compiler;
+    compiler.program = program;
+    compiler.function = &program->functions[index++];
+    compiler.next_register = compiler.function->register_count;
+    compile_statement(&compiler, nodes[i]->as.function.statements);
+    // Falling off the end returns 0.
+    compile_return_zero(&compiler);
+  }
+}
+
+void free_bytecode_program(bytecode_program* program) {
+  for (int i = 0; i < program->function_count; i++) {
+    free(program->functions[i].code);
+  }
+  free(program->functions);
+  program->functions = NULL;
+  program->function_count = 0;
+  program->main_function = -1;
+}
+
+// ───── Printing ─────
+
+static void print_operand(FILE* output, const bytecode_program* program,
+                          char kind, int operand) {
+  switch (kind) {
+    case 'r':
+      (void)fprintf(output, "r%d", operand);
+      break;
+    case 't':
+      (void)fprintf(output, "@%d", operand);
+      break;
+    case 'f':
+      (void)fprintf(output, "%.*s", program->functions[operand].name_length,
+                    program->functions[operand].name);
+      break;
+    default:
+      (void)fprintf(output, "%d", operand);
+      break;
+  }
+}
+
+void print_bytecode_program(FILE* output, const bytecode_program* program) {
+  for (int i = 0; i < program->function_count; i++) {
+    const bytecode_function* function = &program->functions[i];
+    (void)fprintf(output, "%.*s (%d parameters, %d registers):\n",
+                  function->name_length, function->name,
+                  function->parameter_count, function->register_count);
+    for (int pc = 0; pc < function->code_size;) {
+      bytecode_opcode opcode = (bytecode_opcode)function->code[pc];
+      const opcode_info* info = &opcode_table[opcode];
+      (void)fprintf(output, "  %4d  %-16s", pc, info->name);
+      int operand_count = get_bytecode_operand_count(opcode);
+      for (int j = 0; j < operand_count; j++) {
+        (void)fprintf(output, j == 0 ? "" : ", ");
+        print_operand(output, program, info->operands[j],
+                      function->code[pc + 1 + j]);
+      }
+      (void)fprintf(output, "\n");
+      pc += 1 + operand_count;
+    }
+  }
+}
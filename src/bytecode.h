@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "parser.h"
+
+// Every opcode is followed in the code by its operands, one int each. `a`,
+// `b` and `c` name registers of the running function, `k` an integer
+// constant and `t` the code index of a jump target.
+typedef enum {
+  BYTECODE_CONSTANT,  // a k: a = k.
+  BYTECODE_MOVE,      // a b: a = b.
+  BYTECODE_ADD,       // a b c: a = b + c, wrapping like the rest.
+  BYTECODE_SUB,
+  BYTECODE_MUL,
+  BYTECODE_DIV,
+  BYTECODE_MOD,
+  BYTECODE_EQ,  // a b c: a = 1 if b == c holds, else 0.
+  BYTECODE_NE,
+  BYTECODE_LT,
+  BYTECODE_GT,
+  BYTECODE_LE,
+  BYTECODE_GE,
+  BYTECODE_NEGATE,        // a b: a = -b.
+  BYTECODE_ADD_CONSTANT,  // a b k: a = b + k. Fuses a CONSTANT and an ADD.
+  BYTECODE_JUMP,          // t: continue at t.
+  BYTECODE_JUMP_IF_ZERO,  // a t: continue at t if a is 0.
+  BYTECODE_JUMP_IF_NONZERO,  // a t: continue at t if a is not 0.
+  BYTECODE_JUMP_IF_EQ,  // a b t: continue at t if a == b. Fuses a compare
+                        // and a conditional jump.
+  BYTECODE_JUMP_IF_NE,
+  BYTECODE_JUMP_IF_LT,
+  BYTECODE_JUMP_IF_GT,
+  BYTECODE_JUMP_IF_LE,
+  BYTECODE_JUMP_IF_GE,
+  BYTECODE_CALL,  // a f b k: a = functions[f] called with the k arguments in
+                  // registers b to b + k - 1.
+  BYTECODE_RETURN,  // a: return a.
+  BYTECODE_OPCODE_COUNT,
+} bytecode_opcode;
+
+// A function's registers are its local slots from the resolver, the
+// parameters first, followed by the temporaries its expressions need. A
+// call's arguments sit in consecutive registers at the top of the caller's
+// frame, where they become the callee's first registers.
+typedef struct bytecode_function {
+  const char* name;  // Not null-terminated.
+  int name_length;
+  int parameter_count;
+  int register_count;
+  int* code;
+  int code_size;
+  int code_capacity;
+} bytecode_function;
+
+typedef struct bytecode_program {
+  bytecode_function* functions;
+  int function_count;
+  int main_function;  // Index of main, or -1 if there is none.
+} bytecode_program;
+
+/*
+Compiles a whole program to bytecode.
+
+Expressions are evaluated straight into the register that needs them, so
+variables are read in place and an assignment's value is computed into the
+variable's own register. Two superinstructions cut dispatches in common
+code: adding or subtracting a constant is a single ADD_CONSTANT, and an if
+or while whose condition is a comparison jumps on the comparison directly.
+While loops keep their test at the bottom, so each iteration costs one
+jump. Calls are resolved to function indexes here; a call to a function the
+program does not define, or with the wrong number of arguments, exits with
+an error. Resolves each function's variables first if that has not
+happened yet.
+
+Args:
+  nodes: Array of AST function nodes.
+  function_count: Number of entries in nodes.
+  program: Output program; free it with free_bytecode_program.
+
+Returns:
+  void
+*/
+void compile_bytecode_program(ast_node** nodes, int function_count,
+                              bytecode_program* program);
+
+/*
+Gives the number of operands that follow an opcode in the code.
+
+Args:
+  opcode: Opcode to look up.
+
+Returns:
+  How many ints the operands take.
+*/
+int get_bytecode_operand_count(bytecode_opcode opcode);
+
+/*
+Frees a program's functions and their code.
+
+Args:
+  program: Program to free.
+
+Returns:
+  void
+*/
+void free_bytecode_program(bytecode_program* program);
+
+/*
+Prints a readable listing of a program's bytecode.
+
+Args:
+  output: Stream to print to.
+  program: Program to print.
+
+Returns:
+  void
+*/
+void print_bytecode_program(FILE* output, const bytecode_program* program);
@@ -46,15 +46,28 @@ static inline void debug_print(const char* func, int line, const char* fmt,
 
 const size_t MAX_LINE_LENGTH = 64;
 const int INITIAL_MEMORY_CAPACITY = 8;
-const int BUFFER_SIZE = 32;
 const map op_constants[] = {{TOKEN_PLUS, "add"},
                             {TOKEN_MINUS, "sub"},
                             {TOKEN_STAR, "imul"},
                             {TOKEN_SLASH, "idiv"},
                             {0, NULL}};
 
-const map low_linux_registers[] = {
-    {1, "edi"}, {2, "esi"}, {3, "edx"}, {4, "ecx"}, {5, "e8d"}, {6, "e9d"},
+// Condition codes for the comparison operators, as used in jcc and setcc.
+const map condition_codes[] = {{TOKEN_EQ, "e"}, {TOKEN_NEQ, "ne"},
+                               {TOKEN_LT, "l"}, {TOKEN_GT, "g"},
+                               {TOKEN_LEQ, "le"}, {TOKEN_GEQ, "ge"},
+                               {0, NULL}};
+
+// The condition codes that hold exactly when the ones above do not.
+const map inverted_condition_codes[] = {{TOKEN_EQ, "ne"}, {TOKEN_NEQ, "e"},
+                                        {TOKEN_LT, "ge"}, {TOKEN_GT, "le"},
+                                        {TOKEN_LEQ, "g"}, {TOKEN_GEQ, "l"},
+                                        {0, NULL}};
+
+enum { ARGUMENT_REGISTER_COUNT = 6 };
+
+const map low_linux_registers[ARGUMENT_REGISTER_COUNT] = {
+    {1, "edi"}, {2, "esi"}, {3, "edx"}, {4, "ecx"}, {5, "r8d"}, {6, "r9d"},
 };
 
 const char* get_op_name(TokenType operator) {
@@ -65,89 +78,210 @@ const char* get_op_name(TokenType operator) {
   }
   return "UNKNOWN_OP";
 }
+static const char* get_condition_code(TokenType operator, int inverted) {
+  const map* codes = inverted ? inverted_condition_codes : condition_codes;
+  for (int i = 0; codes[i].name != NULL; i++) {
+    if (codes[i].symbol == operator) {
+      return codes[i].name;
+    }
+  }
+  return NULL;
+}
+
 const char* get_low_linux_registers_name(int index) {
+  if (index < 0 || index >= ARGUMENT_REGISTER_COUNT) {
+    error_and_exit("Error: No argument register left\n");
+  }
   return low_linux_registers[index].name;
 }
 
 void init_memory(memory* mem) {
   mem->variable_capacity = INITIAL_MEMORY_CAPACITY;
 
-  mem->variables = (variable_in_memory**)malloc(
-      sizeof(variable_in_memory*) * (unsigned long)mem->variable_capacity);
+  mem->variables = (variable_in_memory*)malloc(
+      sizeof(variable_in_memory) * (unsigned long)mem->variable_capacity);
   mem->number_of_variables = 0;
+
+  mem->bucket_capacity = INITIAL_MEMORY_CAPACITY * 2;
+  mem->buckets = (memory_bucket*)calloc((size_t)mem->bucket_capacity,
+                                        sizeof(memory_bucket));
+  mem->number_of_buckets_used = 0;
+
+  mem->scope_capacity = INITIAL_MEMORY_CAPACITY;
+  mem->scope_starts =
+      (int*)malloc(sizeof(int) * (unsigned long)mem->scope_capacity);
+  mem->scope_depth = 0;
+
+  if (!mem->variables || !mem->buckets || !mem->scope_starts) {
+    error_and_exit("malloc failed");
+  }
   mem->next_starting_location = -4;  // Start at memory address 16 (2^4)
 }
 
+void free_memory(memory* mem) {
+  for (int i = 0; i < mem->number_of_variables; i++) {
+    free(mem->variables[i].variable_name);
+  }
+  for (int i = 0; i < mem->bucket_capacity; i++) {
+    free(mem->buckets[i].name);
+  }
+  free(mem->variables);
+  free(mem->buckets);
+  free(mem->scope_starts);
+  mem->variables = NULL;
+  mem->buckets = NULL;
+  mem->scope_starts = NULL;
+  mem->number_of_variables = 0;
+  mem->scope_depth = 0;
+}
+
+// FNV-1a over the raw lexeme, so lookups never need a null terminator.
+static unsigned int hash_variable_name(const char* lexeme, int length) {
+  unsigned int hash = 2166136261U;
+  for (int i = 0; i < length; i++) {
+    hash ^= (unsigned char)lexeme[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+// Returns the bucket holding `lexeme`, or the empty bucket where it belongs.
+static memory_bucket* find_memory_bucket(memory* mem, const char* lexeme,
+                                         int length, unsigned int hash) {
+  unsigned int mask = (unsigned int)mem->bucket_capacity - 1U;
+  unsigned int index = hash & mask;
+  for (;;) {
+    memory_bucket* bucket = &mem->buckets[index];
+    if (bucket->name == NULL ||
+        (bucket->hash == hash && bucket->name_length == length &&
+         memcmp(bucket->name, lexeme, (size_t)length) == 0)) {
+      return bucket;
+    }
+    index = (index + 1U) & mask;
+  }
+}
+
+static void grow_memory_buckets(memory* mem) {
+  memory_bucket* old_buckets = mem->buckets;
+  int old_capacity = mem->bucket_capacity;
+
+  mem->bucket_capacity *= 2;
+  mem->buckets = (memory_bucket*)calloc((size_t)mem->bucket_capacity,
+                                        sizeof(memory_bucket));
+  if (!mem->buckets) {
+    error_and_exit("calloc failed");
+  }
+  for (int i = 0; i < old_capacity; i++) {
+    if (old_buckets[i].name != NULL) {
+      *find_memory_bucket(mem, old_buckets[i].name, old_buckets[i].name_length,
+                          old_buckets[i].hash) = old_buckets[i];
+    }
+  }
+  free(old_buckets);
+}
+
+void push_memory_scope(memory* mem) {
+  if (mem->scope_depth == mem->scope_capacity) {
+    mem->scope_capacity *= 2;
+    int* new_scope_starts =
+        (int*)realloc(mem->scope_starts,
+                      sizeof(int) * (unsigned long)mem->scope_capacity);
+    if (new_scope_starts == NULL) {
+      error_and_exit("realloc failed");
+    }
+    mem->scope_starts = new_scope_starts;
+  }
+  mem->scope_starts[mem->scope_depth++] = mem->number_of_variables;
+}
+
+void pop_memory_scope(memory* mem) {
+  if (mem->scope_depth == 0) {
+    return;
+  }
+  int scope_start = mem->scope_starts[--mem->scope_depth];
+  if (scope_start == mem->number_of_variables) {
+    return;
+  }
+  // The popped slots become free for whatever the enclosing scope declares
+  // next.
+  mem->next_starting_location = mem->variables[scope_start].memory_difference;
+  while (mem->number_of_variables > scope_start) {
+    variable_in_memory* variable =
+        &mem->variables[--mem->number_of_variables];
+    find_memory_bucket(mem, variable->variable_name, variable->name_length,
+                       variable->hash)
+        ->variable = variable->shadowed_variable;
+    free(variable->variable_name);
+  }
+}
+
 void add_variable_to_memory(memory* mem, char* variable_name) {
-  variable_in_memory* new_variable =
-      (variable_in_memory*)malloc(sizeof(variable_in_memory));
-  new_variable->variable_name = variable_name;
-  new_variable->memory_difference = mem->next_starting_location;
-  DEBUG_PRINT("Adding variable %s to memory at location %d\n", variable_name,
-              new_variable->memory_difference);
-  mem->next_starting_location -= 4;
+  int name_length = (int)strlen(variable_name);
+  unsigned int hash = hash_variable_name(variable_name, name_length);
 
   if (mem->number_of_variables + 1 > mem->variable_capacity) {
     DEBUG_PRINT("Memory full! Increasing capacity to %d\n",
                 mem->variable_capacity * 2);
     mem->variable_capacity *= 2;
-    variable_in_memory** new_variable_in_memory_location =
-        (variable_in_memory**)realloc(
-            (void*)mem->variables,
-            sizeof(variable_in_memory*) *
-                (long unsigned int)mem->variable_capacity);
+    variable_in_memory* new_variable_in_memory_location =
+        (variable_in_memory*)realloc(
+            mem->variables, sizeof(variable_in_memory) *
+                                (long unsigned int)mem->variable_capacity);
     if (new_variable_in_memory_location == NULL) {
-      printf("Error reallocating memory\n");
+      error_and_exit("Error reallocating memory\n");
     }
     mem->variables = new_variable_in_memory_location;
   }
+  // Keep the load factor at or below one half so probes stay short.
+  if ((mem->number_of_buckets_used + 1) * 2 > mem->bucket_capacity) {
+    grow_memory_buckets(mem);
+  }
 
-  // NOLINTNEXTLINE(clang-analyzer-core.NullDereference)
-  mem->variables[mem->number_of_variables] = new_variable;
-  mem->number_of_variables++;
+  int index = mem->number_of_variables++;
+  variable_in_memory* new_variable = &mem->variables[index];
+  new_variable->variable_name = variable_name;
+  new_variable->name_length = name_length;
+  new_variable->hash = hash;
+  new_variable->memory_difference = mem->next_starting_location;
+  new_variable->variable_type = 0;
+  DEBUG_PRINT("Adding variable %s to memory at location %d\n", variable_name,
+              new_variable->memory_difference);
+  mem->next_starting_location -= 4;
 
-  // free(old_variable_location); Realloc frees so don't need this
+  memory_bucket* bucket =
+      find_memory_bucket(mem, variable_name, name_length, hash);
+  if (bucket->name == NULL) {
+    // Buckets keep their own copy of the name because they outlive the scope
+    // of the variable that created them.
+    char* bucket_name = malloc((size_t)name_length + 1);
+    if (!bucket_name) {
+      error_and_exit("malloc failed");
+    }
+    memcpy(bucket_name, variable_name, (size_t)name_length + 1);
+    bucket->name = bucket_name;
+    bucket->name_length = name_length;
+    bucket->hash = hash;
+    bucket->variable = -1;
+    mem->number_of_buckets_used++;
+  }
+  new_variable->shadowed_variable = bucket->variable;
+  bucket->variable = index;
 }
 
 int get_variable_memory_location(memory* mem, const char* lexeme, int length) {
   DEBUG_PRINT("Searching for variable: '%.*s' (length = %d)\n", length, lexeme,
               length);
 
-  for (int i = 0; i < mem->number_of_variables; i++) {
-    char* variable_name = mem->variables[i]->variable_name;
-    int variable_length = (int)strlen(variable_name);
-    int compare_result = strncmp(variable_name, lexeme, (unsigned long)length);
-
-    DEBUG_PRINT("  Checking [%d]: name = '%s', strlen = %d, strncmp = %d\n", i,
-                variable_name, variable_length, compare_result);
-
-    if (length == variable_length && compare_result == 0) {
-      DEBUG_PRINT("  -> Match found! Returning memory offset: %d\n",
-                  mem->variables[i]->memory_difference);
-      return mem->variables[i]->memory_difference;
-    }
+  memory_bucket* bucket = find_memory_bucket(
+      mem, lexeme, length, hash_variable_name(lexeme, length));
+  if (bucket->name == NULL || bucket->variable < 0) {
+    DEBUG_PRINT("  -> No match found.\n");
+    return -1;  // NULL is a pointer; returning -1 is better for an int
   }
 
-  DEBUG_PRINT("  -> No match found.\n");
-  return -1;  // NULL is a pointer; returning -1 is better for an int
-}
-
-char* get_variable_memory_location_with_pointer(memory* mem, const char* lexeme,
-                                                int length) {
-  int offset = get_variable_memory_location(mem, lexeme, length);
-  char* buffer =
-      malloc((size_t)BUFFER_SIZE);  // plenty of room for [rbp-<offset>]
-  if (!buffer) {
-    error_and_exit("malloc failed");
-  }
-  if (offset > 0) {
-    (void)sprintf(buffer, "[rbp+%d]",
-                  offset);  // format the result into the buffer
-  } else {
-    (void)sprintf(buffer, "[rbp%d]",
-                  offset);  // format the result into the buffer
-  }
-  return buffer;
+  DEBUG_PRINT("  -> Match found! Returning memory offset: %d\n",
+              mem->variables[bucket->variable].memory_difference);
+  return mem->variables[bucket->variable].memory_difference;
 }
 
 void init_list_of_instructions(list_of_x86_instructions* list) {
@@ -180,25 +314,50 @@ add_instruction(list_of_x86_instructions* list, char* instruction) {
   list->instruction_count++;
 }
 
+enum { RED_ZONE_SIZE = 128, STACK_ALIGNMENT = 16 };
+
+// Frame of the function being generated. A leaf function whose slots fit in
+// the System V red zone sets up no frame and addresses them from rsp.
+static struct {
+  int has_frame;
+  int size;  // Bytes reserved below rbp, a multiple of STACK_ALIGNMENT.
+  int temporary_slot;  // First slot past the variables, for temporaries.
+  const Token* name;   // Function name, which prefixes its labels.
+  int next_label;
+} current_frame = {1, 0, 0, NULL, 0};
+
+static const char* get_frame_register(void) {
+  return current_frame.has_frame ? "rbp" : "rsp";
+}
+
+// Stack slots are 4 bytes wide and grow down from [rbp-4], or from [rsp-4]
+// without a frame.
+static int slot_to_memory_difference(int slot) { return -4 * (slot + 1); }
+
+static int memory_difference_to_slot(int memory_difference) {
+  return (-memory_difference / 4) - 1;
+}
+
 // NOLINTNEXTLINE(misc-no-recursion)
 void ast_variable_literal_or_binary_to_x86(ast_node* node,
-                                           list_of_x86_instructions* list,
-                                           memory* mem) {
+                                           list_of_x86_instructions* list) {
   DEBUG_PRINT("In ast_variable_literal_or_binary_to_x86\n");
+  if (node == NULL) {
+    return;
+  }
   if (node->type == AST_BINARY) {
-    ast_binary_node_to_x86(node, list, mem, 1);
+    ast_binary_node_to_x86(node, list);
   } else if (node->type == AST_VARIABLE || node->type == AST_INT_LITERAL) {
-    ast_variable_or_literal_node_to_x86(node, list, mem);
+    ast_variable_or_literal_node_to_x86(node, list);
   } else if (node->type == AST_FUNCTION_CALL) {
-    ast_function_call_node_to_x86(node, list, mem);
+    ast_function_call_node_to_x86(node, list);
   } else {
     return;
   }
 }
 
 void ast_variable_or_literal_node_to_x86(ast_node* node,
-                                         list_of_x86_instructions* list,
-                                         memory* mem) {
+                                         list_of_x86_instructions* list) {
   DEBUG_PRINT("In ast_variable_or_literal_node_to_x86\n");
   if (node->type == AST_INT_LITERAL) {
     DEBUG_PRINT("IS Int Literal");
@@ -212,18 +371,14 @@ void ast_variable_or_literal_node_to_x86(ast_node* node,
     add_instruction(
         list, new_instruction);  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
   } else if (node->type == AST_VARIABLE) {
-    char* operand = get_variable_memory_location_with_pointer(
-        mem, node->as.variable_name->lexeme, node->as.variable_name->length);
-
     char* new_instruction =
         malloc(MAX_LINE_LENGTH);  // enough for full instruction line
     if (!new_instruction) {
       error_and_exit("malloc failed");
     }
-    (void)sprintf(new_instruction, "        mov     eax, DWORD PTR %s",
-                  operand);
-    free(operand);  // don't forget to free the operand string
-                    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+    (void)sprintf(new_instruction, "        mov     eax, DWORD PTR [%s%d]",
+                  get_frame_register(), slot_to_memory_difference(node->slot));
+    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
     add_instruction(list, new_instruction);
   } else {
     (void)fprintf(stderr, "ERROR: Unknown AST node type\n");
@@ -231,168 +386,558 @@ void ast_variable_or_literal_node_to_x86(ast_node* node,
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
 }
 
+static int is_leaf(const ast_node* node) {
+  return node->type == AST_INT_LITERAL || node->type == AST_VARIABLE;
+}
+
+// Checks an expression or statement, and everything nested in it, for calls.
 // NOLINTNEXTLINE(misc-no-recursion)
-void ast_binary_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                            memory* mem, int first) {
-  DEBUG_PRINT("ast_binary_node_to_x86");
-  if (node->as.binary.right->type == AST_INT_LITERAL) {
-    ast_node* right_node = node->as.binary.right;
-    char* new_instruction = malloc(MAX_LINE_LENGTH);
-    if (!new_instruction) {
-      error_and_exit("malloc failed");
-    }
-    (void)sprintf(new_instruction, "        mov     edx, %d",
-                  right_node->as.int_literal.int_literal);
+static int contains_call(const ast_node* node) {
+  if (node == NULL) {
+    return 0;
+  }
+  switch (node->type) {
+    case AST_FUNCTION_CALL:
+      return 1;
+    case AST_BINARY:
+      return contains_call(node->as.binary.left) ||
+             contains_call(node->as.binary.right);
+    case AST_UNARY:
+      return contains_call(node->as.unary.operand);
+    case AST_DECLARATION:
+      return contains_call(node->as.declaration.expression);
+    case AST_RETURN:
+      return contains_call(node->as._return.expression);
+    case AST_IF_STATEMENT:
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      return contains_call(node->as.if_elif_else_statement.condition) ||
+             contains_call(node->as.if_elif_else_statement.body);
+    case AST_WHILE_STATEMENT:
+      return contains_call(node->as.while_statement.condition) ||
+             contains_call(node->as.while_statement.body);
+    case AST_BLOCK:
+      for (int i = 0; i < node->as.block.count; i++) {
+        if (contains_call(node->as.block.statements[i])) {
+          return 1;
+        }
+      }
+      return 0;
+    default:
+      return 0;
+  }
+}
 
-    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-    add_instruction(list, new_instruction);
-  } else if (node->as.binary.right->type == AST_VARIABLE) {
-    ast_node* right_node = node->as.binary.right;
-    char* operand = get_variable_memory_location_with_pointer(
-        mem, right_node->as.variable_name->lexeme,
-        right_node->as.variable_name->length);
+// Appends "mnemonic destination, source" in the usual column layout.
+static void add_two_operand_instruction(list_of_x86_instructions* list,
+                                        const char* mnemonic,
+                                        const char* destination,
+                                        const char* source) {
+  char* new_instruction = malloc(MAX_LINE_LENGTH);
+  if (!new_instruction) {
+    error_and_exit("malloc failed");
+  }
+  (void)snprintf(new_instruction, MAX_LINE_LENGTH, "        %-7s %s, %s",
+                 mnemonic, destination, source);
+  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+  add_instruction(list, new_instruction);
+}
 
-    char* new_instruction =
-        malloc(MAX_LINE_LENGTH);  // enough for full instruction line
-    if (!new_instruction) {
-      error_and_exit("malloc failed");
-    }
-    (void)sprintf(new_instruction, "        mov     edx, DWORD PTR %s",
-                  operand);
-    free(operand);  // don't forget to free the operand string
-                    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-    add_instruction(list, new_instruction);
+enum { OPERAND_LENGTH = 32 };
+
+// Formats a literal as an immediate or a variable as its stack slot.
+static void format_leaf_operand(char* operand, const ast_node* node) {
+  if (node->type == AST_INT_LITERAL) {
+    (void)sprintf(operand, "%d", node->as.int_literal.int_literal);
   } else {
-    // Add in what else to do if not literal
-    ast_binary_node_to_x86(node->as.binary.right, list, mem, 1);
+    (void)sprintf(operand, "DWORD PTR [%s%d]", get_frame_register(),
+                  slot_to_memory_difference(node->slot));
   }
-  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-  if (node->as.binary.left->type == AST_INT_LITERAL) {
-    ast_node* left_node = node->as.binary.left;
-    char* new_instruction = malloc(MAX_LINE_LENGTH);
-    if (!new_instruction) {
-      error_and_exit("malloc failed");
-    }
-    (void)sprintf(new_instruction, "        mov     eax, %d",
-                  left_node->as.int_literal.int_literal);
-    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-    add_instruction(list, new_instruction);
+}
 
-  } else if (node->as.binary.left->type == AST_VARIABLE) {
-    ast_node* left_node = node->as.binary.left;
-    char* operand = get_variable_memory_location_with_pointer(
-        mem, left_node->as.variable_name->lexeme,
-        left_node->as.variable_name->length);
+// Loads a literal or variable into a 32-bit register.
+static void add_leaf_load(ast_node* node, const char* register_name,
+                          list_of_x86_instructions* list) {
+  char operand[OPERAND_LENGTH];
+  format_leaf_operand(operand, node);
+  add_two_operand_instruction(list, "mov", register_name, operand);
+}
 
-    char* new_instruction =
-        malloc(MAX_LINE_LENGTH);  // enough for full instruction line
-    if (!new_instruction) {
-      error_and_exit("malloc failed");
-    }
-    (void)sprintf(new_instruction, "        mov     eax, DWORD PTR %s",
-                  operand);
-    free(operand);  // don't forget to free the operand string
+// ───── Expression Evaluation Order ─────
+
+// Scratch registers for expression temporaries. edx is left out so idiv can
+// always clobber it, and eax comes first so a whole expression ends in it.
+enum { EXPRESSION_REGISTER_COUNT = 8 };
+static const char* const expression_registers[EXPRESSION_REGISTER_COUNT] = {
+    "eax", "ecx", "esi", "edi", "r8d", "r9d", "r10d", "r11d"};
+static const char* const
+    expression_byte_registers[EXPRESSION_REGISTER_COUNT] = {
+        "al", "cl", "sil", "dil", "r8b", "r9b", "r10b", "r11b"};
+
+// A call clobbers every scratch register, so it needs more than there are.
+enum { CALL_REGISTER_NEED = EXPRESSION_REGISTER_COUNT + 1 };
+
+// Free scratch registers, as indexes into expression_registers. The top one
+// receives the next result; registers missing from the stack hold operands
+// still waiting for their operator.
+typedef struct register_stack {
+  int registers[EXPRESSION_REGISTER_COUNT];
+  int count;
+  int temporary_count;  // Memory temporaries in use past the variables.
+} register_stack;
+
+static const char* get_top_register(const register_stack* stack) {
+  return expression_registers[stack->registers[stack->count - 1]];
+}
 
-    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-    add_instruction(list, new_instruction);
+static void swap_top_registers(register_stack* stack) {
+  int top = stack->registers[stack->count - 1];
+  stack->registers[stack->count - 1] = stack->registers[stack->count - 2];
+  stack->registers[stack->count - 2] = top;
+}
+
+static int is_division(TokenType operator) {
+  return operator == TOKEN_SLASH || operator == TOKEN_PERCENT;
+}
+
+// Sethi-Ullman number: how many registers evaluating a node into a register
+// takes without spilling.
+static int get_register_need(const ast_node* node);
+
+// Registers the right operand of a binary node takes. A variable or literal
+// is used in place, except that idiv has no immediate form.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int get_right_operand_need(const ast_node* node) {
+  const ast_node* right = node->as.binary.right;
+  if (right->type == AST_VARIABLE ||
+      (right->type == AST_INT_LITERAL &&
+       !is_division(node->as.binary._operator))) {
+    return 0;
   }
+  return get_register_need(right);
+}
 
-  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-  if (first == 0) {
-    char* new_instruction =
-        malloc(MAX_LINE_LENGTH);  // enough for full instruction line
-    if (!new_instruction) {
-      error_and_exit("malloc failed");
+// NOLINTNEXTLINE(misc-no-recursion)
+static int get_register_need(const ast_node* node) {
+  switch (node->type) {
+    case AST_FUNCTION_CALL:
+      return CALL_REGISTER_NEED;
+    case AST_BINARY: {
+      int left_need = get_register_need(node->as.binary.left);
+      int right_need = get_right_operand_need(node);
+      if (left_need == right_need) {
+        return left_need + 1;
+      }
+      return left_need > right_need ? left_need : right_need;
     }
+    default:
+      return 1;
+  }
+}
 
-    (void)sprintf(new_instruction, "        %s     edx, eax",
-                  get_op_name(node->as.binary._operator));
-
-    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-    add_instruction(list, new_instruction);
+// Memory temporaries add_expression uses for a node when `available`
+// registers are free. Mirrors its choice of order.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int get_temporary_need(const ast_node* node, int available) {
+  if (node == NULL || node->type != AST_BINARY) {
+    return 0;
+  }
+  const ast_node* left = node->as.binary.left;
+  const ast_node* right = node->as.binary.right;
+  int left_need = get_register_need(left);
+  int right_need = get_right_operand_need(node);
+  int first = 0;
+  int second = 0;
+  if (right_need == 0) {
+    return get_temporary_need(left, available);
+  }
+  if (left_need >= available && right_need >= available) {
+    first = get_temporary_need(right, available);
+    second = 1 + get_temporary_need(left, available);
+  } else if (right_need > left_need) {
+    first = get_temporary_need(right, available);
+    second = get_temporary_need(left, available - 1);
   } else {
-    char* new_instruction =
-        malloc(MAX_LINE_LENGTH);  // enough for full instruction line
-    if (!new_instruction) {
-      error_and_exit("malloc failed");
+    first = get_temporary_need(left, available);
+    second = get_temporary_need(right, available - 1);
+  }
+  return first > second ? first : second;
+}
+
+// Largest get_temporary_need of any expression in a statement.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int get_statement_temporary_need(const ast_node* node) {
+  if (node == NULL) {
+    return 0;
+  }
+  const ast_node* expression = NULL;
+  switch (node->type) {
+    case AST_DECLARATION:
+      expression = node->as.declaration.expression;
+      break;
+    case AST_RETURN:
+      expression = node->as._return.expression;
+      break;
+    case AST_IF_STATEMENT:
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      expression = node->as.if_elif_else_statement.condition;
+      node = node->as.if_elif_else_statement.body;
+      break;
+    case AST_WHILE_STATEMENT:
+      expression = node->as.while_statement.condition;
+      node = node->as.while_statement.body;
+      break;
+    default:
+      break;
+  }
+  int need = get_temporary_need(expression, EXPRESSION_REGISTER_COUNT);
+  if (node != NULL && node->type == AST_BLOCK) {
+    for (int i = 0; i < node->as.block.count; i++) {
+      int statement_need =
+          get_statement_temporary_need(node->as.block.statements[i]);
+      need = statement_need > need ? statement_need : need;
     }
-    (void)sprintf(new_instruction, "        %s     eax, edx",
-                  get_op_name(node->as.binary._operator));
+  }
+  return need;
+}
 
-    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-    add_instruction(list, new_instruction);
+// Appends "mnemonic operand" in the usual column layout.
+static void add_one_operand_instruction(list_of_x86_instructions* list,
+                                        const char* mnemonic,
+                                        const char* operand) {
+  char* new_instruction = malloc(MAX_LINE_LENGTH);
+  if (!new_instruction) {
+    error_and_exit("malloc failed");
   }
+  (void)snprintf(new_instruction, MAX_LINE_LENGTH, "        %-7s %s",
+                 mnemonic, operand);
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+  add_instruction(list, new_instruction);
 }
 
-void ast_variable_declaration_node_to_x86(ast_node* node, memory* mem) {
-  char* variable_name =
-      malloc((unsigned long)node->as.variable_declaration.name->length +
-             (unsigned long)1);
-  if (!variable_name) {
-    error_and_exit("malloc failed");
+// Computes target = target / divisor or target % divisor. idiv divides
+// edx:eax, so unless the dividend is already in eax it is exchanged with
+// whatever eax holds, which is exchanged back afterwards.
+static void add_division(TokenType operator, const char* target,
+                         const char* divisor, list_of_x86_instructions* list) {
+  const char* result = operator == TOKEN_SLASH ? "eax" : "edx";
+  if (strcmp(target, "eax") == 0) {
+    add_instruction(list, "        cdq");
+    add_one_operand_instruction(list, "idiv", divisor);
+    if (strcmp(result, "eax") != 0) {
+      add_two_operand_instruction(list, "mov", "eax", result);
+    }
     return;
   }
-  strncpy(variable_name, node->as.variable_declaration.name->lexeme,
-          (size_t)node->as.variable_declaration.name->length);
-  variable_name[node->as.variable_declaration.name->length] = '\0';
-  add_variable_to_memory(mem, variable_name);
+  add_two_operand_instruction(list, "xchg", "eax", target);
+  if (strcmp(divisor, "eax") == 0) {
+    // The divisor was in eax, so the exchange moved it into the target.
+    add_instruction(list, "        cdq");
+    add_one_operand_instruction(list, "idiv", target);
+    add_two_operand_instruction(list, "mov", target, result);
+    return;
+  }
+  add_instruction(list, "        cdq");
+  add_one_operand_instruction(list, "idiv", divisor);
+  if (strcmp(result, "eax") != 0) {
+    add_two_operand_instruction(list, "mov", "eax", result);
+  }
+  add_two_operand_instruction(list, "xchg", "eax", target);
 }
 
-void ast_declaration_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                                 memory* mem) {
-  DEBUG_PRINT("In ast_declaration_node_to_x86 function\n");
-  char* variable_location_string = NULL;
-  if (node->as.declaration.variable->type == AST_VARIABLE_DECLARATION) {
-    ast_variable_declaration_node_to_x86(node->as.declaration.variable, mem);
-    variable_location_string = get_variable_memory_location_with_pointer(
-        mem,
-        node->as.declaration.variable->as.variable_declaration.name->lexeme,
-        node->as.declaration.variable->as.variable_declaration.name->length);
-  } else if (node->as.declaration.variable->type == AST_VARIABLE) {
-    variable_location_string = get_variable_memory_location_with_pointer(
-        mem, node->as.declaration.variable->as.variable_name->lexeme,
-        node->as.declaration.variable->as.variable_name->length);
+// Materializes a comparison as 0 or 1 in the target register.
+static void add_comparison_value(const char* condition, const char* target,
+                                 const char* operand,
+                                 list_of_x86_instructions* list) {
+  const char* byte_register = NULL;
+  for (int i = 0; i < EXPRESSION_REGISTER_COUNT; i++) {
+    if (strcmp(target, expression_registers[i]) == 0) {
+      byte_register = expression_byte_registers[i];
+    }
+  }
+  char mnemonic[OPERAND_LENGTH];
+  (void)sprintf(mnemonic, "set%s", condition);
+  add_two_operand_instruction(list, "cmp", target, operand);
+  add_one_operand_instruction(list, mnemonic, byte_register);
+  add_two_operand_instruction(list, "movzx", target, byte_register);
+}
+
+static void add_operation(TokenType operator, const char* target,
+                          const char* operand,
+                          list_of_x86_instructions* list) {
+  if (is_division(operator)) {
+    add_division(operator, target, operand, list);
+    return;
+  }
+  const char* condition = get_condition_code(operator, 0);
+  if (condition != NULL) {
+    add_comparison_value(condition, target, operand, list);
+    return;
+  }
+  const char* mnemonic = get_op_name(operator);
+  if (strcmp(mnemonic, "UNKNOWN_OP") == 0) {
+    error_and_exit("Error: Unsupported operator\n");
+  }
+  add_two_operand_instruction(list, mnemonic, target, operand);
+}
+
+static void add_expression(ast_node* node, register_stack* stack,
+                           list_of_x86_instructions* list);
+
+// Evaluates the left side of a binary node into the register on top of the
+// stack and writes where the right side's value can be read to `operand`.
+// Each side that is more demanding goes first, so the other side still
+// finds enough free registers; when neither side fits next to the other,
+// the right value waits in a memory temporary instead. Returns 1 if it
+// took a temporary, which the caller releases after reading the operand.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int add_operands(ast_node* node, register_stack* stack, char* operand,
+                        list_of_x86_instructions* list) {
+  const char* target = get_top_register(stack);
+  ast_node* left = node->as.binary.left;
+  ast_node* right = node->as.binary.right;
+  int available = stack->count;
+  int left_need = get_register_need(left);
+  int right_need = get_right_operand_need(node);
+  if (right_need == 0) {
+    add_expression(left, stack, list);
+    format_leaf_operand(operand, right);
+  } else if (left_need >= available && right_need >= available) {
+    add_expression(right, stack, list);
+    int temporary = stack->temporary_count++;
+    (void)sprintf(operand, "DWORD PTR [%s%d]", get_frame_register(),
+                  slot_to_memory_difference(current_frame.temporary_slot +
+                                            temporary));
+    add_two_operand_instruction(list, "mov", operand, target);
+    add_expression(left, stack, list);
+    return 1;
+  } else if (right_need > left_need) {
+    // The right value goes to the second register, so the result still
+    // lands in the top one.
+    swap_top_registers(stack);
+    add_expression(right, stack, list);
+    int right_register = stack->registers[--stack->count];
+    add_expression(left, stack, list);
+    stack->registers[stack->count++] = right_register;
+    swap_top_registers(stack);
+    (void)strcpy(operand, expression_registers[right_register]);
   } else {
+    add_expression(left, stack, list);
+    int left_register = stack->registers[--stack->count];
+    add_expression(right, stack, list);
+    (void)strcpy(operand, get_top_register(stack));
+    stack->registers[stack->count++] = left_register;
+  }
+  return 0;
+}
+
+// Evaluates an expression into the register on top of the stack, leaving
+// every register off the stack untouched. A call needs more registers than
+// there are, so it is only ever evaluated with none of them held.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void add_expression(ast_node* node, register_stack* stack,
+                           list_of_x86_instructions* list) {
+  const char* target = get_top_register(stack);
+  if (node->type == AST_FUNCTION_CALL) {
+    ast_function_call_node_to_x86(node, list);
+    if (strcmp(target, "eax") != 0) {
+      add_two_operand_instruction(list, "mov", target, "eax");
+    }
+    return;
+  }
+  if (node->type != AST_BINARY) {
+    add_leaf_load(node, target, list);
+    return;
+  }
+  char operand[OPERAND_LENGTH];
+  int temporary = add_operands(node, stack, operand, list);
+  add_operation(node->as.binary._operator, target, operand, list);
+  stack->temporary_count -= temporary;
+}
+
+// Starts with every scratch register free and eax on top.
+static void init_register_stack(register_stack* stack) {
+  stack->count = EXPRESSION_REGISTER_COUNT;
+  stack->temporary_count = 0;
+  for (int i = 0; i < EXPRESSION_REGISTER_COUNT; i++) {
+    stack->registers[i] = EXPRESSION_REGISTER_COUNT - 1 - i;
+  }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void ast_binary_node_to_x86(ast_node* node, list_of_x86_instructions* list) {
+  DEBUG_PRINT("ast_binary_node_to_x86");
+  register_stack stack;
+  init_register_stack(&stack);
+  add_expression(node, &stack, list);
+}
+
+void ast_declaration_node_to_x86(ast_node* node,
+                                 list_of_x86_instructions* list) {
+  DEBUG_PRINT("In ast_declaration_node_to_x86 function\n");
+  if (node->as.declaration.variable->type != AST_VARIABLE_DECLARATION &&
+      node->as.declaration.variable->type != AST_VARIABLE) {
     error_and_exit("Error: Not a variable node\n");
   }
 
-  ast_variable_literal_or_binary_to_x86(node->as.declaration.expression, list,
-                                        mem);
+  ast_variable_literal_or_binary_to_x86(node->as.declaration.expression, list);
 
-  print_memory(mem);
   char* new_instruction =
       malloc(MAX_LINE_LENGTH);  // enough for full instruction line
   if (!new_instruction) {
     error_and_exit("malloc failed");
   }
 
-  (void)sprintf(new_instruction, "        mov     DWORD PTR %s, eax",
-                variable_location_string);
-  free(variable_location_string);
+  (void)sprintf(new_instruction, "        mov     DWORD PTR [%s%d], eax",
+                get_frame_register(),
+                slot_to_memory_difference(node->as.declaration.variable->slot));
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
   add_instruction(list, new_instruction);
 }
 
 // NOLINTNEXTLINE(misc-no-recursion)
-void ast_return_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                            memory* mem) {
+void ast_return_node_to_x86(ast_node* node, list_of_x86_instructions* list) {
   DEBUG_PRINT("In Return Node\n");
 
-  ast_statement_node_to_x86(node->as._return.expression, list, mem);
+  ast_variable_literal_or_binary_to_x86(node->as._return.expression, list);
   char* new_instruction = NULL;  //= malloc(MAX_LINE_LENGTH);
 
-  new_instruction = "        pop     rbp";
+  if (current_frame.has_frame) {
+    if (current_frame.size > 0) {
+      // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+      add_instruction(list, "        mov     rsp, rbp");
+    }
+    new_instruction = "        pop     rbp";
+    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+    add_instruction(list, new_instruction);
+  }
+  new_instruction = "        ret";
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
   add_instruction(list, new_instruction);
-  new_instruction = "        ret";
+}
+
+// ───── Control Flow ─────
+
+// Labels are numbered per function and prefixed with its name, so they stay
+// unique across the functions of a file.
+static int new_label(void) { return current_frame.next_label++; }
+
+static void format_label(char* label, int number) {
+  (void)sprintf(label, ".L%.*s_%d", current_frame.name->length,
+                current_frame.name->lexeme, number);
+}
+
+static void add_label(int number, list_of_x86_instructions* list) {
+  char label[OPERAND_LENGTH];
+  format_label(label, number);
+  char* new_instruction = malloc(MAX_LINE_LENGTH);
+  if (!new_instruction) {
+    error_and_exit("malloc failed");
+  }
+  (void)snprintf(new_instruction, MAX_LINE_LENGTH, "%s:", label);
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
   add_instruction(list, new_instruction);
 }
 
+static void add_jump(const char* mnemonic, int number,
+                     list_of_x86_instructions* list) {
+  char label[OPERAND_LENGTH];
+  format_label(label, number);
+  add_one_operand_instruction(list, mnemonic, label);
+}
+
+// Jumps to a label when the condition is `when` (1 for true, 0 for false).
+// A comparison sets the flags with its own cmp right before the jcc, so the
+// pair macro-fuses and no boolean is materialized; any other condition is
+// evaluated into eax and tested against zero.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void add_condition_jump(ast_node* condition, int when, int label,
+                               list_of_x86_instructions* list) {
+  const char* code = NULL;
+  if (condition->type == AST_BINARY) {
+    code = get_condition_code(condition->as.binary._operator, !when);
+  }
+  char mnemonic[OPERAND_LENGTH];
+  if (code != NULL) {
+    register_stack stack;
+    init_register_stack(&stack);
+    char operand[OPERAND_LENGTH];
+    add_operands(condition, &stack, operand, list);
+    add_two_operand_instruction(list, "cmp", get_top_register(&stack),
+                                operand);
+    (void)sprintf(mnemonic, "j%s", code);
+  } else {
+    ast_variable_literal_or_binary_to_x86(condition, list);
+    add_two_operand_instruction(list, "test", "eax", "eax");
+    (void)sprintf(mnemonic, "j%s", when ? "ne" : "e");
+  }
+  add_jump(mnemonic, label, list);
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static int ends_with_return(const ast_node* node) {
+  if (node != NULL && node->type == AST_BLOCK && node->as.block.count > 0) {
+    int last = node->as.block.count - 1;
+    return ends_with_return(node->as.block.statements[last]);
+  }
+  return node != NULL && node->type == AST_RETURN;
+}
+
+static int is_else_arm(const ast_node* node) {
+  return node != NULL && (node->type == AST_ELSE_IF_STATEMENT ||
+                          node->type == AST_ELSE_STATEMENT);
+}
+
+// Generates an if statement together with the else-if and else statements
+// that follow it in the same block. Each arm's test jumps past the arm when
+// it fails. Returns how many statements it used.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int add_if_chain(ast_node** statements, int count,
+                        list_of_x86_instructions* list) {
+  int end_label = -1;
+  int used = 0;
+  while (used < count && (used == 0 || is_else_arm(statements[used]))) {
+    ast_node* arm = statements[used++];
+    if (arm->type == AST_ELSE_STATEMENT) {
+      ast_statement_node_to_x86(arm->as.if_elif_else_statement.body, list);
+      break;
+    }
+    int next_label = new_label();
+    add_condition_jump(arm->as.if_elif_else_statement.condition, 0,
+                       next_label, list);
+    ast_statement_node_to_x86(arm->as.if_elif_else_statement.body, list);
+    if (used < count && is_else_arm(statements[used]) &&
+        !ends_with_return(arm->as.if_elif_else_statement.body)) {
+      if (end_label < 0) {
+        end_label = new_label();
+      }
+      add_jump("jmp", end_label, list);
+    }
+    add_label(next_label, list);
+  }
+  if (end_label >= 0) {
+    add_label(end_label, list);
+  }
+  return used;
+}
+
+// Rotates the loop so its test sits at the bottom: the entry jumps down to
+// the test once, and every iteration after that ends in a single jcc back to
+// the body.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void add_while(ast_node* node, list_of_x86_instructions* list) {
+  int body_label = new_label();
+  int test_label = new_label();
+  add_jump("jmp", test_label, list);
+  add_label(body_label, list);
+  ast_statement_node_to_x86(node->as.while_statement.body, list);
+  add_label(test_label, list);
+  add_condition_jump(node->as.while_statement.condition, 1, body_label, list);
+}
+
 // NOLINTNEXTLINE(misc-no-recursion)
-void ast_statement_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                               memory* mem) {
+void ast_statement_node_to_x86(ast_node* node, list_of_x86_instructions* list) {
   DEBUG_PRINT("In Statement Node\n");
   if (node == NULL) {
     DEBUG_PRINT("NULL NODE\n");
@@ -404,27 +949,40 @@ void ast_statement_node_to_x86(ast_node* node, list_of_x86_instructions* list,
     case AST_INT_LITERAL:
 
       DEBUG_PRINT("In Int Literal Node\n");
-      ast_variable_or_literal_node_to_x86(node, list, mem);
+      ast_variable_or_literal_node_to_x86(node, list);
       break;
     case AST_DECLARATION:
 
       DEBUG_PRINT("In Declaration Node\n");
-      ast_declaration_node_to_x86(node, list, mem);
+      ast_declaration_node_to_x86(node, list);
       break;
     case AST_VARIABLE_DECLARATION:
 
+      // The resolver already bound its slot; nothing to emit.
       DEBUG_PRINT("In Variable Declaration Node\n");
-      ast_variable_declaration_node_to_x86(node, mem);
       break;
     case AST_FUNCTION_CALL:
 
       DEBUG_PRINT("In Function Call\n");
-      ast_function_call_node_to_x86(node, list, mem);
+      ast_function_call_node_to_x86(node, list);
       break;
     case AST_RETURN:
 
       DEBUG_PRINT("In Return Statement\n");
-      ast_return_node_to_x86(node, list, mem);
+      ast_return_node_to_x86(node, list);
+      break;
+    case AST_IF_STATEMENT:
+      add_if_chain(&node, 1, list);
+      break;
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      error_and_exit("Error: else without a matching if\n");
+      break;
+    case AST_WHILE_STATEMENT:
+      add_while(node, list);
+      break;
+    case AST_BLOCK:
+      ast_block_node_to_x86(node, list);
       break;
     default:
 
@@ -433,21 +991,29 @@ void ast_statement_node_to_x86(ast_node* node, list_of_x86_instructions* list,
   }
 }
 
-void ast_block_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                           memory* mem) {
+// NOLINTNEXTLINE(misc-no-recursion)
+void ast_block_node_to_x86(ast_node* node, list_of_x86_instructions* list) {
   DEBUG_PRINT("In blocknode%d\n", node->as.block.count);
-  for (int i = 0; i < node->as.block.count; i++) {
+  for (int i = 0; i < node->as.block.count;) {
     DEBUG_PRINT("Blocknode: %d\n", i);
-
-    ast_statement_node_to_x86(node->as.block.statements[i], list, mem);
+    ast_node* statement = node->as.block.statements[i];
+    if (statement != NULL && statement->type == AST_IF_STATEMENT) {
+      i += add_if_chain(&node->as.block.statements[i], node->as.block.count - i,
+                        list);
+    } else {
+      ast_statement_node_to_x86(statement, list);
+      i++;
+    }
   }
 }
 
 // NOLINTNEXTLINE(misc-no-recursion)
 void ast_function_call_node_to_x86(ast_node* node,
-                                   list_of_x86_instructions* list,
-                                   memory* mem) {
+                                   list_of_x86_instructions* list) {
   DEBUG_PRINT("In Function Call\n");
+  if (node->as.function_call.param_count > ARGUMENT_REGISTER_COUNT) {
+    error_and_exit("Error: Too many arguments in function call\n");
+  }
 
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
   for (int i = 0; i < node->as.function_call.param_count; i++) {
@@ -457,8 +1023,12 @@ void ast_function_call_node_to_x86(ast_node* node,
           "%d",
           node->as.function_call.parameters[i]->as.int_literal.int_literal);
     }
-    ast_variable_literal_or_binary_to_x86(node->as.function_call.parameters[i],
-                                          list, mem);
+    ast_node* parameter = node->as.function_call.parameters[i];
+    if (is_leaf(parameter)) {
+      add_leaf_load(parameter, get_low_linux_registers_name(i), list);
+      continue;
+    }
+    ast_variable_literal_or_binary_to_x86(parameter, list);
 
     DEBUG_PRINT("1\n");
     char* new_instruction = malloc(MAX_LINE_LENGTH);
@@ -517,8 +1087,12 @@ void ast_function_node_to_x86(ast_node* node, list_of_x86_instructions* list) {
   if (node->type != AST_FUNCTION_DECLARATION) {
     error_and_exit("Error: Not a function node\n");
   }
-  memory* mem = malloc(sizeof(memory));
-  init_memory(mem);
+  if (node->as.function.param_count > ARGUMENT_REGISTER_COUNT) {
+    error_and_exit("Error: Too many parameters\n");
+  }
+  if (node->as.function.slot_count < 0) {
+    resolve_function_variables(node);
+  }
   if (strncmp(node->as.function.name->lexeme, "main", strlen("main")) == 0) {
     char* new_instruction = "main:";
     // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
@@ -564,52 +1138,174 @@ void ast_function_node_to_x86(ast_node* node, list_of_x86_instructions* list) {
     // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
     add_instruction(list, new_instruction);
   }
-  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-  char* new_instruction = "        push    rbp";
-  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-  add_instruction(list, new_instruction);
-  new_instruction = "        mov     rbp, rsp";
-  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-  add_instruction(list, new_instruction);
+  // Calls need rsp below the slots and 16-byte aligned, so only a leaf
+  // function may leave its slots in the red zone. Expression temporaries
+  // take the slots past the variables.
+  current_frame.temporary_slot = node->as.function.slot_count;
+  current_frame.name = node->as.function.name;
+  current_frame.next_label = 0;
+  int slot_bytes =
+      4 * (node->as.function.slot_count +
+           get_statement_temporary_need(node->as.function.statements));
+  current_frame.has_frame = contains_call(node->as.function.statements) ||
+                            slot_bytes > RED_ZONE_SIZE;
+  current_frame.size = 0;
+  char* new_instruction = NULL;
+  if (current_frame.has_frame) {
+    current_frame.size = (slot_bytes + STACK_ALIGNMENT - 1) /
+                         STACK_ALIGNMENT * STACK_ALIGNMENT;
+    new_instruction = "        push    rbp";
+    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+    add_instruction(list, new_instruction);
+    new_instruction = "        mov     rbp, rsp";
+    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+    add_instruction(list, new_instruction);
+  }
+  if (current_frame.size > 0) {
+    new_instruction = malloc(MAX_LINE_LENGTH);
+    if (!new_instruction) {
+      error_and_exit("malloc failed");
+    }
+    (void)sprintf(new_instruction, "        sub     rsp, %d",
+                  current_frame.size);
+    // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+    add_instruction(list, new_instruction);
+  }
 
   for (int i = 0; i < node->as.function.param_count; i++) {
-    char* variable_name = malloc((unsigned long)node->as.function.parameters[i]
-                                     ->as.variable_declaration.name->length +
-                                 (unsigned long)1);
-    if (!variable_name) {
-      free((void*)mem);
+    new_instruction = malloc(MAX_LINE_LENGTH);
+    if (!new_instruction) {
       error_and_exit("malloc failed");
-      return;
     }
-    strncpy(
-        variable_name,
-        node->as.function.parameters[i]->as.variable_declaration.name->lexeme,
-        (size_t)node->as.function.parameters[i]
-            ->as.variable_declaration.name->length);
-    variable_name[node->as.function.parameters[i]
-                      ->as.variable_declaration.name->length] = '\0';
-    add_variable_to_memory(mem, variable_name);
-    char* var_loc_with_pointer = get_variable_memory_location_with_pointer(
-        mem,
-        node->as.function.parameters[i]->as.variable_declaration.name->lexeme,
-        node->as.function.parameters[i]->as.variable_declaration.name->length);
-    new_instruction = malloc(MAX_LINE_LENGTH);
-    (void)sprintf(new_instruction, "        mov     DWORD PTR %s, %s",
-                  var_loc_with_pointer, get_low_linux_registers_name(i));
+    (void)sprintf(new_instruction, "        mov     DWORD PTR [%s%d], %s",
+                  get_frame_register(),
+                  slot_to_memory_difference(
+                      node->as.function.parameters[i]->slot),
+                  get_low_linux_registers_name(i));
     // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
     add_instruction(list, new_instruction);
-    free(var_loc_with_pointer);
   }
 
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
-  ast_block_node_to_x86(node->as.function.statements, list, mem);
-  free((void*)mem);
+  ast_block_node_to_x86(node->as.function.statements, list);
 }
 
-void list_of_ast_function_nodes_to_x86(ast_node** nodes,
-                                       list_of_x86_instructions* list,
-                                       int numberOfFunctions) {
-  DEBUG_PRINT("Going through %d functions.\n", numberOfFunctions);
+// ───── Name Resolution ─────
+
+static char* copy_token_name(const Token* name) {
+  char* variable_name = malloc((size_t)name->length + 1);
+  if (!variable_name) {
+    error_and_exit("malloc failed");
+    return NULL;
+  }
+  memcpy(variable_name, name->lexeme, (size_t)name->length);
+  variable_name[name->length] = '\0';
+  return variable_name;
+}
+
+static void bind_variable_declaration(ast_node* node, memory* mem,
+                                      int* slot_count) {
+  add_variable_to_memory(
+      mem, copy_token_name(node->as.variable_declaration.name));
+  node->slot = memory_difference_to_slot(
+      mem->variables[mem->number_of_variables - 1].memory_difference);
+  if (node->slot + 1 > *slot_count) {
+    *slot_count = node->slot + 1;
+  }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static void resolve_node_variables(ast_node* node, memory* mem,
+                                   int* slot_count) {
+  if (node == NULL) {
+    return;
+  }
+  switch (node->type) {
+    case AST_VARIABLE: {
+      int memory_difference = get_variable_memory_location(
+          mem, node->as.variable_name->lexeme, node->as.variable_name->length);
+      if (memory_difference == -1) {
+        (void)fprintf(stderr, "Error: Use of undeclared variable '%.*s'\n",
+                      node->as.variable_name->length,
+                      node->as.variable_name->lexeme);
+        error_and_exit("");
+      }
+      node->slot = memory_difference_to_slot(memory_difference);
+      break;
+    }
+    case AST_VARIABLE_DECLARATION:
+      bind_variable_declaration(node, mem, slot_count);
+      break;
+    case AST_DECLARATION:
+      resolve_node_variables(node->as.declaration.variable, mem, slot_count);
+      resolve_node_variables(node->as.declaration.expression, mem, slot_count);
+      break;
+    case AST_BINARY:
+      resolve_node_variables(node->as.binary.left, mem, slot_count);
+      resolve_node_variables(node->as.binary.right, mem, slot_count);
+      break;
+    case AST_UNARY:
+      resolve_node_variables(node->as.unary.operand, mem, slot_count);
+      break;
+    case AST_FUNCTION_CALL:
+      for (int i = 0; i < node->as.function_call.param_count; i++) {
+        resolve_node_variables(node->as.function_call.parameters[i], mem,
+                               slot_count);
+      }
+      break;
+    case AST_RETURN:
+      resolve_node_variables(node->as._return.expression, mem, slot_count);
+      break;
+    case AST_IF_STATEMENT:
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      resolve_node_variables(node->as.if_elif_else_statement.condition, mem,
+                             slot_count);
+      resolve_node_variables(node->as.if_elif_else_statement.body, mem,
+                             slot_count);
+      break;
+    case AST_WHILE_STATEMENT:
+      resolve_node_variables(node->as.while_statement.condition, mem,
+                             slot_count);
+      resolve_node_variables(node->as.while_statement.body, mem, slot_count);
+      break;
+    case AST_BLOCK:
+      push_memory_scope(mem);
+      for (int i = 0; i < node->as.block.count; i++) {
+        resolve_node_variables(node->as.block.statements[i], mem, slot_count);
+      }
+      pop_memory_scope(mem);
+      break;
+    default:
+      break;
+  }
+}
+
+void resolve_function_variables(ast_node* function) {
+  if (function->type != AST_FUNCTION_DECLARATION) {
+    error_and_exit("Error: Not a function node\n");
+  }
+  memory mem;
+  init_memory(&mem);
+  int slot_count = 0;
+  for (int i = 0; i < function->as.function.param_count; i++) {
+    bind_variable_declaration(function->as.function.parameters[i], &mem,
+                              &slot_count);
+  }
+  resolve_node_variables(function->as.function.statements, &mem, &slot_count);
+  function->as.function.slot_count = slot_count;
+  free_memory(&mem);
+}
+
+void resolve_variables(ast_node** nodes, int number_of_functions) {
+  for (int i = 0; i < number_of_functions; i++) {
+    if (nodes[i] != NULL) {
+      resolve_function_variables(nodes[i]);
+    }
+  }
+}
+
+void add_start_stub(list_of_x86_instructions* list) {
   char* new_instruction = ".intel_syntax noprefix";
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
   add_instruction(list, new_instruction);
@@ -634,6 +1330,13 @@ void list_of_ast_function_nodes_to_x86(ast_node** nodes,
   new_instruction = "    syscall";
   // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
   add_instruction(list, new_instruction);
+}
+
+void list_of_ast_function_nodes_to_x86(ast_node** nodes,
+                                       list_of_x86_instructions* list,
+                                       int numberOfFunctions) {
+  DEBUG_PRINT("Going through %d functions.\n", numberOfFunctions);
+  add_start_stub(list);
 
   for (int i = 0; i < numberOfFunctions; ++i) {
     if (nodes[i] != NULL) {
@@ -660,8 +1363,8 @@ void print_instructions(list_of_x86_instructions* list) {
 void print_memory(memory* mem) {
   DEBUG_PRINT("Memory Layout (%d variable(s)):\n", mem->number_of_variables);
   for (int i = 0; i < mem->number_of_variables; i++) {
-    printf("  %s -> [rbp-%d]\n", mem->variables[i]->variable_name,
-           mem->variables[i]->memory_difference * -1);  // make offset positive
+    printf("  %s -> [rbp-%d]\n", mem->variables[i].variable_name,
+           mem->variables[i].memory_difference * -1);  // make offset positive
   }
 }
 
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,14 +9,32 @@
 
 typedef struct variable_in_memory {
   char* variable_name;
+  int name_length;
+  unsigned int hash;
   int memory_difference;
   int variable_type;
+  int shadowed_variable;  // Index of the outer variable this one hides, or -1.
 } variable_in_memory;
 
+// One open-addressing slot per distinct name. `variable` is the index of the
+// innermost visible declaration of that name, or -1 once its scope is popped.
+typedef struct memory_bucket {
+  char* name;
+  int name_length;
+  unsigned int hash;
+  int variable;
+} memory_bucket;
+
 typedef struct memory {
-  variable_in_memory** variables;
+  variable_in_memory* variables;  // Stored inline, in declaration order.
   int variable_capacity;
   int number_of_variables;
+  memory_bucket* buckets;  // Capacity is always a power of two.
+  int bucket_capacity;
+  int number_of_buckets_used;
+  int* scope_starts;  // number_of_variables when each open scope was pushed.
+  int scope_capacity;
+  int scope_depth;
   int next_starting_location;
 } memory;
 
@@ -46,50 +66,75 @@ Returns:
 void init_memory(memory* mem);
 
 /*
-Adds a variable to the memory tracking system.
+Releases everything owned by a memory struct, including variable names.
+
+Args:
+  mem: Pointer to memory struct.
+
+Returns:
+  void
+*/
+void free_memory(memory* mem);
 
-Stores its name and stack offset in the memory table.
+/*
+Opens a new block scope in the memory table.
+
+Variables added after this call shadow outer variables of the same name until
+the matching pop_memory_scope.
 
 Args:
   mem: Pointer to memory struct.
-  variable_name: Name of the variable to add.
 
 Returns:
   void
 */
-void add_variable_to_memory(memory* mem, char* variable_name);
+void push_memory_scope(memory* mem);
 
 /*
-Finds the stack memory location of a variable.
+Closes the innermost block scope.
 
-Searches the memory table for a variable name and returns its offset.
+Removes every variable declared since the matching push_memory_scope, makes
+any shadowed outer variables visible again, and lets later declarations reuse
+the freed stack slots.
 
 Args:
   mem: Pointer to memory struct.
-  lexeme: Name of the variable.
-  length: Length of the variable name.
 
 Returns:
-  Stack offset (int) if found, or 0 if not found.
+  void
 */
-int get_variable_memory_location(memory* mem, const char* lexeme, int length);
+void pop_memory_scope(memory* mem);
 
 /*
-Generates the memory address string for a variable (e.g., [rbp-4]).
+Adds a variable to the memory tracking system.
 
-Creates a string suitable for use in x86 assembly from a variable's memory
-offset.
+Stores its name and stack offset in the memory table. The table takes
+ownership of `variable_name`.
 
 Args:
   mem: Pointer to memory struct.
-  lexeme: Variable name.
-  length: Length of variable name.
+  variable_name: Name of the variable to add.
 
 Returns:
-  String with formatted memory address.
+  void
 */
-char* get_variable_memory_location_with_pointer(memory* mem, const char* lexeme,
-                                                int length);
+void add_variable_to_memory(memory* mem, char* variable_name);
+
+/*
+Finds the stack memory location of a variable.
+
+Looks the name up in the hashed memory table and returns the offset of the
+innermost visible declaration.
+
+Args:
+  mem: Pointer to memory struct.
+  lexeme: Name of the variable.
+  length: Length of the variable name.
+
+Returns:
+  Stack offset (int) if found, or -1 if not found.
+*/
+int get_variable_memory_location(memory* mem, const char* lexeme, int length);
 
 /*
 Initializes a list to hold x86 instructions.
@@ -142,128 +187,113 @@ Dispatches to specialized handlers based on node type.
 Args:
   node: Pointer to the AST node.
   list: List of generated x86 instructions.
-  mem: Variable memory tracking struct.
 
 Returns:
   void
 */
 void ast_variable_literal_or_binary_to_x86(ast_node* node,
-                                           list_of_x86_instructions* list,
-                                           memory* mem);
+                                           list_of_x86_instructions* list);
 
 /*
 Generates x86 code from either a variable or a literal.
 
 Used when the node type is guaranteed to be a simple operand.
 
+Variables are read straight from the stack slot the resolver bound to them.
+
 Args:
   node: ast_node representing the operand.
   list: Instruction list.
-  mem: Memory state.
 
 Returns:
   void
 */
 void ast_variable_or_literal_node_to_x86(ast_node* node,
-                                         list_of_x86_instructions* list,
-                                         memory* mem);
+                                         list_of_x86_instructions* list);
 
 /*
-Generates x86 code for a binary expression.
-
-Evaluates left and right subtrees and emits the appropriate assembly based on
-the operator.
+Generates x86 code for a binary expression, leaving the result in eax.
+
+Registers come from a pool of caller-saved scratch registers (eax, ecx, esi,
+edi and r8d-r11d). Each subtree's Sethi-Ullman number, the registers it
+needs, decides the order: the more demanding side is evaluated first, so
+the other side's evaluation still finds enough free registers. Variables
+and literals on the right are used in place as memory operands and
+immediates. When neither side fits next to the other, which includes calls
+on both sides, the right value waits in a stack temporary. Division and
+modulo go through eax and edx as idiv requires, and a comparison becomes
+cmp, setcc and movzx.
 
 Args:
   node: AST_BINARY node.
   list: Instruction list.
-  mem: Memory context.
-  first: Flag to indicate if this is the root binary node in an expression.
-
-Returns:
-  void
-*/
-void ast_binary_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                            memory* mem, int first);
-
-/*
-Generates x86 code for a variable declaration.
-
-Emits memory allocation and possibly initialization for declared variables.
-
-Args:
-  node: AST_VARIABLE_DECLARATION node.
-  list: Instruction list.
-  mem: Memory context.
 
 Returns:
   void
 */
-void ast_variable_declaration_node_to_x86(ast_node* node, memory* mem);
+void ast_binary_node_to_x86(ast_node* node, list_of_x86_instructions* list);
 
 /*
 Generates x86 code for a full declaration (type + assignment).
 
-Handles both memory allocation and assignment logic.
+Evaluates the expression and stores it into the variable's stack slot.
 
 Args:
   node: AST_DECLARATION node.
   list: Instruction list.
-  mem: Memory context.
 
 Returns:
   void
 */
-void ast_declaration_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                                 memory* mem);
+void ast_declaration_node_to_x86(ast_node* node,
+                                 list_of_x86_instructions* list);
 
 /*
 Generates x86 code for a return statement.
 
-Loads the return value into the appropriate register and emits `ret`.
+Loads the return value into the appropriate register, tears down the
+function's frame if it has one, and emits `ret`.
 
 Args:
   node: AST_RETURN node.
   list: Instruction list.
-  mem: Memory context.
 
 Returns:
   void
 */
-void ast_return_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                            memory* mem);
+void ast_return_node_to_x86(ast_node* node, list_of_x86_instructions* list);
 
 /*
 Generates x86 instructions for a general AST statement.
 
-Dispatches based on the node type to the appropriate handler.
+Dispatches based on the node type to the appropriate handler. A branch on a
+comparison emits the cmp right before the jcc so the two macro-fuse, and
+any other condition is tested with test. While loops are rotated: the entry
+jumps to the test at the bottom, which branches back to the body.
 
 Args:
   node: AST statement node.
   list: Instruction list.
-  mem: Memory context.
 
 Returns:
   void
 */
-void ast_statement_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                               memory* mem);
+void ast_statement_node_to_x86(ast_node* node, list_of_x86_instructions* list);
 
 /*
 Generates x86 code for a block of statements.
 
-Sequentially emits instructions for each node in the block.
+Sequentially emits instructions for each node in the block, taking an if
+statement together with the else-if and else statements that follow it.
 
 Args:
   node: AST_BLOCK node.
   list: Instruction list.
-  mem: Memory context.
 
 Returns:
   void
 */
-void ast_block_node_to_x86(ast_node* node, list_of_x86_instructions* list,
-                           memory* mem);
+void ast_block_node_to_x86(ast_node* node, list_of_x86_instructions* list);
 
 /*
 Generates x86 instructions for a function call.
@@ -273,18 +303,22 @@ Prepares arguments, handles calling convention, and emits `call`.
 Args:
   node: AST_FUNCTION_CALL node.
   list: Instruction list.
-  mem: Memory context.
 
 Returns:
   void
 */
 void ast_function_call_node_to_x86(ast_node* node,
-                                   list_of_x86_instructions* list, memory* mem);
+                                   list_of_x86_instructions* list);
 
 /*
 Generates full x86 instructions for a function.
 
-Emits function prologue, body, and epilogue, and handles memory context.
+Emits function prologue, body, and epilogue. Resolves the function's
+variables first if resolve_variables has not already done so. A leaf
+function (one with no calls) whose slots fit in the 128-byte System V red
+zone gets no prologue and addresses its slots from rsp. Any other saves rbp
+and reserves its slots with a `sub rsp` rounded up to 16 bytes, keeping rsp
+aligned at its calls.
 
 Args:
   node: AST_FUNCTION_DECLARATION node.
@@ -295,6 +329,19 @@ Returns:
 */
 void ast_function_node_to_x86(ast_node* node, list_of_x86_instructions* list);
 
+/*
+Emits the assembler directives and the _start entry point.
+
+_start calls main and exits with its return value.
+
+Args:
+  list: Output instruction list.
+
+Returns:
+  void
+*/
+void add_start_stub(list_of_x86_instructions* list);
+
 /*
 Generates x86 instructions for all top-level function nodes.
 
@@ -312,6 +359,37 @@ void list_of_ast_function_nodes_to_x86(ast_node** nodes,
                                        list_of_x86_instructions* list,
                                        int numberOfFunctions);
 
+// ───── Name Resolution ─────
+
+/*
+Binds every variable in a function to a stack slot.
+
+Walks the parameters and body with a scoped memory table, storing the slot
+index in each AST_VARIABLE_DECLARATION and AST_VARIABLE node and the number of
+slots used in the function node. Exits on a use of an undeclared variable.
+
+Args:
+  function: AST_FUNCTION_DECLARATION node.
+
+Returns:
+  void
+*/
+void resolve_function_variables(ast_node* function);
+
+/*
+Runs resolve_function_variables over every top-level function.
+
+Intended to run once, right after parse_file.
+
+Args:
+  nodes: Array of ast_node pointers.
+  number_of_functions: Number of entries in nodes.
+
+Returns:
+  void
+*/
+void resolve_variables(ast_node** nodes, int number_of_functions);
+
 // ───── Output ─────
 
 /*
@@ -351,6 +429,7 @@ Args:
   i: Index into a register mapping.
 
 Returns:
-  Name of the corresponding register (e.g., "edi", "esi", etc.).
+  Name of the corresponding register (e.g., "edi", "esi", etc.). Exits with
+  an error past the sixth register.
 */
 const char* get_low_linux_registers_name(int index);
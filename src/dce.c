@@ -0,0 +1,166 @@
+/*
+ * Dead Code Elimination
+ * Constant branch folding, block merging, phi simplification and
+ * mark-and-sweep removal of unused values on the SSA form.
+ */
+
+#include "dce.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "ssa.h"
+
+// ───── Control Flow ─────
+
+// Turns every branch on a constant into a jump to the side it always takes.
+static void fold_constant_branches(ssa_function* function) {
+  for (int i = 0; i < function->block_count; i++) {
+    ssa_block* block = &function->blocks[i];
+    if (block->instruction_count == 0) {
+      continue;
+    }
+    ssa_instruction* terminator =
+        &function->instructions[block->instructions[block->instruction_count -
+                                                    1]];
+    if (terminator->opcode != SSA_BRANCH ||
+        terminator->operands[0].kind != SSA_OPERAND_CONSTANT) {
+      continue;
+    }
+    int not_taken = terminator->operands[0].value != 0 ? block->successors[1]
+                                                        : block->successors[0];
+    remove_ssa_edge(function, i, not_taken);
+    terminator->opcode = SSA_JUMP;
+    terminator->operand_count = 0;
+  }
+}
+
+// Folds every block that is its predecessor's only successor, and that
+// predecessor its only predecessor, into that predecessor.
+static void merge_straight_line_blocks(ssa_function* function) {
+  for (int i = 0; i < function->block_count; i++) {
+    const ssa_block* block = &function->blocks[i];
+    while (block->successor_count == 1) {
+      int successor = block->successors[0];
+      if (successor == 0 || successor == i ||
+          function->blocks[successor].predecessor_count != 1) {
+        break;
+      }
+      merge_ssa_blocks(function, i, successor);
+    }
+  }
+}
+
+// ───── Phis ─────
+
+// Returns the one operand every input of a phi agrees on, ignoring inputs
+// that read the phi itself, or an SSA_OPERAND_NONE operand if they differ.
+static ssa_operand get_unique_input(const ssa_function* function, int phi) {
+  const ssa_instruction* instruction = &function->instructions[phi];
+  ssa_operand unique = ssa_none();
+  for (int i = 0; i < instruction->operand_count; i++) {
+    ssa_operand input = instruction->operands[i];
+    if (input.kind == SSA_OPERAND_VALUE && input.value == phi) {
+      continue;
+    }
+    if (unique.kind == SSA_OPERAND_NONE) {
+      unique = input;
+    } else if (unique.kind != input.kind || unique.value != input.value) {
+      return ssa_none();
+    }
+  }
+  return unique;
+}
+
+// Replaces phis with a single distinct input by that input until none are
+// left. Removing one can make another trivial, so this repeats.
+static void simplify_phis(ssa_function* function) {
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int i = 0; i < function->instruction_count; i++) {
+      const ssa_instruction* instruction = &function->instructions[i];
+      if (instruction->block < 0 || instruction->opcode != SSA_PHI) {
+        continue;
+      }
+      ssa_operand unique = get_unique_input(function, i);
+      if (unique.kind == SSA_OPERAND_NONE) {
+        continue;
+      }
+      replace_ssa_uses(function, i, unique);
+      remove_ssa_instruction(function, i);
+      changed = 1;
+    }
+  }
+}
+
+// ───── Mark and Sweep ─────
+
+// Checks whether an instruction must stay even if nothing reads its value.
+static int has_side_effects(const ssa_instruction* instruction) {
+  switch (instruction->opcode) {
+    case SSA_CALL:
+    case SSA_STORE:
+    case SSA_JUMP:
+    case SSA_BRANCH:
+    case SSA_RETURN:
+      return 1;
+    default:
+      return ssa_may_trap(instruction);
+  }
+}
+
+static void mark_live(unsigned char* live, int* worklist, int* count,
+                      int instruction) {
+  if (live[instruction]) {
+    return;
+  }
+  live[instruction] = 1;
+  worklist[(*count)++] = instruction;
+}
+
+static void remove_unused_values(ssa_function* function) {
+  int total = function->instruction_count;
+  unsigned char* live = (unsigned char*)malloc((size_t)total + 1);
+  int* worklist = (int*)malloc(sizeof(int) * ((size_t)total + 1));
+  if (!live || !worklist) {
+    error_and_exit("malloc failed");
+  }
+  memset(live, 0, (size_t)total + 1);
+
+  int count = 0;
+  for (int i = 0; i < total; i++) {
+    const ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block >= 0 && has_side_effects(instruction)) {
+      mark_live(live, worklist, &count, i);
+    }
+  }
+  while (count > 0) {
+    const ssa_instruction* instruction =
+        &function->instructions[worklist[--count]];
+    for (int i = 0; i < instruction->operand_count; i++) {
+      if (instruction->operands[i].kind == SSA_OPERAND_VALUE) {
+        mark_live(live, worklist, &count, instruction->operands[i].value);
+      }
+    }
+  }
+
+  for (int i = 0; i < total; i++) {
+    if (!live[i] && function->instructions[i].block >= 0) {
+      remove_ssa_instruction(function, i);
+    }
+  }
+  free(worklist);
+  free(live);
+}
+
+void eliminate_dead_ssa_code(ssa_function* function) {
+  fold_constant_branches(function);
+  remove_unreachable_ssa_blocks(function);
+  simplify_phis(function);
+  merge_straight_line_blocks(function);
+  remove_unreachable_ssa_blocks(function);
+  remove_unused_values(function);
+  compute_ssa_dominators(function);
+}
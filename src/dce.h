@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ssa.h"
+
+/*
+Removes dead code from a function in SSA form.
+
+Branches on a constant become jumps, and the blocks that leaves unreachable
+(including everything after a return) are deleted. Phis whose inputs all
+agree are replaced by that input, and a block entered only by a jump from a
+block with no other successor is merged into it. Finally every instruction
+whose value nothing needs is deleted: calls, returns, branches and stores
+are kept, and so is anything they read, transitively. Division and modulo
+count as needed unless the divisor is a constant that cannot trap. Run after
+promote_ssa_locals, stores to locals are gone and a local assigned but never
+read is just an unused value, so this also removes dead stores. Recomputes
+the dominators before returning.
+
+Args:
+  function: Function to clean up.
+
+Returns:
+  void
+*/
+void eliminate_dead_ssa_code(ssa_function* function);
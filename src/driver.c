@@ -0,0 +1,253 @@
+/*
+ * Driver
+ * Command line options and the choice of backend pipeline.
+ */
+
+#include "driver.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "codegen.h"
+#include "dce.h"
+#include "encode.h"
+#include "eval.h"
+#include "fold.h"
+#include "gvn.h"
+#include "ifconv.h"
+#include "inline.h"
+#include "jit.h"
+#include "lir.h"
+#include "loop.h"
+#include "lower.h"
+#include "object.h"
+#include "parser.h"
+#include "peephole.h"
+#include "regalloc.h"
+#include "specialize.h"
+#include "ssa.h"
+#include "tail.h"
+#include "vm.h"
+
+#define CONSTEXPR_STEPS_FLAG "-fconstexpr-steps="
+#define INLINE_LIMIT_FLAG "-finline-limit="
+#define SPECIALIZE_THRESHOLD_FLAG "-fspecialize-threshold="
+#define UNROLL_FACTOR_FLAG "-funroll-factor="
+#define OBJECT_FILE_NAME "chat.o"
+#define EXECUTABLE_FILE_NAME "chat"
+
+enum { DECIMAL_BASE = 10 };
+
+void init_compiler_options(compiler_options* options) {
+  options->optimization_level = 0;
+  options->peephole = -1;
+  options->inline_limit = DEFAULT_INLINE_LIMIT;
+  options->eval_step_limit = DEFAULT_EVAL_STEP_LIMIT;
+  options->specialize_threshold = DEFAULT_SPECIALIZE_THRESHOLD;
+  options->unroll_loops = 0;
+  options->unroll_factor = DEFAULT_UNROLL_FACTOR;
+  options->dump_ssa = 0;
+  options->dump_lir = 0;
+  options->dump_bytecode = 0;
+  options->output = OUTPUT_ASSEMBLY;
+}
+
+// Reads the number after a flag's '=', or exits naming what it was for.
+static int parse_flag_value(const char* text, const char* what) {
+  char* end = NULL;
+  long value = strtol(text, &end, DECIMAL_BASE);
+  if (end == text || *end != '\0' || value < 0 || value > INT_MAX) {
+    (void)fprintf(stderr, "Error: Invalid %s '%s'\n", what, text);
+    error_and_exit("");
+  }
+  return (int)value;
+}
+
+void parse_compiler_options(compiler_options* options, int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* argument = argv[i];
+    if (strcmp(argument, "-O0") == 0) {
+      options->optimization_level = 0;
+    } else if (strcmp(argument, "-O1") == 0 || strcmp(argument, "-O") == 0) {
+      options->optimization_level = 1;
+    } else if (strcmp(argument, "-O2") == 0) {
+      options->optimization_level = 2;
+    } else if (strcmp(argument, "-fpeephole") == 0) {
+      options->peephole = 1;
+    } else if (strcmp(argument, "-fno-peephole") == 0) {
+      options->peephole = 0;
+    } else if (strcmp(argument, "-fno-inline") == 0) {
+      options->inline_limit = 0;
+    } else if (strncmp(argument, INLINE_LIMIT_FLAG,
+                       strlen(INLINE_LIMIT_FLAG)) == 0) {
+      options->inline_limit = parse_flag_value(
+          argument + strlen(INLINE_LIMIT_FLAG), "inline limit");
+    } else if (strncmp(argument, CONSTEXPR_STEPS_FLAG,
+                       strlen(CONSTEXPR_STEPS_FLAG)) == 0) {
+      options->eval_step_limit = parse_flag_value(
+          argument + strlen(CONSTEXPR_STEPS_FLAG), "constexpr step limit");
+    } else if (strcmp(argument, "-fno-specialize") == 0) {
+      options->specialize_threshold = 0;
+    } else if (strncmp(argument, SPECIALIZE_THRESHOLD_FLAG,
+                       strlen(SPECIALIZE_THRESHOLD_FLAG)) == 0) {
+      options->specialize_threshold =
+          parse_flag_value(argument + strlen(SPECIALIZE_THRESHOLD_FLAG),
+                           "specialization threshold");
+    } else if (strcmp(argument, "-funroll-loops") == 0) {
+      options->unroll_loops = 1;
+    } else if (strcmp(argument, "-fno-unroll-loops") == 0) {
+      options->unroll_loops = 0;
+    } else if (strncmp(argument, UNROLL_FACTOR_FLAG,
+                       strlen(UNROLL_FACTOR_FLAG)) == 0) {
+      options->unroll_factor = parse_flag_value(
+          argument + strlen(UNROLL_FACTOR_FLAG), "unroll factor");
+    } else if (strcmp(argument, "-fdump-ssa") == 0) {
+      options->dump_ssa = 1;
+    } else if (strcmp(argument, "-fdump-lir") == 0) {
+      options->dump_lir = 1;
+    } else if (strcmp(argument, "-fdump-bytecode") == 0) {
+      options->dump_bytecode = 1;
+    } else if (strcmp(argument, "-S") == 0) {
+      options->output = OUTPUT_ASSEMBLY;
+    } else if (strcmp(argument, "-c") == 0) {
+      options->output = OUTPUT_OBJECT;
+    } else if (strcmp(argument, "-static") == 0) {
+      options->output = OUTPUT_EXECUTABLE;
+    } else if (strcmp(argument, "--run") == 0) {
+      options->output = OUTPUT_RUN;
+    } else if (strcmp(argument, "--interpret") == 0) {
+      options->output = OUTPUT_BYTECODE;
+    } else {
+      (void)fprintf(stderr, "Error: Unknown option '%s'\n", argument);
+      error_and_exit("");
+    }
+  }
+}
+
+static void build_optimized_ssa(ast_node* node, ssa_function* ssa,
+                                const compiler_options* options) {
+  build_ssa_function(node, ssa);
+  promote_ssa_locals(ssa);
+  eliminate_tail_recursion(ssa);
+  convert_ssa_branches_to_selects(ssa);
+  number_ssa_values(ssa);
+  optimize_ssa_loops(ssa);
+  eliminate_dead_ssa_code(ssa);
+  if (options->unroll_loops) {
+    // Unroll the cleaned-up loops, then fold the copies' constants.
+    unroll_ssa_loops(ssa, options->unroll_factor);
+    number_ssa_values(ssa);
+    eliminate_dead_ssa_code(ssa);
+  }
+}
+
+static void ssa_function_to_x86(const ssa_function* ssa,
+                                list_of_x86_instructions* list,
+                                const compiler_options* options) {
+  lir_function function;
+  lower_ssa_to_lir(ssa, &function);
+  if (options->optimization_level >= 2) {
+    allocate_registers_graph_coloring(&function);
+  } else {
+    allocate_registers_linear_scan(&function);
+  }
+  if (options->dump_lir) {
+    print_lir_function(stderr, &function);
+  }
+  lir_function_to_x86(&function, list);
+  free_lir_function(&function);
+}
+
+static void optimized_program_to_x86(ast_node** nodes, int function_count,
+                                     list_of_x86_instructions* list,
+                                     const compiler_options* options) {
+  ssa_function* functions = (ssa_function*)malloc(
+      sizeof(ssa_function) * ((size_t)function_count + 1));
+  if (!functions) {
+    error_and_exit("malloc failed");
+  }
+  int count = 0;
+  for (int i = 0; i < function_count; i++) {
+    if (nodes[i] != NULL) {
+      build_optimized_ssa(nodes[i], &functions[count++], options);
+    }
+  }
+  evaluate_constant_calls(functions, count, options->eval_step_limit);
+  count = specialize_ssa_functions(&functions, count,
+                                   options->specialize_threshold);
+  inline_ssa_functions(functions, count, options->inline_limit);
+  for (int i = 0; i < count; i++) {
+    if (options->dump_ssa) {
+      print_ssa_function(stderr, &functions[i]);
+    }
+    ssa_function_to_x86(&functions[i], list, options);
+  }
+  // Calls to a copy name it through the copy's own storage, so nothing is
+  // freed until every function has been emitted.
+  for (int i = 0; i < count; i++) {
+    free_ssa_function(&functions[i]);
+  }
+  free(functions);
+}
+
+static int is_peephole_enabled(const compiler_options* options) {
+  if (options->peephole >= 0) {
+    return options->peephole;
+  }
+  return options->optimization_level >= 1;
+}
+
+void compile_to_x86(ast_node** nodes, int function_count,
+                    list_of_x86_instructions* list,
+                    const compiler_options* options) {
+  if (options->optimization_level == 0) {
+    list_of_ast_function_nodes_to_x86(nodes, list, function_count);
+  } else {
+    fold_constants(nodes, function_count);
+    add_start_stub(list);
+    optimized_program_to_x86(nodes, function_count, list, options);
+  }
+  if (is_peephole_enabled(options)) {
+    optimize_peephole(list);
+  }
+}
+
+int write_compiler_output(list_of_x86_instructions* list,
+                          const compiler_options* options) {
+  if (options->output == OUTPUT_ASSEMBLY) {
+    print_instructions(list);
+    return 0;
+  }
+  x86_code code;
+  encode_x86_instructions(list, &code);
+  int result = 0;
+  if (options->output == OUTPUT_OBJECT) {
+    write_elf_object(&code, OBJECT_FILE_NAME);
+  } else if (options->output == OUTPUT_EXECUTABLE) {
+    write_elf_executable(&code, EXECUTABLE_FILE_NAME);
+  } else {
+    result = run_x86_code(&code);
+    printf("main returned %d\n", result);
+  }
+  free_x86_code(&code);
+  return result;
+}
+
+int interpret_program(ast_node** nodes, int function_count,
+                      const compiler_options* options) {
+  if (options->optimization_level >= 1) {
+    fold_constants(nodes, function_count);
+  }
+  bytecode_program program;
+  compile_bytecode_program(nodes, function_count, &program);
+  if (options->dump_bytecode) {
+    print_bytecode_program(stderr, &program);
+  }
+  int result = run_bytecode_program(&program);
+  free_bytecode_program(&program);
+  printf("main returned %d\n", result);
+  return result;
+}
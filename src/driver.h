@@ -0,0 +1,149 @@
+#pragma once
+
+#include "codegen.h"
+#include "parser.h"
+
+// What the compiler writes out.
+typedef enum {
+  OUTPUT_ASSEMBLY,    // Assembly text, chat.s (-S).
+  OUTPUT_OBJECT,      // Relocatable object, chat.o (-c).
+  OUTPUT_EXECUTABLE,  // Statically linked executable, chat (-static).
+  OUTPUT_RUN,         // Nothing written; main runs in memory (--run).
+  OUTPUT_BYTECODE,    // No native code; main runs on the VM (--interpret).
+} output_kind;
+
+// Settings chosen on the command line.
+typedef struct compiler_options {
+  // 0 = direct AST codegen, 1 = LIR with linear scan, 2 = LIR with graph
+  // coloring.
+  int optimization_level;
+  // 1 = run the peephole pass, 0 = skip it, -1 = decide by level (on from
+  // -O1).
+  int peephole;
+  // Largest callee, in SSA instructions, the inliner copies into its
+  // callers (0 = no inlining). Only used from -O1.
+  int inline_limit;
+  // Most instructions run to evaluate one call with constant arguments at
+  // compile time (0 = no evaluation). Only used from -O1.
+  int eval_step_limit;
+  // Fewest instructions a copy of a function specialized on constant
+  // arguments must save to be kept (0 = no specialization). Only used from
+  // -O1.
+  int specialize_threshold;
+  // 1 = unroll counted loops (-funroll-loops), 0 = leave them. Only used
+  // from -O1.
+  int unroll_loops;
+  // Trips per unrolled loop iteration.
+  int unroll_factor;
+  // 1 = print each function's final SSA to stderr (-fdump-ssa). Only used
+  // from -O1.
+  int dump_ssa;
+  // 1 = print each function's LIR to stderr once its registers are
+  // allocated (-fdump-lir). Only used from -O1.
+  int dump_lir;
+  // 1 = print the program's bytecode to stderr before running it
+  // (-fdump-bytecode). Only used with --interpret.
+  int dump_bytecode;
+  output_kind output;
+} compiler_options;
+
+/*
+Fills in the default options (-O0).
+
+Args:
+  options: Options to initialize.
+
+Returns:
+  void
+*/
+void init_compiler_options(compiler_options* options);
+
+/*
+Reads compiler flags from the command line.
+
+Recognizes -O0, -O1, -O2, -O (same as -O1), -fpeephole, -fno-peephole,
+-finline-limit=<n>, -fno-inline (same as -finline-limit=0),
+-fconstexpr-steps=<n>, -fspecialize-threshold=<n>, -fno-specialize (same
+as -fspecialize-threshold=0), -funroll-loops, -fno-unroll-loops,
+-funroll-factor=<n>, -fdump-ssa, -fdump-lir, -fdump-bytecode, -S, -c,
+-static, --run and --interpret. Exits on anything else.
+
+Args:
+  options: Options to update; should already be initialized.
+  argc: Argument count from main.
+  argv: Argument vector from main.
+
+Returns:
+  void
+*/
+void parse_compiler_options(compiler_options* options, int argc, char** argv);
+
+/*
+Generates the whole program's x86 assembly at the requested level.
+
+At -O0 every function goes through the direct AST code generator. From -O1
+on, constants are folded on the AST, then each function is built into SSA
+form, its locals promoted to values, self-recursive tail calls turned into
+loops, short branches turned into selects, redundant computations merged by
+value numbering, loop invariants hoisted and induction variables reduced,
+counted loops unrolled with -funroll-loops, and dead code removed. Calls
+with constant arguments are then evaluated at compile time and constant
+arguments passed into their callees, functions are cloned for the constant
+arguments their calls share when that saves enough, and small callees are
+inlined across the program. With -fdump-ssa each function's SSA is
+printed to stderr at this point. Finally each function is lowered to LIR,
+register allocated (linear scan at -O1, graph coloring at -O2), printed
+to stderr with -fdump-lir, and emitted from there. The peephole pass then
+runs over the whole listing when enabled.
+
+Args:
+  nodes: Array of resolved AST function nodes.
+  function_count: Number of entries in nodes.
+  list: Output instruction list.
+  options: Compiler options.
+
+Returns:
+  void
+*/
+void compile_to_x86(ast_node** nodes, int function_count,
+                    list_of_x86_instructions* list,
+                    const compiler_options* options);
+
+/*
+Writes the compiled program out.
+
+Writes the assembly text to chat.s. With -c or -static the program is
+instead encoded directly into machine code and written as the relocatable
+object chat.o, ready for ld, or as the runnable executable chat, which
+needs neither an assembler nor a linker. With --run nothing is written:
+the machine code is run in memory and main's result is printed.
+
+Args:
+  list: Instruction list from compile_to_x86.
+  options: Compiler options.
+
+Returns:
+  The value main returned with --run, 0 otherwise.
+*/
+int write_compiler_output(list_of_x86_instructions* list,
+                           const compiler_options* options);
+
+/*
+Runs the program on the bytecode virtual machine instead of compiling it to
+x86.
+
+From -O1 on, constants are folded on the AST first. The program is then
+compiled to bytecode, printed to stderr with -fdump-bytecode, and
+interpreted, skipping the optimizing backend, the encoder and the files
+entirely, and main's result is printed.
+
+Args:
+  nodes: Array of resolved AST function nodes.
+  function_count: Number of entries in nodes.
+  options: Compiler options.
+
+Returns:
+  The value main returned.
+*/
+int interpret_program(ast_node** nodes, int function_count,
+                      const compiler_options* options);
@@ -0,0 +1,1082 @@
+/*
+ * Encoder
+ * Machine code for the emitted x86 instruction text, so the compiler can
+ * write object files without an external assembler.
+ */
+
+#include "encode.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lexer.h"
+#include "lir.h"
+
+enum {
+  MAX_INSTRUCTION_LENGTH = 15,
+  ENCODE_MAX_OPERANDS = 3,
+  ENCODE_OPERAND_LENGTH = 64,
+  ENCODE_MNEMONIC_LENGTH = 16,
+  INITIAL_CODE_CAPACITY = 256,
+  INITIAL_TABLE_CAPACITY = 16,
+  SHORT_JUMP_LENGTH = 2,
+  NEAR_JUMP_LENGTH = 5,
+  NEAR_CONDITIONAL_JUMP_LENGTH = 6,
+  BYTE_BITS = 8,
+  BYTE_MASK = 0xFF,
+  DWORD_SIZE = 4,
+  QWORD_SIZE = 8,
+  DECIMAL_BASE = 10,
+};
+
+// REX prefix bits, and the fields of the ModRM and SIB bytes.
+enum {
+  REX = 0x40,
+  REX_W = 0x08,
+  REX_R = 0x04,
+  REX_X = 0x02,
+  REX_B = 0x01,
+  REGISTER_LOW_BITS = 7,
+  REGISTER_HIGH_BIT = 8,
+  MOD_INDIRECT = 0,
+  MOD_DISPLACEMENT_8 = 1,
+  MOD_DISPLACEMENT_32 = 2,
+  MOD_REGISTER = 3,
+  MOD_SHIFT = 6,
+  REG_SHIFT = 3,
+  RM_SIB = 4,  // Also the SIB index meaning "no index".
+  SCALE_SHIFT = 6,
+};
+
+// Opcodes. Values above 0xFF are two-byte opcodes starting with 0x0F.
+enum {
+  OPCODE_ARITHMETIC_STORE = 0x01,  // add r/m, reg; + extension * 8
+  OPCODE_ARITHMETIC_LOAD = 0x03,   // add reg, r/m; + extension * 8
+  OPCODE_PUSH = 0x50,
+  OPCODE_POP = 0x58,
+  OPCODE_IMUL_IMMEDIATE_32 = 0x69,
+  OPCODE_IMUL_IMMEDIATE_8 = 0x6B,
+  OPCODE_JCC_8 = 0x70,
+  OPCODE_ARITHMETIC_IMMEDIATE_32 = 0x81,
+  OPCODE_ARITHMETIC_IMMEDIATE_8 = 0x83,
+  OPCODE_TEST = 0x85,
+  OPCODE_XCHG = 0x87,
+  OPCODE_MOV_STORE = 0x89,
+  OPCODE_MOV_LOAD = 0x8B,
+  OPCODE_LEA = 0x8D,
+  OPCODE_XCHG_RAX = 0x90,
+  OPCODE_CDQ = 0x99,
+  OPCODE_MOV_IMMEDIATE = 0xB8,
+  OPCODE_SHIFT_IMMEDIATE = 0xC1,
+  OPCODE_RET = 0xC3,
+  OPCODE_MOV_RM_IMMEDIATE = 0xC7,
+  OPCODE_SHIFT_ONE = 0xD1,
+  OPCODE_CALL = 0xE8,
+  OPCODE_JMP_32 = 0xE9,
+  OPCODE_JMP_8 = 0xEB,
+  OPCODE_UNARY = 0xF7,  // test imm, not, neg, mul, imul, div, idiv
+  OPCODE_SYSCALL = 0x0F05,
+  OPCODE_CMOV = 0x0F40,
+  OPCODE_JCC_32 = 0x0F80,
+  OPCODE_SETCC = 0x0F90,
+  OPCODE_IMUL = 0x0FAF,
+  OPCODE_MOVZX_BYTE = 0x0FB6,
+};
+
+// ModRM reg field extensions of OPCODE_UNARY.
+enum {
+  UNARY_TEST = 0,
+  UNARY_NOT = 2,
+  UNARY_NEG = 3,
+  UNARY_IMUL = 5,
+  UNARY_IDIV = 7,
+};
+
+typedef struct named_value {
+  const char* name;
+  int value;
+} named_value;
+
+// Extensions for OPCODE_ARITHMETIC_*.
+static const named_value arithmetic_operations[] = {
+    {"add", 0}, {"or", 1}, {"and", 4}, {"sub", 5},
+    {"xor", 6}, {"cmp", 7}, {NULL, 0}};
+
+// Extensions for OPCODE_SHIFT_*.
+static const named_value shift_operations[] = {
+    {"shl", 4}, {"sal", 4}, {"shr", 5}, {"sar", 7}, {NULL, 0}};
+
+// Extensions for OPCODE_UNARY with a single operand.
+static const named_value unary_operations[] = {{"not", UNARY_NOT},
+                                               {"neg", UNARY_NEG},
+                                               {"idiv", UNARY_IDIV},
+                                               {NULL, 0}};
+
+// Condition codes added to the jcc, setcc and cmov opcodes.
+static const named_value condition_codes[] = {
+    {"e", 0x4}, {"ne", 0x5}, {"l", 0xC}, {"ge", 0xD},
+    {"le", 0xE}, {"g", 0xF}, {NULL, 0}};
+
+// Operand sizes in bytes, written before a memory operand.
+static const named_value size_prefixes[] = {{"BYTE PTR ", 1},
+                                            {"DWORD PTR ", DWORD_SIZE},
+                                            {"QWORD PTR ", QWORD_SIZE},
+                                            {NULL, 0}};
+
+// Instructions without operands.
+static const named_value plain_instructions[] = {{"cdq", OPCODE_CDQ},
+                                                 {"ret", OPCODE_RET},
+                                                 {"syscall", OPCODE_SYSCALL},
+                                                 {NULL, 0}};
+
+typedef enum {
+  OPERAND_REGISTER,
+  OPERAND_IMMEDIATE,
+  OPERAND_MEMORY,
+  OPERAND_NAME,  // A label or function symbol.
+} operand_kind;
+
+typedef struct operand {
+  operand_kind kind;
+  int size;   // REGISTER and sized MEMORY width in bytes, otherwise 0.
+  int reg;    // REGISTER, or the MEMORY base register.
+  int index;  // MEMORY index register, or -1.
+  int scale;  // MEMORY index scale.
+  int value;  // IMMEDIATE value or MEMORY displacement.
+  char name[ENCODE_OPERAND_LENGTH];  // NAME text.
+} operand;
+
+typedef struct parsed_instruction {
+  char mnemonic[ENCODE_MNEMONIC_LENGTH];
+  operand operands[ENCODE_MAX_OPERANDS];
+  int operand_count;
+} parsed_instruction;
+
+typedef enum {
+  ITEM_CODE,   // Fully encoded bytes.
+  ITEM_LABEL,  // Defines a symbol here.
+  ITEM_JUMP,   // call, jmp or jcc, encoded once its length is settled.
+} item_kind;
+
+typedef enum {
+  JUMP_CALL,
+  JUMP_ALWAYS,
+  JUMP_CONDITIONAL,
+} jump_kind;
+
+typedef struct encoded_item {
+  item_kind kind;
+  unsigned char bytes[MAX_INSTRUCTION_LENGTH];
+  int length;  // Bytes the item takes; for a JUMP, its current form.
+  int symbol;  // LABEL definition or JUMP target.
+  jump_kind jump;
+  int condition;  // JUMP_CONDITIONAL condition code.
+  int offset;     // Byte offset in the code.
+} encoded_item;
+
+typedef struct item_list {
+  encoded_item* items;
+  int count;
+  int capacity;
+} item_list;
+
+static void* checked_realloc(void* pointer, size_t size) {
+  void* result = realloc(pointer, size);
+  if (result == NULL) {
+    error_and_exit("malloc failed");
+  }
+  return result;
+}
+
+static void report_unencodable(const char* line) {
+  (void)fprintf(stderr, "Error: Cannot encode '%s'\n", line);
+  error_and_exit("");
+}
+
+static int find_named_value(const named_value* table, const char* name) {
+  for (int i = 0; table[i].name != NULL; i++) {
+    if (strcmp(table[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int fits_in_byte(int value) {
+  return value >= INT8_MIN && value <= INT8_MAX;
+}
+
+// ───── Symbols ─────
+
+int find_x86_symbol(const x86_code* code, const char* name) {
+  for (int i = 0; i < code->symbol_count; i++) {
+    if (strcmp(code->symbols[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int get_symbol(x86_code* code, const char* name) {
+  int symbol = find_x86_symbol(code, name);
+  if (symbol >= 0) {
+    return symbol;
+  }
+  if (code->symbol_count == code->symbol_capacity) {
+    code->symbol_capacity *= 2;
+    code->symbols = (x86_symbol*)checked_realloc(
+        code->symbols, sizeof(x86_symbol) * (size_t)code->symbol_capacity);
+  }
+  x86_symbol* added = &code->symbols[code->symbol_count];
+  size_t length = strlen(name);
+  added->name = (char*)checked_realloc(NULL, length + 1);
+  memcpy(added->name, name, length + 1);
+  added->offset = -1;
+  added->global = 0;
+  return code->symbol_count++;
+}
+
+static void add_relocation(x86_code* code, int offset, int symbol) {
+  if (code->relocation_count == code->relocation_capacity) {
+    code->relocation_capacity *= 2;
+    code->relocations = (x86_relocation*)checked_realloc(
+        code->relocations,
+        sizeof(x86_relocation) * (size_t)code->relocation_capacity);
+  }
+  code->relocations[code->relocation_count].offset = offset;
+  code->relocations[code->relocation_count].symbol = symbol;
+  code->relocation_count++;
+}
+
+// ───── Parsing ─────
+
+static void copy_trimmed(char* destination, size_t capacity, const char* start,
+                         const char* end) {
+  while (start < end && isspace((unsigned char)*start)) {
+    start++;
+  }
+  while (end > start && isspace((unsigned char)end[-1])) {
+    end--;
+  }
+  size_t length = (size_t)(end - start);
+  if (length >= capacity) {
+    length = capacity - 1;
+  }
+  memcpy(destination, start, length);
+  destination[length] = '\0';
+}
+
+// Returns the register a name denotes and sets its width, or returns -1.
+static int parse_register(const char* text, int* size) {
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    if (strcmp(text, get_lir_register_name_32(reg)) == 0) {
+      *size = DWORD_SIZE;
+      return reg;
+    }
+    if (strcmp(text, get_lir_register_name_64(reg)) == 0) {
+      *size = QWORD_SIZE;
+      return reg;
+    }
+    if (strcmp(text, get_lir_register_name_8(reg)) == 0) {
+      *size = 1;
+      return reg;
+    }
+  }
+  return -1;
+}
+
+// Parses a decimal integer that fits in 32 bits.
+static int parse_integer(const char* text, int* value) {
+  char* end = NULL;
+  long long parsed = strtoll(text, &end, DECIMAL_BASE);
+  if (end == text || *end != '\0' || parsed < INT32_MIN ||
+      parsed > INT32_MAX) {
+    return 0;
+  }
+  *value = (int)parsed;
+  return 1;
+}
+
+// Parses the inside of [...] as a sum of a base register, an index register
+// with an optional scale, and a signed displacement.
+static int parse_address(const char* text, operand* result) {
+  result->reg = -1;
+  result->index = -1;
+  result->scale = 1;
+  result->value = 0;
+  while (*text != '\0') {
+    int negative = 0;
+    if (*text == '+' || *text == '-') {
+      negative = *text == '-';
+      text++;
+    }
+    const char* end = text;
+    while (*end != '\0' && *end != '+' && *end != '-') {
+      end++;
+    }
+    char term[ENCODE_OPERAND_LENGTH];
+    copy_trimmed(term, sizeof(term), text, end);
+    char* star = strchr(term, '*');
+    int scale = 1;
+    if (star != NULL) {
+      *star = '\0';
+      if (!parse_integer(star + 1, &scale) ||
+          (scale != 1 && scale != 2 && scale != DWORD_SIZE &&
+           scale != QWORD_SIZE)) {
+        return 0;
+      }
+    }
+    int size = 0;
+    int reg = parse_register(term, &size);
+    if (reg >= 0) {
+      if (negative || size != QWORD_SIZE) {
+        return 0;
+      }
+      if (result->reg < 0 && star == NULL) {
+        result->reg = reg;
+      } else if (result->index < 0 && reg != LIR_RSP) {
+        result->index = reg;
+        result->scale = scale;
+      } else {
+        return 0;
+      }
+    } else {
+      int displacement = 0;
+      if (star != NULL || !parse_integer(term, &displacement)) {
+        return 0;
+      }
+      result->value += negative ? -displacement : displacement;
+    }
+    text = end;
+  }
+  return result->reg >= 0;
+}
+
+static int parse_operand(const char* text, operand* result) {
+  memset(result, 0, sizeof(*result));
+  for (int i = 0; size_prefixes[i].name != NULL; i++) {
+    size_t length = strlen(size_prefixes[i].name);
+    if (strncmp(text, size_prefixes[i].name, length) == 0) {
+      result->size = size_prefixes[i].value;
+      text += length;
+      break;
+    }
+  }
+  size_t length = strlen(text);
+  if (text[0] == '[' && length >= 2 && text[length - 1] == ']') {
+    char address[ENCODE_OPERAND_LENGTH];
+    copy_trimmed(address, sizeof(address), text + 1, text + length - 1);
+    result->kind = OPERAND_MEMORY;
+    return parse_address(address, result);
+  }
+  if (result->size != 0) {
+    return 0;
+  }
+  result->reg = parse_register(text, &result->size);
+  if (result->reg >= 0) {
+    result->kind = OPERAND_REGISTER;
+    return 1;
+  }
+  if (parse_integer(text, &result->value)) {
+    result->kind = OPERAND_IMMEDIATE;
+    return 1;
+  }
+  for (const char* name = text; *name != '\0'; name++) {
+    if (!isalnum((unsigned char)*name) && *name != '_' && *name != '.') {
+      return 0;
+    }
+  }
+  result->kind = OPERAND_NAME;
+  copy_trimmed(result->name, sizeof(result->name), text, text + length);
+  return length > 0 && length < sizeof(result->name);
+}
+
+// Splits "mnemonic a, b" into its parts.
+static int parse_instruction(const char* text, parsed_instruction* result) {
+  memset(result, 0, sizeof(*result));
+  const char* mnemonic_end = text;
+  while (isalnum((unsigned char)*mnemonic_end)) {
+    mnemonic_end++;
+  }
+  if (mnemonic_end == text ||
+      (size_t)(mnemonic_end - text) >= sizeof(result->mnemonic)) {
+    return 0;
+  }
+  copy_trimmed(result->mnemonic, sizeof(result->mnemonic), text,
+               mnemonic_end);
+  const char* start = mnemonic_end;
+  while (*start != '\0') {
+    if (result->operand_count == ENCODE_MAX_OPERANDS) {
+      return 0;
+    }
+    const char* comma = start;
+    while (*comma != '\0' && *comma != ',') {
+      comma++;
+    }
+    char text_operand[ENCODE_OPERAND_LENGTH];
+    copy_trimmed(text_operand, sizeof(text_operand), start, comma);
+    if (!parse_operand(text_operand,
+                       &result->operands[result->operand_count++])) {
+      return 0;
+    }
+    start = *comma == ',' ? comma + 1 : comma;
+  }
+  return 1;
+}
+
+// ───── Encoding ─────
+
+static void add_byte(encoded_item* item, int value) {
+  item->bytes[item->length++] = (unsigned char)(value & BYTE_MASK);
+}
+
+static void add_int32(unsigned char* bytes, int value) {
+  uint32_t bits = (uint32_t)value;
+  for (int i = 0; i < DWORD_SIZE; i++) {
+    bytes[i] = (unsigned char)((bits >> (unsigned int)(i * BYTE_BITS)) &
+                               BYTE_MASK);
+  }
+}
+
+static void add_immediate_32(encoded_item* item, int value) {
+  add_int32(item->bytes + item->length, value);
+  item->length += DWORD_SIZE;
+}
+
+static void add_opcode(encoded_item* item, int opcode) {
+  if (opcode > BYTE_MASK) {
+    add_byte(item, opcode >> BYTE_BITS);
+  }
+  add_byte(item, opcode);
+}
+
+static int get_scale_bits(int scale) {
+  int bits = 0;
+  while ((1 << bits) < scale) {
+    bits++;
+  }
+  return bits;
+}
+
+static int get_modrm(int mod, int reg, int rm) {
+  return (mod << MOD_SHIFT) | ((reg & REGISTER_LOW_BITS) << REG_SHIFT) |
+         (rm & REGISTER_LOW_BITS);
+}
+
+// Encodes an instruction whose operands are a register or opcode extension
+// (`field`) and a register or memory operand (`rm`): the REX prefix if one
+// is needed, the opcode, ModRM, then any SIB byte and displacement.
+static void add_modrm_instruction(encoded_item* item, int wide, int opcode,
+                                  int field, const operand* rm) {
+  int rex = wide ? REX_W : 0;
+  int needs_rex = wide;
+  if (field & REGISTER_HIGH_BIT) {
+    rex |= REX_R;
+    needs_rex = 1;
+  }
+  if (rm->reg & REGISTER_HIGH_BIT) {
+    rex |= REX_B;
+    needs_rex = 1;
+  }
+  if (rm->kind == OPERAND_MEMORY && rm->index >= 0 &&
+      (rm->index & REGISTER_HIGH_BIT)) {
+    rex |= REX_X;
+    needs_rex = 1;
+  }
+  // Without a REX prefix, byte registers 4-7 would be ah, ch, dh and bh.
+  if (rm->kind == OPERAND_REGISTER && rm->size == 1 && rm->reg >= LIR_RSP) {
+    needs_rex = 1;
+  }
+  if (needs_rex) {
+    add_byte(item, REX | rex);
+  }
+  add_opcode(item, opcode);
+
+  if (rm->kind == OPERAND_REGISTER) {
+    add_byte(item, get_modrm(MOD_REGISTER, field, rm->reg));
+    return;
+  }
+  int base = rm->reg & REGISTER_LOW_BITS;
+  int mod = MOD_DISPLACEMENT_32;
+  // rbp and r13 as a base with no displacement would mean rip-relative.
+  if (rm->value == 0 && base != LIR_RBP) {
+    mod = MOD_INDIRECT;
+  } else if (fits_in_byte(rm->value)) {
+    mod = MOD_DISPLACEMENT_8;
+  }
+  if (rm->index < 0 && base != LIR_RSP) {
+    add_byte(item, get_modrm(mod, field, base));
+  } else {
+    add_byte(item, get_modrm(mod, field, RM_SIB));
+    int index = rm->index < 0 ? RM_SIB : rm->index;
+    add_byte(item, (get_scale_bits(rm->scale) << SCALE_SHIFT) |
+                       ((index & REGISTER_LOW_BITS) << REG_SHIFT) | base);
+  }
+  if (mod == MOD_DISPLACEMENT_8) {
+    add_byte(item, rm->value);
+  } else if (mod == MOD_DISPLACEMENT_32) {
+    add_immediate_32(item, rm->value);
+  }
+}
+
+static int is_register_or_memory(const operand* value) {
+  return value->kind == OPERAND_REGISTER || value->kind == OPERAND_MEMORY;
+}
+
+// Returns the shared width of the sized operands, 4 or 8 bytes, or 0 if
+// they disagree or none has a size.
+static int get_operation_size(const parsed_instruction* instruction) {
+  int size = 0;
+  for (int i = 0; i < instruction->operand_count; i++) {
+    int operand_size = instruction->operands[i].size;
+    if (operand_size == 0) {
+      continue;
+    }
+    if ((size != 0 && operand_size != size) ||
+        (operand_size != DWORD_SIZE && operand_size != QWORD_SIZE)) {
+      return 0;
+    }
+    size = operand_size;
+  }
+  return size;
+}
+
+// add, sub, cmp and the other two-operand arithmetic instructions.
+static int encode_arithmetic(int extension, const operand* destination,
+                             const operand* source, int wide,
+                             encoded_item* item) {
+  if (source->kind == OPERAND_REGISTER &&
+      is_register_or_memory(destination)) {
+    add_modrm_instruction(item, wide,
+                          OPCODE_ARITHMETIC_STORE + extension * BYTE_BITS,
+                          source->reg, destination);
+  } else if (destination->kind == OPERAND_REGISTER &&
+             source->kind == OPERAND_MEMORY) {
+    add_modrm_instruction(item, wide,
+                          OPCODE_ARITHMETIC_LOAD + extension * BYTE_BITS,
+                          destination->reg, source);
+  } else if (source->kind == OPERAND_IMMEDIATE &&
+             is_register_or_memory(destination)) {
+    int small = fits_in_byte(source->value);
+    add_modrm_instruction(item, wide,
+                          small ? OPCODE_ARITHMETIC_IMMEDIATE_8
+                                : OPCODE_ARITHMETIC_IMMEDIATE_32,
+                          extension, destination);
+    if (small) {
+      add_byte(item, source->value);
+    } else {
+      add_immediate_32(item, source->value);
+    }
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+static int encode_mov(const operand* destination, const operand* source,
+                      int wide, encoded_item* item) {
+  if (source->kind == OPERAND_REGISTER &&
+      is_register_or_memory(destination)) {
+    add_modrm_instruction(item, wide, OPCODE_MOV_STORE, source->reg,
+                          destination);
+  } else if (destination->kind == OPERAND_REGISTER &&
+             source->kind == OPERAND_MEMORY) {
+    add_modrm_instruction(item, wide, OPCODE_MOV_LOAD, destination->reg,
+                          source);
+  } else if (destination->kind == OPERAND_REGISTER &&
+             source->kind == OPERAND_IMMEDIATE && !wide) {
+    if (destination->reg & REGISTER_HIGH_BIT) {
+      add_byte(item, REX | REX_B);
+    }
+    add_byte(item,
+             OPCODE_MOV_IMMEDIATE + (destination->reg & REGISTER_LOW_BITS));
+    add_immediate_32(item, source->value);
+  } else if (source->kind == OPERAND_IMMEDIATE &&
+             is_register_or_memory(destination)) {
+    // 64-bit destinations take a sign-extended 32-bit immediate.
+    add_modrm_instruction(item, wide, OPCODE_MOV_RM_IMMEDIATE, 0,
+                          destination);
+    add_immediate_32(item, source->value);
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+// imul with one operand (edx:eax = eax * r/m), two or three.
+static int encode_imul(const parsed_instruction* instruction, int wide,
+                       encoded_item* item) {
+  const operand* operands = instruction->operands;
+  if (instruction->operand_count == 1 && is_register_or_memory(&operands[0])) {
+    add_modrm_instruction(item, wide, OPCODE_UNARY, UNARY_IMUL, &operands[0]);
+    return 1;
+  }
+  if (operands[0].kind != OPERAND_REGISTER) {
+    return 0;
+  }
+  const operand* source = &operands[1];
+  const operand* multiplier = NULL;
+  if (instruction->operand_count == 2 &&
+      operands[1].kind == OPERAND_IMMEDIATE) {
+    source = &operands[0];
+    multiplier = &operands[1];
+  } else if (instruction->operand_count == ENCODE_MAX_OPERANDS) {
+    multiplier = &operands[2];
+  }
+  if (!is_register_or_memory(source) ||
+      (multiplier != NULL && multiplier->kind != OPERAND_IMMEDIATE)) {
+    return 0;
+  }
+  if (multiplier == NULL) {
+    add_modrm_instruction(item, wide, OPCODE_IMUL, operands[0].reg, source);
+  } else if (fits_in_byte(multiplier->value)) {
+    add_modrm_instruction(item, wide, OPCODE_IMUL_IMMEDIATE_8,
+                          operands[0].reg, source);
+    add_byte(item, multiplier->value);
+  } else {
+    add_modrm_instruction(item, wide, OPCODE_IMUL_IMMEDIATE_32,
+                          operands[0].reg, source);
+    add_immediate_32(item, multiplier->value);
+  }
+  return 1;
+}
+
+static int encode_shift(int extension, const operand* destination,
+                        const operand* count, int wide, encoded_item* item) {
+  if (!is_register_or_memory(destination) ||
+      count->kind != OPERAND_IMMEDIATE || count->value < 0 ||
+      count->value >= (wide ? QWORD_SIZE : DWORD_SIZE) * BYTE_BITS) {
+    return 0;
+  }
+  if (count->value == 1) {
+    add_modrm_instruction(item, wide, OPCODE_SHIFT_ONE, extension,
+                          destination);
+  } else {
+    add_modrm_instruction(item, wide, OPCODE_SHIFT_IMMEDIATE, extension,
+                          destination);
+    add_byte(item, count->value);
+  }
+  return 1;
+}
+
+static int encode_test(const operand* first, const operand* second, int wide,
+                       encoded_item* item) {
+  if (second->kind == OPERAND_IMMEDIATE && is_register_or_memory(first)) {
+    add_modrm_instruction(item, wide, OPCODE_UNARY, UNARY_TEST, first);
+    add_immediate_32(item, second->value);
+    return 1;
+  }
+  // test and xchg are symmetric, so either operand may be the r/m one.
+  const operand* reg = second->kind == OPERAND_REGISTER ? second : first;
+  const operand* rm = reg == second ? first : second;
+  if (reg->kind != OPERAND_REGISTER || !is_register_or_memory(rm)) {
+    return 0;
+  }
+  add_modrm_instruction(item, wide, OPCODE_TEST, reg->reg, rm);
+  return 1;
+}
+
+static int encode_xchg(const operand* first, const operand* second, int wide,
+                       encoded_item* item) {
+  // Exchanges with eax have a one-byte form. Not for eax with itself: 0x90
+  // is nop, which would leave the upper half of rax alone.
+  if (first->kind == OPERAND_REGISTER && second->kind == OPERAND_REGISTER &&
+      (first->reg == LIR_RAX) != (second->reg == LIR_RAX)) {
+    int other = first->reg == LIR_RAX ? second->reg : first->reg;
+    if (wide || (other & REGISTER_HIGH_BIT)) {
+      add_byte(item, REX | (wide ? REX_W : 0) |
+                         ((other & REGISTER_HIGH_BIT) ? REX_B : 0));
+    }
+    add_byte(item, OPCODE_XCHG_RAX + (other & REGISTER_LOW_BITS));
+    return 1;
+  }
+  const operand* reg = second->kind == OPERAND_REGISTER ? second : first;
+  const operand* rm = reg == second ? first : second;
+  if (reg->kind != OPERAND_REGISTER || !is_register_or_memory(rm)) {
+    return 0;
+  }
+  add_modrm_instruction(item, wide, OPCODE_XCHG, reg->reg, rm);
+  return 1;
+}
+
+static int encode_push_or_pop(int opcode, const operand* reg,
+                              encoded_item* item) {
+  if (reg->kind != OPERAND_REGISTER || reg->size != QWORD_SIZE) {
+    return 0;
+  }
+  if (reg->reg & REGISTER_HIGH_BIT) {
+    add_byte(item, REX | REX_B);
+  }
+  add_byte(item, opcode + (reg->reg & REGISTER_LOW_BITS));
+  return 1;
+}
+
+// Returns the condition code for the text after a jcc, setcc or cmov
+// prefix, or -1 when the mnemonic does not start with the prefix.
+static int get_condition(const char* mnemonic, const char* prefix) {
+  size_t length = strlen(prefix);
+  if (strncmp(mnemonic, prefix, length) != 0) {
+    return -1;
+  }
+  int found = find_named_value(condition_codes, mnemonic + length);
+  return found < 0 ? -1 : condition_codes[found].value;
+}
+
+// Turns a call or jump into an ITEM_JUMP, sized later.
+static int encode_jump(const parsed_instruction* instruction,
+                       encoded_item* item, x86_code* code) {
+  const char* mnemonic = instruction->mnemonic;
+  if (strcmp(mnemonic, "call") == 0) {
+    item->jump = JUMP_CALL;
+  } else if (strcmp(mnemonic, "jmp") == 0) {
+    item->jump = JUMP_ALWAYS;
+  } else if (get_condition(mnemonic, "j") >= 0) {
+    item->jump = JUMP_CONDITIONAL;
+    item->condition = get_condition(mnemonic, "j");
+  } else {
+    return 0;
+  }
+  if (instruction->operand_count != 1 ||
+      instruction->operands[0].kind != OPERAND_NAME) {
+    return 0;
+  }
+  item->kind = ITEM_JUMP;
+  item->symbol = get_symbol(code, instruction->operands[0].name);
+  item->length =
+      item->jump == JUMP_CALL ? NEAR_JUMP_LENGTH : SHORT_JUMP_LENGTH;
+  return 1;
+}
+
+// Encodes instructions whose operands have no shared width: setcc, movzx,
+// lea and push/pop.
+static int encode_special(const parsed_instruction* instruction,
+                          encoded_item* item) {
+  const char* mnemonic = instruction->mnemonic;
+  const operand* operands = instruction->operands;
+  int count = instruction->operand_count;
+  int condition = get_condition(mnemonic, "set");
+  if (condition >= 0) {
+    if (count != 1 || !is_register_or_memory(&operands[0]) ||
+        operands[0].size != 1) {
+      return 0;
+    }
+    add_modrm_instruction(item, 0, OPCODE_SETCC + condition, 0, &operands[0]);
+    return 1;
+  }
+  if (strcmp(mnemonic, "movzx") == 0) {
+    if (count != 2 || operands[0].kind != OPERAND_REGISTER ||
+        operands[0].size < DWORD_SIZE || !is_register_or_memory(&operands[1]) ||
+        operands[1].size != 1) {
+      return 0;
+    }
+    add_modrm_instruction(item, operands[0].size == QWORD_SIZE,
+                          OPCODE_MOVZX_BYTE, operands[0].reg, &operands[1]);
+    return 1;
+  }
+  if (strcmp(mnemonic, "lea") == 0) {
+    if (count != 2 || operands[0].kind != OPERAND_REGISTER ||
+        operands[0].size < DWORD_SIZE || operands[1].kind != OPERAND_MEMORY) {
+      return 0;
+    }
+    add_modrm_instruction(item, operands[0].size == QWORD_SIZE, OPCODE_LEA,
+                          operands[0].reg, &operands[1]);
+    return 1;
+  }
+  if (strcmp(mnemonic, "push") == 0) {
+    return count == 1 && encode_push_or_pop(OPCODE_PUSH, &operands[0], item);
+  }
+  if (strcmp(mnemonic, "pop") == 0) {
+    return count == 1 && encode_push_or_pop(OPCODE_POP, &operands[0], item);
+  }
+  return -1;
+}
+
+// Encodes the instructions whose operands share one width.
+static int encode_sized(const parsed_instruction* instruction,
+                        encoded_item* item) {
+  const char* mnemonic = instruction->mnemonic;
+  const operand* operands = instruction->operands;
+  int count = instruction->operand_count;
+  int size = get_operation_size(instruction);
+  if (size == 0) {
+    return 0;
+  }
+  int wide = size == QWORD_SIZE;
+  int found = find_named_value(arithmetic_operations, mnemonic);
+  if (found >= 0) {
+    return count == 2 && encode_arithmetic(arithmetic_operations[found].value,
+                                           &operands[0], &operands[1], wide,
+                                           item);
+  }
+  found = find_named_value(shift_operations, mnemonic);
+  if (found >= 0) {
+    return count == 2 && encode_shift(shift_operations[found].value,
+                                      &operands[0], &operands[1], wide, item);
+  }
+  found = find_named_value(unary_operations, mnemonic);
+  if (found >= 0) {
+    if (count != 1 || !is_register_or_memory(&operands[0])) {
+      return 0;
+    }
+    add_modrm_instruction(item, wide, OPCODE_UNARY,
+                          unary_operations[found].value, &operands[0]);
+    return 1;
+  }
+  int condition = get_condition(mnemonic, "cmov");
+  if (condition >= 0) {
+    if (count != 2 || operands[0].kind != OPERAND_REGISTER ||
+        !is_register_or_memory(&operands[1])) {
+      return 0;
+    }
+    add_modrm_instruction(item, wide, OPCODE_CMOV + condition,
+                          operands[0].reg, &operands[1]);
+    return 1;
+  }
+  if (strcmp(mnemonic, "mov") == 0) {
+    return count == 2 && encode_mov(&operands[0], &operands[1], wide, item);
+  }
+  if (strcmp(mnemonic, "test") == 0) {
+    return count == 2 && encode_test(&operands[0], &operands[1], wide, item);
+  }
+  if (strcmp(mnemonic, "xchg") == 0) {
+    return count == 2 && encode_xchg(&operands[0], &operands[1], wide, item);
+  }
+  if (strcmp(mnemonic, "imul") == 0) {
+    return count >= 1 && encode_imul(instruction, wide, item);
+  }
+  return 0;
+}
+
+static int encode_instruction(const parsed_instruction* instruction,
+                              encoded_item* item, x86_code* code) {
+  item->kind = ITEM_CODE;
+  int found = find_named_value(plain_instructions, instruction->mnemonic);
+  if (found >= 0) {
+    if (instruction->operand_count != 0) {
+      return 0;
+    }
+    add_opcode(item, plain_instructions[found].value);
+    return 1;
+  }
+  if (instruction->operand_count == 1 &&
+      instruction->operands[0].kind == OPERAND_NAME) {
+    return encode_jump(instruction, item, code);
+  }
+  int special = encode_special(instruction, item);
+  if (special >= 0) {
+    return special;
+  }
+  return encode_sized(instruction, item);
+}
+
+// ───── Listing ─────
+
+static encoded_item* add_item(item_list* items) {
+  if (items->count == items->capacity) {
+    items->capacity *= 2;
+    items->items = (encoded_item*)checked_realloc(
+        items->items, sizeof(encoded_item) * (size_t)items->capacity);
+  }
+  encoded_item* item = &items->items[items->count++];
+  memset(item, 0, sizeof(*item));
+  return item;
+}
+
+// Handles the directives the code generators emit; only .global matters.
+static int encode_directive(const char* text, x86_code* code) {
+  static const char* const ignored[] = {".text", ".intel_syntax noprefix"};
+  for (size_t i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++) {
+    if (strcmp(text, ignored[i]) == 0) {
+      return 1;
+    }
+  }
+  static const char* const global_directives[] = {".global ", ".globl "};
+  for (size_t i = 0; i < sizeof(global_directives) / sizeof(char*); i++) {
+    size_t length = strlen(global_directives[i]);
+    if (strncmp(text, global_directives[i], length) == 0) {
+      char name[ENCODE_OPERAND_LENGTH];
+      copy_trimmed(name, sizeof(name), text + length, text + strlen(text));
+      int symbol = get_symbol(code, name);
+      code->symbols[symbol].global = 1;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void encode_line(const char* line, item_list* items, x86_code* code) {
+  char text[ENCODE_OPERAND_LENGTH * ENCODE_MAX_OPERANDS];
+  const char* end = strchr(line, '#');
+  copy_trimmed(text, sizeof(text), line,
+               end != NULL ? end : line + strlen(line));
+  size_t length = strlen(text);
+  if (length == 0) {
+    return;
+  }
+  if (text[length - 1] == ':') {
+    text[length - 1] = '\0';
+    int symbol = get_symbol(code, text);
+    if (code->symbols[symbol].offset >= 0) {
+      (void)fprintf(stderr, "Error: Label '%s' defined twice\n", text);
+      error_and_exit("");
+    }
+    // Marked defined now; the real offset is set by layout_items.
+    code->symbols[symbol].offset = 0;
+    encoded_item* item = add_item(items);
+    item->kind = ITEM_LABEL;
+    item->symbol = symbol;
+    return;
+  }
+  if (text[0] == '.') {
+    if (!encode_directive(text, code)) {
+      report_unencodable(line);
+    }
+    return;
+  }
+  parsed_instruction instruction;
+  encoded_item* item = add_item(items);
+  if (!parse_instruction(text, &instruction) ||
+      !encode_instruction(&instruction, item, code)) {
+    report_unencodable(line);
+  }
+}
+
+// Assigns offsets to the items and the symbols they define.
+static void layout_items(item_list* items, x86_code* code) {
+  int offset = 0;
+  for (int i = 0; i < items->count; i++) {
+    encoded_item* item = &items->items[i];
+    item->offset = offset;
+    if (item->kind == ITEM_LABEL) {
+      code->symbols[item->symbol].offset = offset;
+    }
+    offset += item->length;
+  }
+}
+
+static int get_jump_displacement(const encoded_item* item,
+                                 const x86_code* code) {
+  return code->symbols[item->symbol].offset - (item->offset + item->length);
+}
+
+// Lengthens every short jump whose target is out of reach until none is.
+// Lengthening only ever moves targets further away, so this settles.
+static void relax_jumps(item_list* items, x86_code* code) {
+  for (int i = 0; i < items->count; i++) {
+    encoded_item* item = &items->items[i];
+    if (item->kind == ITEM_JUMP && code->symbols[item->symbol].offset < 0) {
+      item->length = item->jump == JUMP_CONDITIONAL
+                         ? NEAR_CONDITIONAL_JUMP_LENGTH
+                         : NEAR_JUMP_LENGTH;
+    }
+  }
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    layout_items(items, code);
+    for (int i = 0; i < items->count; i++) {
+      encoded_item* item = &items->items[i];
+      if (item->kind == ITEM_JUMP && item->length == SHORT_JUMP_LENGTH &&
+          !fits_in_byte(get_jump_displacement(item, code))) {
+        item->length = item->jump == JUMP_CONDITIONAL
+                           ? NEAR_CONDITIONAL_JUMP_LENGTH
+                           : NEAR_JUMP_LENGTH;
+        changed = 1;
+      }
+    }
+  }
+}
+
+static void encode_final_jump(encoded_item* item, x86_code* code) {
+  int displacement = get_jump_displacement(item, code);
+  int length = item->length;
+  item->length = 0;
+  if (length == SHORT_JUMP_LENGTH) {
+    add_byte(item, item->jump == JUMP_ALWAYS ? OPCODE_JMP_8
+                                             : OPCODE_JCC_8 + item->condition);
+    add_byte(item, displacement);
+    return;
+  }
+  if (item->jump == JUMP_CALL) {
+    add_byte(item, OPCODE_CALL);
+  } else if (item->jump == JUMP_ALWAYS) {
+    add_byte(item, OPCODE_JMP_32);
+  } else {
+    add_opcode(item, OPCODE_JCC_32 + item->condition);
+  }
+  if (code->symbols[item->symbol].offset < 0) {
+    add_relocation(code, item->offset + item->length, item->symbol);
+    displacement = 0;
+  }
+  add_immediate_32(item, displacement);
+}
+
+static void append_code(x86_code* code, const unsigned char* bytes,
+                        int length) {
+  while (code->size + length > code->capacity) {
+    code->capacity *= 2;
+    code->bytes = (unsigned char*)checked_realloc(code->bytes,
+                                                  (size_t)code->capacity);
+  }
+  memcpy(code->bytes + code->size, bytes, (size_t)length);
+  code->size += length;
+}
+
+void encode_x86_instructions(const list_of_x86_instructions* list,
+                             x86_code* code) {
+  code->size = 0;
+  code->capacity = INITIAL_CODE_CAPACITY;
+  code->bytes = (unsigned char*)checked_realloc(NULL, (size_t)code->capacity);
+  code->symbol_count = 0;
+  code->symbol_capacity = INITIAL_TABLE_CAPACITY;
+  code->symbols = (x86_symbol*)checked_realloc(
+      NULL, sizeof(x86_symbol) * (size_t)code->symbol_capacity);
+  code->relocation_count = 0;
+  code->relocation_capacity = INITIAL_TABLE_CAPACITY;
+  code->relocations = (x86_relocation*)checked_realloc(
+      NULL, sizeof(x86_relocation) * (size_t)code->relocation_capacity);
+
+  item_list items = {NULL, 0, INITIAL_TABLE_CAPACITY};
+  items.items = (encoded_item*)checked_realloc(
+      NULL, sizeof(encoded_item) * (size_t)items.capacity);
+  for (int i = 0; i < list->instruction_count; i++) {
+    encode_line(list->instructions[i], &items, code);
+  }
+  for (int i = 0; i < code->symbol_count; i++) {
+    if (code->symbols[i].offset < 0 &&
+        strncmp(code->symbols[i].name, ".L", 2) == 0) {
+      (void)fprintf(stderr, "Error: Undefined label '%s'\n",
+                    code->symbols[i].name);
+      error_and_exit("");
+    }
+  }
+
+  relax_jumps(&items, code);
+  for (int i = 0; i < items.count; i++) {
+    encoded_item* item = &items.items[i];
+    if (item->kind == ITEM_JUMP) {
+      encode_final_jump(item, code);
+    }
+    append_code(code, item->bytes, item->length);
+  }
+  free(items.items);
+}
+
+void free_x86_code(x86_code* code) {
+  for (int i = 0; i < code->symbol_count; i++) {
+    free(code->symbols[i].name);
+  }
+  free(code->symbols);
+  free(code->relocations);
+  free(code->bytes);
+  code->symbols = NULL;
+  code->relocations = NULL;
+  code->bytes = NULL;
+  code->symbol_count = 0;
+  code->relocation_count = 0;
+  code->size = 0;
+}
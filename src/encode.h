@@ -0,0 +1,76 @@
+#pragma once
+
+#include "codegen.h"
+
+// A name defined by a label or referenced by a call or jump.
+typedef struct x86_symbol {
+  char* name;  // Null-terminated copy.
+  int offset;  // Byte offset of the definition, or -1 if undefined.
+  int global;  // 1 if named by a .global directive.
+} x86_symbol;
+
+// A 32-bit field that must hold the symbol's address relative to the end of
+// the field, for the linker to fill in.
+typedef struct x86_relocation {
+  int offset;  // Byte offset of the field.
+  int symbol;  // Index into the symbols.
+} x86_relocation;
+
+typedef struct x86_code {
+  unsigned char* bytes;
+  int size;
+  int capacity;
+  x86_symbol* symbols;
+  int symbol_count;
+  int symbol_capacity;
+  x86_relocation* relocations;
+  int relocation_count;
+  int relocation_capacity;
+} x86_code;
+
+/*
+Encodes an x86 listing into machine code.
+
+Reads the Intel-syntax text the code generators emit: labels, the .global,
+.text and .intel_syntax directives, and the instructions they use, with
+32-bit, 64-bit and byte registers, immediates, and [base+index*scale+disp]
+memory operands. Each instruction gets its shortest form: the REX prefix
+only when it needs one, an 8-bit immediate or displacement whenever the
+value fits, and no displacement at all where the base allows. Jumps start
+out with 8-bit displacements and are lengthened to 32 bits, repeatedly,
+until every target is in range. Calls and jumps to a symbol the listing
+does not define are left as relocations. Exits on any line it cannot
+encode and on undefined or duplicate labels.
+
+Args:
+  list: Instruction list to encode.
+  code: Output code; initialized here and freed with free_x86_code.
+
+Returns:
+  void
+*/
+void encode_x86_instructions(const list_of_x86_instructions* list,
+                             x86_code* code);
+
+/*
+Looks up a symbol by name.
+
+Args:
+  code: Encoded code.
+  name: Null-terminated symbol name.
+
+Returns:
+  Index of the symbol, or -1 if the code has none by that name.
+*/
+int find_x86_symbol(const x86_code* code, const char* name);
+
+/*
+Releases the storage of encoded code.
+
+Args:
+  code: Code to free.
+
+Returns:
+  void
+*/
+void free_x86_code(x86_code* code);
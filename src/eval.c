@@ -0,0 +1,351 @@
+/*
+ * Compile-Time Evaluation
+ * Runs calls with constant arguments while compiling, and passes constant
+ * arguments on into the functions they are given to.
+ */
+
+#include "eval.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "dce.h"
+#include "gvn.h"
+#include "ssa.h"
+
+// ───── Interpreter ─────
+
+typedef enum {
+  EVAL_RUNNING,
+  EVAL_RETURNED,
+  EVAL_FAILED,
+} eval_status;
+
+typedef struct evaluator {
+  const ssa_function* functions;
+  int count;
+  int steps_left;  // Shared by every call the evaluation makes.
+} evaluator;
+
+// One function being run.
+typedef struct eval_frame {
+  const ssa_function* function;
+  const int* arguments;
+  int* values;      // The value of every instruction run so far.
+  int* phi_values;  // Scratch space for entering a block.
+  int block;
+  int position;  // Index in the block of the next instruction.
+  int depth;
+  int result;
+} eval_frame;
+
+static int read_operand(const eval_frame* frame, ssa_operand operand,
+                        int* value) {
+  switch (operand.kind) {
+    case SSA_OPERAND_CONSTANT:
+      *value = operand.value;
+      return 1;
+    case SSA_OPERAND_VALUE:
+      *value = frame->values[operand.value];
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+// Follows the edge to `target`, setting the phis at its top. They are all
+// read before any is written, since one may read another's old value.
+static eval_status enter_block(eval_frame* frame, int target) {
+  const ssa_function* function = frame->function;
+  const ssa_block* block = &function->blocks[target];
+  int edge = -1;
+  for (int i = 0; i < block->predecessor_count; i++) {
+    if (block->predecessors[i] == frame->block) {
+      edge = i;
+      break;
+    }
+  }
+  int phi_count = 0;
+  while (phi_count < block->instruction_count &&
+         function->instructions[block->instructions[phi_count]].opcode ==
+             SSA_PHI) {
+    const ssa_instruction* phi =
+        &function->instructions[block->instructions[phi_count]];
+    if (edge < 0 || edge >= phi->operand_count ||
+        !read_operand(frame, phi->operands[edge],
+                      &frame->phi_values[phi_count])) {
+      return EVAL_FAILED;
+    }
+    phi_count++;
+  }
+  for (int i = 0; i < phi_count; i++) {
+    frame->values[block->instructions[i]] = frame->phi_values[i];
+  }
+  frame->block = target;
+  frame->position = phi_count;
+  return EVAL_RUNNING;
+}
+
+static int run_function(evaluator* state, int index, const int* arguments,
+                        int depth, int* result);
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static eval_status run_call(evaluator* state, eval_frame* frame,
+                            const ssa_instruction* call, int* result) {
+  int callee = find_ssa_function(state->functions, state->count, call);
+  if (callee < 0 ||
+      call->operand_count != state->functions[callee].parameter_count ||
+      frame->depth + 1 >= EVAL_DEPTH_LIMIT) {
+    return EVAL_FAILED;
+  }
+  int* arguments =
+      (int*)checked_malloc(sizeof(int) * (size_t)call->operand_count);
+  eval_status status = EVAL_RUNNING;
+  for (int i = 0; i < call->operand_count && status == EVAL_RUNNING; i++) {
+    if (!read_operand(frame, call->operands[i], &arguments[i])) {
+      status = EVAL_FAILED;
+    }
+  }
+  if (status == EVAL_RUNNING &&
+      !run_function(state, callee, arguments, frame->depth + 1, result)) {
+    status = EVAL_FAILED;
+  }
+  free(arguments);
+  return status;
+}
+
+// Runs the instruction at the frame's position and moves past it.
+// NOLINTNEXTLINE(misc-no-recursion)
+static eval_status step(evaluator* state, eval_frame* frame) {
+  const ssa_function* function = frame->function;
+  const ssa_block* block = &function->blocks[frame->block];
+  if (frame->position >= block->instruction_count || --state->steps_left < 0) {
+    return EVAL_FAILED;
+  }
+  int id = block->instructions[frame->position++];
+  const ssa_instruction* instruction = &function->instructions[id];
+  int* value = &frame->values[id];
+  int first = 0;
+  int second = 0;
+  switch (instruction->opcode) {
+    case SSA_PARAMETER:
+      if (instruction->index >= function->parameter_count) {
+        return EVAL_FAILED;
+      }
+      *value = frame->arguments[instruction->index];
+      return EVAL_RUNNING;
+    case SSA_ADD:
+    case SSA_SUB:
+    case SSA_MUL:
+    case SSA_DIV:
+    case SSA_MOD:
+    case SSA_EQ:
+    case SSA_NE:
+    case SSA_LT:
+    case SSA_GT:
+    case SSA_LE:
+    case SSA_GE:
+      if (!read_operand(frame, instruction->operands[0], &first) ||
+          !read_operand(frame, instruction->operands[1], &second) ||
+          !fold_ssa_binary(instruction->opcode, first, second, value)) {
+        return EVAL_FAILED;
+      }
+      return EVAL_RUNNING;
+    case SSA_SELECT: {
+      int chosen = 0;
+      if (!read_operand(frame, instruction->operands[0], &first) ||
+          !read_operand(frame, instruction->operands[first != 0 ? 1 : 2],
+                        &chosen)) {
+        return EVAL_FAILED;
+      }
+      *value = chosen;
+      return EVAL_RUNNING;
+    }
+    case SSA_CALL:
+      return run_call(state, frame, instruction, value);
+    case SSA_JUMP:
+      return enter_block(frame, block->successors[0]);
+    case SSA_BRANCH:
+      if (!read_operand(frame, instruction->operands[0], &first)) {
+        return EVAL_FAILED;
+      }
+      return enter_block(frame, block->successors[first != 0 ? 0 : 1]);
+    case SSA_RETURN:
+      if (instruction->operand_count == 0 ||
+          !read_operand(frame, instruction->operands[0], &frame->result)) {
+        return EVAL_FAILED;
+      }
+      return EVAL_RETURNED;
+    default:
+      // Phis are set on entering their block; loads and stores are gone
+      // once locals are promoted.
+      return EVAL_FAILED;
+  }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static int run_function(evaluator* state, int index, const int* arguments,
+                        int depth, int* result) {
+  eval_frame frame;
+  frame.function = &state->functions[index];
+  frame.arguments = arguments;
+  size_t value_count = (size_t)frame.function->instruction_count;
+  frame.values = (int*)checked_malloc(sizeof(int) * value_count);
+  frame.phi_values = (int*)checked_malloc(sizeof(int) * value_count);
+  memset(frame.values, 0, sizeof(int) * value_count);
+  frame.block = 0;
+  frame.position = 0;
+  frame.depth = depth;
+  frame.result = 0;
+
+  eval_status status = EVAL_RUNNING;
+  while (status == EVAL_RUNNING) {
+    status = step(state, &frame);
+  }
+  free(frame.phi_values);
+  free(frame.values);
+  if (status != EVAL_RETURNED) {
+    return 0;
+  }
+  *result = frame.result;
+  return 1;
+}
+
+int evaluate_ssa_call(const ssa_function* functions, int count, int callee,
+                      const int* arguments, int step_limit, int* result) {
+  evaluator state;
+  state.functions = functions;
+  state.count = count;
+  state.steps_left = step_limit;
+  return run_function(&state, callee, arguments, 0, result);
+}
+
+// ───── Program Rewriting ─────
+
+static int has_constant_operands(const ssa_instruction* instruction) {
+  for (int i = 0; i < instruction->operand_count; i++) {
+    if (instruction->operands[i].kind != SSA_OPERAND_CONSTANT) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Replaces every call in one function that can be evaluated by its result.
+// Returns 1 if any was.
+static int fold_constant_calls(ssa_function* functions, int count, int caller,
+                               int step_limit) {
+  ssa_function* function = &functions[caller];
+  int changed = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    const ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block < 0 || instruction->opcode != SSA_CALL ||
+        !has_constant_operands(instruction)) {
+      continue;
+    }
+    int callee = find_ssa_function(functions, count, instruction);
+    if (callee < 0 ||
+        instruction->operand_count != functions[callee].parameter_count) {
+      continue;
+    }
+    int* arguments = (int*)checked_malloc(
+        sizeof(int) * (size_t)instruction->operand_count);
+    for (int j = 0; j < instruction->operand_count; j++) {
+      arguments[j] = instruction->operands[j].value;
+    }
+    int result = 0;
+    if (evaluate_ssa_call(functions, count, callee, arguments, step_limit,
+                          &result)) {
+      replace_ssa_uses(function, i, ssa_constant(result));
+      remove_ssa_instruction(function, i);
+      changed = 1;
+    }
+    free(arguments);
+  }
+  return changed;
+}
+
+// Replaces the parameters of one function that every call in the program
+// passes the same constant. Returns 1 if any was.
+static int propagate_constant_arguments(ssa_function* functions, int count,
+                                        int callee) {
+  ssa_function* function = &functions[callee];
+  int parameter_count = function->parameter_count;
+  if (parameter_count == 0 || is_ssa_main(function)) {
+    return 0;
+  }
+  int* constants = (int*)checked_malloc(sizeof(int) * (size_t)parameter_count);
+  unsigned char* agreed =
+      (unsigned char*)checked_malloc((size_t)parameter_count);
+  memset(agreed, 1, (size_t)parameter_count);
+  int call_count = 0;
+  int valid = 1;
+  for (int i = 0; i < count && valid; i++) {
+    for (int j = 0; j < functions[i].instruction_count && valid; j++) {
+      const ssa_instruction* call = &functions[i].instructions[j];
+      if (call->block < 0 || call->opcode != SSA_CALL ||
+          find_ssa_function(functions, count, call) != callee) {
+        continue;
+      }
+      valid = call->operand_count == parameter_count;
+      call_count++;
+      for (int p = 0; p < parameter_count && valid; p++) {
+        ssa_operand argument = call->operands[p];
+        if (argument.kind != SSA_OPERAND_CONSTANT ||
+            (call_count > 1 && argument.value != constants[p])) {
+          agreed[p] = 0;
+        }
+        constants[p] = argument.value;
+      }
+    }
+  }
+
+  int changed = 0;
+  if (valid && call_count > 0) {
+    ssa_use_list* uses = build_ssa_use_lists(function);
+    for (int i = 0; i < function->instruction_count; i++) {
+      const ssa_instruction* instruction = &function->instructions[i];
+      if (instruction->block >= 0 && instruction->opcode == SSA_PARAMETER &&
+          instruction->index < parameter_count &&
+          agreed[instruction->index] && uses[i].count > 0) {
+        replace_ssa_uses(function, i,
+                         ssa_constant(constants[instruction->index]));
+        changed = 1;
+      }
+    }
+    free_ssa_use_lists(uses, function->instruction_count);
+  }
+  free(agreed);
+  free(constants);
+  return changed;
+}
+
+void evaluate_constant_calls(ssa_function* functions, int count,
+                             int step_limit) {
+  if (step_limit <= 0 || count == 0) {
+    return;
+  }
+  unsigned char* changed = (unsigned char*)checked_malloc((size_t)count);
+  int any_changed = 1;
+  // Each round removes calls or makes parameters unused, so this ends.
+  while (any_changed) {
+    any_changed = 0;
+    for (int i = 0; i < count; i++) {
+      changed[i] = (unsigned char)fold_constant_calls(functions, count, i,
+                                                      step_limit);
+      if (propagate_constant_arguments(functions, count, i)) {
+        changed[i] = 1;
+      }
+    }
+    for (int i = 0; i < count; i++) {
+      if (changed[i]) {
+        compute_ssa_dominators(&functions[i]);
+        number_ssa_values(&functions[i]);
+        eliminate_dead_ssa_code(&functions[i]);
+        any_changed = 1;
+      }
+    }
+  }
+  free(changed);
+}
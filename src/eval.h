@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ssa.h"
+
+enum { DEFAULT_EVAL_STEP_LIMIT = 100000, EVAL_DEPTH_LIMIT = 64 };
+
+/*
+Runs a function at compile time on constant arguments.
+
+The SSA form is interpreted directly, with the same 32-bit wrapping
+arithmetic as the generated code. Every instruction executed, in the
+function and in everything it calls, counts against `step_limit`, and calls
+may nest at most EVAL_DEPTH_LIMIT deep, so a function that loops forever or
+recurses without bound is simply given up on.
+
+Args:
+  functions: Every function of the program, promoted.
+  count: Number of functions.
+  callee: Index of the function to run.
+  arguments: One constant per parameter.
+  step_limit: Most instructions to execute.
+  result: Set to the returned value when the function returns 1.
+
+Returns:
+  1 if the function returned a value within the limits, or 0 if it ran out
+  of steps or depth, divided by zero or INT_MIN by -1 (which trap at run
+  time), returned nothing, or called a function the program does not define
+  or with the wrong number of arguments.
+*/
+int evaluate_ssa_call(const ssa_function* functions, int count, int callee,
+                      const int* arguments, int step_limit, int* result);
+
+/*
+Evaluates calls with constant arguments across a whole program.
+
+Every call whose arguments are all constants is run with
+evaluate_ssa_call, and when that succeeds the call is replaced by its
+result. A parameter that every call in the program passes the same
+constant is replaced by that constant inside the callee. main is left
+alone, since it is called from outside. Changed functions are cleaned up
+with number_ssa_values and eliminate_dead_ssa_code, which can make more
+arguments constant, so both steps repeat until nothing changes.
+
+Args:
+  functions: Every function of the program, promoted and cleaned up.
+  count: Number of functions.
+  step_limit: Most instructions to execute for each call; 0 disables
+    evaluation and propagation.
+
+Returns:
+  void
+*/
+void evaluate_constant_calls(ssa_function* functions, int count,
+                             int step_limit);
@@ -0,0 +1,329 @@
+/*
+ * Constant Folding
+ * Compile-time evaluation and algebraic simplification on the AST.
+ */
+
+#include "fold.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ssa.h"
+
+// Constant value known for each resolver slot at the current statement.
+typedef struct constant_environment {
+  int* known;
+  int* values;
+  int slot_count;
+} constant_environment;
+
+static void init_environment(constant_environment* environment,
+                             int slot_count) {
+  size_t size = sizeof(int) * ((size_t)slot_count + 1);
+  environment->slot_count = slot_count;
+  environment->known = (int*)malloc(size);
+  environment->values = (int*)malloc(size);
+  if (!environment->known || !environment->values) {
+    error_and_exit("malloc failed");
+  }
+  memset(environment->known, 0, size);
+}
+
+static void copy_environment(constant_environment* copy,
+                             const constant_environment* environment) {
+  init_environment(copy, environment->slot_count);
+  size_t size = sizeof(int) * ((size_t)environment->slot_count + 1);
+  memcpy(copy->known, environment->known, size);
+  memcpy(copy->values, environment->values, size);
+}
+
+static void free_environment(constant_environment* environment) {
+  free(environment->known);
+  free(environment->values);
+}
+
+static int is_literal(const ast_node* node, int value) {
+  return node->type == AST_INT_LITERAL &&
+         node->as.int_literal.int_literal == value;
+}
+
+static void make_literal(ast_node* node, int value) {
+  node->type = AST_INT_LITERAL;
+  node->as.int_literal.int_literal = value;
+  node->as.int_literal.token = NULL;
+}
+
+// Replaces node with one of its operands.
+static void replace_with(ast_node* node, const ast_node* operand) {
+  *node = *operand;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static int has_call(const ast_node* node) {
+  switch (node->type) {
+    case AST_FUNCTION_CALL:
+      return 1;
+    case AST_BINARY:
+      return has_call(node->as.binary.left) || has_call(node->as.binary.right);
+    case AST_UNARY:
+      return has_call(node->as.unary.operand);
+    default:
+      return 0;
+  }
+}
+
+// Evaluates left op right as the generated code would. Returns 0 when the
+// operation must be left to run time.
+static int evaluate_binary(TokenType operator, int left, int right,
+                           int* result) {
+  ssa_opcode opcode = SSA_ADD;
+  switch (operator) {
+    case TOKEN_PLUS:
+      opcode = SSA_ADD;
+      break;
+    case TOKEN_MINUS:
+      opcode = SSA_SUB;
+      break;
+    case TOKEN_STAR:
+      opcode = SSA_MUL;
+      break;
+    case TOKEN_SLASH:
+      opcode = SSA_DIV;
+      break;
+    case TOKEN_PERCENT:
+      opcode = SSA_MOD;
+      break;
+    case TOKEN_EQ:
+      opcode = SSA_EQ;
+      break;
+    case TOKEN_NEQ:
+      opcode = SSA_NE;
+      break;
+    case TOKEN_LT:
+      opcode = SSA_LT;
+      break;
+    case TOKEN_GT:
+      opcode = SSA_GT;
+      break;
+    case TOKEN_LEQ:
+      opcode = SSA_LE;
+      break;
+    case TOKEN_GEQ:
+      opcode = SSA_GE;
+      break;
+    default:
+      return 0;
+  }
+  return fold_ssa_binary(opcode, left, right, result);
+}
+
+static void simplify_identities(ast_node* node) {
+  ast_node* left = node->as.binary.left;
+  ast_node* right = node->as.binary.right;
+  switch (node->as.binary._operator) {
+    case TOKEN_PLUS:
+      if (is_literal(right, 0)) {
+        replace_with(node, left);
+      } else if (is_literal(left, 0)) {
+        replace_with(node, right);
+      }
+      break;
+    case TOKEN_MINUS:
+      if (is_literal(right, 0)) {
+        replace_with(node, left);
+      } else if (left->type == AST_VARIABLE && right->type == AST_VARIABLE &&
+                 left->slot == right->slot) {
+        make_literal(node, 0);
+      }
+      break;
+    case TOKEN_STAR:
+      if (is_literal(right, 1)) {
+        replace_with(node, left);
+      } else if (is_literal(left, 1)) {
+        replace_with(node, right);
+      } else if ((is_literal(right, 0) && !has_call(left)) ||
+                 (is_literal(left, 0) && !has_call(right))) {
+        make_literal(node, 0);
+      }
+      break;
+    case TOKEN_SLASH:
+      if (is_literal(right, 1)) {
+        replace_with(node, left);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static void fold_expression(ast_node* node,
+                            const constant_environment* environment) {
+  if (node == NULL) {
+    return;
+  }
+  switch (node->type) {
+    case AST_VARIABLE:
+      if (node->slot >= 0 && environment->known[node->slot]) {
+        make_literal(node, environment->values[node->slot]);
+      }
+      break;
+    case AST_UNARY:
+      fold_expression(node->as.unary.operand, environment);
+      if (node->as.unary._operator == '-' &&
+          node->as.unary.operand->type == AST_INT_LITERAL) {
+        make_literal(node,
+                     (int)(0U - (unsigned int)node->as.unary.operand->as
+                                    .int_literal.int_literal));
+      }
+      break;
+    case AST_BINARY: {
+      fold_expression(node->as.binary.left, environment);
+      fold_expression(node->as.binary.right, environment);
+      ast_node* left = node->as.binary.left;
+      ast_node* right = node->as.binary.right;
+      int result = 0;
+      if (left->type == AST_INT_LITERAL && right->type == AST_INT_LITERAL &&
+          evaluate_binary(node->as.binary._operator,
+                          left->as.int_literal.int_literal,
+                          right->as.int_literal.int_literal, &result)) {
+        make_literal(node, result);
+      } else {
+        simplify_identities(node);
+      }
+      break;
+    }
+    case AST_FUNCTION_CALL:
+      for (int i = 0; i < node->as.function_call.param_count; i++) {
+        fold_expression(node->as.function_call.parameters[i], environment);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void forget_slot(constant_environment* environment, int slot) {
+  if (slot >= 0) {
+    environment->known[slot] = 0;
+  }
+}
+
+// Forgets every variable a statement may write.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void forget_assigned(const ast_node* node,
+                            constant_environment* environment) {
+  if (node == NULL) {
+    return;
+  }
+  switch (node->type) {
+    case AST_VARIABLE_DECLARATION:
+      forget_slot(environment, node->slot);
+      break;
+    case AST_DECLARATION:
+      forget_slot(environment, node->as.declaration.variable->slot);
+      break;
+    case AST_IF_STATEMENT:
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      forget_assigned(node->as.if_elif_else_statement.body, environment);
+      break;
+    case AST_WHILE_STATEMENT:
+      forget_assigned(node->as.while_statement.body, environment);
+      break;
+    case AST_BLOCK:
+      for (int i = 0; i < node->as.block.count; i++) {
+        forget_assigned(node->as.block.statements[i], environment);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void fold_statement(ast_node* node, constant_environment* environment);
+
+// Folds a body that may or may not run, against a scratch copy of what is
+// known on entry.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void fold_conditional_body(ast_node* body,
+                                  const constant_environment* environment) {
+  constant_environment body_environment;
+  copy_environment(&body_environment, environment);
+  fold_statement(body, &body_environment);
+  free_environment(&body_environment);
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static void fold_statement(ast_node* node, constant_environment* environment) {
+  if (node == NULL) {
+    return;
+  }
+  switch (node->type) {
+    case AST_VARIABLE_DECLARATION:
+      forget_slot(environment, node->slot);
+      break;
+    case AST_DECLARATION: {
+      ast_node* expression = node->as.declaration.expression;
+      fold_expression(expression, environment);
+      int slot = node->as.declaration.variable->slot;
+      if (slot >= 0) {
+        environment->known[slot] = expression->type == AST_INT_LITERAL;
+        if (environment->known[slot]) {
+          environment->values[slot] = expression->as.int_literal.int_literal;
+        }
+      }
+      break;
+    }
+    case AST_RETURN:
+      fold_expression(node->as._return.expression, environment);
+      break;
+    case AST_FUNCTION_CALL:
+      fold_expression(node, environment);
+      break;
+    case AST_IF_STATEMENT:
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      fold_expression(node->as.if_elif_else_statement.condition, environment);
+      fold_conditional_body(node->as.if_elif_else_statement.body, environment);
+      forget_assigned(node, environment);
+      break;
+    case AST_WHILE_STATEMENT:
+      // The condition and body also see values from earlier iterations.
+      forget_assigned(node, environment);
+      fold_expression(node->as.while_statement.condition, environment);
+      fold_conditional_body(node->as.while_statement.body, environment);
+      break;
+    case AST_BLOCK:
+      for (int i = 0; i < node->as.block.count; i++) {
+        fold_statement(node->as.block.statements[i], environment);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void fold_function_constants(ast_node* function) {
+  if (function->type != AST_FUNCTION_DECLARATION) {
+    error_and_exit("Error: Not a function node\n");
+  }
+  if (function->as.function.slot_count < 0) {
+    resolve_function_variables(function);
+  }
+  constant_environment environment;
+  init_environment(&environment, function->as.function.slot_count);
+  fold_statement(function->as.function.statements, &environment);
+  free_environment(&environment);
+}
+
+void fold_constants(ast_node** nodes, int number_of_functions) {
+  for (int i = 0; i < number_of_functions; i++) {
+    if (nodes[i] != NULL) {
+      fold_function_constants(nodes[i]);
+    }
+  }
+}
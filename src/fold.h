@@ -0,0 +1,35 @@
+#pragma once
+
+#include "parser.h"
+
+/*
+Folds constants and simplifies arithmetic identities in one function.
+
+Evaluates binary operators whose operands are both constant with 32-bit
+wrapping semantics, leaving division or modulo by zero and INT_MIN / -1 for
+run time. Rewrites x + 0, x - 0, x * 1, x / 1, x * 0 (when x has no calls)
+and x - x for the same variable. Variables initialized or assigned a
+constant are replaced by that constant at later uses in straight-line code;
+anything assigned inside an if or while body is forgotten after it, and
+inside a loop before it. Nodes are rewritten in place. Resolves the
+function's variables first if that has not happened yet.
+
+Args:
+  function: AST_FUNCTION_DECLARATION node.
+
+Returns:
+  void
+*/
+void fold_function_constants(ast_node* function);
+
+/*
+Runs fold_function_constants over every top-level function.
+
+Args:
+  nodes: Array of ast_node pointers.
+  number_of_functions: Number of entries in nodes.
+
+Returns:
+  void
+*/
+void fold_constants(ast_node** nodes, int number_of_functions);
@@ -0,0 +1,288 @@
+/*
+ * Global Value Numbering
+ * Dominator-scoped common subexpression elimination and constant folding
+ * on the SSA form.
+ */
+
+#include "gvn.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "ssa.h"
+
+// An instruction available in the current dominator-tree scope, chained to
+// the entry that headed its bucket before it.
+typedef struct value_entry {
+  unsigned hash;
+  int instruction;
+  int next;
+} value_entry;
+
+// Scoped hash table. Entries are pushed as instructions are numbered and
+// popped in reverse order on leaving a dominator subtree, so each bucket
+// head can be restored from the popped entry's `next`.
+typedef struct value_table {
+  int* buckets;
+  unsigned mask;
+  value_entry* entries;
+  int entry_count;
+} value_table;
+
+typedef struct value_numbering {
+  ssa_function* function;
+  value_table table;
+  ssa_operand* replacement;  // What each redundant instruction becomes.
+} value_numbering;
+
+// ───── Canonical Form ─────
+
+static int is_commutative(ssa_opcode opcode) {
+  return opcode == SSA_ADD || opcode == SSA_MUL || opcode == SSA_EQ ||
+         opcode == SSA_NE;
+}
+
+static ssa_opcode get_swapped_comparison(ssa_opcode opcode) {
+  switch (opcode) {
+    case SSA_LT:
+      return SSA_GT;
+    case SSA_GT:
+      return SSA_LT;
+    case SSA_LE:
+      return SSA_GE;
+    case SSA_GE:
+      return SSA_LE;
+    default:
+      return opcode;
+  }
+}
+
+static int is_numbered(ssa_opcode opcode) {
+  return (opcode >= SSA_ADD && opcode <= SSA_SELECT) || opcode == SSA_PHI;
+}
+
+// Checks whether an operand belongs after another in canonical order:
+// constants last, values by number.
+static int goes_after(ssa_operand first, ssa_operand second) {
+  if (first.kind != second.kind) {
+    return first.kind == SSA_OPERAND_CONSTANT;
+  }
+  return first.kind == SSA_OPERAND_VALUE && first.value > second.value;
+}
+
+// Orders the operands of commutative operators and comparisons, flipping
+// the comparison when its operands swap.
+static void canonicalize(ssa_instruction* instruction) {
+  ssa_opcode swapped = get_swapped_comparison(instruction->opcode);
+  if (!is_commutative(instruction->opcode) && swapped == instruction->opcode) {
+    return;
+  }
+  if (!goes_after(instruction->operands[0], instruction->operands[1])) {
+    return;
+  }
+  ssa_operand first = instruction->operands[0];
+  instruction->operands[0] = instruction->operands[1];
+  instruction->operands[1] = first;
+  instruction->opcode = swapped;
+}
+
+// ───── Constant Folding ─────
+
+static int try_fold(const ssa_instruction* instruction, int* result) {
+  if (instruction->opcode == SSA_PHI || instruction->operand_count != 2 ||
+      instruction->operands[0].kind != SSA_OPERAND_CONSTANT ||
+      instruction->operands[1].kind != SSA_OPERAND_CONSTANT) {
+    return 0;
+  }
+  return fold_ssa_binary(instruction->opcode, instruction->operands[0].value,
+                         instruction->operands[1].value, result);
+}
+
+// A select on a constant, or between two equal operands, is just one of
+// its operands.
+static int try_simplify_select(const ssa_instruction* instruction,
+                               ssa_operand* result) {
+  if (instruction->opcode != SSA_SELECT) {
+    return 0;
+  }
+  ssa_operand condition = instruction->operands[0];
+  ssa_operand on_true = instruction->operands[1];
+  ssa_operand on_false = instruction->operands[2];
+  if (condition.kind == SSA_OPERAND_CONSTANT) {
+    *result = condition.value != 0 ? on_true : on_false;
+    return 1;
+  }
+  if (on_true.kind == on_false.kind && on_true.value == on_false.value) {
+    *result = on_true;
+    return 1;
+  }
+  return 0;
+}
+
+// ───── Value Table ─────
+
+static unsigned hash_instruction(const ssa_instruction* instruction) {
+  unsigned hash = 2166136261U ^ (unsigned)instruction->opcode;
+  if (instruction->opcode == SSA_PHI) {
+    // Phis in different blocks merge different paths.
+    hash = (hash * 16777619U) ^ (unsigned)instruction->block;
+  }
+  for (int i = 0; i < instruction->operand_count; i++) {
+    hash = (hash * 16777619U) ^ (unsigned)instruction->operands[i].kind;
+    hash = (hash * 16777619U) ^ (unsigned)instruction->operands[i].value;
+  }
+  return hash;
+}
+
+static int is_same_expression(const ssa_instruction* first,
+                              const ssa_instruction* second) {
+  if (first->opcode != second->opcode ||
+      first->operand_count != second->operand_count ||
+      (first->opcode == SSA_PHI && first->block != second->block)) {
+    return 0;
+  }
+  for (int i = 0; i < first->operand_count; i++) {
+    if (first->operands[i].kind != second->operands[i].kind ||
+        first->operands[i].value != second->operands[i].value) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void init_table(value_table* table, int instruction_count) {
+  unsigned bucket_count = 16;
+  while (bucket_count < 2U * (unsigned)instruction_count) {
+    bucket_count *= 2;
+  }
+  table->mask = bucket_count - 1;
+  table->buckets = (int*)malloc(sizeof(int) * bucket_count);
+  table->entries = (value_entry*)malloc(sizeof(value_entry) *
+                                        ((size_t)instruction_count + 1));
+  if (!table->buckets || !table->entries) {
+    error_and_exit("malloc failed");
+  }
+  for (unsigned i = 0; i < bucket_count; i++) {
+    table->buckets[i] = -1;
+  }
+  table->entry_count = 0;
+}
+
+static void free_table(value_table* table) {
+  free(table->buckets);
+  free(table->entries);
+}
+
+// Returns the available instruction computing the same value, or -1 after
+// making this one available instead.
+static int find_or_insert(value_table* table, const ssa_function* function,
+                          int instruction) {
+  const ssa_instruction* candidate = &function->instructions[instruction];
+  unsigned hash = hash_instruction(candidate);
+  int* bucket = &table->buckets[hash & table->mask];
+  for (int i = *bucket; i >= 0; i = table->entries[i].next) {
+    if (table->entries[i].hash == hash &&
+        is_same_expression(
+            &function->instructions[table->entries[i].instruction],
+            candidate)) {
+      return table->entries[i].instruction;
+    }
+  }
+  value_entry* entry = &table->entries[table->entry_count];
+  entry->hash = hash;
+  entry->instruction = instruction;
+  entry->next = *bucket;
+  *bucket = table->entry_count++;
+  return -1;
+}
+
+static void pop_entries(value_table* table, int mark) {
+  while (table->entry_count > mark) {
+    const value_entry* entry = &table->entries[--table->entry_count];
+    table->buckets[entry->hash & table->mask] = entry->next;
+  }
+}
+
+// ───── Dominator Walk ─────
+
+static void apply_replacements(const value_numbering* state,
+                               ssa_instruction* instruction) {
+  for (int i = 0; i < instruction->operand_count; i++) {
+    ssa_operand* operand = &instruction->operands[i];
+    if (operand->kind == SSA_OPERAND_VALUE &&
+        state->replacement[operand->value].kind != SSA_OPERAND_NONE) {
+      *operand = state->replacement[operand->value];
+    }
+  }
+}
+
+// Numbers one block's instructions and then its dominator-tree children,
+// which see everything this block makes available.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void number_block(value_numbering* state, int block) {
+  ssa_function* function = state->function;
+  int mark = state->table.entry_count;
+  const ssa_block* current = &function->blocks[block];
+  for (int i = 0; i < current->instruction_count; i++) {
+    int id = current->instructions[i];
+    ssa_instruction* instruction = &function->instructions[id];
+    // A phi input along a back edge may not be numbered yet; the final
+    // rewrite in number_ssa_values catches it.
+    apply_replacements(state, instruction);
+    if (!is_numbered(instruction->opcode)) {
+      continue;
+    }
+    if (instruction->opcode != SSA_PHI) {
+      canonicalize(instruction);
+    }
+    int folded = 0;
+    if (try_fold(instruction, &folded)) {
+      state->replacement[id] = ssa_constant(folded);
+      continue;
+    }
+    ssa_operand selected;
+    if (try_simplify_select(instruction, &selected)) {
+      state->replacement[id] = selected;
+      continue;
+    }
+    int leader = find_or_insert(&state->table, function, id);
+    if (leader >= 0) {
+      state->replacement[id] = ssa_value(leader);
+    }
+  }
+  for (int i = 0; i < current->dominator_child_count; i++) {
+    number_block(state, current->dominator_children[i]);
+  }
+  pop_entries(&state->table, mark);
+}
+
+void number_ssa_values(ssa_function* function) {
+  value_numbering state;
+  state.function = function;
+  init_table(&state.table, function->instruction_count);
+  state.replacement = (ssa_operand*)malloc(
+      sizeof(ssa_operand) * ((size_t)function->instruction_count + 1));
+  if (!state.replacement) {
+    error_and_exit("malloc failed");
+  }
+  for (int i = 0; i < function->instruction_count; i++) {
+    state.replacement[i] = ssa_none();
+  }
+
+  number_block(&state, 0);
+
+  for (int i = 0; i < function->instruction_count; i++) {
+    ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block < 0) {
+      continue;
+    }
+    if (state.replacement[i].kind != SSA_OPERAND_NONE) {
+      remove_ssa_instruction(function, i);
+    } else {
+      apply_replacements(&state, instruction);
+    }
+  }
+  free(state.replacement);
+  free_table(&state.table);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ssa.h"
+
+/*
+Removes redundant computations with dominator-scoped value numbering.
+
+Walks the dominator tree keeping a table of the pure instructions
+(arithmetic, comparisons and phis) whose blocks dominate the current one.
+An instruction computing the same opcode on the same operands as one in the
+table is replaced by that earlier value. Commutative operators and
+comparisons are put in a canonical operand order first, constants second,
+so a + b and b + a match, as do a < b and b > a. Instructions whose
+operands are all constant are folded with 32-bit wrapping semantics, except
+division or modulo by zero and INT_MIN / -1, which are left to trap at run
+time. A select whose condition is constant, or whose two values are equal,
+is replaced by the value it picks. Needs compute_ssa_dominators; the CFG is
+left unchanged.
+
+Args:
+  function: Function in SSA form, with every local promoted.
+
+Returns:
+  void
+*/
+void number_ssa_values(ssa_function* function);
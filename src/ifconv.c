@@ -0,0 +1,198 @@
+/*
+ * If-Conversion
+ * Replaces short value-picking branches with selects on the SSA form.
+ */
+
+#include "ifconv.h"
+
+#include <stdlib.h>
+
+#include "codegen.h"
+#include "ssa.h"
+
+// Returns the block an arm jumps to when the arm is reached only from
+// `branch` and everything before its jump can be speculated, adding those
+// instructions to *cost; otherwise -1.
+static int get_arm_target(const ssa_function* function, int branch, int arm,
+                          int* cost) {
+  const ssa_block* current = &function->blocks[arm];
+  if (arm == branch || current->predecessor_count != 1 ||
+      current->predecessors[0] != branch || current->instruction_count == 0) {
+    return -1;
+  }
+  int last = current->instruction_count - 1;
+  if (function->instructions[current->instructions[last]].opcode !=
+      SSA_JUMP) {
+    return -1;
+  }
+  for (int i = 0; i < last; i++) {
+    int instruction = current->instructions[i];
+    if (!ssa_can_speculate(&function->instructions[instruction])) {
+      return -1;
+    }
+  }
+  *cost += last;
+  return current->successors[0];
+}
+
+static int find_predecessor(const ssa_function* function, int block,
+                            int predecessor) {
+  const ssa_block* current = &function->blocks[block];
+  for (int i = 0; i < current->predecessor_count; i++) {
+    if (current->predecessors[i] == predecessor) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int count_phis(const ssa_function* function, int block) {
+  const ssa_block* current = &function->blocks[block];
+  int count = 0;
+  while (count < current->instruction_count &&
+         function->instructions[current->instructions[count]].opcode ==
+             SSA_PHI) {
+    count++;
+  }
+  return count;
+}
+
+static int is_same_operand(ssa_operand first, ssa_operand second) {
+  return first.kind == second.kind && first.value == second.value;
+}
+
+// Moves everything but an arm's jump to just before the terminator of the
+// block that branches to it.
+static void hoist_arm(ssa_function* function, int arm, int block) {
+  int count = function->blocks[arm].instruction_count - 1;
+  for (int i = 0; i < count; i++) {
+    // Each hoisted instruction leaves the arm, so the next is always first.
+    move_ssa_instruction(function, function->blocks[arm].instructions[0],
+                         block, function->blocks[block].instruction_count - 1);
+  }
+}
+
+// Converts the diamond or triangle below a block when it has one and it
+// fits the limit. Returns 1 if it did.
+static int convert_branch(ssa_function* function, int block) {
+  const ssa_block* current = &function->blocks[block];
+  if (current->instruction_count == 0) {
+    return 0;
+  }
+  int terminator = current->instructions[current->instruction_count - 1];
+  if (function->instructions[terminator].opcode != SSA_BRANCH) {
+    return 0;
+  }
+  ssa_operand condition = function->instructions[terminator].operands[0];
+  if (condition.kind != SSA_OPERAND_VALUE) {
+    return 0;
+  }
+  int on_true = current->successors[0];
+  int on_false = current->successors[1];
+  if (on_true == on_false) {
+    return 0;
+  }
+
+  // The blocks the join is entered from when the condition holds and when
+  // it does not: an arm, or the branching block itself for a triangle.
+  int cost = 0;
+  int true_target = get_arm_target(function, block, on_true, &cost);
+  int false_target = get_arm_target(function, block, on_false, &cost);
+  int join;
+  int true_source = on_true;
+  int false_source = on_false;
+  if (true_target >= 0 && true_target == false_target) {
+    join = true_target;
+  } else if (true_target == on_false) {
+    join = on_false;
+    false_source = block;
+  } else if (false_target == on_true) {
+    join = on_true;
+    true_source = block;
+  } else {
+    return 0;
+  }
+  if (join == block) {
+    return 0;
+  }
+
+  int phi_count = count_phis(function, join);
+  int true_position = find_predecessor(function, join, true_source);
+  int false_position = find_predecessor(function, join, false_source);
+  for (int i = 0; i < phi_count; i++) {
+    const ssa_instruction* phi =
+        &function->instructions[function->blocks[join].instructions[i]];
+    if (!is_same_operand(phi->operands[true_position],
+                         phi->operands[false_position])) {
+      cost++;
+    }
+  }
+  if (cost > IF_CONVERSION_LIMIT) {
+    return 0;
+  }
+
+  if (true_source != block) {
+    hoist_arm(function, true_source, block);
+  }
+  if (false_source != block) {
+    hoist_arm(function, false_source, block);
+  }
+  int* phis = (int*)checked_malloc(sizeof(int) * (size_t)phi_count);
+  ssa_operand* values =
+      (ssa_operand*)checked_malloc(sizeof(ssa_operand) * (size_t)phi_count);
+  for (int i = 0; i < phi_count; i++) {
+    phis[i] = function->blocks[join].instructions[i];
+    ssa_operand if_true =
+        function->instructions[phis[i]].operands[true_position];
+    ssa_operand if_false =
+        function->instructions[phis[i]].operands[false_position];
+    values[i] = if_true;
+    if (!is_same_operand(if_true, if_false)) {
+      int select = insert_ssa_instruction(
+          function, block, function->blocks[block].instruction_count - 1,
+          SSA_SELECT);
+      add_ssa_operand(function, select, condition);
+      add_ssa_operand(function, select, if_true);
+      add_ssa_operand(function, select, if_false);
+      values[i] = ssa_value(select);
+    }
+  }
+
+  remove_ssa_instruction(function, terminator);
+  add_ssa_instruction(function, block, SSA_JUMP, ssa_none(), ssa_none());
+  remove_ssa_edge(function, block, on_true);
+  remove_ssa_edge(function, block, on_false);
+  if (true_source != block) {
+    remove_ssa_edge(function, true_source, join);
+  }
+  if (false_source != block) {
+    remove_ssa_edge(function, false_source, join);
+  }
+  add_ssa_edge(function, block, join);
+  for (int i = 0; i < phi_count; i++) {
+    add_ssa_operand(function, phis[i], values[i]);
+  }
+  free(values);
+  free(phis);
+  return 1;
+}
+
+void convert_ssa_branches_to_selects(ssa_function* function) {
+  int changed = 0;
+  int progress = 1;
+  while (progress) {
+    progress = 0;
+    // Later blocks first, so inner ifs are converted before the ones
+    // around them look at their arms.
+    for (int b = function->block_count - 1; b >= 0; b--) {
+      if (convert_branch(function, b)) {
+        progress = 1;
+        changed = 1;
+      }
+    }
+  }
+  if (changed) {
+    remove_unreachable_ssa_blocks(function);
+    compute_ssa_dominators(function);
+  }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ssa.h"
+
+// Most instructions and selects one conversion may speculate.
+enum { IF_CONVERSION_LIMIT = 4 };
+
+/*
+Replaces short branches that only pick between values with selects.
+
+Looks for a block ending in a branch whose arms are diamonds (both
+successors are single-predecessor blocks jumping to the same join) or
+triangles (one successor is such a block and the other is the join). The
+arms' instructions are hoisted above the branch, each phi in the join that
+merges differing values gets a select on the branch condition, and the
+branch becomes a jump, so lowering can emit cmp and cmov instead of jumps
+the processor may mispredict. An arm qualifies only when it has no phis and
+every instruction is safe to run unconditionally: calls and divisions that
+could trap stay behind the branch. A conversion is skipped when the
+hoisted instructions plus the selects exceed IF_CONVERSION_LIMIT. Nested
+shapes are converted inside out. Removes the emptied arms and recomputes the
+dominators when anything changes.
+
+Args:
+  function: Function with its locals promoted.
+
+Returns:
+  void
+*/
+void convert_ssa_branches_to_selects(ssa_function* function);
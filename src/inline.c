@@ -0,0 +1,277 @@
+/*
+ * Inlining
+ * Copies small, non-recursive callees into their callers on the SSA form.
+ */
+
+#include "inline.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "dce.h"
+#include "gvn.h"
+#include "ssa.h"
+
+int get_ssa_function_size(const ssa_function* function) {
+  int size = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    const ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block >= 0 && instruction->opcode != SSA_PARAMETER &&
+        instruction->opcode != SSA_PHI && instruction->opcode != SSA_JUMP) {
+      size++;
+    }
+  }
+  return size;
+}
+
+// ───── Call Graph ─────
+
+// calls[caller * count + callee] is 1 when caller has a call to callee.
+static unsigned char* build_call_graph(const ssa_function* functions,
+                                       int count) {
+  size_t size = (size_t)count * (size_t)count;
+  unsigned char* calls = (unsigned char*)checked_malloc(size);
+  memset(calls, 0, size);
+  for (int i = 0; i < count; i++) {
+    const ssa_function* function = &functions[i];
+    for (int j = 0; j < function->instruction_count; j++) {
+      const ssa_instruction* instruction = &function->instructions[j];
+      if (instruction->block < 0 || instruction->opcode != SSA_CALL) {
+        continue;
+      }
+      int callee = find_ssa_function(functions, count, instruction);
+      if (callee >= 0) {
+        calls[(size_t)i * (size_t)count + (size_t)callee] = 1;
+      }
+    }
+  }
+  return calls;
+}
+
+// Checks whether a function can reach itself through the call graph.
+static int is_recursive(const unsigned char* calls, int count, int function) {
+  unsigned char* seen = (unsigned char*)checked_malloc((size_t)count);
+  memset(seen, 0, (size_t)count);
+  int* stack = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  int depth = 0;
+  stack[depth++] = function;
+  int found = 0;
+  while (depth > 0 && !found) {
+    int current = stack[--depth];
+    for (int callee = 0; callee < count; callee++) {
+      if (!calls[(size_t)current * (size_t)count + (size_t)callee]) {
+        continue;
+      }
+      if (callee == function) {
+        found = 1;
+        break;
+      }
+      if (!seen[callee]) {
+        seen[callee] = 1;
+        stack[depth++] = callee;
+      }
+    }
+  }
+  free(stack);
+  free(seen);
+  return found;
+}
+
+// Appends a function to `order` after everything it calls.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void visit_callees_first(const unsigned char* calls, int count,
+                                int function, unsigned char* visited,
+                                int* order, int* order_count) {
+  visited[function] = 1;
+  for (int callee = 0; callee < count; callee++) {
+    if (calls[(size_t)function * (size_t)count + (size_t)callee] &&
+        !visited[callee]) {
+      visit_callees_first(calls, count, callee, visited, order, order_count);
+    }
+  }
+  order[(*order_count)++] = function;
+}
+
+// ───── Copying a Callee ─────
+
+static ssa_operand map_operand(const ssa_operand* value_map,
+                               ssa_operand operand) {
+  return operand.kind == SSA_OPERAND_VALUE ? value_map[operand.value]
+                                           : operand;
+}
+
+// Replaces one call with a copy of the callee's blocks.
+static void inline_call(ssa_function* caller, int call,
+                        const ssa_function* callee) {
+  int call_block = caller->instructions[call].block;
+  const ssa_block* block = &caller->blocks[call_block];
+  int position = 0;
+  while (block->instructions[position] != call) {
+    position++;
+  }
+  int continuation = split_ssa_block(caller, call_block, position + 1);
+
+  int* block_map =
+      (int*)checked_malloc(sizeof(int) * (size_t)callee->block_count);
+  for (int i = 0; i < callee->block_count; i++) {
+    block_map[i] = new_ssa_block(caller);
+  }
+
+  // Create every copy first so operands can refer forward along back edges.
+  size_t map_size = sizeof(ssa_operand) * (size_t)callee->instruction_count;
+  ssa_operand* value_map = (ssa_operand*)checked_malloc(map_size);
+  int* copies =
+      (int*)checked_malloc(sizeof(int) * (size_t)callee->instruction_count);
+  for (int i = 0; i < callee->instruction_count; i++) {
+    value_map[i] = ssa_none();
+    copies[i] = -1;
+  }
+  for (int i = 0; i < callee->block_count; i++) {
+    const ssa_block* source = &callee->blocks[i];
+    for (int j = 0; j < source->instruction_count; j++) {
+      int id = source->instructions[j];
+      const ssa_instruction* instruction = &callee->instructions[id];
+      if (instruction->opcode == SSA_PARAMETER) {
+        const ssa_instruction* call_instruction = &caller->instructions[call];
+        value_map[id] = call_instruction->operands[instruction->index];
+        continue;
+      }
+      ssa_opcode opcode =
+          instruction->opcode == SSA_RETURN ? SSA_JUMP : instruction->opcode;
+      int copy = add_ssa_instruction(caller, block_map[i], opcode, ssa_none(),
+                                     ssa_none());
+      caller->instructions[copy].index = instruction->index;
+      caller->instructions[copy].symbol = instruction->symbol;
+      caller->instructions[copy].symbol_length = instruction->symbol_length;
+      value_map[id] = ssa_value(copy);
+      copies[id] = copy;
+    }
+  }
+
+  ssa_operand result = ssa_constant(0);
+  int return_count = 0;
+  int phi = -1;
+  for (int i = 0; i < callee->instruction_count; i++) {
+    const ssa_instruction* instruction = &callee->instructions[i];
+    if (copies[i] < 0) {
+      continue;
+    }
+    if (instruction->opcode != SSA_RETURN) {
+      for (int j = 0; j < instruction->operand_count; j++) {
+        add_ssa_operand(caller, copies[i],
+                        map_operand(value_map, instruction->operands[j]));
+      }
+      continue;
+    }
+    // A return without a value leaves 0 behind.
+    ssa_operand returned =
+        instruction->operand_count > 0
+            ? map_operand(value_map, instruction->operands[0])
+            : ssa_constant(0);
+    add_ssa_edge(caller, block_map[instruction->block], continuation);
+    if (return_count == 1) {
+      phi = insert_ssa_instruction(caller, continuation, 0, SSA_PHI);
+      add_ssa_operand(caller, phi, result);
+    }
+    if (phi >= 0) {
+      add_ssa_operand(caller, phi, returned);
+    }
+    result = returned;
+    return_count++;
+  }
+  if (phi >= 0) {
+    result = ssa_value(phi);
+  }
+
+  // Adding the edges target by target keeps each block's predecessors, and
+  // so its phi inputs, in the callee's order. The successors are then put
+  // back in the callee's order too, since a branch depends on it.
+  for (int i = 0; i < callee->block_count; i++) {
+    const ssa_block* source = &callee->blocks[i];
+    for (int j = 0; j < source->predecessor_count; j++) {
+      add_ssa_edge(caller, block_map[source->predecessors[j]], block_map[i]);
+    }
+  }
+  for (int i = 0; i < callee->block_count; i++) {
+    const ssa_block* source = &callee->blocks[i];
+    ssa_block* copy = &caller->blocks[block_map[i]];
+    for (int j = 0; j < source->successor_count; j++) {
+      copy->successors[j] = block_map[source->successors[j]];
+    }
+  }
+
+  add_ssa_instruction(caller, call_block, SSA_JUMP, ssa_none(), ssa_none());
+  add_ssa_edge(caller, call_block, block_map[0]);
+  replace_ssa_uses(caller, call, result);
+  remove_ssa_instruction(caller, call);
+
+  free(copies);
+  free(value_map);
+  free(block_map);
+}
+
+// ───── Driver ─────
+
+static int can_inline(const ssa_function* callee, const ssa_instruction* call,
+                      int recursive, int limit) {
+  return !recursive && call->operand_count == callee->parameter_count &&
+         get_ssa_function_size(callee) <= limit;
+}
+
+// Inlines every eligible call in one function. Returns 1 if any was.
+static int inline_calls(ssa_function* functions, int count, int caller,
+                        const unsigned char* recursive, int limit) {
+  ssa_function* function = &functions[caller];
+  int original_count = function->instruction_count;
+  int changed = 0;
+  for (int i = 0; i < original_count; i++) {
+    const ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block < 0 || instruction->opcode != SSA_CALL) {
+      continue;
+    }
+    int callee = find_ssa_function(functions, count, instruction);
+    if (callee < 0 || callee == caller ||
+        !can_inline(&functions[callee], instruction, recursive[callee],
+                    limit)) {
+      continue;
+    }
+    inline_call(function, i, &functions[callee]);
+    changed = 1;
+  }
+  return changed;
+}
+
+void inline_ssa_functions(ssa_function* functions, int count, int limit) {
+  if (limit <= 0 || count == 0) {
+    return;
+  }
+  unsigned char* calls = build_call_graph(functions, count);
+  unsigned char* recursive = (unsigned char*)checked_malloc((size_t)count);
+  for (int i = 0; i < count; i++) {
+    recursive[i] = (unsigned char)is_recursive(calls, count, i);
+  }
+  unsigned char* visited = (unsigned char*)checked_malloc((size_t)count);
+  memset(visited, 0, (size_t)count);
+  int* order = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  int order_count = 0;
+  for (int i = 0; i < count; i++) {
+    if (!visited[i]) {
+      visit_callees_first(calls, count, i, visited, order, &order_count);
+    }
+  }
+
+  for (int i = 0; i < order_count; i++) {
+    ssa_function* function = &functions[order[i]];
+    if (inline_calls(functions, count, order[i], recursive, limit)) {
+      remove_unreachable_ssa_blocks(function);
+      compute_ssa_dominators(function);
+      number_ssa_values(function);
+      eliminate_dead_ssa_code(function);
+    }
+  }
+  free(order);
+  free(visited);
+  free(recursive);
+  free(calls);
+}
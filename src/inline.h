@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ssa.h"
+
+enum { DEFAULT_INLINE_LIMIT = 20 };
+
+/*
+Estimates the cost of a function as an inline candidate: the number of
+instructions left in it, not counting parameters, phis and jumps.
+
+Args:
+  function: Function in SSA form.
+
+Returns:
+  The estimated size.
+*/
+int get_ssa_function_size(const ssa_function* function);
+
+/*
+Inlines calls to small functions across a whole program.
+
+Functions are visited callees first. At each call whose target is defined
+in the program, takes as many arguments as it has parameters, is not
+recursive (directly or through other functions) and has an estimated size
+of at most `limit`, the callee's blocks are copied into the caller. Its
+parameters become the call's argument operands and its returns jumps to
+the code after the call, with a phi when there are several. A function
+that had calls inlined is then cleaned up with number_ssa_values and
+eliminate_dead_ssa_code, so callers further up see its optimized size.
+Every function keeps its own body, since other code may still call it.
+
+Args:
+  functions: Every function of the program, promoted and cleaned up.
+  count: Number of functions.
+  limit: Largest callee size to inline; 0 disables inlining.
+
+Returns:
+  void
+*/
+void inline_ssa_functions(ssa_function* functions, int count, int limit);
@@ -0,0 +1,104 @@
+/*
+ * JIT
+ * Runs encoded machine code in memory, without writing a file to execute.
+ */
+
+#include "jit.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "encode.h"
+#include "lexer.h"
+
+#define PERF_MAP_FORMAT "/tmp/perf-%d.map"
+
+enum { PERF_MAP_PATH_SIZE = 64 };
+
+typedef int (*entry_function)(void);
+
+// ───── Perf Map ─────
+
+static int is_local_label(const x86_symbol* symbol) {
+  return strncmp(symbol->name, ".L", 2) == 0;
+}
+
+// A function runs up to the next function, or to the end of the code.
+static int function_end(const x86_code* code, int offset) {
+  int end = code->size;
+  for (int i = 0; i < code->symbol_count; i++) {
+    const x86_symbol* symbol = &code->symbols[i];
+    if (!is_local_label(symbol) && symbol->offset > offset &&
+        symbol->offset < end) {
+      end = symbol->offset;
+    }
+  }
+  return end;
+}
+
+// Writes one "start size name" line per function, the format perf looks for
+// when it meets addresses outside any mapped file. Profiling is optional,
+// so a map that cannot be written is only reported.
+static void write_perf_map(const x86_code* code, const unsigned char* base) {
+  char path[PERF_MAP_PATH_SIZE];
+  (void)snprintf(path, sizeof(path), PERF_MAP_FORMAT, (int)getpid());
+  FILE* file = fopen(path, "we");
+  if (file == NULL) {
+    (void)fprintf(stderr, "Warning: Could not write perf map '%s'\n", path);
+    return;
+  }
+  for (int i = 0; i < code->symbol_count; i++) {
+    const x86_symbol* symbol = &code->symbols[i];
+    if (is_local_label(symbol)) {
+      continue;
+    }
+    int size = function_end(code, symbol->offset) - symbol->offset;
+    (void)fprintf(file, "%lx %x %s\n",
+                  (unsigned long)(uintptr_t)(base + symbol->offset),
+                  (unsigned int)size, symbol->name);
+  }
+  (void)fclose(file);
+}
+
+// ───── Execution ─────
+
+int run_x86_code(const x86_code* code) {
+  for (int i = 0; i < code->symbol_count; i++) {
+    if (code->symbols[i].offset < 0) {
+      (void)fprintf(stderr, "Error: Undefined symbol '%s'\n",
+                    code->symbols[i].name);
+      error_and_exit("");
+    }
+  }
+  int main_symbol = find_x86_symbol(code, "main");
+  if (main_symbol < 0) {
+    error_and_exit("Error: No main function to run\n");
+  }
+
+  // Map at least one byte so an empty program still gets a valid mapping.
+  size_t size = code->size > 0 ? (size_t)code->size : 1;
+  void* buffer = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer == MAP_FAILED) {
+    error_and_exit("Error: Could not map memory for the code\n");
+  }
+  memcpy(buffer, code->bytes, (size_t)code->size);
+  // Never writable and executable at once.
+  if (mprotect(buffer, size, PROT_READ | PROT_EXEC) != 0) {
+    (void)munmap(buffer, size);
+    error_and_exit("Error: Could not make the code executable\n");
+  }
+  write_perf_map(code, buffer);
+
+  void* address = (unsigned char*)buffer + code->symbols[main_symbol].offset;
+  entry_function entry = NULL;
+  // ISO C has no cast between object and function pointers.
+  memcpy(&entry, &address, sizeof(entry));
+  int result = entry();
+
+  (void)munmap(buffer, size);
+  return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "encode.h"
+
+/*
+Runs encoded code inside the compiler's own process.
+
+The code is copied into a freshly mapped buffer, which is then switched
+from writable to read-and-execute before anything in it runs. main is then
+called directly, with no assembler, linker or new process involved. A perf
+map, /tmp/perf-<pid>.map, names each function's address range so that perf
+can attribute samples in the buffer. Exits if the code has no main,
+references a symbol it does not define, or the buffer cannot be mapped.
+
+Args:
+  code: Encoded program.
+
+Returns:
+  The value main returned.
+*/
+int run_x86_code(const x86_code* code);
@@ -15,6 +15,14 @@ void error_and_exit(const char* error_msg) {
   exit(EXIT_FAILURE);
 }
 
+void* checked_malloc(size_t size) {
+  void* pointer = malloc(size == 0 ? 1 : size);
+  if (!pointer) {
+    error_and_exit("malloc failed");
+  }
+  return pointer;
+}
+
 static int at_end(Lexer* lexer) { return *lexer->current == '\0'; }
 
 static char advance(Lexer* lexer) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 typedef enum {
   TOKEN_EOF,          // end of file
   TOKEN_INT_LITERAL,  // Integer literal
@@ -58,6 +60,16 @@ Returns:
 */
 void error_and_exit(const char* error_msg);
 
+/*
+Allocates memory, exiting with an error if the allocation fails.
+
+Args:
+  size: Number of bytes to allocate; 0 still returns a valid pointer.
+Returns:
+  The allocated memory, to be released with free.
+*/
+void* checked_malloc(size_t size);
+
 /*
 Determines the token type of a given identifier string.
 
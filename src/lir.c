@@ -0,0 +1,627 @@
+/*
+ * LIR
+ * A low-level, x86-shaped intermediate representation over virtual
+ * registers, used by the optimizing backend between lowering and register
+ * allocation.
+ */
+
+#include "lir.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lexer.h"
+
+enum {
+  INITIAL_LIR_CAPACITY = 16,
+  LIR_LINE_LENGTH = 96,
+  LIR_OPERAND_LENGTH = 48,
+  LIR_RED_ZONE_SIZE = 128
+};
+
+static const int argument_registers[LIR_MAX_REGISTER_ARGUMENTS] = {
+    LIR_RDI, LIR_RSI, LIR_RDX, LIR_RCX, LIR_R8, LIR_R9};
+
+static const int caller_saved_registers[] = {
+    LIR_RAX, LIR_RCX, LIR_RDX, LIR_RSI, LIR_RDI,
+    LIR_R8,  LIR_R9,  LIR_R10, LIR_R11};
+
+enum {
+  CALLER_SAVED_REGISTER_COUNT =
+      sizeof(caller_saved_registers) / sizeof(caller_saved_registers[0])
+};
+
+static const char* const register_names_32[LIR_PHYSICAL_REGISTER_COUNT] = {
+    "eax", "ecx", "edx",  "ebx",  "esp",  "ebp",  "esi",  "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+
+static const char* const register_names_64[LIR_PHYSICAL_REGISTER_COUNT] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8",  "r9",  "r10", "r11", "r12", "r13", "r14", "r15"};
+
+static const char* const register_names_8[LIR_PHYSICAL_REGISTER_COUNT] = {
+    "al",  "cl",  "dl",   "bl",   "spl",  "bpl",  "sil",  "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+
+static const char* const opcode_names[] = {
+    "mov", "add", "sub",  "imul", "shl",  "sar", "shr", "neg",
+    "lea", "cdq", "imul", "idiv", "call", "ret", "cmp", "set",
+    "jmp", "j",   "label", "jmp", "cmov"};
+
+// Appended to "set", "j" and "cmov".
+static const char* const condition_suffixes[] = {"e", "ne", "l",
+                                                 "g", "le", "ge"};
+
+void init_lir_function(lir_function* function, const char* name,
+                       int name_length) {
+  function->name = name;
+  function->name_length = name_length;
+  function->instruction_capacity = INITIAL_LIR_CAPACITY;
+  function->instruction_count = 0;
+  function->instructions = (lir_instruction*)malloc(
+      sizeof(lir_instruction) * (size_t)function->instruction_capacity);
+  if (!function->instructions) {
+    error_and_exit("malloc failed");
+  }
+  function->next_register = LIR_FIRST_VIRTUAL_REGISTER;
+  function->next_label = 0;
+  function->spill_slot_count = 0;
+  function->callee_saved_used = 0;
+}
+
+void free_lir_function(lir_function* function) {
+  free(function->instructions);
+  function->instructions = NULL;
+  function->instruction_count = 0;
+  function->instruction_capacity = 0;
+}
+
+int new_lir_register(lir_function* function) {
+  return function->next_register++;
+}
+
+int new_lir_label(lir_function* function) { return function->next_label++; }
+
+lir_instruction* add_lir_instruction(lir_function* function, lir_opcode opcode,
+                                     lir_operand first, lir_operand second) {
+  if (function->instruction_count == function->instruction_capacity) {
+    function->instruction_capacity *= 2;
+    lir_instruction* new_instructions = (lir_instruction*)realloc(
+        function->instructions,
+        sizeof(lir_instruction) * (size_t)function->instruction_capacity);
+    if (new_instructions == NULL) {
+      error_and_exit("realloc failed");
+    }
+    function->instructions = new_instructions;
+  }
+  lir_instruction* instruction =
+      &function->instructions[function->instruction_count++];
+  instruction->opcode = opcode;
+  instruction->operands[0] = first;
+  instruction->operands[1] = second;
+  instruction->operand_count = (first.kind != LIR_OPERAND_NONE) +
+                               (second.kind != LIR_OPERAND_NONE);
+  instruction->condition = LIR_CONDITION_E;
+  return instruction;
+}
+
+lir_operand lir_none(void) {
+  lir_operand operand;
+  memset(&operand, 0, sizeof(operand));
+  operand.kind = LIR_OPERAND_NONE;
+  operand.index = -1;
+  return operand;
+}
+
+lir_operand lir_register(int reg) {
+  lir_operand operand = lir_none();
+  operand.kind = LIR_OPERAND_REGISTER;
+  operand.reg = reg;
+  return operand;
+}
+
+lir_operand lir_immediate(int value) {
+  lir_operand operand = lir_none();
+  operand.kind = LIR_OPERAND_IMMEDIATE;
+  operand.value = value;
+  return operand;
+}
+
+lir_operand lir_memory(int base, int displacement) {
+  lir_operand operand = lir_none();
+  operand.kind = LIR_OPERAND_MEMORY;
+  operand.reg = base;
+  operand.scale = 1;
+  operand.value = displacement;
+  return operand;
+}
+
+lir_operand lir_indexed_memory(int base, int index, int scale,
+                               int displacement) {
+  lir_operand operand = lir_memory(base, displacement);
+  operand.index = index;
+  operand.scale = scale;
+  return operand;
+}
+
+lir_operand lir_symbol(const char* symbol, int length) {
+  lir_operand operand = lir_none();
+  operand.kind = LIR_OPERAND_SYMBOL;
+  operand.symbol = symbol;
+  operand.symbol_length = length;
+  return operand;
+}
+
+lir_operand lir_label(const lir_function* function, int label) {
+  lir_operand operand = lir_none();
+  operand.kind = LIR_OPERAND_LABEL;
+  operand.value = label;
+  operand.symbol = function->name;
+  operand.symbol_length = function->name_length;
+  return operand;
+}
+
+lir_condition invert_lir_condition(lir_condition condition) {
+  switch (condition) {
+    case LIR_CONDITION_E:
+      return LIR_CONDITION_NE;
+    case LIR_CONDITION_NE:
+      return LIR_CONDITION_E;
+    case LIR_CONDITION_L:
+      return LIR_CONDITION_GE;
+    case LIR_CONDITION_G:
+      return LIR_CONDITION_LE;
+    case LIR_CONDITION_LE:
+      return LIR_CONDITION_G;
+    case LIR_CONDITION_GE:
+      return LIR_CONDITION_L;
+  }
+  return condition;
+}
+
+lir_condition swap_lir_condition(lir_condition condition) {
+  switch (condition) {
+    case LIR_CONDITION_L:
+      return LIR_CONDITION_G;
+    case LIR_CONDITION_G:
+      return LIR_CONDITION_L;
+    case LIR_CONDITION_LE:
+      return LIR_CONDITION_GE;
+    case LIR_CONDITION_GE:
+      return LIR_CONDITION_LE;
+    default:
+      return condition;
+  }
+}
+
+int is_lir_virtual_register(int reg) {
+  return reg >= LIR_FIRST_VIRTUAL_REGISTER;
+}
+
+int is_lir_callee_saved(int reg) {
+  return reg == LIR_RBX || reg == LIR_RSP || reg == LIR_RBP ||
+         (reg >= LIR_R12 && reg <= LIR_R15);
+}
+
+int get_lir_argument_register(int index) { return argument_registers[index]; }
+
+const char* get_lir_register_name_32(int reg) {
+  return register_names_32[reg];
+}
+
+const char* get_lir_register_name_64(int reg) {
+  return register_names_64[reg];
+}
+
+const char* get_lir_register_name_8(int reg) { return register_names_8[reg]; }
+
+// Adds the registers an operand reads when it is a source, or that its
+// address reads when it is a memory destination.
+static void add_operand_uses(const lir_operand* operand, int* uses,
+                             int* use_count) {
+  if (operand->kind == LIR_OPERAND_REGISTER) {
+    uses[(*use_count)++] = operand->reg;
+  } else if (operand->kind == LIR_OPERAND_MEMORY) {
+    uses[(*use_count)++] = operand->reg;
+    if (operand->index >= 0) {
+      uses[(*use_count)++] = operand->index;
+    }
+  }
+}
+
+static void add_address_uses(const lir_operand* operand, int* uses,
+                             int* use_count) {
+  if (operand->kind == LIR_OPERAND_MEMORY) {
+    add_operand_uses(operand, uses, use_count);
+  }
+}
+
+void get_lir_uses_and_defs(const lir_instruction* instruction, int* uses,
+                           int* use_count, int* defs, int* def_count) {
+  *use_count = 0;
+  *def_count = 0;
+  const lir_operand* destination = &instruction->operands[0];
+  const lir_operand* source = &instruction->operands[1];
+  switch (instruction->opcode) {
+    case LIR_MOV:
+      add_operand_uses(source, uses, use_count);
+      add_address_uses(destination, uses, use_count);
+      if (destination->kind == LIR_OPERAND_REGISTER) {
+        defs[(*def_count)++] = destination->reg;
+      }
+      break;
+    case LIR_ADD:
+    case LIR_SUB:
+    case LIR_IMUL:
+    case LIR_SHL:
+    case LIR_SAR:
+    case LIR_SHR:
+    case LIR_NEG:
+    case LIR_CMOV:
+      add_operand_uses(source, uses, use_count);
+      add_operand_uses(destination, uses, use_count);
+      if (destination->kind == LIR_OPERAND_REGISTER) {
+        defs[(*def_count)++] = destination->reg;
+      }
+      break;
+    case LIR_LEA:
+      add_operand_uses(source, uses, use_count);
+      defs[(*def_count)++] = destination->reg;
+      break;
+    case LIR_CDQ:
+      uses[(*use_count)++] = LIR_RAX;
+      defs[(*def_count)++] = LIR_RDX;
+      break;
+    case LIR_IMUL_HIGH:
+      uses[(*use_count)++] = LIR_RAX;
+      add_operand_uses(destination, uses, use_count);
+      defs[(*def_count)++] = LIR_RAX;
+      defs[(*def_count)++] = LIR_RDX;
+      break;
+    case LIR_IDIV:
+      uses[(*use_count)++] = LIR_RAX;
+      uses[(*use_count)++] = LIR_RDX;
+      add_operand_uses(destination, uses, use_count);
+      defs[(*def_count)++] = LIR_RAX;
+      defs[(*def_count)++] = LIR_RDX;
+      break;
+    case LIR_CALL:
+      for (int i = 0; i < destination->value; i++) {
+        uses[(*use_count)++] = argument_registers[i];
+      }
+      for (int i = 0; i < CALLER_SAVED_REGISTER_COUNT; i++) {
+        defs[(*def_count)++] = caller_saved_registers[i];
+      }
+      break;
+    case LIR_RET:
+      uses[(*use_count)++] = LIR_RAX;
+      break;
+    case LIR_TAIL_CALL:
+      for (int i = 0; i < destination->value; i++) {
+        uses[(*use_count)++] = argument_registers[i];
+      }
+      break;
+    case LIR_CMP:
+      add_operand_uses(destination, uses, use_count);
+      add_operand_uses(source, uses, use_count);
+      break;
+    case LIR_SETCC:
+      add_address_uses(destination, uses, use_count);
+      if (destination->kind == LIR_OPERAND_REGISTER) {
+        defs[(*def_count)++] = destination->reg;
+      }
+      break;
+    case LIR_JMP:
+    case LIR_JCC:
+    case LIR_LABEL:
+      break;
+  }
+}
+
+static int is_register(const lir_operand* operand) {
+  return operand->kind == LIR_OPERAND_REGISTER;
+}
+
+static void format_register(char* buffer, int reg) {
+  if (is_lir_virtual_register(reg)) {
+    (void)sprintf(buffer, "v%d", reg - LIR_FIRST_VIRTUAL_REGISTER);
+  } else {
+    (void)sprintf(buffer, "%s", register_names_32[reg]);
+  }
+}
+
+static void format_address_register(char* buffer, int reg) {
+  if (is_lir_virtual_register(reg)) {
+    (void)sprintf(buffer, "v%d", reg - LIR_FIRST_VIRTUAL_REGISTER);
+  } else {
+    (void)sprintf(buffer, "%s", register_names_64[reg]);
+  }
+}
+
+// Writes [base+index*scale+displacement], leaving out the parts not used.
+static void format_address(char* buffer, const lir_operand* operand) {
+  char base[LIR_OPERAND_LENGTH];
+  char index[LIR_OPERAND_LENGTH];
+  format_address_register(base, operand->reg);
+  buffer += sprintf(buffer, "[%s", base);
+  if (operand->index >= 0) {
+    format_address_register(index, operand->index);
+    buffer += sprintf(buffer, "+%s", index);
+    if (operand->scale != 1) {
+      buffer += sprintf(buffer, "*%d", operand->scale);
+    }
+  }
+  if (operand->value != 0) {
+    buffer += sprintf(buffer, "%+d", operand->value);
+  }
+  (void)sprintf(buffer, "]");
+}
+
+static void format_operand(char* buffer, const lir_operand* operand) {
+  switch (operand->kind) {
+    case LIR_OPERAND_REGISTER:
+      format_register(buffer, operand->reg);
+      break;
+    case LIR_OPERAND_IMMEDIATE:
+      (void)sprintf(buffer, "%d", operand->value);
+      break;
+    case LIR_OPERAND_MEMORY:
+      (void)sprintf(buffer, "DWORD PTR ");
+      format_address(buffer + strlen(buffer), operand);
+      break;
+    case LIR_OPERAND_LABEL:
+      (void)sprintf(buffer, ".L%.*s_%d", operand->symbol_length,
+                    operand->symbol, operand->value);
+      break;
+    case LIR_OPERAND_SYMBOL:
+      (void)sprintf(buffer, "%.*s", operand->symbol_length, operand->symbol);
+      break;
+    case LIR_OPERAND_NONE:
+      buffer[0] = '\0';
+      break;
+  }
+}
+
+static void format_instruction(char* buffer,
+                               const lir_instruction* instruction) {
+  char first[LIR_OPERAND_LENGTH];
+  char second[LIR_OPERAND_LENGTH];
+  format_operand(first, &instruction->operands[0]);
+  if (instruction->opcode == LIR_LEA) {
+    // lea computes the address itself, so it takes no operand size.
+    format_address(second, &instruction->operands[1]);
+  } else {
+    format_operand(second, &instruction->operands[1]);
+  }
+  char name[LIR_OPERAND_LENGTH];
+  (void)sprintf(name, "%s", opcode_names[instruction->opcode]);
+  if (instruction->opcode == LIR_SETCC || instruction->opcode == LIR_JCC ||
+      instruction->opcode == LIR_CMOV) {
+    (void)sprintf(name + strlen(name), "%s",
+                  condition_suffixes[instruction->condition]);
+  }
+  if (instruction->opcode == LIR_LABEL) {
+    (void)sprintf(buffer, "%s:", first);
+  } else if (instruction->opcode == LIR_SETCC &&
+             is_register(&instruction->operands[0]) &&
+             !is_lir_virtual_register(instruction->operands[0].reg)) {
+    (void)sprintf(buffer, "        %-8s%s", name,
+                  register_names_8[instruction->operands[0].reg]);
+  } else if (instruction->operand_count == 2) {
+    (void)sprintf(buffer, "        %-8s%s, %s", name, first, second);
+  } else if (instruction->operand_count == 1 &&
+             instruction->opcode != LIR_RET) {
+    (void)sprintf(buffer, "        %-8s%s", name, first);
+  } else {
+    (void)sprintf(buffer, "        %s", name);
+  }
+}
+
+static void add_formatted_instruction(list_of_x86_instructions* list,
+                                      const char* text) {
+  char* new_instruction = malloc(strlen(text) + 1);
+  if (!new_instruction) {
+    error_and_exit("malloc failed");
+  }
+  strcpy(new_instruction, text);
+  // NOLINTNEXTLINE(clang-analyzer-unix.Malloc)
+  add_instruction(list, new_instruction);
+}
+
+static int count_callee_saved(unsigned int callee_saved_used) {
+  int count = 0;
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    if (callee_saved_used & (1U << (unsigned int)reg)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Bytes reserved below the callee-saved pushes, padded so rsp stays 16-byte
+// aligned at calls.
+static int get_frame_size(const lir_function* function) {
+  int saved_bytes = 8 * count_callee_saved(function->callee_saved_used);
+  int frame_size = 4 * function->spill_slot_count;
+  while ((saved_bytes + frame_size) % 16 != 0) {
+    frame_size += 4;
+  }
+  return frame_size;
+}
+
+// A function that makes no calls and saves no registers can leave its spill
+// slots in the 128-byte System V red zone below rsp and set up no frame.
+static int needs_frame(const lir_function* function) {
+  if (function->callee_saved_used != 0 ||
+      4 * function->spill_slot_count > LIR_RED_ZONE_SIZE) {
+    return 1;
+  }
+  for (int i = 0; i < function->instruction_count; i++) {
+    if (function->instructions[i].opcode == LIR_CALL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Copies an instruction for output. Without a frame rbp still holds the
+// caller's value, so slots the allocator placed below rbp are addressed the
+// same distance below rsp instead.
+static lir_instruction get_output_instruction(const lir_function* function,
+                                              int index, int has_frame) {
+  lir_instruction instruction = function->instructions[index];
+  for (int i = 0; i < instruction.operand_count && !has_frame; i++) {
+    if (instruction.operands[i].kind == LIR_OPERAND_MEMORY &&
+        instruction.operands[i].reg == LIR_RBP) {
+      instruction.operands[i].reg = LIR_RSP;
+    }
+  }
+  return instruction;
+}
+
+// Restores rsp, the callee-saved registers and rbp to how the caller left
+// them, so a ret or tail jmp can follow.
+static void add_frame_teardown(const lir_function* function,
+                               list_of_x86_instructions* list) {
+  char line[LIR_LINE_LENGTH];
+  int saved_count = count_callee_saved(function->callee_saved_used);
+  if (get_frame_size(function) > 0) {
+    if (saved_count > 0) {
+      (void)sprintf(line, "        lea     rsp, [rbp-%d]", 8 * saved_count);
+      add_formatted_instruction(list, line);
+    } else {
+      add_instruction(list, "        mov     rsp, rbp");
+    }
+  }
+  for (int reg = LIR_PHYSICAL_REGISTER_COUNT - 1; reg >= 0; reg--) {
+    if (function->callee_saved_used & (1U << (unsigned int)reg)) {
+      (void)sprintf(line, "        pop     %s", register_names_64[reg]);
+      add_formatted_instruction(list, line);
+    }
+  }
+  add_instruction(list, "        pop     rbp");
+}
+
+// Rewrites "mov r, s" followed by an add, sub or imul of r into a single
+// three-operand lea or imul. The LIR never reads the flags add and sub leave
+// behind, so lea is a safe replacement. Returns 0 when the pair has no fused
+// form.
+static int fuse_three_operand(const lir_instruction* move,
+                              const lir_instruction* next,
+                              lir_instruction* fused) {
+  if (move->opcode != LIR_MOV || !is_register(&move->operands[0]) ||
+      next->operand_count != 2 || !is_register(&next->operands[0]) ||
+      next->operands[0].reg != move->operands[0].reg) {
+    return 0;
+  }
+  int target = move->operands[0].reg;
+  const lir_operand* source = &move->operands[1];
+  const lir_operand* value = &next->operands[1];
+  if (source->kind == LIR_OPERAND_REGISTER && source->reg == target) {
+    return 0;
+  }
+  fused->operand_count = 2;
+  fused->operands[0] = move->operands[0];
+  if (next->opcode == LIR_IMUL && value->kind == LIR_OPERAND_IMMEDIATE &&
+      (is_register(source) || source->kind == LIR_OPERAND_MEMORY)) {
+    // imul r, s, imm; the caller appends the immediate.
+    fused->opcode = LIR_IMUL;
+    fused->operands[1] = *source;
+    return 1;
+  }
+  if (!is_register(source)) {
+    return 0;
+  }
+  fused->opcode = LIR_LEA;
+  if (next->opcode == LIR_ADD && is_register(value) && value->reg != target) {
+    fused->operands[1] = lir_indexed_memory(source->reg, value->reg, 1, 0);
+    return 1;
+  }
+  if (next->opcode == LIR_ADD && value->kind == LIR_OPERAND_IMMEDIATE) {
+    fused->operands[1] = lir_memory(source->reg, value->value);
+    return 1;
+  }
+  if (next->opcode == LIR_SUB && value->kind == LIR_OPERAND_IMMEDIATE &&
+      value->value != INT_MIN) {
+    fused->operands[1] = lir_memory(source->reg, -value->value);
+    return 1;
+  }
+  return 0;
+}
+
+void lir_function_to_x86(const lir_function* function,
+                         list_of_x86_instructions* list) {
+  char line[LIR_LINE_LENGTH];
+  (void)sprintf(line, "%.*s:", function->name_length, function->name);
+  add_formatted_instruction(list, line);
+  int has_frame = needs_frame(function);
+  if (has_frame) {
+    add_instruction(list, "        push    rbp");
+    add_instruction(list, "        mov     rbp, rsp");
+    for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+      if (function->callee_saved_used & (1U << (unsigned int)reg)) {
+        (void)sprintf(line, "        push    %s", register_names_64[reg]);
+        add_formatted_instruction(list, line);
+      }
+    }
+    int frame_size = get_frame_size(function);
+    if (frame_size > 0) {
+      (void)sprintf(line, "        sub     rsp, %d", frame_size);
+      add_formatted_instruction(list, line);
+    }
+  }
+
+  for (int i = 0; i < function->instruction_count; i++) {
+    lir_instruction current = get_output_instruction(function, i, has_frame);
+    const lir_instruction* instruction = &current;
+    if (instruction->opcode == LIR_RET) {
+      if (has_frame) {
+        add_frame_teardown(function, list);
+      }
+      add_instruction(list, "        ret");
+      continue;
+    }
+    if (instruction->opcode == LIR_TAIL_CALL && has_frame) {
+      add_frame_teardown(function, list);
+    }
+    if (instruction->opcode == LIR_MOV &&
+        instruction->operands[0].kind == LIR_OPERAND_REGISTER &&
+        instruction->operands[1].kind == LIR_OPERAND_REGISTER &&
+        instruction->operands[0].reg == instruction->operands[1].reg) {
+      continue;
+    }
+    if (i + 1 < function->instruction_count) {
+      lir_instruction next = get_output_instruction(function, i + 1, has_frame);
+      lir_instruction fused;
+      if (fuse_three_operand(instruction, &next, &fused)) {
+        format_instruction(line, &fused);
+        if (fused.opcode == LIR_IMUL) {
+          (void)sprintf(line + strlen(line), ", %d", next.operands[1].value);
+        }
+        add_formatted_instruction(list, line);
+        i++;
+        continue;
+      }
+    }
+    format_instruction(line, instruction);
+    add_formatted_instruction(list, line);
+    if (instruction->opcode == LIR_SETCC) {
+      int reg = instruction->operands[0].reg;
+      (void)sprintf(line, "        movzx   %s, %s", register_names_32[reg],
+                    register_names_8[reg]);
+      add_formatted_instruction(list, line);
+    }
+  }
+}
+
+void print_lir_function(FILE* output, const lir_function* function) {
+  char line[LIR_LINE_LENGTH];
+  (void)fprintf(output, "%.*s:\n", function->name_length, function->name);
+  for (int i = 0; i < function->instruction_count; i++) {
+    format_instruction(line, &function->instructions[i]);
+    (void)fprintf(output, "%s\n", line);
+  }
+}
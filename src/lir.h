@@ -0,0 +1,400 @@
+#pragma once
+
+#include "codegen.h"
+
+// Physical registers, numbered by their x86-64 encoding.
+typedef enum {
+  LIR_RAX,
+  LIR_RCX,
+  LIR_RDX,
+  LIR_RBX,
+  LIR_RSP,
+  LIR_RBP,
+  LIR_RSI,
+  LIR_RDI,
+  LIR_R8,
+  LIR_R9,
+  LIR_R10,
+  LIR_R11,
+  LIR_R12,
+  LIR_R13,
+  LIR_R14,
+  LIR_R15,
+  LIR_PHYSICAL_REGISTER_COUNT
+} lir_physical_register;
+
+// Register numbers at or above this value are virtual registers.
+enum { LIR_FIRST_VIRTUAL_REGISTER = LIR_PHYSICAL_REGISTER_COUNT };
+
+// System V argument registers, in order.
+enum { LIR_MAX_REGISTER_ARGUMENTS = 6 };
+
+typedef enum {
+  LIR_OPERAND_NONE,
+  LIR_OPERAND_REGISTER,
+  LIR_OPERAND_IMMEDIATE,
+  LIR_OPERAND_MEMORY,  // DWORD PTR [reg + index * scale + value]
+  LIR_OPERAND_LABEL,
+  LIR_OPERAND_SYMBOL,
+} lir_operand_kind;
+
+typedef struct lir_operand {
+  lir_operand_kind kind;
+  int reg;    // REGISTER, or the MEMORY base register.
+  int index;  // MEMORY index register, or -1.
+  int scale;  // MEMORY index scale.
+  int value;  // IMMEDIATE value, MEMORY displacement, or LABEL number.
+  const char* symbol;  // SYMBOL name (not null-terminated).
+  int symbol_length;
+} lir_operand;
+
+typedef enum {
+  LIR_MOV,   // dst = src
+  LIR_ADD,   // dst += src
+  LIR_SUB,   // dst -= src
+  LIR_IMUL,  // dst *= src
+  LIR_SHL,   // dst <<= src (immediate)
+  LIR_SAR,   // dst >>= src (immediate), arithmetic
+  LIR_SHR,   // dst >>= src (immediate), logical
+  LIR_NEG,   // dst = -dst
+  LIR_LEA,   // dst = address of src (a MEMORY operand)
+  LIR_CDQ,   // edx = sign of eax
+  LIR_IMUL_HIGH,  // edx:eax = eax * src, signed
+  LIR_IDIV,  // eax = edx:eax / src, edx = edx:eax % src
+  LIR_CALL,  // call symbol; value is the number of register arguments
+  LIR_RET,   // epilogue and ret; eax holds the result
+  LIR_CMP,   // flags = first - second
+  LIR_SETCC,  // dst = condition ? 1 : 0
+  LIR_JMP,    // goto label
+  LIR_JCC,    // goto label if condition
+  LIR_LABEL,  // label definition
+  LIR_TAIL_CALL,  // epilogue, then jmp symbol; value is as for LIR_CALL
+  LIR_CMOV,  // dst = src if condition; src is a register or MEMORY
+} lir_opcode;
+
+// Signed conditions read by LIR_SETCC, LIR_JCC and LIR_CMOV.
+typedef enum {
+  LIR_CONDITION_E,
+  LIR_CONDITION_NE,
+  LIR_CONDITION_L,
+  LIR_CONDITION_G,
+  LIR_CONDITION_LE,
+  LIR_CONDITION_GE,
+} lir_condition;
+
+typedef struct lir_instruction {
+  lir_opcode opcode;
+  lir_operand operands[2];
+  int operand_count;
+  lir_condition condition;  // SETCC, JCC and CMOV only.
+} lir_instruction;
+
+typedef struct lir_function {
+  const char* name;
+  int name_length;
+  lir_instruction* instructions;
+  int instruction_count;
+  int instruction_capacity;
+  int next_register;  // Next unused virtual register number.
+  int next_label;     // Next unused label number.
+  // Filled in by register allocation:
+  int spill_slot_count;           // 4-byte stack slots below the saves.
+  unsigned int callee_saved_used;  // Bit per physical register.
+} lir_function;
+
+// ───── Construction ─────
+
+/*
+Initializes an empty LIR function.
+
+Args:
+  function: Function to initialize.
+  name: Function name (not null-terminated).
+  name_length: Length of the name.
+
+Returns:
+  void
+*/
+void init_lir_function(lir_function* function, const char* name,
+                       int name_length);
+
+/*
+Releases the instruction storage of a LIR function.
+
+Args:
+  function: Function to free.
+
+Returns:
+  void
+*/
+void free_lir_function(lir_function* function);
+
+/*
+Allocates a fresh virtual register.
+
+Args:
+  function: Function the register belongs to.
+
+Returns:
+  The new register number.
+*/
+int new_lir_register(lir_function* function);
+
+/*
+Allocates a fresh label number.
+
+Args:
+  function: Function the label belongs to.
+
+Returns:
+  The new label number.
+*/
+int new_lir_label(lir_function* function);
+
+/*
+Appends an instruction to a LIR function.
+
+Args:
+  function: Function to append to.
+  opcode: Instruction opcode.
+  first: First operand (LIR_OPERAND_NONE if unused).
+  second: Second operand (LIR_OPERAND_NONE if unused).
+
+Returns:
+  Pointer to the appended instruction.
+*/
+lir_instruction* add_lir_instruction(lir_function* function, lir_opcode opcode,
+                                     lir_operand first, lir_operand second);
+
+/*
+Builds a register operand.
+
+Args:
+  reg: Physical or virtual register number.
+
+Returns:
+  The operand.
+*/
+lir_operand lir_register(int reg);
+
+/*
+Builds an immediate operand.
+
+Args:
+  value: 32-bit immediate.
+
+Returns:
+  The operand.
+*/
+lir_operand lir_immediate(int value);
+
+/*
+Builds a DWORD memory operand [base + displacement].
+
+Args:
+  base: Base register.
+  displacement: Byte displacement.
+
+Returns:
+  The operand.
+*/
+lir_operand lir_memory(int base, int displacement);
+
+/*
+Builds a DWORD memory operand [base + index * scale + displacement].
+
+Args:
+  base: Base register.
+  index: Index register.
+  scale: Index scale: 1, 2, 4 or 8.
+  displacement: Byte displacement.
+
+Returns:
+  The operand.
+*/
+lir_operand lir_indexed_memory(int base, int index, int scale,
+                               int displacement);
+
+/*
+Builds a symbol operand naming a function.
+
+Args:
+  symbol: Name (not null-terminated).
+  length: Length of the name.
+
+Returns:
+  The operand.
+*/
+lir_operand lir_symbol(const char* symbol, int length);
+
+/*
+Builds a label operand. Labels are printed with the function name, so they
+stay unique across the functions of a file.
+
+Args:
+  function: Function the label belongs to.
+  label: Label number from new_lir_label.
+
+Returns:
+  The operand.
+*/
+lir_operand lir_label(const lir_function* function, int label);
+
+/*
+Returns the condition that holds exactly when the given one does not.
+
+Args:
+  condition: Condition to invert.
+
+Returns:
+  The inverted condition.
+*/
+lir_condition invert_lir_condition(lir_condition condition);
+
+/*
+Returns the condition that tests the same relation with the operands of the
+comparison swapped (e.g., less becomes greater).
+
+Args:
+  condition: Condition to mirror.
+
+Returns:
+  The mirrored condition.
+*/
+lir_condition swap_lir_condition(lir_condition condition);
+
+/*
+Returns an operand with no content.
+
+Returns:
+  The operand.
+*/
+lir_operand lir_none(void);
+
+// ───── Register Queries ─────
+
+/*
+Checks whether a register number names a virtual register.
+
+Args:
+  reg: Register number.
+
+Returns:
+  1 for virtual registers, 0 for physical registers.
+*/
+int is_lir_virtual_register(int reg);
+
+/*
+Checks whether a physical register must be preserved across calls.
+
+Args:
+  reg: Physical register number.
+
+Returns:
+  1 for rbx, rbp, rsp and r12-r15, 0 otherwise.
+*/
+int is_lir_callee_saved(int reg);
+
+/*
+Returns the System V register for an integer argument.
+
+Args:
+  index: Zero-based argument position, below LIR_MAX_REGISTER_ARGUMENTS.
+
+Returns:
+  Physical register number.
+*/
+int get_lir_argument_register(int index);
+
+/*
+Returns the 32-bit name of a physical register (e.g., "eax", "r8d").
+
+Args:
+  reg: Physical register number.
+
+Returns:
+  Register name.
+*/
+const char* get_lir_register_name_32(int reg);
+
+/*
+Returns the 64-bit name of a physical register (e.g., "rax", "r8").
+
+Args:
+  reg: Physical register number.
+
+Returns:
+  Register name.
+*/
+const char* get_lir_register_name_64(int reg);
+
+/*
+Returns the name of the low byte of a physical register (e.g., "al",
+"r8b").
+
+Args:
+  reg: Physical register number.
+
+Returns:
+  Register name.
+*/
+const char* get_lir_register_name_8(int reg);
+
+// ───── Instruction Queries ─────
+
+/*
+Collects the registers an instruction reads and writes.
+
+Includes implicit operands such as eax/edx for cdq, the widening imul and
+idiv, argument registers and clobbered caller-saved registers for calls, and
+eax for ret. A register that is both read and written (e.g., the destination
+of add) appears in both lists.
+
+Args:
+  instruction: Instruction to inspect.
+  uses: Output array for read registers (at least 16 entries).
+  use_count: Output number of read registers.
+  defs: Output array for written registers (at least 16 entries).
+  def_count: Output number of written registers.
+
+Returns:
+  void
+*/
+void get_lir_uses_and_defs(const lir_instruction* instruction, int* uses,
+                           int* use_count, int* defs, int* def_count);
+
+// ───── Output ─────
+
+/*
+Emits a register-allocated LIR function as x86 assembly text.
+
+Writes the label, a prologue that saves rbp and any callee-saved registers
+the allocator used and reserves spill slots, the body, and a matching
+epilogue at every ret and before every tail-call jmp. A function with no
+calls and no callee-saved registers whose spill slots fit in the 128-byte
+red zone gets neither, and addresses its slots from rsp. Moves from a register
+to itself are dropped, and a copy followed by an add, sub or imul of the
+copy is merged into a single three-operand lea or imul. setcc is widened to
+32 bits with movzx.
+
+Args:
+  function: Allocated function (no virtual registers left).
+  list: Instruction list to append to.
+
+Returns:
+  void
+*/
+void lir_function_to_x86(const lir_function* function,
+                         list_of_x86_instructions* list);
+
+/*
+Prints a LIR function, virtual registers included, for debugging.
+
+Args:
+  output: Stream to print to.
+  function: Function to print.
+
+Returns:
+  void
+*/
+void print_lir_function(FILE* output, const lir_function* function);
@@ -0,0 +1,797 @@
+/*
+ * Loop Optimization
+ * Hoists loop invariants and reduces induction variables on the SSA form.
+ */
+
+#include "loop.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "ssa.h"
+
+typedef struct ssa_loop {
+  int header;
+  int preheader;  // The only predecessor from outside; ends in a jump.
+  int latch;      // The only predecessor from inside.
+  int entry_position;  // Index of the preheader among the header's preds.
+  int latch_position;  // Index of the latch among the header's preds.
+  unsigned char* body;  // Per block: 1 inside the loop, header included.
+  int size;             // Blocks in the body.
+} ssa_loop;
+
+// A header phi that goes up by `step` on every trip around the loop.
+typedef struct induction_variable {
+  int phi;
+  int increment;  // The instruction computing phi + step.
+  int step;
+} induction_variable;
+
+static int wrapping_multiply(int left, int right) {
+  return (int)((uint32_t)left * (uint32_t)right);
+}
+
+// ───── Loop Detection ─────
+
+static int is_reachable(const ssa_function* function, int block) {
+  return block == 0 || function->blocks[block].immediate_dominator >= 0;
+}
+
+// Fills in a loop headed by a block with one predecessor from outside,
+// which only jumps to it, and one back edge. Returns 0 if the block heads no
+// such loop.
+static int find_loop(const ssa_function* function, int header,
+                     ssa_loop* loop) {
+  const ssa_block* current = &function->blocks[header];
+  loop->header = header;
+  loop->preheader = -1;
+  loop->latch = -1;
+  for (int i = 0; i < current->predecessor_count; i++) {
+    int predecessor = current->predecessors[i];
+    if (!is_reachable(function, predecessor)) {
+      continue;
+    }
+    if (ssa_block_dominates(function, header, predecessor)) {
+      if (loop->latch >= 0) {
+        return 0;
+      }
+      loop->latch = predecessor;
+      loop->latch_position = i;
+    } else {
+      if (loop->preheader >= 0) {
+        return 0;
+      }
+      loop->preheader = predecessor;
+      loop->entry_position = i;
+    }
+  }
+  return loop->latch >= 0 && loop->preheader >= 0 &&
+         function->blocks[loop->preheader].successor_count == 1;
+}
+
+// Marks the blocks that reach the latch without passing the header.
+static void collect_body(const ssa_function* function, ssa_loop* loop,
+                         int* worklist) {
+  loop->body =
+      (unsigned char*)checked_malloc((size_t)function->block_count);
+  memset(loop->body, 0, (size_t)function->block_count);
+  loop->body[loop->header] = 1;
+  loop->size = 1;
+  int count = 0;
+  if (!loop->body[loop->latch]) {
+    loop->body[loop->latch] = 1;
+    loop->size++;
+    worklist[count++] = loop->latch;
+  }
+  while (count > 0) {
+    const ssa_block* current = &function->blocks[worklist[--count]];
+    for (int i = 0; i < current->predecessor_count; i++) {
+      int predecessor = current->predecessors[i];
+      if (!loop->body[predecessor] && is_reachable(function, predecessor)) {
+        loop->body[predecessor] = 1;
+        loop->size++;
+        worklist[count++] = predecessor;
+      }
+    }
+  }
+}
+
+static int compare_loop_sizes(const void* first, const void* second) {
+  return ((const ssa_loop*)first)->size - ((const ssa_loop*)second)->size;
+}
+
+// Returns the function's loops, innermost (smallest) first.
+static ssa_loop* find_loops(const ssa_function* function, int* count) {
+  ssa_loop* loops = (ssa_loop*)checked_malloc(
+      sizeof(ssa_loop) * (size_t)function->reachable_block_count);
+  int* worklist =
+      (int*)checked_malloc(sizeof(int) * (size_t)function->block_count);
+  *count = 0;
+  for (int i = 0; i < function->reachable_block_count; i++) {
+    ssa_loop* loop = &loops[*count];
+    if (find_loop(function, function->reverse_postorder[i], loop)) {
+      collect_body(function, loop, worklist);
+      (*count)++;
+    }
+  }
+  free(worklist);
+  qsort(loops, (size_t)*count, sizeof(ssa_loop), compare_loop_sizes);
+  return loops;
+}
+
+// ───── Invariant Code Motion ─────
+
+static int is_invariant(const ssa_function* function, const ssa_loop* loop,
+                        int instruction) {
+  const ssa_instruction* current = &function->instructions[instruction];
+  if (!ssa_can_speculate(current)) {
+    return 0;
+  }
+  for (int i = 0; i < current->operand_count; i++) {
+    ssa_operand operand = current->operands[i];
+    if (operand.kind == SSA_OPERAND_VALUE &&
+        loop->body[function->instructions[operand.value].block]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Visits the body in reverse postorder, so an instruction's operands have
+// already moved out when it is considered.
+static void hoist_invariants(ssa_function* function, const ssa_loop* loop) {
+  for (int i = 0; i < function->reachable_block_count; i++) {
+    int block = function->reverse_postorder[i];
+    if (!loop->body[block]) {
+      continue;
+    }
+    int position = 0;
+    while (position < function->blocks[block].instruction_count) {
+      int instruction = function->blocks[block].instructions[position];
+      if (is_invariant(function, loop, instruction)) {
+        move_ssa_instruction(
+            function, instruction, loop->preheader,
+            function->blocks[loop->preheader].instruction_count - 1);
+      } else {
+        position++;
+      }
+    }
+  }
+}
+
+// ───── Induction Variables ─────
+
+static int count_phis(const ssa_function* function, int block) {
+  const ssa_block* current = &function->blocks[block];
+  int count = 0;
+  while (count < current->instruction_count &&
+         function->instructions[current->instructions[count]].opcode ==
+             SSA_PHI) {
+    count++;
+  }
+  return count;
+}
+
+static int is_value_of(ssa_operand operand, int instruction) {
+  return operand.kind == SSA_OPERAND_VALUE && operand.value == instruction;
+}
+
+// Checks whether a header phi is stepped by a constant from the latch, and
+// fills in *variable if so.
+static int find_induction_variable(const ssa_function* function,
+                                   const ssa_loop* loop, int phi,
+                                   induction_variable* variable) {
+  ssa_operand next =
+      function->instructions[phi].operands[loop->latch_position];
+  if (next.kind != SSA_OPERAND_VALUE) {
+    return 0;
+  }
+  const ssa_instruction* increment = &function->instructions[next.value];
+  if ((increment->opcode != SSA_ADD && increment->opcode != SSA_SUB) ||
+      !loop->body[increment->block] ||
+      !is_value_of(increment->operands[0], phi) ||
+      increment->operands[1].kind != SSA_OPERAND_CONSTANT) {
+    return 0;
+  }
+  variable->phi = phi;
+  variable->increment = next.value;
+  variable->step = increment->operands[1].value;
+  if (increment->opcode == SSA_SUB) {
+    variable->step = (int)(0U - (uint32_t)variable->step);
+  }
+  return 1;
+}
+
+// Adds a header phi that starts at start and goes up by step each trip,
+// stepping right after the original variable does.
+static int add_induction_variable(ssa_function* function,
+                                  const ssa_loop* loop,
+                                  const induction_variable* variable,
+                                  ssa_operand start, int step) {
+  int phi = insert_ssa_instruction(function, loop->header, 0, SSA_PHI);
+  int block = function->instructions[variable->increment].block;
+  const ssa_block* current = &function->blocks[block];
+  int position = 0;
+  while (current->instructions[position] != variable->increment) {
+    position++;
+  }
+  int increment =
+      insert_ssa_instruction(function, block, position + 1, SSA_ADD);
+  add_ssa_operand(function, increment, ssa_value(phi));
+  add_ssa_operand(function, increment, ssa_constant(step));
+  for (int i = 0; i < function->blocks[loop->header].predecessor_count; i++) {
+    if (i == loop->entry_position) {
+      add_ssa_operand(function, phi, start);
+    } else if (i == loop->latch_position) {
+      add_ssa_operand(function, phi, ssa_value(increment));
+    } else {
+      // Unreachable predecessors never supply a value.
+      add_ssa_operand(function, phi, ssa_constant(0));
+    }
+  }
+  return phi;
+}
+
+// Replaces every i * k in the loop with its own induction variable, which
+// starts at init * k and steps by step * k. Returns the replacement for the
+// first positive k and stores k in *factor, or returns -1.
+static int reduce_multiplies(ssa_function* function, const ssa_loop* loop,
+                             const induction_variable* variable,
+                             int* factor) {
+  int reduced = -1;
+  int instruction_count = function->instruction_count;
+  for (int i = 0; i < instruction_count; i++) {
+    const ssa_instruction* multiply = &function->instructions[i];
+    if (multiply->block < 0 || !loop->body[multiply->block] ||
+        multiply->opcode != SSA_MUL ||
+        !is_value_of(multiply->operands[0], variable->phi) ||
+        multiply->operands[1].kind != SSA_OPERAND_CONSTANT) {
+      continue;
+    }
+    int k = multiply->operands[1].value;
+    if (k == 0 || k == 1) {
+      continue;
+    }
+    ssa_operand init =
+        function->instructions[variable->phi].operands[loop->entry_position];
+    ssa_operand start;
+    if (init.kind == SSA_OPERAND_CONSTANT) {
+      start = ssa_constant(wrapping_multiply(init.value, k));
+    } else {
+      int product = insert_ssa_instruction(
+          function, loop->preheader,
+          function->blocks[loop->preheader].instruction_count - 1, SSA_MUL);
+      add_ssa_operand(function, product, init);
+      add_ssa_operand(function, product, ssa_constant(k));
+      start = ssa_value(product);
+    }
+    int phi = add_induction_variable(function, loop, variable, start,
+                                     wrapping_multiply(variable->step, k));
+    replace_ssa_uses(function, i, ssa_value(phi));
+    remove_ssa_instruction(function, i);
+    if (reduced < 0 && k > 0) {
+      reduced = phi;
+      *factor = k;
+    }
+  }
+  return reduced;
+}
+
+static int count_uses(const ssa_function* function, int value) {
+  int count = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    const ssa_instruction* current = &function->instructions[i];
+    if (current->block < 0) {
+      continue;
+    }
+    for (int j = 0; j < current->operand_count; j++) {
+      if (is_value_of(current->operands[j], value)) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+// Rewrites the header test i < n (or i <= n) as i * k < n * k on the
+// reduced variable when i is read by nothing else, so i dies. Only done
+// when i counts up from a constant to a constant and neither it nor i * k
+// can overflow on the way.
+static void replace_exit_test(ssa_function* function, const ssa_loop* loop,
+                              const induction_variable* variable,
+                              int reduced, int factor) {
+  const ssa_block* header = &function->blocks[loop->header];
+  const ssa_instruction* terminator =
+      &function->instructions[header->instructions[header->instruction_count -
+                                                   1]];
+  if (terminator->opcode != SSA_BRANCH ||
+      terminator->operands[0].kind != SSA_OPERAND_VALUE ||
+      !loop->body[header->successors[0]] ||
+      loop->body[header->successors[1]]) {
+    return;
+  }
+  int test = terminator->operands[0].value;
+  ssa_instruction* comparison = &function->instructions[test];
+  ssa_operand init =
+      function->instructions[variable->phi].operands[loop->entry_position];
+  if ((comparison->opcode != SSA_LT && comparison->opcode != SSA_LE) ||
+      comparison->block != loop->header ||
+      !is_value_of(comparison->operands[0], variable->phi) ||
+      comparison->operands[1].kind != SSA_OPERAND_CONSTANT ||
+      init.kind != SSA_OPERAND_CONSTANT || variable->step <= 0) {
+    return;
+  }
+  if (count_uses(function, variable->phi) != 2 ||
+      count_uses(function, variable->increment) != 1) {
+    return;
+  }
+
+  // i never leaves [low, high]: it stops at most one step past the bound.
+  int64_t bound = comparison->operands[1].value;
+  int64_t low = init.value < bound ? init.value : bound;
+  int64_t high = bound + variable->step;
+  if (init.value > high) {
+    high = init.value;
+  }
+  if (high > INT_MAX || low * factor < INT_MIN || high * factor > INT_MAX) {
+    return;
+  }
+  comparison->operands[0] = ssa_value(reduced);
+  comparison->operands[1] = ssa_constant((int)(bound * factor));
+}
+
+static void reduce_induction_variables(ssa_function* function,
+                                       const ssa_loop* loop) {
+  const ssa_block* header = &function->blocks[loop->header];
+  int phi_count = count_phis(function, loop->header);
+  int* phis = (int*)checked_malloc(sizeof(int) * (size_t)phi_count);
+  memcpy(phis, header->instructions, sizeof(int) * (size_t)phi_count);
+  for (int i = 0; i < phi_count; i++) {
+    induction_variable variable;
+    if (!find_induction_variable(function, loop, phis[i], &variable)) {
+      continue;
+    }
+    int factor = 0;
+    int reduced = reduce_multiplies(function, loop, &variable, &factor);
+    if (reduced >= 0) {
+      replace_exit_test(function, loop, &variable, reduced, factor);
+    }
+  }
+  free(phis);
+}
+
+// ───── Unrolling ─────
+
+// A two-block loop whose header leaves once an induction variable stepping
+// upward fails `variable < bound` (or <=).
+typedef struct counted_loop {
+  induction_variable variable;
+  ssa_opcode test;    // SSA_LT or SSA_LE, with the variable on the left.
+  ssa_operand bound;  // A constant or a value defined before the loop.
+  int size;  // Instructions in one trip, leaving out phis and terminators.
+} counted_loop;
+
+// Checks for a header that tests a counter and a single body block that
+// jumps back to it, and fills in *counted.
+static int find_counted_loop(const ssa_function* function,
+                             const ssa_loop* loop, counted_loop* counted) {
+  const ssa_block* header = &function->blocks[loop->header];
+  const ssa_block* body = &function->blocks[loop->latch];
+  if (loop->size != 2 || loop->latch == loop->header ||
+      body->predecessor_count != 1 || header->successors[0] != loop->latch) {
+    return 0;
+  }
+  const ssa_instruction* terminator =
+      &function->instructions[header->instructions[header->instruction_count -
+                                                   1]];
+  if (terminator->opcode != SSA_BRANCH ||
+      terminator->operands[0].kind != SSA_OPERAND_VALUE) {
+    return 0;
+  }
+  const ssa_instruction* comparison =
+      &function->instructions[terminator->operands[0].value];
+  if (comparison->block != loop->header) {
+    return 0;
+  }
+  ssa_opcode test = comparison->opcode;
+  ssa_operand counter = comparison->operands[0];
+  ssa_operand bound = comparison->operands[1];
+  if (test == SSA_GT || test == SSA_GE) {
+    // n > i is i < n, and n >= i is i <= n.
+    test = test == SSA_GT ? SSA_LT : SSA_LE;
+    counter = comparison->operands[1];
+    bound = comparison->operands[0];
+  }
+  if ((test != SSA_LT && test != SSA_LE) ||
+      counter.kind != SSA_OPERAND_VALUE ||
+      function->instructions[counter.value].opcode != SSA_PHI ||
+      function->instructions[counter.value].block != loop->header) {
+    return 0;
+  }
+  if (bound.kind == SSA_OPERAND_VALUE &&
+      loop->body[function->instructions[bound.value].block]) {
+    return 0;
+  }
+  if (!find_induction_variable(function, loop, counter.value,
+                               &counted->variable) ||
+      counted->variable.step <= 0) {
+    return 0;
+  }
+  counted->test = test;
+  counted->bound = bound;
+  counted->size = header->instruction_count -
+                  count_phis(function, loop->header) - 1 +
+                  body->instruction_count - 1;
+  return 1;
+}
+
+// Returns how many times the body runs when the counter starts and stops
+// at constants and never wraps, or -1 when that is not known.
+static int64_t get_trip_count(const ssa_function* function,
+                              const ssa_loop* loop,
+                              const counted_loop* counted) {
+  ssa_operand init = function->instructions[counted->variable.phi]
+                         .operands[loop->entry_position];
+  if (init.kind != SSA_OPERAND_CONSTANT ||
+      counted->bound.kind != SSA_OPERAND_CONSTANT) {
+    return -1;
+  }
+  int64_t start = init.value;
+  int64_t step = counted->variable.step;
+  // i <= n is i < n + 1 once the arithmetic is 64-bit.
+  int64_t end = counted->bound.value + (counted->test == SSA_LE ? 1 : 0);
+  int64_t trips = start < end ? (end - start + step - 1) / step : 0;
+  if (start + trips * step > INT_MAX) {
+    return -1;
+  }
+  return trips;
+}
+
+// Copies the instructions of one trip around a counted loop, renaming the
+// values they read to the copies made so far.
+typedef struct loop_copier {
+  ssa_operand* map;  // Current copy of each original instruction, or NONE.
+  int original_count;
+  int* phis;  // The header's phis.
+  int phi_count;
+  int* header;  // The header's instructions after its phis, minus the branch.
+  int header_count;
+  int* body;  // The body's instructions minus the jump.
+  int body_count;
+} loop_copier;
+
+static int* copy_block_instructions(const ssa_function* function, int block,
+                                    int first, int* count) {
+  const ssa_block* current = &function->blocks[block];
+  *count = current->instruction_count - 1 - first;
+  int* instructions =
+      (int*)checked_malloc(sizeof(int) * ((size_t)*count + 1));
+  memcpy(instructions, &current->instructions[first],
+         sizeof(int) * (size_t)*count);
+  return instructions;
+}
+
+static void init_loop_copier(const ssa_function* function,
+                             const ssa_loop* loop, loop_copier* copier) {
+  copier->original_count = function->instruction_count;
+  copier->map = (ssa_operand*)checked_malloc(
+      sizeof(ssa_operand) * (size_t)copier->original_count);
+  for (int i = 0; i < copier->original_count; i++) {
+    copier->map[i] = ssa_none();
+  }
+  copier->phi_count = count_phis(function, loop->header);
+  copier->phis = (int*)checked_malloc(sizeof(int) *
+                                      ((size_t)copier->phi_count + 1));
+  memcpy(copier->phis, function->blocks[loop->header].instructions,
+         sizeof(int) * (size_t)copier->phi_count);
+  copier->header = copy_block_instructions(
+      function, loop->header, copier->phi_count, &copier->header_count);
+  copier->body =
+      copy_block_instructions(function, loop->latch, 0, &copier->body_count);
+}
+
+static void free_loop_copier(loop_copier* copier) {
+  free(copier->map);
+  free(copier->phis);
+  free(copier->header);
+  free(copier->body);
+}
+
+static ssa_operand map_operand(const loop_copier* copier,
+                               ssa_operand operand) {
+  if (operand.kind == SSA_OPERAND_VALUE &&
+      operand.value < copier->original_count &&
+      copier->map[operand.value].kind != SSA_OPERAND_NONE) {
+    return copier->map[operand.value];
+  }
+  return operand;
+}
+
+// Appends copies of instructions to the end of a block.
+static void copy_instructions(ssa_function* function, loop_copier* copier,
+                              int block, const int* instructions,
+                              int count) {
+  for (int i = 0; i < count; i++) {
+    int original = instructions[i];
+    int copy = insert_ssa_instruction(
+        function, block, function->blocks[block].instruction_count,
+        function->instructions[original].opcode);
+    ssa_instruction* target = &function->instructions[copy];
+    const ssa_instruction* source = &function->instructions[original];
+    target->index = source->index;
+    target->symbol = source->symbol;
+    target->symbol_length = source->symbol_length;
+    for (int j = 0; j < function->instructions[original].operand_count;
+         j++) {
+      add_ssa_operand(
+          function, copy,
+          map_operand(copier, function->instructions[original].operands[j]));
+    }
+    copier->map[original] = ssa_value(copy);
+  }
+}
+
+// Makes the header phis read values[] from here on.
+static void set_phi_values(loop_copier* copier, const ssa_operand* values) {
+  for (int i = 0; i < copier->phi_count; i++) {
+    copier->map[copier->phis[i]] = values[i];
+  }
+}
+
+// Appends one trip (the header's work, then the body's) to a block.
+// values[] holds what the header phis read at its start and is left holding
+// what they would read on the next trip.
+static void copy_trip(ssa_function* function, const ssa_loop* loop,
+                      loop_copier* copier, int block, ssa_operand* values) {
+  set_phi_values(copier, values);
+  copy_instructions(function, copier, block, copier->header,
+                    copier->header_count);
+  copy_instructions(function, copier, block, copier->body,
+                    copier->body_count);
+  for (int i = 0; i < copier->phi_count; i++) {
+    values[i] = map_operand(
+        copier,
+        function->instructions[copier->phis[i]].operands[loop->latch_position]);
+  }
+}
+
+static ssa_operand* get_entry_values(const ssa_function* function,
+                                     const ssa_loop* loop,
+                                     const loop_copier* copier) {
+  ssa_operand* values = (ssa_operand*)checked_malloc(
+      sizeof(ssa_operand) * ((size_t)copier->phi_count + 1));
+  for (int i = 0; i < copier->phi_count; i++) {
+    values[i] = function->instructions[copier->phis[i]]
+                    .operands[loop->entry_position];
+  }
+  return values;
+}
+
+// Swaps the edge from one block to another for an edge from a new block,
+// keeping its place among the target's predecessors and so its phi inputs.
+static void replace_predecessor(ssa_function* function, int block,
+                                int predecessor, int replacement) {
+  ssa_block* current = &function->blocks[block];
+  for (int i = 0; i < current->predecessor_count; i++) {
+    if (current->predecessors[i] == predecessor) {
+      current->predecessors[i] = replacement;
+      break;
+    }
+  }
+  ssa_block* source = &function->blocks[replacement];
+  source->successors[source->successor_count++] = block;
+}
+
+// Runs every trip in straight-line code in place of the loop, followed by
+// the last, failing test. Whatever the header computed for after the loop
+// is read from those copies, and the loop is left unreachable. Returns the
+// new block.
+static int unroll_fully(ssa_function* function, const ssa_loop* loop,
+                        int64_t trips) {
+  loop_copier copier;
+  init_loop_copier(function, loop, &copier);
+  ssa_operand* values = get_entry_values(function, loop, &copier);
+  int copies = new_ssa_block(function);
+  for (int64_t r = 0; r < trips; r++) {
+    copy_trip(function, loop, &copier, copies, values);
+  }
+  set_phi_values(&copier, values);
+  copy_instructions(function, &copier, copies, copier.header,
+                    copier.header_count);
+  for (int i = 0; i < copier.phi_count; i++) {
+    replace_ssa_uses(function, copier.phis[i], values[i]);
+  }
+  for (int i = 0; i < copier.header_count; i++) {
+    replace_ssa_uses(function, copier.header[i],
+                     copier.map[copier.header[i]]);
+  }
+
+  remove_ssa_edge(function, loop->preheader, loop->header);
+  add_ssa_edge(function, loop->preheader, copies);
+  add_ssa_instruction(function, copies, SSA_JUMP, ssa_none(), ssa_none());
+  int exit = function->blocks[loop->header].successors[1];
+  replace_predecessor(function, exit, loop->header, copies);
+  free(values);
+  free_loop_copier(&copier);
+  return copies;
+}
+
+// The unrolled copy runs while the counter is below the bound by at least
+// (factor - 1) steps, so each of its trips would have passed the test.
+static int64_t get_unrolled_distance(const counted_loop* counted,
+                                     int factor) {
+  return (int64_t)(factor - 1) * counted->variable.step;
+}
+
+// Checks whether the unrolled copy's test can be written without the
+// subtraction from the bound wrapping unnoticed.
+static int can_limit_unrolled_trips(const counted_loop* counted,
+                                    int factor) {
+  int64_t distance = get_unrolled_distance(counted, factor);
+  if (distance > INT_MAX) {
+    return 0;
+  }
+  if (counted->bound.kind == SSA_OPERAND_CONSTANT) {
+    return counted->bound.value - distance >= INT_MIN;
+  }
+  return counted->test == SSA_LT;
+}
+
+// Computes the unrolled copy's bound at the end of the preheader.
+static ssa_operand get_unrolled_limit(ssa_function* function,
+                                      const ssa_loop* loop,
+                                      const counted_loop* counted,
+                                      int factor) {
+  int64_t distance = get_unrolled_distance(counted, factor);
+  if (counted->bound.kind == SSA_OPERAND_CONSTANT) {
+    return ssa_constant((int)(counted->bound.value - distance));
+  }
+  // n - distance, or INT_MIN, which no counter is below, if that would wrap.
+  int difference =
+      add_ssa_instruction(function, loop->preheader, SSA_SUB, counted->bound,
+                          ssa_constant((int)distance));
+  int wraps = add_ssa_instruction(
+      function, loop->preheader, SSA_LT, counted->bound,
+      ssa_constant((int)(INT_MIN + distance)));
+  int limit = add_ssa_instruction(function, loop->preheader, SSA_SELECT,
+                                  ssa_value(wraps), ssa_constant(INT_MIN));
+  add_ssa_operand(function, limit, ssa_value(difference));
+  return ssa_value(limit);
+}
+
+// Puts an unrolled copy of the loop in front of it that runs `factor` trips
+// per test while at least that many remain. The original loop then runs
+// whatever is left. Fills blocks[] with the three new blocks in the order
+// they should be laid out.
+static void unroll_partially(ssa_function* function, const ssa_loop* loop,
+                             const counted_loop* counted, int factor,
+                             int* blocks) {
+  loop_copier copier;
+  init_loop_copier(function, loop, &copier);
+  ssa_operand* values = get_entry_values(function, loop, &copier);
+  int counter = 0;
+  while (copier.phis[counter] != counted->variable.phi) {
+    counter++;
+  }
+  // Split off the preheader's jump, so the original loop is entered from a
+  // block of its own.
+  int entry = split_ssa_block(
+      function, loop->preheader,
+      function->blocks[loop->preheader].instruction_count - 1);
+  ssa_operand limit = get_unrolled_limit(function, loop, counted, factor);
+  int head = new_ssa_block(function);
+  int copies = new_ssa_block(function);
+  add_ssa_instruction(function, loop->preheader, SSA_JUMP, ssa_none(),
+                      ssa_none());
+  add_ssa_edge(function, loop->preheader, head);
+
+  int* phis = (int*)checked_malloc(sizeof(int) *
+                                   ((size_t)copier.phi_count + 1));
+  for (int i = 0; i < copier.phi_count; i++) {
+    phis[i] =
+        add_ssa_instruction(function, head, SSA_PHI, values[i], ssa_none());
+    values[i] = ssa_value(phis[i]);
+  }
+  int guard = add_ssa_instruction(function, head, counted->test,
+                                  ssa_value(phis[counter]), limit);
+  add_ssa_instruction(function, head, SSA_BRANCH, ssa_value(guard),
+                      ssa_none());
+  add_ssa_edge(function, head, copies);
+  add_ssa_edge(function, head, entry);
+
+  for (int r = 0; r < factor; r++) {
+    copy_trip(function, loop, &copier, copies, values);
+  }
+  add_ssa_instruction(function, copies, SSA_JUMP, ssa_none(), ssa_none());
+  add_ssa_edge(function, copies, head);
+  for (int i = 0; i < copier.phi_count; i++) {
+    add_ssa_operand(function, phis[i], values[i]);
+    function->instructions[copier.phis[i]].operands[loop->entry_position] =
+        ssa_value(phis[i]);
+  }
+  blocks[0] = head;
+  blocks[1] = copies;
+  blocks[2] = entry;
+  free(phis);
+  free(values);
+  free_loop_copier(&copier);
+}
+
+void optimize_ssa_loops(ssa_function* function) {
+  int count = 0;
+  ssa_loop* loops = find_loops(function, &count);
+  for (int i = 0; i < count; i++) {
+    hoist_invariants(function, &loops[i]);
+    reduce_induction_variables(function, &loops[i]);
+  }
+  for (int i = 0; i < count; i++) {
+    free(loops[i].body);
+  }
+  free(loops);
+}
+
+void unroll_ssa_loops(ssa_function* function, int factor) {
+  int count = 0;
+  ssa_loop* loops = find_loops(function, &count);
+  // The new blocks of each unrolled loop, to go right after its preheader.
+  int* added = (int*)checked_malloc(sizeof(int) * 3 * ((size_t)count + 1));
+  int* added_count = (int*)checked_malloc(sizeof(int) * ((size_t)count + 1));
+  int original_block_count = function->block_count;
+  int changed = 0;
+  // Only two-block loops qualify, and unrolling one leaves the blocks of
+  // the others alone, so the loops found up front stay valid.
+  for (int i = 0; i < count; i++) {
+    added_count[i] = 0;
+    counted_loop counted;
+    if (!find_counted_loop(function, &loops[i], &counted)) {
+      continue;
+    }
+    int size = counted.size > 0 ? counted.size : 1;
+    int64_t trips = get_trip_count(function, &loops[i], &counted);
+    int unrolled_factor = factor;
+    if (unrolled_factor > UNROLL_SIZE_LIMIT / size) {
+      unrolled_factor = UNROLL_SIZE_LIMIT / size;
+    }
+    if (trips > 0 && trips * size <= UNROLL_SIZE_LIMIT) {
+      added[3 * i] = unroll_fully(function, &loops[i], trips);
+      added_count[i] = 1;
+      changed = 1;
+    } else if (unrolled_factor >= 2 &&
+               can_limit_unrolled_trips(&counted, unrolled_factor)) {
+      unroll_partially(function, &loops[i], &counted, unrolled_factor,
+                       &added[3 * i]);
+      added_count[i] = 3;
+      changed = 1;
+    }
+  }
+
+  if (changed) {
+    // Lay the new blocks out after their preheaders rather than at the end.
+    int* order =
+        (int*)checked_malloc(sizeof(int) * (size_t)function->block_count);
+    int position = 0;
+    for (int b = 0; b < original_block_count; b++) {
+      order[position++] = b;
+      for (int i = 0; i < count; i++) {
+        if (loops[i].preheader == b) {
+          for (int j = 0; j < added_count[i]; j++) {
+            order[position++] = added[3 * i + j];
+          }
+        }
+      }
+    }
+    reorder_ssa_blocks(function, order);
+    free(order);
+    remove_unreachable_ssa_blocks(function);
+    compute_ssa_dominators(function);
+  }
+  for (int i = 0; i < count; i++) {
+    free(loops[i].body);
+  }
+  free(added_count);
+  free(added);
+  free(loops);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ssa.h"
+
+// Trips per unrolled iteration when -funroll-loops gives no factor.
+enum { DEFAULT_UNROLL_FACTOR = 4 };
+
+// Most instructions an unrolled loop body, or a fully unrolled loop, may
+// hold.
+enum { UNROLL_SIZE_LIMIT = 64 };
+
+/*
+Moves work out of loops and replaces multiplies by induction variables with
+running sums.
+
+Finds the natural loops, those entered through a header with one
+predecessor outside the loop that only jumps to it (the preheader) and one
+back edge, and handles them innermost first:
+
+  - Loop-invariant code motion: an instruction that could be speculated and
+    reads only constants and values defined outside the loop moves to the
+    end of the preheader, so it runs once.
+  - Strength reduction: a header phi stepped by a constant each iteration
+    (i = i + c) is an induction variable, and i * k for a constant k becomes
+    a new induction variable that starts at init * k and steps by c * k.
+  - Linear-function test replacement: when the header tests i < n or
+    i <= n against a constant, i starts at a constant and steps upward, and
+    i is otherwise only read by its step and reduced multiplies, the test
+    moves to the reduced variable (i * k < n * k) if that cannot overflow,
+    leaving i dead.
+
+Every transformation keeps 32-bit wrapping semantics. The CFG and the
+dominators are left unchanged; run eliminate_dead_ssa_code afterwards to
+delete the variables the rewrites leave unused.
+
+Args:
+  function: Function with its locals promoted, values numbered (so
+            constants are the second operand of commutative operators and
+            comparisons) and dominators computed.
+
+Returns:
+  void
+*/
+void optimize_ssa_loops(ssa_function* function);
+
+/*
+Unrolls counted loops.
+
+Handles loops of two blocks: a header whose test is i < n or i <= n, with i
+an induction variable stepping upward and n a constant or a value from
+before the loop, and one body block that jumps back. When i starts and
+stops at constants and the whole loop fits UNROLL_SIZE_LIMIT instructions,
+every trip is copied out in straight-line code. Otherwise a copy of the
+loop running `factor` trips per test (fewer if the body would exceed the
+limit) is placed in front. It loops while i < n - (factor - 1) * step,
+and the original loop then runs the remaining trips. The left-over loop of
+a full unroll finds its test false straight away; run number_ssa_values
+and eliminate_dead_ssa_code afterwards to delete it. Recomputes the
+dominators when anything changes.
+
+Args:
+  function: Function with its locals promoted, values numbered and
+            dominators computed.
+  factor: Trips per unrolled iteration; below 2, only full unrolling
+          happens.
+
+Returns:
+  void
+*/
+void unroll_ssa_loops(ssa_function* function, int factor);
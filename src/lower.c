@@ -0,0 +1,976 @@
+/*
+ * Lowering
+ * Instruction selection from SSA into LIR for the optimizing backend.
+ */
+
+#include "lower.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lir.h"
+#include "parser.h"
+#include "ssa.h"
+
+typedef struct lowering_context {
+  const ssa_function* ssa;
+  lir_function* function;
+  ssa_use_list* uses;
+  int* value_registers;  // Virtual register of each SSA value, or -1.
+  int* phi_registers;    // Register each phi's inputs travel through, or -1.
+  int* block_labels;     // LIR label of each SSA block.
+  int* layout;           // SSA blocks in the order they are emitted.
+  int* layout_positions;  // Index of each block in the layout.
+  unsigned char* is_jump_target;  // Blocks some jump names.
+  unsigned char* is_folded;  // Instructions lowered as part of their user.
+  unsigned char* is_tail_call;  // Calls whose result is returned at once.
+} lowering_context;
+
+// Values get their register on first mention, which for a loop-carried
+// value can come before its definition.
+static int get_value_register(lowering_context* context, int value) {
+  if (context->value_registers[value] < 0) {
+    context->value_registers[value] = new_lir_register(context->function);
+  }
+  return context->value_registers[value];
+}
+
+// Returns an immediate for a constant, or the register holding the value.
+static lir_operand lower_operand(lowering_context* context,
+                                 ssa_operand operand) {
+  if (operand.kind == SSA_OPERAND_CONSTANT) {
+    return lir_immediate(operand.value);
+  }
+  return lir_register(get_value_register(context, operand.value));
+}
+
+// Returns a register holding the operand, materializing constants.
+static int lower_operand_register(lowering_context* context,
+                                  ssa_operand operand) {
+  if (operand.kind == SSA_OPERAND_VALUE) {
+    return get_value_register(context, operand.value);
+  }
+  int result = new_lir_register(context->function);
+  add_lir_instruction(context->function, LIR_MOV, lir_register(result),
+                      lir_immediate(operand.value));
+  return result;
+}
+
+// Binds a value to the register a helper computed it into.
+static void define_value(lowering_context* context, int value, int reg) {
+  if (context->value_registers[value] < 0) {
+    context->value_registers[value] = reg;
+  } else {
+    add_lir_instruction(context->function, LIR_MOV,
+                        lir_register(context->value_registers[value]),
+                        lir_register(reg));
+  }
+}
+
+static int is_constant(ssa_operand operand) {
+  return operand.kind == SSA_OPERAND_CONSTANT;
+}
+
+static int is_value(ssa_operand operand) {
+  return operand.kind == SSA_OPERAND_VALUE;
+}
+
+static void lower_call(lowering_context* context, int call) {
+  const ssa_instruction* instruction = &context->ssa->instructions[call];
+  int argument_count = instruction->operand_count;
+  if (argument_count > LIR_MAX_REGISTER_ARGUMENTS) {
+    error_and_exit("Error: Too many arguments in function call\n");
+  }
+  // Arguments are SSA values computed before the call, so no argument
+  // register is clobbered by a nested call once it is in place.
+  for (int i = 0; i < argument_count; i++) {
+    add_lir_instruction(context->function, LIR_MOV,
+                        lir_register(get_lir_argument_register(i)),
+                        lower_operand(context, instruction->operands[i]));
+  }
+  lir_operand target =
+      lir_symbol(instruction->symbol, instruction->symbol_length);
+  // A call whose result is returned right away reuses this frame's return
+  // address: the callee's ret goes straight back to our caller.
+  lir_opcode opcode = context->is_tail_call[call] ? LIR_TAIL_CALL : LIR_CALL;
+  lir_instruction* lowered =
+      add_lir_instruction(context->function, opcode, target, lir_none());
+  // The argument count rides along so liveness knows which registers the
+  // call reads.
+  lowered->operands[0].value = argument_count;
+  if (opcode == LIR_CALL && context->uses[call].count > 0) {
+    add_lir_instruction(context->function, LIR_MOV,
+                        lir_register(get_value_register(context, call)),
+                        lir_register(LIR_RAX));
+  }
+}
+
+static int lower_division(lowering_context* context, ssa_opcode opcode,
+                          lir_operand dividend, int divisor) {
+  lir_function* function = context->function;
+  int result = new_lir_register(function);
+  add_lir_instruction(function, LIR_MOV, lir_register(LIR_RAX), dividend);
+  add_lir_instruction(function, LIR_CDQ, lir_none(), lir_none());
+  add_lir_instruction(function, LIR_IDIV, lir_register(divisor), lir_none());
+  add_lir_instruction(function, LIR_MOV, lir_register(result),
+                      lir_register(opcode == SSA_MOD ? LIR_RDX : LIR_RAX));
+  return result;
+}
+
+static int copy_register(lir_function* function, int source) {
+  int result = new_lir_register(function);
+  add_lir_instruction(function, LIR_MOV, lir_register(result),
+                      lir_register(source));
+  return result;
+}
+
+static void add_immediate_instruction(lir_function* function,
+                                      lir_opcode opcode, int reg, int value) {
+  add_lir_instruction(function, opcode, lir_register(reg),
+                      lir_immediate(value));
+}
+
+static int is_power_of_two(unsigned int value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+static int log2_of(unsigned int value) {
+  int shift = 0;
+  while (value > 1) {
+    value >>= 1;
+    shift++;
+  }
+  return shift;
+}
+
+// Multipliers a single lea can apply: [x+x*2], [x+x*4] and [x+x*8].
+static int is_lea_factor(unsigned int value) {
+  return value == 3 || value == 5 || value == 9;
+}
+
+// How to multiply by a constant magnitude with at most two single-cycle
+// instructions instead of a 3-cycle imul.
+typedef struct multiply_plan {
+  unsigned int first_factor;   // lea factor applied first, or 1.
+  unsigned int second_factor;  // lea factor applied next, or 1.
+  int shift;                   // Left shift applied after the leas.
+  int adjust;  // 1 to add the operand after the shift, -1 to subtract it.
+  int operations;
+} multiply_plan;
+
+// Returns 0 when no plan beats imul.
+static int plan_multiply(unsigned int magnitude, multiply_plan* plan) {
+  plan->first_factor = 1;
+  plan->second_factor = 1;
+  plan->shift = 0;
+  plan->adjust = 0;
+  int trailing_zeros = 0;
+  while (((magnitude >> trailing_zeros) & 1U) == 0) {
+    trailing_zeros++;
+  }
+  unsigned int odd = magnitude >> trailing_zeros;
+  plan->shift = trailing_zeros;
+  if (odd == 1) {
+    plan->operations = 1;
+    return 1;
+  }
+  if (is_lea_factor(odd)) {
+    plan->first_factor = odd;
+    plan->operations = 1 + (trailing_zeros > 0);
+    return 1;
+  }
+  if (trailing_zeros > 0) {
+    return 0;
+  }
+  plan->operations = 2;
+  unsigned int factors[3] = {3, 5, 9};
+  for (int i = 0; i < 3; i++) {
+    if (odd % factors[i] == 0 && is_lea_factor(odd / factors[i])) {
+      plan->first_factor = factors[i];
+      plan->second_factor = odd / factors[i];
+      return 1;
+    }
+  }
+  if (is_power_of_two(odd - 1)) {
+    plan->shift = log2_of(odd - 1);
+    plan->adjust = 1;
+    return 1;
+  }
+  if (odd < UINT_MAX && is_power_of_two(odd + 1)) {
+    plan->shift = log2_of(odd + 1);
+    plan->adjust = -1;
+    return 1;
+  }
+  return 0;
+}
+
+static int add_lea_multiply(lir_function* function, int source,
+                            unsigned int factor) {
+  int result = new_lir_register(function);
+  add_lir_instruction(
+      function, LIR_LEA, lir_register(result),
+      lir_indexed_memory(source, source, (int)factor - 1, 0));
+  return result;
+}
+
+// Multiplies by a constant with shifts, lea and add/sub where that is
+// cheaper than imul.
+static int lower_multiply_by_constant(lir_function* function, int source,
+                                      int multiplier) {
+  if (multiplier == 0) {
+    int result = new_lir_register(function);
+    add_lir_instruction(function, LIR_MOV, lir_register(result),
+                        lir_immediate(0));
+    return result;
+  }
+  int negate = multiplier < 0 && multiplier != INT_MIN;
+  unsigned int magnitude =
+      negate ? 0U - (unsigned int)multiplier : (unsigned int)multiplier;
+  multiply_plan plan;
+  if (magnitude == 1) {
+    plan.operations = 0;
+  } else if (!plan_multiply(magnitude, &plan)) {
+    plan.operations = 3;
+  }
+  if (plan.operations + negate > 2) {
+    int result = copy_register(function, source);
+    add_immediate_instruction(function, LIR_IMUL, result, multiplier);
+    return result;
+  }
+
+  int result = source;
+  if (magnitude != 1) {
+    if (plan.first_factor > 1) {
+      result = add_lea_multiply(function, result, plan.first_factor);
+    }
+    if (plan.second_factor > 1) {
+      result = add_lea_multiply(function, result, plan.second_factor);
+    }
+    if (plan.shift > 0) {
+      if (result == source) {
+        result = copy_register(function, source);
+      }
+      add_immediate_instruction(function, LIR_SHL, result, plan.shift);
+    }
+    if (plan.adjust != 0) {
+      add_lir_instruction(function, plan.adjust > 0 ? LIR_ADD : LIR_SUB,
+                          lir_register(result), lir_register(source));
+    }
+  }
+  if (result == source) {
+    result = copy_register(function, source);
+  }
+  if (negate) {
+    add_lir_instruction(function, LIR_NEG, lir_register(result), lir_none());
+  }
+  return result;
+}
+
+// Computes the multiplier and shift for signed division by a constant
+// (Hacker's Delight, figure 10-1). The divisor must not be -1, 0 or 1.
+static void compute_division_magic(int divisor, int* multiplier, int* shift) {
+  const unsigned int two_31 = 0x80000000U;
+  unsigned int magnitude =
+      divisor < 0 ? 0U - (unsigned int)divisor : (unsigned int)divisor;
+  unsigned int threshold = two_31 + ((unsigned int)divisor >> 31U);
+  unsigned int limit = threshold - 1 - (threshold % magnitude);
+  int power = 31;
+  unsigned int quotient_1 = two_31 / limit;
+  unsigned int remainder_1 = two_31 - (quotient_1 * limit);
+  unsigned int quotient_2 = two_31 / magnitude;
+  unsigned int remainder_2 = two_31 - (quotient_2 * magnitude);
+  unsigned int delta = 0;
+  do {
+    power++;
+    quotient_1 *= 2;
+    remainder_1 *= 2;
+    if (remainder_1 >= limit) {
+      quotient_1++;
+      remainder_1 -= limit;
+    }
+    quotient_2 *= 2;
+    remainder_2 *= 2;
+    if (remainder_2 >= magnitude) {
+      quotient_2++;
+      remainder_2 -= magnitude;
+    }
+    delta = magnitude - remainder_2;
+  } while (quotient_1 < delta || (quotient_1 == delta && remainder_1 == 0));
+  unsigned int magic = quotient_2 + 1;
+  *multiplier = (int)(divisor < 0 ? 0U - magic : magic);
+  *shift = power - 32;
+}
+
+// Adds one when the value is negative, turning a floor into truncation.
+static void add_sign_correction(lir_function* function, int reg) {
+  int sign = copy_register(function, reg);
+  add_immediate_instruction(function, LIR_SHR, sign, 31);
+  add_lir_instruction(function, LIR_ADD, lir_register(reg),
+                      lir_register(sign));
+}
+
+// Divides by +/-2^shift: biases negative dividends by 2^shift - 1 so the
+// arithmetic shift truncates toward zero.
+static int lower_divide_by_power_of_two(lir_function* function, int dividend,
+                                        int shift, int negate) {
+  int result = copy_register(function, dividend);
+  if (shift > 1) {
+    add_immediate_instruction(function, LIR_SAR, result, 31);
+  }
+  add_immediate_instruction(function, LIR_SHR, result, 32 - shift);
+  add_lir_instruction(function, LIR_ADD, lir_register(result),
+                      lir_register(dividend));
+  add_immediate_instruction(function, LIR_SAR, result, shift);
+  if (negate) {
+    add_lir_instruction(function, LIR_NEG, lir_register(result), lir_none());
+  }
+  return result;
+}
+
+// Takes the high half of dividend * magic and corrects it to the quotient.
+static int lower_divide_by_magic(lir_function* function, int dividend,
+                                 int divisor) {
+  int multiplier = 0;
+  int shift = 0;
+  compute_division_magic(divisor, &multiplier, &shift);
+  int magic = new_lir_register(function);
+  add_lir_instruction(function, LIR_MOV, lir_register(magic),
+                      lir_immediate(multiplier));
+  add_lir_instruction(function, LIR_MOV, lir_register(LIR_RAX),
+                      lir_register(dividend));
+  add_lir_instruction(function, LIR_IMUL_HIGH, lir_register(magic),
+                      lir_none());
+  int result = copy_register(function, LIR_RDX);
+  if (divisor > 0 && multiplier < 0) {
+    add_lir_instruction(function, LIR_ADD, lir_register(result),
+                        lir_register(dividend));
+  } else if (divisor < 0 && multiplier > 0) {
+    add_lir_instruction(function, LIR_SUB, lir_register(result),
+                        lir_register(dividend));
+  }
+  if (shift > 0) {
+    add_immediate_instruction(function, LIR_SAR, result, shift);
+  }
+  add_sign_correction(function, result);
+  return result;
+}
+
+static int lower_divide_by_constant(lir_function* function, int dividend,
+                                    int divisor) {
+  unsigned int magnitude =
+      divisor < 0 ? 0U - (unsigned int)divisor : (unsigned int)divisor;
+  if (magnitude == 1) {
+    return copy_register(function, dividend);
+  }
+  if (is_power_of_two(magnitude)) {
+    return lower_divide_by_power_of_two(function, dividend, log2_of(magnitude),
+                                        divisor < 0);
+  }
+  return lower_divide_by_magic(function, dividend, divisor);
+}
+
+// Replaces idiv by a constant with multiplies and shifts. Returns -1 for
+// the divisors idiv has to handle: 0 traps, -1 traps on INT_MIN like the
+// -O0 code does, and INT_MIN has no positive counterpart.
+static int lower_division_by_constant(lir_function* function,
+                                      ssa_opcode opcode, int dividend,
+                                      int divisor) {
+  if (divisor == 0 || divisor == -1 || divisor == INT_MIN) {
+    return -1;
+  }
+  if (opcode == SSA_DIV) {
+    return lower_divide_by_constant(function, dividend, divisor);
+  }
+  // The remainder takes the dividend's sign, so only |divisor| matters.
+  int magnitude = divisor < 0 ? -divisor : divisor;
+  int quotient = lower_divide_by_constant(function, dividend, magnitude);
+  int product = lower_multiply_by_constant(function, quotient, magnitude);
+  int result = copy_register(function, dividend);
+  add_lir_instruction(function, LIR_SUB, lir_register(result),
+                      lir_register(product));
+  return result;
+}
+
+// Returns the lea scale when value is x * 2, x * 4 or x * 8 (either way
+// round), computed in `block` and read only once, and sets factor to x.
+static int get_lea_scale(const lowering_context* context, ssa_operand value,
+                         int block, ssa_operand* factor) {
+  if (!is_value(value) || context->uses[value.value].count != 1) {
+    return 0;
+  }
+  const ssa_instruction* multiply = &context->ssa->instructions[value.value];
+  if (multiply->opcode != SSA_MUL || multiply->block != block) {
+    return 0;
+  }
+  ssa_operand constant = multiply->operands[1];
+  *factor = multiply->operands[0];
+  if (!is_constant(constant)) {
+    constant = multiply->operands[0];
+    *factor = multiply->operands[1];
+  }
+  if (!is_constant(constant) || !is_value(*factor)) {
+    return 0;
+  }
+  return constant.value == 2 || constant.value == 4 || constant.value == 8
+             ? constant.value
+             : 0;
+}
+
+// Recognizes base + x * 2/4/8, which a single lea computes. Returns the
+// scale, or 0 for other shapes.
+static int match_scaled_add(const lowering_context* context, int add,
+                            ssa_operand* base, ssa_operand* factor,
+                            int* multiply) {
+  const ssa_instruction* instruction = &context->ssa->instructions[add];
+  if (instruction->opcode != SSA_ADD) {
+    return 0;
+  }
+  for (int i = 0; i < 2; i++) {
+    ssa_operand scaled = instruction->operands[i];
+    *base = instruction->operands[1 - i];
+    int scale = get_lea_scale(context, scaled, instruction->block, factor);
+    if (scale != 0 && is_value(*base)) {
+      *multiply = scaled.value;
+      return scale;
+    }
+  }
+  return 0;
+}
+
+static lir_opcode get_arithmetic_opcode(ssa_opcode opcode) {
+  switch (opcode) {
+    case SSA_SUB:
+      return LIR_SUB;
+    case SSA_MUL:
+      return LIR_IMUL;
+    default:
+      return LIR_ADD;
+  }
+}
+
+static void lower_binary(lowering_context* context, int id) {
+  lir_function* function = context->function;
+  const ssa_instruction* instruction = &context->ssa->instructions[id];
+  ssa_opcode opcode = instruction->opcode;
+  ssa_operand left = instruction->operands[0];
+  ssa_operand right = instruction->operands[1];
+
+  // Constant multipliers and divisors are strength reduced instead of
+  // materialized.
+  if (opcode == SSA_MUL && (is_constant(left) != is_constant(right))) {
+    ssa_operand factor = is_constant(right) ? left : right;
+    int multiplier = is_constant(right) ? right.value : left.value;
+    define_value(context, id,
+                 lower_multiply_by_constant(
+                     function, get_value_register(context, factor.value),
+                     multiplier));
+    return;
+  }
+  if ((opcode == SSA_DIV || opcode == SSA_MOD) && is_constant(right)) {
+    int dividend = lower_operand_register(context, left);
+    int result =
+        lower_division_by_constant(function, opcode, dividend, right.value);
+    if (result < 0) {
+      result = lower_division(context, opcode, lir_register(dividend),
+                              lower_operand_register(context, right));
+    }
+    define_value(context, id, result);
+    return;
+  }
+  if (opcode == SSA_DIV || opcode == SSA_MOD) {
+    define_value(context, id,
+                 lower_division(context, opcode, lower_operand(context, left),
+                                lower_operand_register(context, right)));
+    return;
+  }
+
+  int result = get_value_register(context, id);
+  ssa_operand base;
+  ssa_operand factor;
+  int multiply = 0;
+  int scale = match_scaled_add(context, id, &base, &factor, &multiply);
+  if (scale != 0) {
+    add_lir_instruction(
+        function, LIR_LEA, lir_register(result),
+        lir_indexed_memory(get_value_register(context, base.value),
+                           get_value_register(context, factor.value), scale,
+                           0));
+    return;
+  }
+  if (opcode == SSA_SUB && is_constant(left) && left.value == 0 &&
+      is_value(right)) {
+    add_lir_instruction(function, LIR_MOV, lir_register(result),
+                        lower_operand(context, right));
+    add_lir_instruction(function, LIR_NEG, lir_register(result), lir_none());
+    return;
+  }
+  // Constants stay immediates; addition can take one on either side.
+  lir_operand first = lower_operand(context, left);
+  lir_operand second = lower_operand(context, right);
+  if (opcode != SSA_SUB && first.kind == LIR_OPERAND_IMMEDIATE) {
+    lir_operand swapped = first;
+    first = second;
+    second = swapped;
+  }
+  add_lir_instruction(function, LIR_MOV, lir_register(result), first);
+  add_lir_instruction(function, get_arithmetic_opcode(opcode),
+                      lir_register(result), second);
+}
+
+static lir_condition get_condition(ssa_opcode opcode) {
+  switch (opcode) {
+    case SSA_NE:
+      return LIR_CONDITION_NE;
+    case SSA_LT:
+      return LIR_CONDITION_L;
+    case SSA_GT:
+      return LIR_CONDITION_G;
+    case SSA_LE:
+      return LIR_CONDITION_LE;
+    case SSA_GE:
+      return LIR_CONDITION_GE;
+    default:
+      return LIR_CONDITION_E;
+  }
+}
+
+// Emits cmp for a comparison and returns the condition to test, which is
+// mirrored when a constant left operand has to move to the right.
+static lir_condition lower_compare(lowering_context* context,
+                                   const ssa_instruction* instruction) {
+  ssa_operand left = instruction->operands[0];
+  ssa_operand right = instruction->operands[1];
+  lir_condition condition = get_condition(instruction->opcode);
+  if (is_constant(left) && is_value(right)) {
+    ssa_operand swapped = left;
+    left = right;
+    right = swapped;
+    condition = swap_lir_condition(condition);
+  }
+  add_lir_instruction(context->function, LIR_CMP,
+                      lir_register(lower_operand_register(context, left)),
+                      lower_operand(context, right));
+  return condition;
+}
+
+static void lower_comparison(lowering_context* context, int id) {
+  lir_condition condition =
+      lower_compare(context, &context->ssa->instructions[id]);
+  add_lir_instruction(context->function, LIR_SETCC,
+                      lir_register(get_value_register(context, id)),
+                      lir_none())
+      ->condition = condition;
+}
+
+static int get_phi_register(lowering_context* context, int phi) {
+  if (context->phi_registers[phi] < 0) {
+    context->phi_registers[phi] = new_lir_register(context->function);
+  }
+  return context->phi_registers[phi];
+}
+
+// Copies this block's inputs to the successor's phis. Each phi has its own
+// transfer register, read back at the top of its block, so phis that read
+// each other still see the values from the end of this block.
+static void lower_phi_inputs(lowering_context* context, int block,
+                             int successor) {
+  const ssa_block* target = &context->ssa->blocks[successor];
+  int position = 0;
+  while (target->predecessors[position] != block) {
+    position++;
+  }
+  for (int i = 0; i < target->instruction_count; i++) {
+    int phi = target->instructions[i];
+    const ssa_instruction* instruction = &context->ssa->instructions[phi];
+    if (instruction->opcode != SSA_PHI) {
+      break;
+    }
+    if (context->uses[phi].count == 0) {
+      continue;
+    }
+    add_lir_instruction(
+        context->function, LIR_MOV,
+        lir_register(get_phi_register(context, phi)),
+        lower_operand(context, instruction->operands[position]));
+  }
+}
+
+// Returns the block emitted right after the given one, or -1 for the last.
+static int get_next_block(const lowering_context* context, int block) {
+  int position = context->layout_positions[block] + 1;
+  return position < context->ssa->block_count ? context->layout[position]
+                                              : -1;
+}
+
+static void lower_jump(lowering_context* context, int block, int target) {
+  if (target != get_next_block(context, block)) {
+    add_lir_instruction(
+        context->function, LIR_JMP,
+        lir_label(context->function, context->block_labels[target]),
+        lir_none());
+  }
+}
+
+static void lower_conditional_jump(lowering_context* context,
+                                   lir_condition condition, int target) {
+  add_lir_instruction(
+      context->function, LIR_JCC,
+      lir_label(context->function, context->block_labels[target]), lir_none())
+      ->condition = condition;
+}
+
+static int is_comparison(ssa_opcode opcode) {
+  return opcode == SSA_EQ || opcode == SSA_NE || opcode == SSA_LT ||
+         opcode == SSA_GT || opcode == SSA_LE || opcode == SSA_GE;
+}
+
+// Returns the comparison a branch or select tests when that is its only user
+// in the same block, so the cmp can move down next to the jcc or cmov
+// instead of materializing a boolean; otherwise -1.
+static int get_fused_comparison(const lowering_context* context, int block,
+                                const ssa_instruction* user) {
+  ssa_operand condition = user->operands[0];
+  if (!is_value(condition) || context->uses[condition.value].count != 1) {
+    return -1;
+  }
+  const ssa_instruction* comparison =
+      &context->ssa->instructions[condition.value];
+  if (!is_comparison(comparison->opcode) || comparison->block != block) {
+    return -1;
+  }
+  return condition.value;
+}
+
+// Sets the flags for a branch or select on its condition and returns the
+// condition that means nonzero.
+static lir_condition lower_condition(lowering_context* context, int block,
+                                     const ssa_instruction* user) {
+  int comparison = get_fused_comparison(context, block, user);
+  if (comparison >= 0) {
+    return lower_compare(context, &context->ssa->instructions[comparison]);
+  }
+  int condition = lower_operand_register(context, user->operands[0]);
+  add_lir_instruction(context->function, LIR_CMP, lir_register(condition),
+                      lir_immediate(0));
+  return LIR_CONDITION_NE;
+}
+
+// Starts from the false value and conditionally moves in the true one, which
+// cmov needs in a register.
+static void lower_select(lowering_context* context, int block, int id) {
+  const ssa_instruction* instruction = &context->ssa->instructions[id];
+  int result = get_value_register(context, id);
+  int on_true = lower_operand_register(context, instruction->operands[1]);
+  add_lir_instruction(context->function, LIR_MOV, lir_register(result),
+                      lower_operand(context, instruction->operands[2]));
+  lir_condition condition = lower_condition(context, block, instruction);
+  add_lir_instruction(context->function, LIR_CMOV, lir_register(result),
+                      lir_register(on_true))
+      ->condition = condition;
+}
+
+// Compares right before the jump so the pair macro-fuses, and falls through
+// to whichever successor comes next.
+static void lower_branch(lowering_context* context, int block,
+                         const ssa_instruction* instruction) {
+  const ssa_block* current = &context->ssa->blocks[block];
+  int on_true = current->successors[0];
+  int on_false = current->successors[1];
+  ssa_operand condition = instruction->operands[0];
+  if (is_constant(condition)) {
+    lower_jump(context, block, condition.value != 0 ? on_true : on_false);
+    return;
+  }
+  lir_condition taken = lower_condition(context, block, instruction);
+  int next = get_next_block(context, block);
+  if (on_false == next) {
+    lower_conditional_jump(context, taken, on_true);
+  } else if (on_true == next) {
+    lower_conditional_jump(context, invert_lir_condition(taken), on_false);
+  } else {
+    lower_conditional_jump(context, taken, on_true);
+    lower_jump(context, block, on_false);
+  }
+}
+
+static void lower_terminator(lowering_context* context, int block, int id) {
+  const ssa_instruction* instruction = &context->ssa->instructions[id];
+  const ssa_block* current = &context->ssa->blocks[block];
+  for (int i = 0; i < current->successor_count; i++) {
+    lower_phi_inputs(context, block, current->successors[i]);
+  }
+  switch (instruction->opcode) {
+    case SSA_JUMP:
+      lower_jump(context, block, current->successors[0]);
+      break;
+    case SSA_BRANCH:
+      lower_branch(context, block, instruction);
+      break;
+    default:
+      if (instruction->operand_count > 0) {
+        add_lir_instruction(context->function, LIR_MOV,
+                            lir_register(LIR_RAX),
+                            lower_operand(context, instruction->operands[0]));
+      }
+      add_lir_instruction(context->function, LIR_RET, lir_none(), lir_none());
+      break;
+  }
+}
+
+static void lower_instruction(lowering_context* context, int block, int id) {
+  const ssa_instruction* instruction = &context->ssa->instructions[id];
+  switch (instruction->opcode) {
+    case SSA_PARAMETER:
+      if (context->uses[id].count > 0) {
+        add_lir_instruction(
+            context->function, LIR_MOV,
+            lir_register(get_value_register(context, id)),
+            lir_register(get_lir_argument_register(instruction->index)));
+      }
+      break;
+    case SSA_ADD:
+    case SSA_SUB:
+    case SSA_MUL:
+    case SSA_DIV:
+    case SSA_MOD:
+      lower_binary(context, id);
+      break;
+    case SSA_EQ:
+    case SSA_NE:
+    case SSA_LT:
+    case SSA_GT:
+    case SSA_LE:
+    case SSA_GE:
+      lower_comparison(context, id);
+      break;
+    case SSA_SELECT:
+      lower_select(context, block, id);
+      break;
+    case SSA_CALL:
+      lower_call(context, id);
+      break;
+    case SSA_PHI:
+      if (context->uses[id].count == 0) {
+        break;
+      }
+      add_lir_instruction(context->function, LIR_MOV,
+                          lir_register(get_value_register(context, id)),
+                          lir_register(get_phi_register(context, id)));
+      break;
+    case SSA_JUMP:
+    case SSA_BRANCH:
+    case SSA_RETURN:
+      lower_terminator(context, block, id);
+      break;
+    case SSA_LOAD:
+    case SSA_STORE:
+      error_and_exit("Error: Locals must be promoted before lowering\n");
+      break;
+  }
+}
+
+// Finds the blocks that need a label: those some edge reaches other than by
+// falling through from the block laid out just before. Mirrors the jumps
+// lower_terminator emits.
+static void mark_jump_targets(lowering_context* context) {
+  const ssa_function* ssa = context->ssa;
+  for (int b = 0; b < ssa->block_count; b++) {
+    const ssa_block* block = &ssa->blocks[b];
+    if (block->instruction_count == 0) {
+      continue;
+    }
+    const ssa_instruction* last =
+        &ssa->instructions[block->instructions[block->instruction_count - 1]];
+    int next = get_next_block(context, b);
+    if (last->opcode == SSA_BRANCH && is_constant(last->operands[0])) {
+      int target = block->successors[last->operands[0].value != 0 ? 0 : 1];
+      context->is_jump_target[target] |= target != next;
+    } else if (last->opcode == SSA_BRANCH) {
+      int on_true = block->successors[0];
+      int on_false = block->successors[1];
+      context->is_jump_target[on_true] |= on_false == next || on_true != next;
+      context->is_jump_target[on_false] |= on_false != next;
+    } else if (last->opcode == SSA_JUMP) {
+      context->is_jump_target[block->successors[0]] |=
+          block->successors[0] != next;
+    }
+  }
+}
+
+// Returns the single block that jumps back to a loop header, or -1 unless
+// the header ends in a real test, falls into the loop body and comes before
+// that block in the layout.
+static int get_loop_latch(const lowering_context* context, int header) {
+  const ssa_function* ssa = context->ssa;
+  const ssa_block* block = &ssa->blocks[header];
+  if (header == 0 || block->instruction_count == 0) {
+    return -1;
+  }
+  const ssa_instruction* last =
+      &ssa->instructions[block->instructions[block->instruction_count - 1]];
+  if (last->opcode != SSA_BRANCH || is_constant(last->operands[0])) {
+    return -1;
+  }
+  int next = get_next_block(context, header);
+  if (next != block->successors[0] && next != block->successors[1]) {
+    return -1;
+  }
+  int latch = -1;
+  for (int i = 0; i < block->predecessor_count; i++) {
+    int predecessor = block->predecessors[i];
+    if (!ssa_block_dominates(ssa, header, predecessor)) {
+      continue;
+    }
+    if (latch >= 0) {
+      return -1;
+    }
+    latch = predecessor;
+  }
+  if (latch < 0 || ssa->blocks[latch].successor_count != 1 ||
+      context->layout_positions[latch] < context->layout_positions[header]) {
+    return -1;
+  }
+  return latch;
+}
+
+// Rotates each loop so its test sits at the bottom: the header moves right
+// after its latch, the entry jumps down to it once, and every iteration
+// after that ends in the test's single conditional branch back to the body.
+static void rotate_loops(lowering_context* context) {
+  for (int header = 0; header < context->ssa->block_count; header++) {
+    int latch = get_loop_latch(context, header);
+    if (latch < 0) {
+      continue;
+    }
+    int from = context->layout_positions[header];
+    int to = context->layout_positions[latch];
+    for (int position = from; position < to; position++) {
+      context->layout[position] = context->layout[position + 1];
+      context->layout_positions[context->layout[position]] = position;
+    }
+    context->layout[to] = header;
+    context->layout_positions[header] = to;
+  }
+}
+
+// Marks the calls directly followed by a return of their result as tail
+// calls, and folds that return into them.
+static void mark_tail_calls(lowering_context* context) {
+  const ssa_function* ssa = context->ssa;
+  for (int b = 0; b < ssa->block_count; b++) {
+    const ssa_block* block = &ssa->blocks[b];
+    if (block->instruction_count < 2) {
+      continue;
+    }
+    int call = block->instructions[block->instruction_count - 2];
+    int last = block->instructions[block->instruction_count - 1];
+    const ssa_instruction* terminator = &ssa->instructions[last];
+    if (ssa->instructions[call].opcode == SSA_CALL &&
+        terminator->opcode == SSA_RETURN && terminator->operand_count == 1 &&
+        is_value(terminator->operands[0]) &&
+        terminator->operands[0].value == call) {
+      context->is_tail_call[call] = 1;
+      context->is_folded[last] = 1;
+    }
+  }
+}
+
+// Marks the multiplies that fold into a lea with the add reading them, and
+// the comparisons that fold into the branch or select testing them.
+static void mark_folded_instructions(lowering_context* context) {
+  for (int i = 0; i < context->ssa->instruction_count; i++) {
+    const ssa_instruction* instruction = &context->ssa->instructions[i];
+    ssa_operand base;
+    ssa_operand factor;
+    int multiply = 0;
+    if (instruction->block < 0) {
+      continue;
+    }
+    if (match_scaled_add(context, i, &base, &factor, &multiply) != 0) {
+      context->is_folded[multiply] = 1;
+    }
+    if (instruction->opcode == SSA_BRANCH ||
+        instruction->opcode == SSA_SELECT) {
+      int comparison =
+          get_fused_comparison(context, instruction->block, instruction);
+      if (comparison >= 0) {
+        context->is_folded[comparison] = 1;
+      }
+    }
+  }
+}
+
+void lower_ssa_to_lir(const ssa_function* ssa, lir_function* function) {
+  if (ssa->parameter_count > LIR_MAX_REGISTER_ARGUMENTS) {
+    error_and_exit("Error: Too many parameters\n");
+  }
+  init_lir_function(function, ssa->name, ssa->name_length);
+
+  lowering_context context;
+  context.ssa = ssa;
+  context.function = function;
+  context.uses = build_ssa_use_lists(ssa);
+  size_t value_count = (size_t)ssa->instruction_count;
+  size_t block_count = (size_t)ssa->block_count;
+  context.value_registers = (int*)checked_malloc(sizeof(int) * value_count);
+  context.phi_registers = (int*)checked_malloc(sizeof(int) * value_count);
+  context.is_folded = (unsigned char*)checked_malloc(value_count);
+  for (size_t i = 0; i < value_count; i++) {
+    context.value_registers[i] = -1;
+    context.phi_registers[i] = -1;
+  }
+  memset(context.is_folded, 0, value_count);
+  context.is_tail_call = (unsigned char*)checked_malloc(value_count);
+  memset(context.is_tail_call, 0, value_count);
+  context.block_labels = (int*)checked_malloc(sizeof(int) * block_count);
+  context.is_jump_target = (unsigned char*)checked_malloc(block_count);
+  memset(context.is_jump_target, 0, block_count);
+  context.layout = (int*)checked_malloc(sizeof(int) * block_count);
+  context.layout_positions = (int*)checked_malloc(sizeof(int) * block_count);
+  for (size_t b = 0; b < block_count; b++) {
+    context.block_labels[b] = new_lir_label(function);
+    context.layout[b] = (int)b;
+    context.layout_positions[b] = (int)b;
+  }
+  rotate_loops(&context);
+  mark_jump_targets(&context);
+  mark_folded_instructions(&context);
+  mark_tail_calls(&context);
+
+  // Blocks keep source order apart from the rotated loop tests.
+  for (int position = 0; position < ssa->block_count; position++) {
+    int b = context.layout[position];
+    if (context.is_jump_target[b]) {
+      add_lir_instruction(function, LIR_LABEL,
+                          lir_label(function, context.block_labels[b]),
+                          lir_none());
+    }
+    const ssa_block* block = &ssa->blocks[b];
+    for (int i = 0; i < block->instruction_count; i++) {
+      if (!context.is_folded[block->instructions[i]]) {
+        lower_instruction(&context, b, block->instructions[i]);
+      }
+    }
+  }
+
+  free_ssa_use_lists(context.uses, ssa->instruction_count);
+  free(context.value_registers);
+  free(context.phi_registers);
+  free(context.is_folded);
+  free(context.is_tail_call);
+  free(context.block_labels);
+  free(context.is_jump_target);
+  free(context.layout);
+  free(context.layout_positions);
+}
+
+void lower_function_to_lir(ast_node* node, lir_function* function) {
+  ssa_function ssa;
+  build_ssa_function(node, &ssa);
+  promote_ssa_locals(&ssa);
+  lower_ssa_to_lir(&ssa, function);
+  free_ssa_function(&ssa);
+}
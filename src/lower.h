@@ -0,0 +1,50 @@
+#pragma once
+
+#include "lir.h"
+#include "parser.h"
+#include "ssa.h"
+
+/*
+Lowers an SSA function into LIR over virtual registers.
+
+Every SSA value gets its own virtual register. Parameters are copied out of
+their System V argument registers on entry, call arguments are moved into
+them before `call`, and return values go through eax. A call whose result is
+returned straight away becomes a tail call, a jmp after the epilogue.
+Constants stay immediates where x86 allows one, multiplies and divides by
+constants are strength reduced, and a single-use x * 2/4/8 folds into the
+lea of the add reading it. A comparison only a branch in its block reads
+becomes a cmp right before that branch's jcc, so the two macro-fuse; other
+comparisons become cmp and setcc, and other branches test their condition
+against zero. A select moves its false value into place and then cmovs the
+true one over it, fusing its comparison the same way. Each phi gets a
+transfer register that every predecessor writes before its jump and the
+phi's block reads on entry. Blocks keep their SSA order except that each
+loop header moves below the block that jumps back to it, so the loop enters
+with one jmp to its test and then iterates on a single conditional branch at
+the bottom. Only blocks reached by something other than falling through get
+a label.
+
+Args:
+  ssa: Function in SSA form, with every local promoted and dominators
+       computed.
+  function: Uninitialized LIR function to fill in.
+
+Returns:
+  void
+*/
+void lower_ssa_to_lir(const ssa_function* ssa, lir_function* function);
+
+/*
+Lowers a function's AST into LIR by building its SSA form, promoting its
+locals and lowering the result with lower_ssa_to_lir. Resolves the
+function's variables first if that has not happened yet.
+
+Args:
+  node: AST_FUNCTION_DECLARATION node.
+  function: Uninitialized LIR function to fill in.
+
+Returns:
+  void
+*/
+void lower_function_to_lir(ast_node* node, lir_function* function);
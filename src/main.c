@@ -5,31 +5,45 @@
 #define DEBUG
 
 #include "codegen.h"
+#include "driver.h"
 #include "lexer.h"
 #include "parser.h"
 
 /**
  * main – Program entry point for the compiler front‑end.
  *
- * Opens the input file "test.txt" for reading; on failure, prints an error
- * message to stderr and returns 1. Otherwise, it:
+ * Reads compiler flags (e.g., -O1) from the command line, then opens the
+ * input file "test.txt" for reading; on failure, prints an error message to
+ * stderr and returns 1. Otherwise, it:
  *   1. Reads the entire file into a dynamically allocated buffer.
  *   2. Initializes the Lexer and tokenizes the source into an array.
  *   3. Prints all tokens to stdout.
  *   4. Parses the tokens into an AST and prints the AST.
- *   5. Converts each AST function node into x86 instructions.
- *   6. Prints the generated instructions.
- *   7. Frees all allocated memory.
+ *   5. Binds every variable reference to its stack slot.
+ *   6. Converts each AST function node into x86 instructions, through the
+ *      optimizing backend when -O1 is given.
+ *   7. Writes the generated instructions to chat.s, or encodes them into
+ *      the object file chat.o (-c) or the executable chat (-static), or
+ *      runs the encoded program in memory (--run). With --interpret the
+ *      functions are compiled to bytecode and run on the virtual machine
+ *      instead.
+ *   8. Frees all allocated memory.
  *
  * Parameters:
- *   None.
+ *   argc: Number of command line arguments.
+ *   argv: Command line arguments.
  *
  * Return:
- *   0 on successful execution.
+ *   0 on successful execution, or what the program's main returned with
+ *   --run or --interpret.
  *   1 if the source file cannot be opened.
  * :contentReference[oaicite:0]{index=0}:contentReference[oaicite:1]{index=1}
  */
-int main() {
+int main(int argc, char** argv) {
+  compiler_options options;
+  init_compiler_options(&options);
+  parse_compiler_options(&options, argc, argv);
+
   FILE* file = fopen("test.txt", "r");
   if (!file) {
     fprintf(stderr, "Error opening file.\n");
@@ -76,16 +90,23 @@ int main() {
 
   astNodes = parse_file(tokens, token_index);
 
+  int function_count = 0;
+  while (astNodes[function_count] != NULL) {
+    function_count++;
+  }
+
   printf("AST Nodes:\n");
 
-  print_ast_output(astNodes, token_index, 1);
+  print_ast_output(astNodes, function_count, 1);
+
+  resolve_variables(astNodes, function_count);
 
   // ast_node* expressionNode =
   // astNodes[1] = astNodes[0]->as.function.statements->as.block.statements[0];
 
   // ast_node* expressionNode = astNodes[1];
 
-  print_ast_output(astNodes, token_index, 1);
+  print_ast_output(astNodes, function_count, 1);
 
   list_of_x86_instructions list;
   init_list_of_instructions(&list);
@@ -93,18 +114,23 @@ int main() {
   memory mem;
   init_memory(&mem);
 
-  printf("Before\n");
+  int result = 0;
+  if (options.output == OUTPUT_BYTECODE) {
+    result = interpret_program(astNodes, function_count, &options);
+  } else {
+    printf("Before\n");
 
-  list_of_ast_function_nodes_to_x86(astNodes, &list, token_index);
-  // ast_declaration_node_to_x86(expressionNode, &list, &mem);
+    compile_to_x86(astNodes, function_count, &list, &options);
+    // ast_declaration_node_to_x86(expressionNode, &list, &mem);
 
-  printf("After\n");
-  print_instructions(&list);
+    printf("After\n");
+    result = write_compiler_output(&list, &options);
+  }
 
   // Cleanup
   free(source);
   free(tokens);
-  return 0;
+  return result;
 
   // printASTFile(astNodes, token_index);
   // void print_ast_output(ast_node** nodes, int count, int outputToFile);
@@ -0,0 +1,343 @@
+/*
+ * Object Files
+ * Packages encoded machine code as an x86-64 ELF object file or a
+ * statically linked executable.
+ */
+
+#include "object.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "encode.h"
+#include "lexer.h"
+
+enum {
+  INITIAL_BUFFER_CAPACITY = 256,
+  TEXT_ALIGNMENT = 16,
+  TABLE_ALIGNMENT = 8,
+  PAGE_SIZE = 0x1000,
+  EXECUTABLE_BASE_ADDRESS = 0x400000,
+  // A rel32 field is relative to the end of the field, 4 bytes past it.
+  RELOCATION_ADDEND = -4,
+  MAX_SECTIONS = 6,
+  // .text always directly follows the null section.
+  TEXT_SECTION = 1,
+};
+
+typedef struct byte_buffer {
+  unsigned char* data;
+  size_t size;
+  size_t capacity;
+} byte_buffer;
+
+// A file being laid out: its bytes so far and its section headers.
+typedef struct elf_file {
+  byte_buffer data;
+  Elf64_Shdr sections[MAX_SECTIONS];
+  int section_count;
+  byte_buffer section_names;
+} elf_file;
+
+// ───── Buffers ─────
+
+static void append_bytes(byte_buffer* buffer, const void* bytes,
+                         size_t length) {
+  if (buffer->size + length > buffer->capacity) {
+    size_t capacity =
+        buffer->capacity == 0 ? INITIAL_BUFFER_CAPACITY : buffer->capacity;
+    while (buffer->size + length > capacity) {
+      capacity *= 2;
+    }
+    unsigned char* data = (unsigned char*)realloc(buffer->data, capacity);
+    if (data == NULL) {
+      error_and_exit("malloc failed");
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+  }
+  if (length > 0) {
+    memcpy(buffer->data + buffer->size, bytes, length);
+  }
+  buffer->size += length;
+}
+
+static void align_buffer(byte_buffer* buffer, size_t alignment) {
+  static const unsigned char zero = 0;
+  while (buffer->size % alignment != 0) {
+    append_bytes(buffer, &zero, 1);
+  }
+}
+
+// Appends a null-terminated string and returns its offset in the buffer.
+static Elf64_Word add_string(byte_buffer* strings, const char* text) {
+  Elf64_Word offset = (Elf64_Word)strings->size;
+  append_bytes(strings, text, strlen(text) + 1);
+  return offset;
+}
+
+// ───── Tables ─────
+
+static int is_local_label(const x86_symbol* symbol) {
+  return strncmp(symbol->name, ".L", 2) == 0;
+}
+
+static int is_global_symbol(const x86_symbol* symbol) {
+  return symbol->global || symbol->offset < 0;
+}
+
+// Builds the symbol table, locals first as ELF requires, placing the code
+// at text_address. Fills in each symbol's table index (0 for those left
+// out) and returns the index of the first global.
+static Elf64_Word build_symbol_table(const x86_code* code,
+                                     Elf64_Addr text_address,
+                                     byte_buffer* table, byte_buffer* strings,
+                                     Elf64_Word* indexes) {
+  Elf64_Sym entry;
+  memset(&entry, 0, sizeof(entry));
+  append_bytes(table, &entry, sizeof(entry));
+  Elf64_Word next = 1;
+  Elf64_Word first_global = 1;
+  for (int global = 0; global <= 1; global++) {
+    for (int i = 0; i < code->symbol_count; i++) {
+      const x86_symbol* symbol = &code->symbols[i];
+      if (is_local_label(symbol) || is_global_symbol(symbol) != global) {
+        continue;
+      }
+      memset(&entry, 0, sizeof(entry));
+      entry.st_name = add_string(strings, symbol->name);
+      entry.st_info =
+          ELF64_ST_INFO(global ? STB_GLOBAL : STB_LOCAL, STT_NOTYPE);
+      if (symbol->offset >= 0) {
+        entry.st_shndx = TEXT_SECTION;
+        entry.st_value = text_address + (Elf64_Addr)symbol->offset;
+      } else {
+        entry.st_shndx = SHN_UNDEF;
+      }
+      append_bytes(table, &entry, sizeof(entry));
+      indexes[i] = next++;
+    }
+    if (!global) {
+      first_global = next;
+    }
+  }
+  return first_global;
+}
+
+static void build_relocations(const x86_code* code, const Elf64_Word* indexes,
+                              byte_buffer* table) {
+  for (int i = 0; i < code->relocation_count; i++) {
+    const x86_relocation* relocation = &code->relocations[i];
+    Elf64_Rela entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.r_offset = (Elf64_Addr)relocation->offset;
+    entry.r_info = ELF64_R_INFO(indexes[relocation->symbol], R_X86_64_PLT32);
+    entry.r_addend = RELOCATION_ADDEND;
+    append_bytes(table, &entry, sizeof(entry));
+  }
+}
+
+// ───── Layout ─────
+
+// Starts a file with room for the ELF header and program_header_count
+// program headers.
+static void init_elf_file(elf_file* file, int program_header_count) {
+  memset(file, 0, sizeof(*file));
+  file->section_count = 1;  // The null section.
+  (void)add_string(&file->section_names, "");
+  Elf64_Ehdr header;
+  memset(&header, 0, sizeof(header));
+  append_bytes(&file->data, &header, sizeof(header));
+  Elf64_Phdr segment;
+  memset(&segment, 0, sizeof(segment));
+  for (int i = 0; i < program_header_count; i++) {
+    append_bytes(&file->data, &segment, sizeof(segment));
+  }
+}
+
+// Appends a section's contents to the file and returns its header, with
+// the name, type, place and size filled in.
+static Elf64_Shdr* add_section(elf_file* file, const char* name,
+                               Elf64_Word type, const byte_buffer* contents,
+                               size_t alignment) {
+  align_buffer(&file->data, alignment);
+  Elf64_Shdr* header = &file->sections[file->section_count++];
+  header->sh_name = add_string(&file->section_names, name);
+  header->sh_type = type;
+  header->sh_offset = (Elf64_Off)file->data.size;
+  header->sh_size = (Elf64_Xword)contents->size;
+  header->sh_addralign = (Elf64_Xword)alignment;
+  append_bytes(&file->data, contents->data, contents->size);
+  return header;
+}
+
+// Adds .symtab and .strtab and returns the index of .symtab.
+static Elf64_Word add_symbol_sections(elf_file* file, const x86_code* code,
+                                      Elf64_Addr text_address,
+                                      Elf64_Word* indexes) {
+  byte_buffer symbols = {NULL, 0, 0};
+  byte_buffer strings = {NULL, 0, 0};
+  (void)add_string(&strings, "");
+  Elf64_Word first_global =
+      build_symbol_table(code, text_address, &symbols, &strings, indexes);
+  Elf64_Word symbol_section = (Elf64_Word)file->section_count;
+  Elf64_Shdr* header =
+      add_section(file, ".symtab", SHT_SYMTAB, &symbols, TABLE_ALIGNMENT);
+  header->sh_link = symbol_section + 1;
+  header->sh_info = first_global;
+  header->sh_entsize = sizeof(Elf64_Sym);
+  (void)add_section(file, ".strtab", SHT_STRTAB, &strings, 1);
+  free(symbols.data);
+  free(strings.data);
+  return symbol_section;
+}
+
+// Adds .shstrtab and the section headers, then fills in the ELF header and
+// the program header of the segment, if there is one.
+static void finish_elf_file(elf_file* file, Elf64_Half type, Elf64_Addr entry,
+                            const Elf64_Phdr* segment) {
+  Elf64_Word names_section = (Elf64_Word)file->section_count;
+  // Adding the section names its own name before its contents are copied.
+  (void)add_section(file, ".shstrtab", SHT_STRTAB, &file->section_names, 1);
+  align_buffer(&file->data, TABLE_ALIGNMENT);
+
+  Elf64_Ehdr header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  header.e_type = type;
+  header.e_machine = EM_X86_64;
+  header.e_version = EV_CURRENT;
+  header.e_entry = entry;
+  header.e_shoff = (Elf64_Off)file->data.size;
+  header.e_ehsize = sizeof(Elf64_Ehdr);
+  header.e_shentsize = sizeof(Elf64_Shdr);
+  header.e_shnum = (Elf64_Half)file->section_count;
+  header.e_shstrndx = (Elf64_Half)names_section;
+  if (segment != NULL) {
+    header.e_phoff = sizeof(Elf64_Ehdr);
+    header.e_phentsize = sizeof(Elf64_Phdr);
+    header.e_phnum = 1;
+    memcpy(file->data.data + sizeof(Elf64_Ehdr), segment, sizeof(*segment));
+  }
+  append_bytes(&file->data, file->sections,
+               sizeof(Elf64_Shdr) * (size_t)file->section_count);
+  memcpy(file->data.data, &header, sizeof(header));
+}
+
+// Replaces the file at path, creating it with the given permissions (less
+// the umask).
+static void write_file(const elf_file* file, const char* path,
+                       mode_t permissions) {
+  (void)unlink(path);
+  int descriptor =
+      open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, permissions);
+  FILE* output = descriptor >= 0 ? fdopen(descriptor, "wb") : NULL;
+  if (output == NULL) {
+    (void)fprintf(stderr, "Error: Cannot write '%s'\n", path);
+    error_and_exit("");
+  }
+  size_t written = fwrite(file->data.data, 1, file->data.size, output);
+  if (fclose(output) != 0 || written != file->data.size) {
+    (void)fprintf(stderr, "Error: Cannot write '%s'\n", path);
+    error_and_exit("");
+  }
+}
+
+static void free_elf_file(elf_file* file) {
+  free(file->data.data);
+  free(file->section_names.data);
+}
+
+static Elf64_Word* allocate_symbol_indexes(const x86_code* code) {
+  Elf64_Word* indexes = (Elf64_Word*)calloc((size_t)code->symbol_count + 1,
+                                            sizeof(Elf64_Word));
+  if (indexes == NULL) {
+    error_and_exit("malloc failed");
+  }
+  return indexes;
+}
+
+// ───── Output ─────
+
+void write_elf_object(const x86_code* code, const char* path) {
+  elf_file file;
+  init_elf_file(&file, 0);
+  byte_buffer text = {code->bytes, (size_t)code->size, (size_t)code->size};
+  Elf64_Shdr* section =
+      add_section(&file, ".text", SHT_PROGBITS, &text, TEXT_ALIGNMENT);
+  section->sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+
+  Elf64_Word* indexes = allocate_symbol_indexes(code);
+  Elf64_Word symbol_section = add_symbol_sections(&file, code, 0, indexes);
+  byte_buffer relocations = {NULL, 0, 0};
+  build_relocations(code, indexes, &relocations);
+  free(indexes);
+  section = add_section(&file, ".rela.text", SHT_RELA, &relocations,
+                        TABLE_ALIGNMENT);
+  section->sh_flags = SHF_INFO_LINK;
+  section->sh_link = symbol_section;
+  section->sh_info = TEXT_SECTION;
+  section->sh_entsize = sizeof(Elf64_Rela);
+  free(relocations.data);
+
+  finish_elf_file(&file, ET_REL, 0, NULL);
+  write_file(&file, path,
+             S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+  free_elf_file(&file);
+}
+
+void write_elf_executable(const x86_code* code, const char* path) {
+  for (int i = 0; i < code->symbol_count; i++) {
+    if (code->symbols[i].offset < 0) {
+      (void)fprintf(stderr, "Error: Undefined symbol '%s'\n",
+                    code->symbols[i].name);
+      error_and_exit("");
+    }
+  }
+  int start = find_x86_symbol(code, "_start");
+  if (start < 0) {
+    error_and_exit("Error: No _start to use as the entry point\n");
+  }
+
+  elf_file file;
+  init_elf_file(&file, 1);
+  byte_buffer text = {code->bytes, (size_t)code->size, (size_t)code->size};
+  Elf64_Shdr* section =
+      add_section(&file, ".text", SHT_PROGBITS, &text, TEXT_ALIGNMENT);
+  section->sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+  // One segment maps the headers and the code, so the code's address is
+  // its file offset above the base.
+  Elf64_Addr text_address = EXECUTABLE_BASE_ADDRESS + section->sh_offset;
+  section->sh_addr = text_address;
+  Elf64_Off text_end = section->sh_offset + section->sh_size;
+
+  Elf64_Word* indexes = allocate_symbol_indexes(code);
+  (void)add_symbol_sections(&file, code, text_address, indexes);
+  free(indexes);
+
+  Elf64_Phdr segment;
+  memset(&segment, 0, sizeof(segment));
+  segment.p_type = PT_LOAD;
+  segment.p_flags = PF_R | PF_X;
+  segment.p_offset = 0;
+  segment.p_vaddr = EXECUTABLE_BASE_ADDRESS;
+  segment.p_paddr = EXECUTABLE_BASE_ADDRESS;
+  segment.p_filesz = text_end;
+  segment.p_memsz = text_end;
+  segment.p_align = PAGE_SIZE;
+  finish_elf_file(&file, ET_EXEC,
+                  text_address + (Elf64_Addr)code->symbols[start].offset,
+                  &segment);
+
+  write_file(&file, path, S_IRWXU | S_IRWXG | S_IRWXO);
+  free_elf_file(&file);
+}
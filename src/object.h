@@ -0,0 +1,41 @@
+#pragma once
+
+#include "encode.h"
+
+/*
+Writes encoded code as a relocatable x86-64 ELF object file.
+
+The object has a .text section holding the code, a symbol table with every
+symbol except the assembler-local .L labels (as an assembler would leave
+them out), and a .rela.text section with an R_X86_64_PLT32 relocation for
+each call or jump to a symbol the code does not define. Symbols named by
+.global and undefined symbols are global; the rest are local to the file.
+Exits if the file cannot be written.
+
+Args:
+  code: Encoded program.
+  path: Path of the object file to write.
+
+Returns:
+  void
+*/
+void write_elf_object(const x86_code* code, const char* path);
+
+/*
+Writes encoded code as a statically linked x86-64 ELF executable.
+
+The program is laid out by itself, with no linker: a single read-and-execute
+segment maps the headers and the code at 0x400000, and the entry point is
+_start. Calls between the program's functions were already resolved by the
+encoder. A symbol table is kept for debuggers and profilers. The file is
+created executable. Exits if the code has no _start, references a symbol
+it does not define, or cannot be written.
+
+Args:
+  code: Encoded program.
+  path: Path of the executable to write.
+
+Returns:
+  void
+*/
+void write_elf_executable(const x86_code* code, const char* path);
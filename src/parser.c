@@ -70,6 +70,7 @@ ast_node* new_variable_node(Token* name) {
     return NULL;
   }
   node->type = AST_VARIABLE;  // Using the variable type for declarations.
+  node->slot = -1;
   node->as.variable_name = name;
   return node;
 }
@@ -87,6 +88,7 @@ ast_node* new_variable_declaration_node(Token* name, Token* type) {
   }
   node->type =
       AST_VARIABLE_DECLARATION;  // Using the variable type for declarations.
+  node->slot = -1;
   node->as.variable_declaration.name = name;
   node->as.variable_declaration.type = type;
   return node;
@@ -155,6 +157,7 @@ ast_node* new_function_node(Token* name, Token* return_type,
   node->as.function.parameters = parameters;
   node->as.function.param_count = count;
   node->as.function.statements = statements;
+  node->as.function.slot_count = -1;
   return node;
 }
 
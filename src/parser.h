@@ -29,6 +29,8 @@ typedef struct ast_node {
   ast_node_type type;  // Helps identify which kind of node this is.
   // int line;         // Optional: storing line number for debugging or error
   // messages.
+  int slot;  // Stack slot bound by the resolver for AST_VARIABLE and
+             // AST_VARIABLE_DECLARATION nodes, or -1 while unresolved.
   union {
     // For integer literals.
     struct {
@@ -74,6 +76,7 @@ typedef struct ast_node {
       struct ast_node** parameters;  // List of parameters (ASTNodes).
       int param_count;               // Number of parameters.
       struct ast_node* statements;  // Block for the statements in the function.
+      int slot_count;  // Stack slots the resolver used, or -1 if unresolved.
     } function;
 
     struct {
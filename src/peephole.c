@@ -0,0 +1,623 @@
+/*
+ * Peephole Optimization
+ * Pattern-driven rewrites over the emitted x86 instruction text.
+ */
+
+#include "peephole.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lexer.h"
+#include "lir.h"
+
+/*
+Rules are written as
+
+  pattern => replacement [if dead X]
+
+where pattern and replacement are instructions separated by ';'. In an
+operand, a single capital letter is a variable: R, S and T match registers
+other than rsp and rbp, M and N sized memory operands and I and J
+immediates; anything else must match literally. A variable seen twice must
+match the same text, and different variables must match different operands.
+"if dead R" requires the register bound to R to be overwritten before it is
+read again; "if dead flags" asks the same of the flags.
+*/
+static const char* const peephole_rules[] = {
+    // A reload of the value that was just stored is redundant.
+    "mov M, R; mov R, M => mov M, R",
+    // Any other reload can copy the register instead.
+    "mov M, R; mov S, M => mov M, R; mov S, R",
+    // Copies through a register that dies right away are forwarded.
+    "mov R, S; mov T, R => mov T, S if dead R",
+    "mov R, I; mov T, R => mov T, I if dead R",
+    "mov R, M; mov T, R => mov T, M if dead R",
+    "mov R, I; mov M, R => mov M, I if dead R",
+    // So are moves whose result is never read.
+    "mov R, I => if dead R",
+    "mov R, S => if dead R",
+    "mov R, M => if dead R",
+    // Immediates fold into the arithmetic that consumes them.
+    "mov R, I; add S, R => add S, I if dead R",
+    "mov R, I; sub S, R => sub S, I if dead R",
+    "mov R, I; imul S, R => imul S, I if dead R",
+    "mov R, I; cmp S, R => cmp S, I if dead R",
+    // Instructions with no effect on the registers anything reads.
+    "mov R, R => ",
+    "add R, 0 => if dead flags",
+    "sub R, 0 => if dead flags",
+    "imul R, 1 => if dead flags",
+    // xor is shorter and breaks the dependency on the old value.
+    "mov R, 0 => xor R, R if dead flags",
+    // test needs no immediate and sets the same flags as comparing with 0.
+    "cmp R, 0 => test R, R",
+};
+
+enum {
+  PEEPHOLE_MAX_OPERANDS = 3,
+  PEEPHOLE_OPERAND_LENGTH = 64,
+  PEEPHOLE_MNEMONIC_LENGTH = 16,
+  PEEPHOLE_MAX_RULE_LINES = 3,
+  PEEPHOLE_VARIABLE_COUNT = 26,
+  PEEPHOLE_LINE_LENGTH = 160,
+  PEEPHOLE_RULE_COUNT = sizeof(peephole_rules) / sizeof(peephole_rules[0]),
+};
+
+// Bit for the flags register in read and write masks.
+static const unsigned int flags_bit = 1U << LIR_PHYSICAL_REGISTER_COUNT;
+
+typedef enum {
+  LINE_INSTRUCTION,
+  LINE_OTHER,  // Labels, directives and blank lines.
+} line_kind;
+
+typedef struct parsed_line {
+  line_kind kind;
+  char mnemonic[PEEPHOLE_MNEMONIC_LENGTH];
+  int operand_count;
+  char operands[PEEPHOLE_MAX_OPERANDS][PEEPHOLE_OPERAND_LENGTH];
+} parsed_line;
+
+typedef enum {
+  CONDITION_NONE,
+  CONDITION_DEAD_REGISTER,
+  CONDITION_DEAD_FLAGS,
+} condition_kind;
+
+typedef struct peephole_rule {
+  parsed_line pattern[PEEPHOLE_MAX_RULE_LINES];
+  int pattern_count;
+  parsed_line replacement[PEEPHOLE_MAX_RULE_LINES];
+  int replacement_count;
+  condition_kind condition;
+  int condition_variable;
+} peephole_rule;
+
+typedef enum {
+  EFFECT_NORMAL,
+  EFFECT_BARRIER,  // Branches and anything unknown: assume all is read.
+  EFFECT_RETURN,   // Nothing but the reads is used afterwards.
+} effect_kind;
+
+// ───── Parsing ─────
+
+static void copy_trimmed(char* destination, size_t capacity, const char* start,
+                         const char* end) {
+  while (start < end && isspace((unsigned char)*start)) {
+    start++;
+  }
+  while (end > start && isspace((unsigned char)end[-1])) {
+    end--;
+  }
+  size_t length = (size_t)(end - start);
+  if (length >= capacity) {
+    length = capacity - 1;
+  }
+  memcpy(destination, start, length);
+  destination[length] = '\0';
+}
+
+// Splits "mnemonic a, b" into its parts. Comments after '#' are dropped.
+static void parse_line(const char* text, parsed_line* line) {
+  memset(line, 0, sizeof(*line));
+  line->kind = LINE_OTHER;
+  const char* end = strchr(text, '#');
+  if (end == NULL) {
+    end = text + strlen(text);
+  }
+  while (text < end && isspace((unsigned char)*text)) {
+    text++;
+  }
+  const char* mnemonic_end = text;
+  while (mnemonic_end < end && isalnum((unsigned char)*mnemonic_end)) {
+    mnemonic_end++;
+  }
+  if (mnemonic_end == text || (mnemonic_end < end && *mnemonic_end == ':') ||
+      *text == '.') {
+    return;
+  }
+  line->kind = LINE_INSTRUCTION;
+  copy_trimmed(line->mnemonic, sizeof(line->mnemonic), text, mnemonic_end);
+
+  const char* operand = mnemonic_end;
+  while (operand < end && line->operand_count < PEEPHOLE_MAX_OPERANDS) {
+    const char* comma = operand;
+    while (comma < end && *comma != ',') {
+      comma++;
+    }
+    copy_trimmed(line->operands[line->operand_count],
+                 PEEPHOLE_OPERAND_LENGTH, operand, comma);
+    if (line->operands[line->operand_count][0] != '\0') {
+      line->operand_count++;
+    }
+    operand = comma + 1;
+  }
+}
+
+static void parse_rule_lines(const char* text, const char* end,
+                             parsed_line* lines, int* count) {
+  *count = 0;
+  char buffer[PEEPHOLE_LINE_LENGTH];
+  while (text < end) {
+    const char* separator = text;
+    while (separator < end && *separator != ';') {
+      separator++;
+    }
+    copy_trimmed(buffer, sizeof(buffer), text, separator);
+    if (buffer[0] != '\0') {
+      parse_line(buffer, &lines[(*count)++]);
+    }
+    text = separator + 1;
+  }
+}
+
+static void compile_rule(const char* text, peephole_rule* rule) {
+  memset(rule, 0, sizeof(*rule));
+  const char* arrow = strstr(text, "=>");
+  if (arrow == NULL) {
+    error_and_exit("Error: Peephole rule without '=>'\n");
+  }
+  parse_rule_lines(text, arrow, rule->pattern, &rule->pattern_count);
+
+  const char* replacement = arrow + 2;
+  const char* condition = strstr(replacement, "if dead ");
+  const char* replacement_end =
+      condition != NULL ? condition : replacement + strlen(replacement);
+  parse_rule_lines(replacement, replacement_end, rule->replacement,
+                   &rule->replacement_count);
+  if (condition != NULL) {
+    const char* subject = condition + strlen("if dead ");
+    if (strcmp(subject, "flags") == 0) {
+      rule->condition = CONDITION_DEAD_FLAGS;
+    } else {
+      rule->condition = CONDITION_DEAD_REGISTER;
+      rule->condition_variable = subject[0] - 'A';
+    }
+  }
+}
+
+// ───── Operand Classes ─────
+
+static const char* const byte_register_names[LIR_PHYSICAL_REGISTER_COUNT] = {
+    "al",  "cl",  "dl",   "bl",   "spl",  "bpl",  "sil",  "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+
+// Returns the register an operand names, or -1. Byte registers set partial.
+static int get_register(const char* operand, int* partial) {
+  *partial = 0;
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    if (strcmp(operand, get_lir_register_name_32(reg)) == 0 ||
+        strcmp(operand, get_lir_register_name_64(reg)) == 0) {
+      return reg;
+    }
+    if (strcmp(operand, byte_register_names[reg]) == 0) {
+      *partial = 1;
+      return reg;
+    }
+  }
+  return -1;
+}
+
+// The frame registers are left alone so prologues keep their shape.
+static int is_register_operand(const char* operand) {
+  int partial = 0;
+  int reg = get_register(operand, &partial);
+  return reg >= 0 && !partial && reg != LIR_RSP && reg != LIR_RBP;
+}
+
+// Only sized operands, so an immediate can replace the register stored.
+static int is_memory_operand(const char* operand) {
+  return strstr(operand, "PTR [") != NULL;
+}
+
+static int is_immediate_operand(const char* operand) {
+  if (*operand == '-') {
+    operand++;
+  }
+  if (*operand == '\0') {
+    return 0;
+  }
+  for (; *operand != '\0'; operand++) {
+    if (!isdigit((unsigned char)*operand)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int is_variable(const char* operand) {
+  return isupper((unsigned char)operand[0]) && operand[1] == '\0';
+}
+
+static int matches_class(char variable, const char* operand) {
+  switch (variable) {
+    case 'R':
+    case 'S':
+    case 'T':
+      return is_register_operand(operand);
+    case 'M':
+    case 'N':
+      return is_memory_operand(operand);
+    case 'I':
+    case 'J':
+      return is_immediate_operand(operand);
+    default:
+      return 0;
+  }
+}
+
+// Registers named inside a memory operand's brackets.
+static unsigned int get_address_registers(const char* operand) {
+  unsigned int mask = 0;
+  const char* cursor = strchr(operand, '[');
+  if (cursor == NULL) {
+    return 0;
+  }
+  char name[PEEPHOLE_OPERAND_LENGTH];
+  while (*cursor != '\0' && *cursor != ']') {
+    if (!isalpha((unsigned char)*cursor)) {
+      cursor++;
+      continue;
+    }
+    const char* start = cursor;
+    while (isalnum((unsigned char)*cursor)) {
+      cursor++;
+    }
+    copy_trimmed(name, sizeof(name), start, cursor);
+    int partial = 0;
+    int reg = get_register(name, &partial);
+    if (reg >= 0) {
+      mask |= 1U << (unsigned int)reg;
+    }
+  }
+  return mask;
+}
+
+// ───── Instruction Effects ─────
+
+static unsigned int register_bit(int reg) { return 1U << (unsigned int)reg; }
+
+static void add_operand_reads(const char* operand, unsigned int* reads) {
+  int partial = 0;
+  int reg = get_register(operand, &partial);
+  if (reg >= 0) {
+    *reads |= register_bit(reg);
+  }
+  *reads |= get_address_registers(operand);
+}
+
+// A register destination is written; a byte destination is also read,
+// since the rest of the register survives. Memory destinations read their
+// address registers.
+static void add_destination(const char* operand, unsigned int* reads,
+                            unsigned int* writes) {
+  int partial = 0;
+  int reg = get_register(operand, &partial);
+  if (reg >= 0) {
+    *writes |= register_bit(reg);
+    if (partial) {
+      *reads |= register_bit(reg);
+    }
+  }
+  *reads |= get_address_registers(operand);
+}
+
+static int is_one_of(const char* mnemonic, const char* const* names,
+                     size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (strcmp(mnemonic, names[i]) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static unsigned int get_call_reads(void) {
+  unsigned int reads = 0;
+  for (int i = 0; i < LIR_MAX_REGISTER_ARGUMENTS; i++) {
+    reads |= register_bit(get_lir_argument_register(i));
+  }
+  return reads | register_bit(LIR_RSP);
+}
+
+static unsigned int get_call_writes(void) {
+  unsigned int writes = flags_bit;
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    if (!is_lir_callee_saved(reg)) {
+      writes |= register_bit(reg);
+    }
+  }
+  return writes;
+}
+
+static unsigned int get_return_reads(void) {
+  unsigned int reads = register_bit(LIR_RAX);
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    if (is_lir_callee_saved(reg)) {
+      reads |= register_bit(reg);
+    }
+  }
+  return reads;
+}
+
+static effect_kind get_effects(const parsed_line* line, unsigned int* reads,
+                               unsigned int* writes) {
+  static const char* const copies[] = {"mov", "movzx", "movsx", "movsxd",
+                                       "lea"};
+  static const char* const updates[] = {"add", "sub", "and", "or", "xor",
+                                        "shl", "shr", "sar", "imul"};
+  static const char* const flag_readers[] = {"adc", "sbb"};
+  static const char* const unary_updates[] = {"neg", "not", "inc", "dec"};
+  static const char* const compares[] = {"cmp", "test"};
+  const char* mnemonic = line->mnemonic;
+  const char (*operands)[PEEPHOLE_OPERAND_LENGTH] = line->operands;
+  *reads = 0;
+  *writes = 0;
+  if (line->kind != LINE_INSTRUCTION) {
+    return EFFECT_BARRIER;
+  }
+
+  if (is_one_of(mnemonic, copies, 5) && line->operand_count == 2) {
+    add_destination(operands[0], reads, writes);
+    add_operand_reads(operands[1], reads);
+  } else if (strcmp(mnemonic, "imul") == 0 && line->operand_count == 3) {
+    add_destination(operands[0], reads, writes);
+    add_operand_reads(operands[1], reads);
+    *writes |= flags_bit;
+  } else if ((is_one_of(mnemonic, updates, 9) ||
+              is_one_of(mnemonic, flag_readers, 2)) &&
+             line->operand_count == 2) {
+    add_operand_reads(operands[0], reads);
+    add_destination(operands[0], reads, writes);
+    add_operand_reads(operands[1], reads);
+    *writes |= flags_bit;
+    if (is_one_of(mnemonic, flag_readers, 2)) {
+      *reads |= flags_bit;
+    }
+  } else if (is_one_of(mnemonic, unary_updates, 4) &&
+             line->operand_count == 1) {
+    add_operand_reads(operands[0], reads);
+    add_destination(operands[0], reads, writes);
+    *writes |= flags_bit;
+  } else if (is_one_of(mnemonic, compares, 2) && line->operand_count == 2) {
+    add_operand_reads(operands[0], reads);
+    add_operand_reads(operands[1], reads);
+    *writes |= flags_bit;
+  } else if (strcmp(mnemonic, "cdq") == 0) {
+    *reads |= register_bit(LIR_RAX);
+    *writes |= register_bit(LIR_RDX);
+  } else if ((strcmp(mnemonic, "idiv") == 0 || strcmp(mnemonic, "div") == 0 ||
+              strcmp(mnemonic, "imul") == 0 || strcmp(mnemonic, "mul") == 0) &&
+             line->operand_count == 1) {
+    add_operand_reads(operands[0], reads);
+    *reads |= register_bit(LIR_RAX) | register_bit(LIR_RDX);
+    *writes |= register_bit(LIR_RAX) | register_bit(LIR_RDX) | flags_bit;
+  } else if (strcmp(mnemonic, "push") == 0 && line->operand_count == 1) {
+    add_operand_reads(operands[0], reads);
+    *reads |= register_bit(LIR_RSP);
+  } else if (strcmp(mnemonic, "pop") == 0 && line->operand_count == 1) {
+    add_destination(operands[0], reads, writes);
+    *reads |= register_bit(LIR_RSP);
+  } else if (strcmp(mnemonic, "call") == 0) {
+    *reads |= get_call_reads();
+    *writes |= get_call_writes();
+  } else if (strcmp(mnemonic, "ret") == 0) {
+    *reads |= get_return_reads();
+    return EFFECT_RETURN;
+  } else if (strncmp(mnemonic, "set", 3) == 0 && line->operand_count == 1) {
+    add_destination(operands[0], reads, writes);
+    *reads |= flags_bit;
+  } else if (strncmp(mnemonic, "cmov", 4) == 0 && line->operand_count == 2) {
+    add_operand_reads(operands[0], reads);
+    add_destination(operands[0], reads, writes);
+    add_operand_reads(operands[1], reads);
+    *reads |= flags_bit;
+  } else {
+    return EFFECT_BARRIER;
+  }
+  return EFFECT_NORMAL;
+}
+
+// Scans forward from a position for the next read or full write of the
+// registers (and flags) in mask.
+static int is_dead_after(const parsed_line* lines, int count, int start,
+                         unsigned int mask) {
+  for (int i = start; i < count; i++) {
+    unsigned int reads = 0;
+    unsigned int writes = 0;
+    effect_kind kind = get_effects(&lines[i], &reads, &writes);
+    if (kind == EFFECT_BARRIER || (reads & mask) != 0) {
+      return 0;
+    }
+    if (kind == EFFECT_RETURN) {
+      return 1;
+    }
+    mask &= ~writes;
+    if (mask == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// ───── Matching ─────
+
+typedef struct binding {
+  const char* values[PEEPHOLE_VARIABLE_COUNT];
+} binding;
+
+static int bind_operand(binding* bound, const char* pattern,
+                        const char* operand) {
+  if (!is_variable(pattern)) {
+    return strcmp(pattern, operand) == 0;
+  }
+  int variable = pattern[0] - 'A';
+  if (bound->values[variable] != NULL) {
+    return strcmp(bound->values[variable], operand) == 0;
+  }
+  if (!matches_class(pattern[0], operand)) {
+    return 0;
+  }
+  int partial = 0;
+  int reg = get_register(operand, &partial);
+  for (int other = 0; other < PEEPHOLE_VARIABLE_COUNT; other++) {
+    const char* value = bound->values[other];
+    if (value == NULL) {
+      continue;
+    }
+    // Different variables must not name the same operand, including the
+    // same register under another width.
+    if (strcmp(value, operand) == 0 ||
+        (reg >= 0 && get_register(value, &partial) == reg)) {
+      return 0;
+    }
+  }
+  bound->values[variable] = operand;
+  return 1;
+}
+
+static int match_rule(const peephole_rule* rule, const parsed_line* lines,
+                      int count, int start, binding* bound) {
+  memset(bound, 0, sizeof(*bound));
+  if (start + rule->pattern_count > count) {
+    return 0;
+  }
+  for (int i = 0; i < rule->pattern_count; i++) {
+    const parsed_line* pattern = &rule->pattern[i];
+    const parsed_line* line = &lines[start + i];
+    if (line->kind != LINE_INSTRUCTION ||
+        strcmp(pattern->mnemonic, line->mnemonic) != 0 ||
+        pattern->operand_count != line->operand_count) {
+      return 0;
+    }
+    for (int j = 0; j < pattern->operand_count; j++) {
+      if (!bind_operand(bound, pattern->operands[j], line->operands[j])) {
+        return 0;
+      }
+    }
+  }
+
+  int after = start + rule->pattern_count;
+  if (rule->condition == CONDITION_DEAD_FLAGS) {
+    return is_dead_after(lines, count, after, flags_bit);
+  }
+  if (rule->condition == CONDITION_DEAD_REGISTER) {
+    int partial = 0;
+    int reg =
+        get_register(bound->values[rule->condition_variable], &partial);
+    return reg >= 0 && is_dead_after(lines, count, after, register_bit(reg));
+  }
+  return 1;
+}
+
+static char* format_replacement(const parsed_line* pattern,
+                                const binding* bound) {
+  const char* operands[PEEPHOLE_MAX_OPERANDS];
+  for (int i = 0; i < pattern->operand_count; i++) {
+    operands[i] = is_variable(pattern->operands[i])
+                      ? bound->values[pattern->operands[i][0] - 'A']
+                      : pattern->operands[i];
+  }
+  char* new_instruction = malloc(PEEPHOLE_LINE_LENGTH);
+  if (!new_instruction) {
+    error_and_exit("malloc failed");
+  }
+  if (pattern->operand_count == 2) {
+    (void)snprintf(new_instruction, PEEPHOLE_LINE_LENGTH, "        %-8s%s, %s",
+                   pattern->mnemonic, operands[0], operands[1]);
+  } else if (pattern->operand_count == 1) {
+    (void)snprintf(new_instruction, PEEPHOLE_LINE_LENGTH, "        %-8s%s",
+                   pattern->mnemonic, operands[0]);
+  } else {
+    (void)snprintf(new_instruction, PEEPHOLE_LINE_LENGTH, "        %s",
+                   pattern->mnemonic);
+  }
+  return new_instruction;
+}
+
+// Makes one pass over the list, returning the number of rewrites.
+static int run_peephole_pass(list_of_x86_instructions* list,
+                             const peephole_rule* rules) {
+  int count = list->instruction_count;
+  parsed_line* lines = (parsed_line*)malloc(sizeof(parsed_line) *
+                                            ((size_t)count + 1));
+  char** output = (char**)malloc(sizeof(char*) *
+                                 ((size_t)count * PEEPHOLE_MAX_RULE_LINES + 1));
+  if (!lines || !output) {
+    error_and_exit("malloc failed");
+  }
+  for (int i = 0; i < count; i++) {
+    parse_line(list->instructions[i], &lines[i]);
+  }
+
+  int rewrites = 0;
+  int output_count = 0;
+  int i = 0;
+  while (i < count) {
+    binding bound;
+    const peephole_rule* applied = NULL;
+    for (int r = 0; r < PEEPHOLE_RULE_COUNT && applied == NULL; r++) {
+      if (match_rule(&rules[r], lines, count, i, &bound)) {
+        applied = &rules[r];
+      }
+    }
+    if (applied == NULL) {
+      output[output_count++] = list->instructions[i];
+      i++;
+      continue;
+    }
+    for (int j = 0; j < applied->replacement_count; j++) {
+      output[output_count++] =
+          format_replacement(&applied->replacement[j], &bound);
+    }
+    i += applied->pattern_count;
+    rewrites++;
+  }
+
+  // Replaced lines may be string literals, so they are dropped rather than
+  // freed, like everywhere else the list is rebuilt.
+  free(list->instructions);
+  list->instructions = output;
+  list->instruction_count = output_count;
+  list->instruction_capacity = count * PEEPHOLE_MAX_RULE_LINES + 1;
+  free(lines);
+  return rewrites;
+}
+
+int optimize_peephole(list_of_x86_instructions* list) {
+  peephole_rule rules[PEEPHOLE_RULE_COUNT];
+  for (int r = 0; r < PEEPHOLE_RULE_COUNT; r++) {
+    compile_rule(peephole_rules[r], &rules[r]);
+  }
+  int total = 0;
+  int rewrites = 0;
+  do {
+    rewrites = run_peephole_pass(list, rules);
+    total += rewrites;
+  } while (rewrites > 0);
+  return total;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "codegen.h"
+
+/*
+Rewrites short instruction sequences in an emitted x86 listing.
+
+Slides a window over the instruction text and applies a table of rewrite
+rules written in a small pattern language (see peephole.c): dropping a
+reload of a value that was just stored, forwarding a copy into its only use
+when the copied register dies, folding immediates into the instruction that
+consumes them, removing self-moves, zeroing registers with xor and comparing
+with zero using test. Labels and directives end a window, and a register or
+the flags only count as dead if a forward scan finds them overwritten (or
+the function returning) before any read or branch. Rules are reapplied
+until nothing changes.
+
+Args:
+  list: Instruction list to optimize in place.
+
+Returns:
+  Number of rewrites applied.
+*/
+int optimize_peephole(list_of_x86_instructions* list);
@@ -0,0 +1,1341 @@
+/*
+ * Register Allocation
+ * Maps the virtual registers of a LIR function onto x86-64 registers.
+ */
+
+#include "regalloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lir.h"
+
+enum { MAX_INSTRUCTION_REGISTERS = 16 };
+
+// Registers handed out by the allocator, caller-saved first so short-lived
+// values do not cost a push and pop. r10 and r11 are kept free as scratch.
+static const int allocation_order[] = {
+    LIR_RAX, LIR_RCX, LIR_RDX, LIR_RSI, LIR_RDI, LIR_R8,
+    LIR_R9,  LIR_RBX, LIR_R12, LIR_R13, LIR_R14, LIR_R15};
+
+enum {
+  ALLOCATABLE_REGISTER_COUNT =
+      sizeof(allocation_order) / sizeof(allocation_order[0])
+};
+
+static const int scratch_register = LIR_R11;
+// Holds a spilled address index while the base is in scratch_register.
+static const int index_scratch_register = LIR_R10;
+
+// Positions where a physical register holds a value the code depends on.
+typedef struct fixed_range {
+  int start;
+  int end;
+} fixed_range;
+
+typedef struct fixed_ranges {
+  fixed_range* ranges;
+  int count;
+  int capacity;
+} fixed_ranges;
+
+static int use_position(int instruction) { return 2 * instruction; }
+
+static int def_position(int instruction) { return (2 * instruction) + 1; }
+
+// Returns an array with one entry per virtual register, all set to -1.
+static int* new_virtual_register_map(const lir_function* function) {
+  int virtual_count = function->next_register - LIR_FIRST_VIRTUAL_REGISTER;
+  int* register_map =
+      (int*)checked_malloc(sizeof(int) * (size_t)virtual_count);
+  for (int i = 0; i < virtual_count; i++) {
+    register_map[i] = -1;
+  }
+  return register_map;
+}
+
+// ───── Control Flow ─────
+
+// A straight-line run of instructions: a label starts one, and a jump or
+// ret ends one.
+typedef struct lir_block {
+  int start;  // First instruction.
+  int end;    // One past the last instruction.
+  int successors[2];
+  int successor_count;
+} lir_block;
+
+// Virtual registers live on entry to and exit from each block, as bitsets
+// of `words` words per block indexed by virtual register number.
+typedef struct control_flow {
+  lir_block* blocks;
+  int block_count;
+  int words;
+  unsigned int* live_in;
+  unsigned int* live_out;
+} control_flow;
+
+enum { BITS_PER_WORD = 32 };
+
+// Checks whether control leaves the function here.
+static int exits_function(lir_opcode opcode) {
+  return opcode == LIR_RET || opcode == LIR_TAIL_CALL;
+}
+
+static int ends_block(lir_opcode opcode) {
+  return opcode == LIR_JMP || opcode == LIR_JCC || exits_function(opcode);
+}
+
+static int starts_block(const lir_function* function, int instruction) {
+  return instruction == 0 ||
+         function->instructions[instruction].opcode == LIR_LABEL ||
+         ends_block(function->instructions[instruction - 1].opcode);
+}
+
+static int test_bit(const unsigned int* bits, int index) {
+  return (bits[index / BITS_PER_WORD] >> (index % BITS_PER_WORD)) & 1U;
+}
+
+static void set_bit(unsigned int* bits, int index) {
+  bits[index / BITS_PER_WORD] |= 1U << (index % BITS_PER_WORD);
+}
+
+static void split_blocks(const lir_function* function, control_flow* flow) {
+  flow->block_count = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    flow->block_count += starts_block(function, i);
+  }
+  flow->blocks = (lir_block*)checked_malloc(sizeof(lir_block) *
+                                            (size_t)flow->block_count);
+  int* label_block =
+      (int*)checked_malloc(sizeof(int) * (size_t)function->next_label);
+  int block = -1;
+  for (int i = 0; i < function->instruction_count; i++) {
+    if (starts_block(function, i)) {
+      flow->blocks[++block].start = i;
+    }
+    flow->blocks[block].end = i + 1;
+    if (function->instructions[i].opcode == LIR_LABEL) {
+      label_block[function->instructions[i].operands[0].value] = block;
+    }
+  }
+  for (int b = 0; b < flow->block_count; b++) {
+    lir_block* current = &flow->blocks[b];
+    const lir_instruction* last = &function->instructions[current->end - 1];
+    current->successor_count = 0;
+    if (last->opcode == LIR_JMP || last->opcode == LIR_JCC) {
+      current->successors[current->successor_count++] =
+          label_block[last->operands[0].value];
+    }
+    if (last->opcode != LIR_JMP && !exits_function(last->opcode) &&
+        b + 1 < flow->block_count) {
+      current->successors[current->successor_count++] = b + 1;
+    }
+  }
+  free(label_block);
+}
+
+// Solves the backward liveness equations over the blocks:
+// in = uses before any def | (out - defs), out = union of successor ins.
+static void compute_block_liveness(const lir_function* function,
+                                   control_flow* flow) {
+  int virtual_count = function->next_register - LIR_FIRST_VIRTUAL_REGISTER;
+  flow->words = (virtual_count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+  size_t size = sizeof(unsigned int) * (size_t)flow->words *
+                (size_t)flow->block_count;
+  flow->live_in = (unsigned int*)checked_malloc(size);
+  flow->live_out = (unsigned int*)checked_malloc(size);
+  unsigned int* gen = (unsigned int*)checked_malloc(size);
+  unsigned int* kill = (unsigned int*)checked_malloc(size);
+  memset(flow->live_in, 0, size);
+  memset(flow->live_out, 0, size);
+  memset(gen, 0, size);
+  memset(kill, 0, size);
+
+  int uses[MAX_INSTRUCTION_REGISTERS];
+  int defs[MAX_INSTRUCTION_REGISTERS];
+  int use_count = 0;
+  int def_count = 0;
+  for (int b = 0; b < flow->block_count; b++) {
+    unsigned int* block_gen = &gen[(size_t)b * (size_t)flow->words];
+    unsigned int* block_kill = &kill[(size_t)b * (size_t)flow->words];
+    for (int i = flow->blocks[b].start; i < flow->blocks[b].end; i++) {
+      get_lir_uses_and_defs(&function->instructions[i], uses, &use_count,
+                            defs, &def_count);
+      for (int j = 0; j < use_count; j++) {
+        int index = uses[j] - LIR_FIRST_VIRTUAL_REGISTER;
+        if (index >= 0 && !test_bit(block_kill, index)) {
+          set_bit(block_gen, index);
+        }
+      }
+      for (int j = 0; j < def_count; j++) {
+        int index = defs[j] - LIR_FIRST_VIRTUAL_REGISTER;
+        if (index >= 0) {
+          set_bit(block_kill, index);
+        }
+      }
+    }
+  }
+
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int b = flow->block_count - 1; b >= 0; b--) {
+      size_t offset = (size_t)b * (size_t)flow->words;
+      const lir_block* block = &flow->blocks[b];
+      for (int w = 0; w < flow->words; w++) {
+        unsigned int out = 0;
+        for (int j = 0; j < block->successor_count; j++) {
+          out |= flow->live_in[((size_t)block->successors[j] *
+                                (size_t)flow->words) +
+                               (size_t)w];
+        }
+        unsigned int in = gen[offset + (size_t)w] |
+                          (out & ~kill[offset + (size_t)w]);
+        if (out != flow->live_out[offset + (size_t)w] ||
+            in != flow->live_in[offset + (size_t)w]) {
+          flow->live_out[offset + (size_t)w] = out;
+          flow->live_in[offset + (size_t)w] = in;
+          changed = 1;
+        }
+      }
+    }
+  }
+  free(gen);
+  free(kill);
+}
+
+static void build_control_flow(const lir_function* function,
+                               control_flow* flow) {
+  split_blocks(function, flow);
+  compute_block_liveness(function, flow);
+}
+
+static void free_control_flow(control_flow* flow) {
+  free(flow->blocks);
+  free(flow->live_in);
+  free(flow->live_out);
+}
+
+// ───── Live Intervals ─────
+
+static void extend_interval(live_interval* intervals, int* interval_count,
+                            int* interval_of, int reg, int position) {
+  if (!is_lir_virtual_register(reg)) {
+    return;
+  }
+  int* index = &interval_of[reg - LIR_FIRST_VIRTUAL_REGISTER];
+  if (*index < 0) {
+    *index = (*interval_count)++;
+    live_interval* interval = &intervals[*index];
+    interval->reg = reg;
+    interval->start = position;
+    interval->end = position;
+    interval->hint = -1;
+    interval->hint_interval = -1;
+    interval->assigned = -1;
+    interval->spill_slot = -1;
+  }
+  live_interval* interval = &intervals[*index];
+  if (position < interval->start) {
+    interval->start = position;
+  }
+  if (position > interval->end) {
+    interval->end = position;
+  }
+}
+
+static void add_move_hints(const lir_function* function,
+                           live_interval* intervals, const int* interval_of) {
+  for (int i = 0; i < function->instruction_count; i++) {
+    const lir_instruction* instruction = &function->instructions[i];
+    if (instruction->opcode != LIR_MOV ||
+        instruction->operands[0].kind != LIR_OPERAND_REGISTER ||
+        instruction->operands[1].kind != LIR_OPERAND_REGISTER) {
+      continue;
+    }
+    int destination = instruction->operands[0].reg;
+    int source = instruction->operands[1].reg;
+    int destination_interval =
+        is_lir_virtual_register(destination)
+            ? interval_of[destination - LIR_FIRST_VIRTUAL_REGISTER]
+            : -1;
+    int source_interval =
+        is_lir_virtual_register(source)
+            ? interval_of[source - LIR_FIRST_VIRTUAL_REGISTER]
+            : -1;
+    if (destination_interval >= 0) {
+      live_interval* interval = &intervals[destination_interval];
+      if (source_interval >= 0 && interval->hint_interval < 0) {
+        interval->hint_interval = source_interval;
+      } else if (source_interval < 0 && interval->hint < 0) {
+        interval->hint = source;
+      }
+    }
+    if (source_interval >= 0 && destination_interval < 0 &&
+        intervals[source_interval].hint < 0) {
+      intervals[source_interval].hint = destination;
+    }
+  }
+}
+
+static int compare_interval_starts(const void* first, const void* second) {
+  const live_interval* a = (const live_interval*)first;
+  const live_interval* b = (const live_interval*)second;
+  if (a->start != b->start) {
+    return a->start < b->start ? -1 : 1;
+  }
+  return (a->reg > b->reg) - (a->reg < b->reg);
+}
+
+live_interval* compute_live_intervals(const lir_function* function,
+                                      int* interval_count) {
+  int virtual_count = function->next_register - LIR_FIRST_VIRTUAL_REGISTER;
+  live_interval* intervals = (live_interval*)checked_malloc(
+      sizeof(live_interval) * (size_t)virtual_count);
+  int* interval_of = new_virtual_register_map(function);
+  *interval_count = 0;
+
+  int uses[MAX_INSTRUCTION_REGISTERS];
+  int defs[MAX_INSTRUCTION_REGISTERS];
+  int use_count = 0;
+  int def_count = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    get_lir_uses_and_defs(&function->instructions[i], uses, &use_count, defs,
+                          &def_count);
+    for (int j = 0; j < use_count; j++) {
+      extend_interval(intervals, interval_count, interval_of, uses[j],
+                      use_position(i));
+    }
+    for (int j = 0; j < def_count; j++) {
+      extend_interval(intervals, interval_count, interval_of, defs[j],
+                      def_position(i));
+    }
+  }
+
+  // A register live into or out of a block covers the whole edge, which is
+  // what keeps loop-carried values alive around the back edge.
+  control_flow flow;
+  build_control_flow(function, &flow);
+  for (int b = 0; b < flow.block_count; b++) {
+    size_t offset = (size_t)b * (size_t)flow.words;
+    for (int index = 0; index < virtual_count; index++) {
+      int reg = index + LIR_FIRST_VIRTUAL_REGISTER;
+      if (test_bit(&flow.live_in[offset], index)) {
+        extend_interval(intervals, interval_count, interval_of, reg,
+                        use_position(flow.blocks[b].start));
+      }
+      if (test_bit(&flow.live_out[offset], index)) {
+        extend_interval(intervals, interval_count, interval_of, reg,
+                        def_position(flow.blocks[b].end - 1));
+      }
+    }
+  }
+  free_control_flow(&flow);
+
+  qsort(intervals, (size_t)*interval_count, sizeof(live_interval),
+        compare_interval_starts);
+  for (int i = 0; i < *interval_count; i++) {
+    interval_of[intervals[i].reg - LIR_FIRST_VIRTUAL_REGISTER] = i;
+  }
+  add_move_hints(function, intervals, interval_of);
+  free(interval_of);
+  return intervals;
+}
+
+// ───── Fixed Registers ─────
+
+static void add_fixed_range(fixed_ranges* ranges, int start, int end) {
+  if (ranges->count == ranges->capacity) {
+    ranges->capacity = ranges->capacity == 0 ? 4 : ranges->capacity * 2;
+    fixed_range* new_ranges = (fixed_range*)realloc(
+        ranges->ranges, sizeof(fixed_range) * (size_t)ranges->capacity);
+    if (new_ranges == NULL) {
+      error_and_exit("realloc failed");
+    }
+    ranges->ranges = new_ranges;
+  }
+  ranges->ranges[ranges->count].start = start;
+  ranges->ranges[ranges->count].end = end;
+  ranges->count++;
+}
+
+// Walks the function backwards, recording where each physical register
+// carries a value from a write (or function entry) to its last read. A write
+// that is never read, like a call clobber, still occupies its position.
+static void compute_fixed_ranges(const lir_function* function,
+                                 fixed_ranges* ranges) {
+  int live_until[LIR_PHYSICAL_REGISTER_COUNT];
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    live_until[reg] = -1;
+  }
+  int uses[MAX_INSTRUCTION_REGISTERS];
+  int defs[MAX_INSTRUCTION_REGISTERS];
+  int use_count = 0;
+  int def_count = 0;
+  for (int i = function->instruction_count - 1; i >= 0; i--) {
+    get_lir_uses_and_defs(&function->instructions[i], uses, &use_count, defs,
+                          &def_count);
+    for (int j = 0; j < def_count; j++) {
+      int reg = defs[j];
+      if (is_lir_virtual_register(reg)) {
+        continue;
+      }
+      int end = live_until[reg] >= 0 ? live_until[reg] : def_position(i);
+      add_fixed_range(&ranges[reg], def_position(i), end);
+      live_until[reg] = -1;
+    }
+    for (int j = 0; j < use_count; j++) {
+      int reg = uses[j];
+      if (!is_lir_virtual_register(reg) && live_until[reg] < 0) {
+        live_until[reg] = use_position(i);
+      }
+    }
+  }
+  // Registers read before any write hold incoming arguments.
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    if (live_until[reg] >= 0) {
+      add_fixed_range(&ranges[reg], 0, live_until[reg]);
+    }
+  }
+}
+
+static int overlaps_fixed_range(const fixed_ranges* ranges,
+                                const live_interval* interval) {
+  for (int i = 0; i < ranges->count; i++) {
+    if (ranges->ranges[i].start <= interval->end &&
+        ranges->ranges[i].end >= interval->start) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// ───── Linear Scan ─────
+
+static int is_register_available(int reg, const int* owner,
+                                 const fixed_ranges* ranges,
+                                 const live_interval* interval) {
+  return reg >= 0 && reg != scratch_register && owner[reg] < 0 &&
+         !overlaps_fixed_range(&ranges[reg], interval);
+}
+
+static int choose_register(const live_interval* intervals,
+                           const live_interval* interval, const int* owner,
+                           const fixed_ranges* ranges) {
+  if (interval->hint >= 0 &&
+      is_register_available(interval->hint, owner, ranges, interval)) {
+    return interval->hint;
+  }
+  if (interval->hint_interval >= 0) {
+    int partner = intervals[interval->hint_interval].assigned;
+    if (is_register_available(partner, owner, ranges, interval)) {
+      return partner;
+    }
+  }
+  for (int i = 0; i < ALLOCATABLE_REGISTER_COUNT; i++) {
+    if (is_register_available(allocation_order[i], owner, ranges, interval)) {
+      return allocation_order[i];
+    }
+  }
+  return -1;
+}
+
+static void run_linear_scan(lir_function* function, live_interval* intervals,
+                            int interval_count, const fixed_ranges* ranges) {
+  int owner[LIR_PHYSICAL_REGISTER_COUNT];
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    owner[reg] = -1;
+  }
+  int active[LIR_PHYSICAL_REGISTER_COUNT];
+  int active_count = 0;
+
+  for (int i = 0; i < interval_count; i++) {
+    live_interval* current = &intervals[i];
+
+    // Release registers whose intervals ended before this one starts.
+    int kept = 0;
+    for (int j = 0; j < active_count; j++) {
+      live_interval* other = &intervals[active[j]];
+      if (other->end < current->start) {
+        owner[other->assigned] = -1;
+      } else {
+        active[kept++] = active[j];
+      }
+    }
+    active_count = kept;
+
+    int reg = choose_register(intervals, current, owner, ranges);
+    if (reg >= 0) {
+      current->assigned = reg;
+      owner[reg] = i;
+      active[active_count++] = i;
+      continue;
+    }
+
+    // Nothing is free: spill whichever interval ends furthest away.
+    int victim = -1;
+    for (int j = 0; j < active_count; j++) {
+      live_interval* other = &intervals[active[j]];
+      if (overlaps_fixed_range(&ranges[other->assigned], current)) {
+        continue;
+      }
+      if (victim < 0 || other->end > intervals[active[victim]].end) {
+        victim = j;
+      }
+    }
+    if (victim >= 0 && intervals[active[victim]].end > current->end) {
+      live_interval* spilled = &intervals[active[victim]];
+      current->assigned = spilled->assigned;
+      owner[current->assigned] = i;
+      spilled->assigned = -1;
+      spilled->spill_slot = function->spill_slot_count++;
+      active[victim] = i;
+    } else {
+      current->spill_slot = function->spill_slot_count++;
+    }
+  }
+}
+
+// ───── Rewriting ─────
+
+static int count_saved_registers(unsigned int callee_saved_used) {
+  int count = 0;
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    if (callee_saved_used & (1U << (unsigned int)reg)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Replaces a virtual register with its physical register or spill slot.
+// Both arrays are indexed by virtual register number.
+static void rewrite_operand(lir_operand* operand, const int* assigned,
+                            const int* spill_slot, int saved_bytes) {
+  if (operand->kind != LIR_OPERAND_REGISTER ||
+      !is_lir_virtual_register(operand->reg)) {
+    return;
+  }
+  int index = operand->reg - LIR_FIRST_VIRTUAL_REGISTER;
+  if (assigned[index] >= 0) {
+    operand->reg = assigned[index];
+  } else {
+    // Spill slots sit below the callee-saved registers pushed after rbp.
+    *operand =
+        lir_memory(LIR_RBP, -saved_bytes - (4 * (spill_slot[index] + 1)));
+  }
+}
+
+// Replaces a virtual register inside an address. A spilled one is reloaded
+// into the given scratch register first.
+static void rewrite_address_register(lir_function* function, int* reg,
+                                     int scratch, const int* assigned,
+                                     const int* spill_slot, int saved_bytes) {
+  if (!is_lir_virtual_register(*reg)) {
+    return;
+  }
+  lir_operand value = lir_register(*reg);
+  rewrite_operand(&value, assigned, spill_slot, saved_bytes);
+  if (value.kind == LIR_OPERAND_MEMORY) {
+    add_lir_instruction(function, LIR_MOV, lir_register(scratch), value);
+    *reg = scratch;
+  } else {
+    *reg = value.reg;
+  }
+}
+
+static void rewrite_address(lir_function* function, lir_operand* operand,
+                            const int* assigned, const int* spill_slot,
+                            int saved_bytes) {
+  if (operand->kind != LIR_OPERAND_MEMORY) {
+    return;
+  }
+  int same_register = operand->index == operand->reg;
+  rewrite_address_register(function, &operand->reg, scratch_register,
+                           assigned, spill_slot, saved_bytes);
+  if (same_register) {
+    operand->index = operand->reg;
+  } else if (operand->index >= 0) {
+    rewrite_address_register(function, &operand->index,
+                             index_scratch_register, assigned, spill_slot,
+                             saved_bytes);
+  }
+}
+
+static int is_memory(const lir_operand* operand) {
+  return operand->kind == LIR_OPERAND_MEMORY;
+}
+
+static void add_legalized_instruction(lir_function* function,
+                                      lir_instruction instruction) {
+  lir_operand* destination = &instruction.operands[0];
+  lir_operand* source = &instruction.operands[1];
+  lir_operand scratch = lir_register(scratch_register);
+  switch (instruction.opcode) {
+    case LIR_MOV:
+    case LIR_ADD:
+    case LIR_SUB:
+      if (is_memory(destination) && is_memory(source)) {
+        add_lir_instruction(function, LIR_MOV, scratch, *source);
+        add_lir_instruction(function, instruction.opcode, *destination,
+                            scratch);
+        return;
+      }
+      break;
+    case LIR_IMUL:
+      // imul can only write a register.
+      if (is_memory(destination)) {
+        add_lir_instruction(function, LIR_MOV, scratch, *destination);
+        add_lir_instruction(function, LIR_IMUL, scratch, *source);
+        add_lir_instruction(function, LIR_MOV, *destination, scratch);
+        return;
+      }
+      break;
+    case LIR_LEA:
+      if (is_memory(destination)) {
+        add_lir_instruction(function, LIR_LEA, scratch, *source);
+        add_lir_instruction(function, LIR_MOV, *destination, scratch);
+        return;
+      }
+      break;
+    case LIR_CMP:
+      if (is_memory(destination) && is_memory(source)) {
+        add_lir_instruction(function, LIR_MOV, scratch, *source);
+        add_lir_instruction(function, LIR_CMP, *destination, scratch);
+        return;
+      }
+      break;
+    case LIR_CMOV:
+      // cmov can only write a register. The moves leave the flags alone.
+      if (is_memory(destination)) {
+        add_lir_instruction(function, LIR_MOV, scratch, *destination);
+        add_lir_instruction(function, LIR_CMOV, scratch, *source)->condition =
+            instruction.condition;
+        add_lir_instruction(function, LIR_MOV, *destination, scratch);
+        return;
+      }
+      break;
+    case LIR_SETCC:
+      // setcc is widened with movzx, which needs a register.
+      if (is_memory(destination)) {
+        add_lir_instruction(function, LIR_SETCC, scratch, lir_none())
+            ->condition = instruction.condition;
+        add_lir_instruction(function, LIR_MOV, *destination, scratch);
+        return;
+      }
+      break;
+    default:
+      break;
+  }
+  add_lir_instruction(function, instruction.opcode, *destination, *source)
+      ->condition = instruction.condition;
+}
+
+static void rewrite_function(lir_function* function, const int* assigned,
+                             const int* spill_slot) {
+  int virtual_count = function->next_register - LIR_FIRST_VIRTUAL_REGISTER;
+  for (int i = 0; i < virtual_count; i++) {
+    if (assigned[i] >= 0 && is_lir_callee_saved(assigned[i])) {
+      function->callee_saved_used |= 1U << (unsigned int)assigned[i];
+    }
+  }
+  int saved_bytes = 8 * count_saved_registers(function->callee_saved_used);
+
+  lir_instruction* old_instructions = function->instructions;
+  int old_count = function->instruction_count;
+  function->instruction_count = 0;
+  function->instruction_capacity = old_count + 1;
+  function->instructions = (lir_instruction*)checked_malloc(
+      sizeof(lir_instruction) * (size_t)function->instruction_capacity);
+
+  for (int i = 0; i < old_count; i++) {
+    lir_instruction instruction = old_instructions[i];
+    for (int j = 0; j < 2; j++) {
+      rewrite_address(function, &instruction.operands[j], assigned,
+                      spill_slot, saved_bytes);
+      rewrite_operand(&instruction.operands[j], assigned, spill_slot,
+                      saved_bytes);
+    }
+    add_legalized_instruction(function, instruction);
+  }
+  free(old_instructions);
+}
+
+void allocate_registers_linear_scan(lir_function* function) {
+  int interval_count = 0;
+  live_interval* intervals = compute_live_intervals(function, &interval_count);
+
+  fixed_ranges ranges[LIR_PHYSICAL_REGISTER_COUNT];
+  memset(ranges, 0, sizeof(ranges));
+  compute_fixed_ranges(function, ranges);
+
+  run_linear_scan(function, intervals, interval_count, ranges);
+
+  int* assigned = new_virtual_register_map(function);
+  int* spill_slot = new_virtual_register_map(function);
+  for (int i = 0; i < interval_count; i++) {
+    int index = intervals[i].reg - LIR_FIRST_VIRTUAL_REGISTER;
+    assigned[index] = intervals[i].assigned;
+    spill_slot[index] = intervals[i].spill_slot;
+  }
+  rewrite_function(function, assigned, spill_slot);
+
+  for (int reg = 0; reg < LIR_PHYSICAL_REGISTER_COUNT; reg++) {
+    free(ranges[reg].ranges);
+  }
+  free(assigned);
+  free(spill_slot);
+  free(intervals);
+}
+
+// ───── Graph Coloring ─────
+
+// Iterated register coalescing (George and Appel). Nodes are register
+// numbers: the allocatable physical registers are precolored, every virtual
+// register is a node to color.
+
+typedef enum {
+  NODE_UNTRACKED,  // rsp, rbp and the scratch registers.
+  NODE_PRECOLORED,
+  NODE_INITIAL,
+  NODE_SIMPLIFY,
+  NODE_FREEZE,
+  NODE_SPILL,
+  NODE_SPILLED,
+  NODE_COALESCED,
+  NODE_COLORED,
+  NODE_SELECTED,
+} node_state;
+
+typedef enum {
+  MOVE_WORKLIST,
+  MOVE_ACTIVE,
+  MOVE_COALESCED,
+  MOVE_CONSTRAINED,
+  MOVE_FROZEN,
+} move_state;
+
+typedef struct int_list {
+  int* items;
+  int count;
+  int capacity;
+} int_list;
+
+typedef struct coloring_move {
+  int destination;
+  int source;
+  move_state state;
+} coloring_move;
+
+typedef struct coloring_graph {
+  int node_count;
+  unsigned char* adjacency_matrix;  // One bit per ordered node pair.
+  int_list* adjacency;              // Neighbors of uncolored nodes.
+  int* degree;
+  int* alias;
+  int* color;
+  int* spill_cost;  // Number of uses and defs.
+  node_state* state;
+  int_list* move_list;  // Moves each node takes part in.
+  coloring_move* moves;
+  int move_count;
+  int move_capacity;
+  // Worklists hold candidates; entries whose state changed since they were
+  // pushed are skipped when popped.
+  int_list simplify_worklist;
+  int_list freeze_worklist;
+  int_list move_worklist;
+  int_list select_stack;
+} coloring_graph;
+
+enum { PRECOLORED_DEGREE = 1 << 30 };
+
+static void push_int(int_list* list, int value) {
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+    int* new_items =
+        (int*)realloc(list->items, sizeof(int) * (size_t)list->capacity);
+    if (new_items == NULL) {
+      error_and_exit("realloc failed");
+    }
+    list->items = new_items;
+  }
+  list->items[list->count++] = value;
+}
+
+static int is_allocatable(int reg) {
+  for (int i = 0; i < ALLOCATABLE_REGISTER_COUNT; i++) {
+    if (allocation_order[i] == reg) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int is_tracked(const coloring_graph* graph, int node) {
+  return graph->state[node] != NODE_UNTRACKED;
+}
+
+static int is_precolored(const coloring_graph* graph, int node) {
+  return graph->state[node] == NODE_PRECOLORED;
+}
+
+static int is_adjacent(const coloring_graph* graph, int first, int second) {
+  size_t bit = ((size_t)first * (size_t)graph->node_count) + (size_t)second;
+  return (graph->adjacency_matrix[bit / 8] >> (bit % 8)) & 1U;
+}
+
+static void set_adjacent(coloring_graph* graph, int first, int second) {
+  size_t bit = ((size_t)first * (size_t)graph->node_count) + (size_t)second;
+  graph->adjacency_matrix[bit / 8] |= (unsigned char)(1U << (bit % 8));
+}
+
+static void add_edge(coloring_graph* graph, int first, int second) {
+  if (first == second || is_adjacent(graph, first, second)) {
+    return;
+  }
+  set_adjacent(graph, first, second);
+  set_adjacent(graph, second, first);
+  if (!is_precolored(graph, first)) {
+    push_int(&graph->adjacency[first], second);
+    graph->degree[first]++;
+  }
+  if (!is_precolored(graph, second)) {
+    push_int(&graph->adjacency[second], first);
+    graph->degree[second]++;
+  }
+}
+
+// Virtual registers that already have a spill slot are left out of the
+// graph; their operands become memory.
+static void init_coloring_graph(coloring_graph* graph,
+                                const lir_function* function,
+                                const int* spill_slot) {
+  memset(graph, 0, sizeof(*graph));
+  int count = function->next_register;
+  graph->node_count = count;
+  size_t matrix_bytes = (((size_t)count * (size_t)count) + 7) / 8;
+  graph->adjacency_matrix = (unsigned char*)checked_malloc(matrix_bytes);
+  memset(graph->adjacency_matrix, 0, matrix_bytes);
+  graph->adjacency =
+      (int_list*)checked_malloc(sizeof(int_list) * (size_t)count);
+  graph->move_list =
+      (int_list*)checked_malloc(sizeof(int_list) * (size_t)count);
+  memset(graph->adjacency, 0, sizeof(int_list) * (size_t)count);
+  memset(graph->move_list, 0, sizeof(int_list) * (size_t)count);
+  graph->degree = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  graph->alias = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  graph->color = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  graph->spill_cost = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  graph->state =
+      (node_state*)checked_malloc(sizeof(node_state) * (size_t)count);
+  for (int node = 0; node < count; node++) {
+    graph->alias[node] = node;
+    graph->spill_cost[node] = 0;
+    if (is_lir_virtual_register(node)) {
+      graph->state[node] =
+          spill_slot[node - LIR_FIRST_VIRTUAL_REGISTER] >= 0 ? NODE_UNTRACKED
+                                                              : NODE_INITIAL;
+      graph->degree[node] = 0;
+      graph->color[node] = -1;
+    } else {
+      graph->state[node] =
+          is_allocatable(node) ? NODE_PRECOLORED : NODE_UNTRACKED;
+      graph->degree[node] = PRECOLORED_DEGREE;
+      graph->color[node] = node;
+    }
+  }
+}
+
+static void free_coloring_graph(coloring_graph* graph) {
+  for (int node = 0; node < graph->node_count; node++) {
+    free(graph->adjacency[node].items);
+    free(graph->move_list[node].items);
+  }
+  free(graph->adjacency_matrix);
+  free(graph->adjacency);
+  free(graph->move_list);
+  free(graph->degree);
+  free(graph->alias);
+  free(graph->color);
+  free(graph->spill_cost);
+  free(graph->state);
+  free(graph->moves);
+  free(graph->simplify_worklist.items);
+  free(graph->freeze_worklist.items);
+  free(graph->move_worklist.items);
+  free(graph->select_stack.items);
+}
+
+static void add_coloring_move(coloring_graph* graph, int destination,
+                              int source) {
+  if (graph->move_count == graph->move_capacity) {
+    graph->move_capacity =
+        graph->move_capacity == 0 ? 8 : graph->move_capacity * 2;
+    coloring_move* new_moves = (coloring_move*)realloc(
+        graph->moves, sizeof(coloring_move) * (size_t)graph->move_capacity);
+    if (new_moves == NULL) {
+      error_and_exit("realloc failed");
+    }
+    graph->moves = new_moves;
+  }
+  int move = graph->move_count++;
+  graph->moves[move].destination = destination;
+  graph->moves[move].source = source;
+  graph->moves[move].state = MOVE_WORKLIST;
+  push_int(&graph->move_list[destination], move);
+  push_int(&graph->move_list[source], move);
+  push_int(&graph->move_worklist, move);
+}
+
+static int is_coalescable_move(const coloring_graph* graph,
+                               const lir_instruction* instruction) {
+  return instruction->opcode == LIR_MOV &&
+         instruction->operands[0].kind == LIR_OPERAND_REGISTER &&
+         instruction->operands[1].kind == LIR_OPERAND_REGISTER &&
+         is_tracked(graph, instruction->operands[0].reg) &&
+         is_tracked(graph, instruction->operands[1].reg);
+}
+
+static void add_block_interference(coloring_graph* graph,
+                                   const lir_function* function,
+                                   const control_flow* flow, int block,
+                                   unsigned char* live) {
+  memset(live, 0, (size_t)graph->node_count);
+  const unsigned int* live_out =
+      &flow->live_out[(size_t)block * (size_t)flow->words];
+  for (int node = LIR_FIRST_VIRTUAL_REGISTER; node < graph->node_count;
+       node++) {
+    if (is_tracked(graph, node) &&
+        test_bit(live_out, node - LIR_FIRST_VIRTUAL_REGISTER)) {
+      live[node] = 1;
+    }
+  }
+  int uses[MAX_INSTRUCTION_REGISTERS];
+  int defs[MAX_INSTRUCTION_REGISTERS];
+  int use_count = 0;
+  int def_count = 0;
+  for (int i = flow->blocks[block].end - 1; i >= flow->blocks[block].start;
+       i--) {
+    const lir_instruction* instruction = &function->instructions[i];
+    get_lir_uses_and_defs(instruction, uses, &use_count, defs, &def_count);
+    if (is_coalescable_move(graph, instruction)) {
+      live[instruction->operands[1].reg] = 0;
+      add_coloring_move(graph, instruction->operands[0].reg,
+                        instruction->operands[1].reg);
+    }
+    for (int j = 0; j < def_count; j++) {
+      if (is_tracked(graph, defs[j])) {
+        live[defs[j]] = 1;
+        graph->spill_cost[defs[j]]++;
+      }
+    }
+    for (int j = 0; j < def_count; j++) {
+      if (!is_tracked(graph, defs[j])) {
+        continue;
+      }
+      for (int node = 0; node < graph->node_count; node++) {
+        if (live[node]) {
+          add_edge(graph, node, defs[j]);
+        }
+      }
+    }
+    for (int j = 0; j < def_count; j++) {
+      live[defs[j]] = 0;
+    }
+    for (int j = 0; j < use_count; j++) {
+      if (is_tracked(graph, uses[j])) {
+        live[uses[j]] = 1;
+        graph->spill_cost[uses[j]]++;
+      }
+    }
+  }
+}
+
+// Builds the interference graph and the move worklist with a backward walk
+// over each block, starting from the registers live out of it. The
+// destination of a move does not interfere with its source, which is what
+// lets the two be coalesced.
+static void build_interference_graph(coloring_graph* graph,
+                                     const lir_function* function) {
+  control_flow flow;
+  build_control_flow(function, &flow);
+  unsigned char* live =
+      (unsigned char*)checked_malloc((size_t)graph->node_count);
+  for (int b = 0; b < flow.block_count; b++) {
+    add_block_interference(graph, function, &flow, b, live);
+  }
+  free(live);
+  free_control_flow(&flow);
+}
+
+static int is_move_enabled(const coloring_graph* graph, int move) {
+  return graph->moves[move].state == MOVE_ACTIVE ||
+         graph->moves[move].state == MOVE_WORKLIST;
+}
+
+static int is_move_related(const coloring_graph* graph, int node) {
+  const int_list* moves = &graph->move_list[node];
+  for (int i = 0; i < moves->count; i++) {
+    if (is_move_enabled(graph, moves->items[i])) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Neighbors still in the graph: not simplified away or merged into another.
+static int is_present(const coloring_graph* graph, int node) {
+  return graph->state[node] != NODE_SELECTED &&
+         graph->state[node] != NODE_COALESCED;
+}
+
+static void make_worklists(coloring_graph* graph) {
+  for (int node = LIR_FIRST_VIRTUAL_REGISTER; node < graph->node_count;
+       node++) {
+    if (!is_tracked(graph, node)) {
+      continue;
+    }
+    if (graph->degree[node] >= ALLOCATABLE_REGISTER_COUNT) {
+      graph->state[node] = NODE_SPILL;
+    } else if (is_move_related(graph, node)) {
+      graph->state[node] = NODE_FREEZE;
+      push_int(&graph->freeze_worklist, node);
+    } else {
+      graph->state[node] = NODE_SIMPLIFY;
+      push_int(&graph->simplify_worklist, node);
+    }
+  }
+}
+
+static void enable_moves(coloring_graph* graph, int node) {
+  const int_list* moves = &graph->move_list[node];
+  for (int i = 0; i < moves->count; i++) {
+    int move = moves->items[i];
+    if (graph->moves[move].state == MOVE_ACTIVE) {
+      graph->moves[move].state = MOVE_WORKLIST;
+      push_int(&graph->move_worklist, move);
+    }
+  }
+}
+
+static void decrement_degree(coloring_graph* graph, int node) {
+  if (is_precolored(graph, node)) {
+    return;
+  }
+  int degree = graph->degree[node]--;
+  if (degree != ALLOCATABLE_REGISTER_COUNT ||
+      graph->state[node] != NODE_SPILL) {
+    return;
+  }
+  enable_moves(graph, node);
+  const int_list* neighbors = &graph->adjacency[node];
+  for (int i = 0; i < neighbors->count; i++) {
+    if (is_present(graph, neighbors->items[i])) {
+      enable_moves(graph, neighbors->items[i]);
+    }
+  }
+  if (is_move_related(graph, node)) {
+    graph->state[node] = NODE_FREEZE;
+    push_int(&graph->freeze_worklist, node);
+  } else {
+    graph->state[node] = NODE_SIMPLIFY;
+    push_int(&graph->simplify_worklist, node);
+  }
+}
+
+static void simplify(coloring_graph* graph, int node) {
+  graph->state[node] = NODE_SELECTED;
+  push_int(&graph->select_stack, node);
+  const int_list* neighbors = &graph->adjacency[node];
+  for (int i = 0; i < neighbors->count; i++) {
+    if (is_present(graph, neighbors->items[i])) {
+      decrement_degree(graph, neighbors->items[i]);
+    }
+  }
+}
+
+static int get_alias(const coloring_graph* graph, int node) {
+  while (graph->state[node] == NODE_COALESCED) {
+    node = graph->alias[node];
+  }
+  return node;
+}
+
+static void add_to_simplify(coloring_graph* graph, int node) {
+  if (!is_precolored(graph, node) && !is_move_related(graph, node) &&
+      graph->degree[node] < ALLOCATABLE_REGISTER_COUNT) {
+    graph->state[node] = NODE_SIMPLIFY;
+    push_int(&graph->simplify_worklist, node);
+  }
+}
+
+// George's test: merging node into kept is safe if every neighbor of node is
+// insignificant or already interferes with kept. Precolored registers never
+// conflict with each other, so they are harmless when kept is one too.
+static int is_george_safe(const coloring_graph* graph, int node, int kept) {
+  const int_list* neighbors = &graph->adjacency[node];
+  for (int i = 0; i < neighbors->count; i++) {
+    int neighbor = neighbors->items[i];
+    if (!is_present(graph, neighbor)) {
+      continue;
+    }
+    if (graph->degree[neighbor] >= ALLOCATABLE_REGISTER_COUNT &&
+        !is_adjacent(graph, neighbor, kept) &&
+        !(is_precolored(graph, neighbor) && is_precolored(graph, kept))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Briggs' test: merging is safe if the combined node has fewer than K
+// neighbors of significant degree.
+static int is_briggs_safe(const coloring_graph* graph, int first, int second,
+                          unsigned char* seen) {
+  int significant = 0;
+  int nodes[2] = {first, second};
+  for (int n = 0; n < 2; n++) {
+    const int_list* neighbors = &graph->adjacency[nodes[n]];
+    for (int i = 0; i < neighbors->count; i++) {
+      int neighbor = neighbors->items[i];
+      if (!is_present(graph, neighbor) || seen[neighbor]) {
+        continue;
+      }
+      seen[neighbor] = 1;
+      if (graph->degree[neighbor] >= ALLOCATABLE_REGISTER_COUNT) {
+        significant++;
+      }
+    }
+  }
+  for (int n = 0; n < 2; n++) {
+    const int_list* neighbors = &graph->adjacency[nodes[n]];
+    for (int i = 0; i < neighbors->count; i++) {
+      seen[neighbors->items[i]] = 0;
+    }
+  }
+  return significant < ALLOCATABLE_REGISTER_COUNT;
+}
+
+static void combine(coloring_graph* graph, int kept, int merged) {
+  graph->state[merged] = NODE_COALESCED;
+  graph->alias[merged] = kept;
+  const int_list* merged_moves = &graph->move_list[merged];
+  for (int i = 0; i < merged_moves->count; i++) {
+    push_int(&graph->move_list[kept], merged_moves->items[i]);
+  }
+  enable_moves(graph, merged);
+  graph->spill_cost[kept] += graph->spill_cost[merged];
+  const int_list* neighbors = &graph->adjacency[merged];
+  for (int i = 0; i < neighbors->count; i++) {
+    int neighbor = neighbors->items[i];
+    if (!is_present(graph, neighbor)) {
+      continue;
+    }
+    add_edge(graph, neighbor, kept);
+    decrement_degree(graph, neighbor);
+  }
+  if (graph->degree[kept] >= ALLOCATABLE_REGISTER_COUNT &&
+      graph->state[kept] == NODE_FREEZE) {
+    graph->state[kept] = NODE_SPILL;
+  }
+}
+
+static void coalesce(coloring_graph* graph, int move, unsigned char* seen) {
+  int first = get_alias(graph, graph->moves[move].destination);
+  int second = get_alias(graph, graph->moves[move].source);
+  int kept = first;
+  int merged = second;
+  // Keep the precolored end, or else the longer-lived end. If the merged
+  // node later fails to color, only the representative is spilled, and
+  // the short copy gets another chance at a register.
+  if (is_precolored(graph, second) ||
+      (!is_precolored(graph, first) &&
+       graph->degree[second] > graph->degree[first])) {
+    kept = second;
+    merged = first;
+  }
+
+  if (kept == merged) {
+    graph->moves[move].state = MOVE_COALESCED;
+    add_to_simplify(graph, kept);
+  } else if (is_precolored(graph, merged) ||
+             is_adjacent(graph, kept, merged)) {
+    graph->moves[move].state = MOVE_CONSTRAINED;
+    add_to_simplify(graph, kept);
+    add_to_simplify(graph, merged);
+  } else if (is_george_safe(graph, merged, kept) ||
+             (!is_precolored(graph, kept) &&
+              (is_george_safe(graph, kept, merged) ||
+               is_briggs_safe(graph, kept, merged, seen)))) {
+    graph->moves[move].state = MOVE_COALESCED;
+    combine(graph, kept, merged);
+    add_to_simplify(graph, kept);
+  } else {
+    graph->moves[move].state = MOVE_ACTIVE;
+  }
+}
+
+static void freeze_moves(coloring_graph* graph, int node) {
+  const int_list* moves = &graph->move_list[node];
+  for (int i = 0; i < moves->count; i++) {
+    int move = moves->items[i];
+    if (!is_move_enabled(graph, move)) {
+      continue;
+    }
+    int destination = get_alias(graph, graph->moves[move].destination);
+    int source = get_alias(graph, graph->moves[move].source);
+    int other = source == get_alias(graph, node) ? destination : source;
+    graph->moves[move].state = MOVE_FROZEN;
+    if (graph->state[other] == NODE_FREEZE && !is_move_related(graph, other) &&
+        graph->degree[other] < ALLOCATABLE_REGISTER_COUNT) {
+      graph->state[other] = NODE_SIMPLIFY;
+      push_int(&graph->simplify_worklist, other);
+    }
+  }
+}
+
+// Picks the spill candidate with the lowest cost per interference, so rarely
+// used values with many neighbors go to memory first.
+static int select_spill(const coloring_graph* graph) {
+  int best = -1;
+  for (int node = LIR_FIRST_VIRTUAL_REGISTER; node < graph->node_count;
+       node++) {
+    if (graph->state[node] != NODE_SPILL) {
+      continue;
+    }
+    if (best < 0 ||
+        (long)graph->spill_cost[node] * graph->degree[best] <
+            (long)graph->spill_cost[best] * graph->degree[node]) {
+      best = node;
+    }
+  }
+  return best;
+}
+
+static int pop_worklist(int_list* worklist, const coloring_graph* graph,
+                        node_state state) {
+  while (worklist->count > 0) {
+    int node = worklist->items[--worklist->count];
+    if (graph->state[node] == state) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+static int pop_move_worklist(coloring_graph* graph) {
+  while (graph->move_worklist.count > 0) {
+    int move = graph->move_worklist.items[--graph->move_worklist.count];
+    if (graph->moves[move].state == MOVE_WORKLIST) {
+      return move;
+    }
+  }
+  return -1;
+}
+
+static void assign_colors(coloring_graph* graph) {
+  while (graph->select_stack.count > 0) {
+    int node = graph->select_stack.items[--graph->select_stack.count];
+    int taken[LIR_PHYSICAL_REGISTER_COUNT] = {0};
+    const int_list* neighbors = &graph->adjacency[node];
+    for (int i = 0; i < neighbors->count; i++) {
+      int neighbor = get_alias(graph, neighbors->items[i]);
+      if (graph->state[neighbor] == NODE_COLORED ||
+          graph->state[neighbor] == NODE_PRECOLORED) {
+        taken[graph->color[neighbor]] = 1;
+      }
+    }
+    graph->state[node] = NODE_SPILLED;
+    for (int i = 0; i < ALLOCATABLE_REGISTER_COUNT; i++) {
+      if (!taken[allocation_order[i]]) {
+        graph->state[node] = NODE_COLORED;
+        graph->color[node] = allocation_order[i];
+        break;
+      }
+    }
+  }
+}
+
+// Runs one round of simplify, coalesce, freeze and spill selection, then
+// colors the graph. Returns 1 if every node got a register.
+static int color_graph(coloring_graph* graph, const lir_function* function,
+                       const int* spill_slot) {
+  init_coloring_graph(graph, function, spill_slot);
+  build_interference_graph(graph, function);
+  make_worklists(graph);
+
+  unsigned char* seen =
+      (unsigned char*)checked_malloc((size_t)graph->node_count);
+  memset(seen, 0, (size_t)graph->node_count);
+  for (;;) {
+    int node = pop_worklist(&graph->simplify_worklist, graph, NODE_SIMPLIFY);
+    if (node >= 0) {
+      simplify(graph, node);
+      continue;
+    }
+    int move = pop_move_worklist(graph);
+    if (move >= 0) {
+      coalesce(graph, move, seen);
+      continue;
+    }
+    node = pop_worklist(&graph->freeze_worklist, graph, NODE_FREEZE);
+    if (node >= 0) {
+      graph->state[node] = NODE_SIMPLIFY;
+      push_int(&graph->simplify_worklist, node);
+      freeze_moves(graph, node);
+      continue;
+    }
+    node = select_spill(graph);
+    if (node < 0) {
+      break;
+    }
+    graph->state[node] = NODE_SIMPLIFY;
+    push_int(&graph->simplify_worklist, node);
+    freeze_moves(graph, node);
+  }
+  free(seen);
+  assign_colors(graph);
+
+  for (int node = LIR_FIRST_VIRTUAL_REGISTER; node < graph->node_count;
+       node++) {
+    if (graph->state[node] == NODE_SPILLED) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void allocate_registers_graph_coloring(lir_function* function) {
+  int* assigned = new_virtual_register_map(function);
+  int* spill_slot = new_virtual_register_map(function);
+
+  // Spilling a node undoes the coalescing decisions around it, so each round
+  // spills only the nodes that failed to color and starts over. Every round
+  // removes at least one node, so this terminates.
+  coloring_graph graph;
+  while (!color_graph(&graph, function, spill_slot)) {
+    for (int node = LIR_FIRST_VIRTUAL_REGISTER; node < graph.node_count;
+         node++) {
+      if (graph.state[node] == NODE_SPILLED) {
+        spill_slot[node - LIR_FIRST_VIRTUAL_REGISTER] =
+            function->spill_slot_count++;
+      }
+    }
+    free_coloring_graph(&graph);
+  }
+  for (int node = LIR_FIRST_VIRTUAL_REGISTER; node < graph.node_count;
+       node++) {
+    if (is_tracked(&graph, node)) {
+      assigned[node - LIR_FIRST_VIRTUAL_REGISTER] =
+          graph.color[get_alias(&graph, node)];
+    }
+  }
+  free_coloring_graph(&graph);
+  rewrite_function(function, assigned, spill_slot);
+
+  free(assigned);
+  free(spill_slot);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "lir.h"
+
+// Live range of one virtual register, in instruction positions. Instruction
+// i reads its operands at position 2i and writes its results at 2i + 1.
+typedef struct live_interval {
+  int reg;    // Virtual register number.
+  int start;  // First position the register is live at.
+  int end;    // Last position the register is live at.
+  int hint;   // Physical register a move pairs it with, or -1.
+  int hint_interval;  // Interval a move pairs it with, or -1.
+  int assigned;       // Physical register, or -1 if spilled.
+  int spill_slot;     // Stack slot when spilled, or -1.
+} live_interval;
+
+/*
+Computes the live interval of every virtual register in a function.
+
+Intervals come back sorted by start position, as linear scan wants them.
+
+Args:
+  function: Function over virtual registers.
+  interval_count: Output number of intervals.
+
+Returns:
+  Heap-allocated array of intervals; the caller frees it.
+*/
+live_interval* compute_live_intervals(const lir_function* function,
+                                      int* interval_count);
+
+/*
+Assigns physical registers to a function's virtual registers by linear scan.
+
+Walks the live intervals in start order, keeping the set of active intervals
+and the physical registers they hold. A register is only handed out if no
+fixed use of it (argument and return registers, idiv operands, call
+clobbers) overlaps the interval, so values live across a call land in
+callee-saved registers. Copies prefer their partner's register so the move
+disappears. When nothing is free, the interval ending furthest away is
+spilled to a stack slot. Afterwards every virtual register is rewritten,
+spilled ones become rbp-relative memory operands, instructions with two
+memory operands go through the r11 scratch register, and the callee-saved
+registers used and spill slot count are recorded in the function.
+
+Args:
+  function: Function over virtual registers.
+
+Returns:
+  void
+*/
+void allocate_registers_linear_scan(lir_function* function);
+
+/*
+Assigns physical registers by iterated register coalescing.
+
+Builds an interference graph over the function's virtual registers, with
+the allocatable physical registers as precolored nodes, then alternates
+simplify, conservative coalescing (Briggs for two virtual registers, George
+against a physical one), freeze and spill selection before coloring. Moves
+whose ends are coalesced, such as copies into argument registers or out of
+eax after a call, come out as self-moves and are dropped at emission. Spill
+candidates are chosen by fewest uses and defs per interference and are
+rewritten to stack slots the same way as for linear scan. Slower than
+linear scan, but usually leaves fewer moves and spills.
+
+Args:
+  function: Function over virtual registers.
+
+Returns:
+  void
+*/
+void allocate_registers_graph_coloring(lir_function* function);
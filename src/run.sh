@@ -1,2 +1,2 @@
-rm tokens && gcc *.c && ./a.out && as -o test.o chat.s && ld -o test test.o && clear && ./test && echo $?
+rm tokens && gcc *.c && ./a.out -static && clear && ./chat && echo $?
 echo "Return Value: $?"
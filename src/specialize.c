@@ -0,0 +1,234 @@
+/*
+ * Specialization
+ * Clones functions for the constant arguments their calls pass, so each
+ * copy can fold on them.
+ */
+
+#include "specialize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "dce.h"
+#include "gvn.h"
+#include "inline.h"
+#include "ssa.h"
+
+// Room for a name's ".<n>" suffix and its terminator.
+enum { SUFFIX_LENGTH = 16 };
+
+// The constants a group of calls agree on: the constant operand at each
+// specialized position and none elsewhere.
+typedef struct call_pattern {
+  ssa_operand* arguments;
+  int count;
+} call_pattern;
+
+static int is_call_to(const ssa_instruction* instruction,
+                      const ssa_function* callee) {
+  return instruction->block >= 0 && instruction->opcode == SSA_CALL &&
+         instruction->symbol_length == callee->name_length &&
+         strncmp(instruction->symbol, callee->name,
+                 (size_t)callee->name_length) == 0;
+}
+
+// ───── Call Patterns ─────
+
+static call_pattern get_call_pattern(const ssa_instruction* call) {
+  call_pattern pattern;
+  pattern.count = call->operand_count;
+  pattern.arguments = (ssa_operand*)checked_malloc(sizeof(ssa_operand) *
+                                                   (size_t)pattern.count);
+  for (int i = 0; i < pattern.count; i++) {
+    pattern.arguments[i] = call->operands[i].kind == SSA_OPERAND_CONSTANT
+                               ? call->operands[i]
+                               : ssa_none();
+  }
+  return pattern;
+}
+
+static int matches_pattern(const ssa_instruction* call,
+                           const call_pattern* pattern) {
+  if (call->operand_count != pattern->count) {
+    return 0;
+  }
+  for (int i = 0; i < pattern->count; i++) {
+    ssa_operand argument = call->operands[i];
+    ssa_operand expected = pattern->arguments[i];
+    if ((argument.kind == SSA_OPERAND_CONSTANT) !=
+            (expected.kind == SSA_OPERAND_CONSTANT) ||
+        (expected.kind == SSA_OPERAND_CONSTANT &&
+         argument.value != expected.value)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int has_constant_argument(const ssa_instruction* call) {
+  for (int i = 0; i < call->operand_count; i++) {
+    if (call->operands[i].kind == SSA_OPERAND_CONSTANT) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Finds a call to `callee` that passes a constant and matches none of the
+// rejected patterns. Returns 1 and sets `pattern` if there is one.
+static int find_candidate(const ssa_function* functions, int count,
+                          const ssa_function* callee,
+                          const call_pattern* rejected, int rejected_count,
+                          call_pattern* pattern) {
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < functions[i].instruction_count; j++) {
+      const ssa_instruction* call = &functions[i].instructions[j];
+      if (!is_call_to(call, callee) ||
+          call->operand_count != callee->parameter_count ||
+          !has_constant_argument(call)) {
+        continue;
+      }
+      int seen = 0;
+      for (int k = 0; k < rejected_count && !seen; k++) {
+        seen = matches_pattern(call, &rejected[k]);
+      }
+      if (!seen) {
+        *pattern = get_call_pattern(call);
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+// ───── Cloning ─────
+
+// Copies `original` with the pattern's constants in place of their
+// parameters, which are dropped, and cleans the copy up.
+static void build_clone(const ssa_function* original,
+                        const call_pattern* pattern, ssa_function* clone) {
+  copy_ssa_function(original, clone);
+  // new_index[i] is what parameter i becomes, or -1 once it is a constant.
+  int* new_index = (int*)checked_malloc(sizeof(int) * (size_t)pattern->count);
+  int kept = 0;
+  for (int i = 0; i < pattern->count; i++) {
+    new_index[i] =
+        pattern->arguments[i].kind == SSA_OPERAND_CONSTANT ? -1 : kept++;
+  }
+  for (int i = 0; i < clone->instruction_count; i++) {
+    ssa_instruction* instruction = &clone->instructions[i];
+    if (instruction->block < 0 || instruction->opcode != SSA_PARAMETER ||
+        instruction->index >= pattern->count) {
+      continue;
+    }
+    int parameter = instruction->index;
+    if (new_index[parameter] >= 0) {
+      instruction->index = new_index[parameter];
+      continue;
+    }
+    replace_ssa_uses(clone, i, pattern->arguments[parameter]);
+    remove_ssa_instruction(clone, i);
+  }
+  clone->parameter_count = kept;
+  free(new_index);
+  compute_ssa_dominators(clone);
+  number_ssa_values(clone);
+  eliminate_dead_ssa_code(clone);
+}
+
+static void name_clone(ssa_function* clone, int number) {
+  size_t size = (size_t)clone->name_length + SUFFIX_LENGTH;
+  clone->owned_name = (char*)checked_malloc(size);
+  int length = snprintf(clone->owned_name, size, "%.*s.%d",
+                        clone->name_length, clone->name, number);
+  clone->name = clone->owned_name;
+  clone->name_length = length;
+}
+
+// Points every call to `original` that matches the pattern at the clone,
+// without the constant arguments.
+static void redirect_calls(ssa_function* functions, int count,
+                           const ssa_function* original,
+                           const call_pattern* pattern,
+                           const ssa_function* clone) {
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < functions[i].instruction_count; j++) {
+      ssa_instruction* call = &functions[i].instructions[j];
+      if (!is_call_to(call, original) || !matches_pattern(call, pattern)) {
+        continue;
+      }
+      int kept = 0;
+      for (int k = 0; k < call->operand_count; k++) {
+        if (pattern->arguments[k].kind != SSA_OPERAND_CONSTANT) {
+          call->operands[kept++] = call->operands[k];
+        }
+      }
+      call->operand_count = kept;
+      call->symbol = clone->name;
+      call->symbol_length = clone->name_length;
+    }
+  }
+}
+
+// ───── Driver ─────
+
+// Makes the copies of one function. Returns the new number of functions.
+static int specialize_function(ssa_function** functions, int count,
+                               int original, int threshold) {
+  call_pattern* rejected = NULL;
+  int rejected_count = 0;
+  int clone_count = 0;
+  call_pattern pattern;
+  while (clone_count < SPECIALIZATION_LIMIT &&
+         find_candidate(*functions, count, &(*functions)[original], rejected,
+                        rejected_count, &pattern)) {
+    ssa_function clone;
+    build_clone(&(*functions)[original], &pattern, &clone);
+    int saved = get_ssa_function_size(&(*functions)[original]) -
+                get_ssa_function_size(&clone);
+    if (saved < threshold) {
+      free_ssa_function(&clone);
+      call_pattern* new_rejected = (call_pattern*)realloc(
+          rejected, sizeof(call_pattern) * (size_t)(rejected_count + 1));
+      if (new_rejected == NULL) {
+        error_and_exit("realloc failed");
+      }
+      rejected = new_rejected;
+      rejected[rejected_count++] = pattern;
+      continue;
+    }
+    name_clone(&clone, ++clone_count);
+    ssa_function* new_functions = (ssa_function*)realloc(
+        *functions, sizeof(ssa_function) * (size_t)(count + 1));
+    if (new_functions == NULL) {
+      error_and_exit("realloc failed");
+    }
+    *functions = new_functions;
+    (*functions)[count++] = clone;
+    redirect_calls(*functions, count, &(*functions)[original], &pattern,
+                   &(*functions)[count - 1]);
+    free(pattern.arguments);
+  }
+  for (int i = 0; i < rejected_count; i++) {
+    free(rejected[i].arguments);
+  }
+  free(rejected);
+  return count;
+}
+
+int specialize_ssa_functions(ssa_function** functions, int count,
+                             int threshold) {
+  if (threshold <= 0) {
+    return count;
+  }
+  int original_count = count;
+  for (int i = 0; i < original_count; i++) {
+    const ssa_function* function = &(*functions)[i];
+    if (function->parameter_count > 0 && !is_ssa_main(function)) {
+      count = specialize_function(functions, count, i, threshold);
+    }
+  }
+  return count;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ssa.h"
+
+enum { DEFAULT_SPECIALIZE_THRESHOLD = 4, SPECIALIZATION_LIMIT = 8 };
+
+/*
+Clones functions for the constant arguments their calls pass.
+
+Calls to the same function that pass the same constants in the same
+positions form a group, whatever their other arguments are. For each group
+the callee is copied with those parameters replaced by the constants and
+cleaned up with number_ssa_values and eliminate_dead_ssa_code, which folds
+away whatever depended on them, such as the branches on a mode flag. A copy
+at least `threshold` instructions smaller than the original (as counted by
+get_ssa_function_size) is kept as a new function named after the original
+with a ".<n>" suffix, which no source name can clash with. Its constant
+parameters are dropped, and the group's calls, including any the copy makes
+to itself, are pointed at it without those arguments. Other copies are
+thrown away. Each function gets at most SPECIALIZATION_LIMIT copies, copies
+are not copied again, and main is never specialized.
+
+Args:
+  functions: Every function of the program, promoted and cleaned up. The
+    array is reallocated to make room for the copies.
+  count: Number of functions.
+  threshold: Fewest instructions a copy must save; 0 disables
+    specialization.
+
+Returns:
+  The number of functions, copies included.
+*/
+int specialize_ssa_functions(ssa_function** functions, int count,
+                             int threshold);
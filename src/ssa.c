@@ -0,0 +1,1452 @@
+/*
+ * SSA
+ * A mid-level intermediate representation: basic blocks of three-address
+ * instructions in static single assignment form, together with the
+ * control-flow graph, dominator tree and def-use chains passes work on.
+ */
+
+#include "ssa.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+
+enum { INITIAL_SSA_CAPACITY = 8 };
+
+static const char* const opcode_names[] = {
+    "param", "add",  "sub",   "mul",  "div",    "mod",    "eq",
+    "ne",    "lt",   "gt",    "le",   "ge",     "select", "call",
+    "phi",   "load", "store", "jump", "branch", "ret"};
+
+static int next_capacity(int capacity) {
+  return capacity == 0 ? INITIAL_SSA_CAPACITY : capacity * 2;
+}
+
+static void push_int(int** items, int* count, int* capacity, int value) {
+  if (*count == *capacity) {
+    *capacity = next_capacity(*capacity);
+    int* new_items = (int*)realloc(*items, sizeof(int) * (size_t)*capacity);
+    if (new_items == NULL) {
+      error_and_exit("realloc failed");
+    }
+    *items = new_items;
+  }
+  (*items)[(*count)++] = value;
+}
+
+// ───── Construction ─────
+
+void init_ssa_function(ssa_function* function, const char* name,
+                       int name_length) {
+  memset(function, 0, sizeof(*function));
+  function->name = name;
+  function->name_length = name_length;
+  new_ssa_block(function);
+}
+
+static void free_block(ssa_block* block) {
+  free(block->instructions);
+  free(block->predecessors);
+  free(block->dominator_children);
+  memset(block, 0, sizeof(*block));
+}
+
+void free_ssa_function(ssa_function* function) {
+  for (int i = 0; i < function->instruction_count; i++) {
+    free(function->instructions[i].operands);
+  }
+  for (int i = 0; i < function->block_count; i++) {
+    free_block(&function->blocks[i]);
+  }
+  free(function->instructions);
+  free(function->blocks);
+  free(function->reverse_postorder);
+  free(function->owned_name);
+  memset(function, 0, sizeof(*function));
+}
+
+// Returns a heap copy of `count` items of `size` bytes, or NULL if there
+// are none.
+static void* copy_items(const void* items, int count, size_t size) {
+  if (count == 0 || items == NULL) {
+    return NULL;
+  }
+  void* copy = checked_malloc(size * (size_t)count);
+  memcpy(copy, items, size * (size_t)count);
+  return copy;
+}
+
+void copy_ssa_function(const ssa_function* source, ssa_function* copy) {
+  *copy = *source;
+  copy->owned_name = NULL;
+  // Capacities shrink to the counts so later growth reallocates correctly.
+  copy->instructions = (ssa_instruction*)copy_items(
+      source->instructions, source->instruction_count,
+      sizeof(ssa_instruction));
+  copy->instruction_capacity = source->instruction_count;
+  for (int i = 0; i < copy->instruction_count; i++) {
+    ssa_instruction* instruction = &copy->instructions[i];
+    instruction->operands = (ssa_operand*)copy_items(
+        instruction->operands, instruction->operand_count,
+        sizeof(ssa_operand));
+    instruction->operand_capacity = instruction->operand_count;
+  }
+  copy->blocks = (ssa_block*)copy_items(source->blocks, source->block_count,
+                                        sizeof(ssa_block));
+  copy->block_capacity = source->block_count;
+  for (int i = 0; i < copy->block_count; i++) {
+    ssa_block* block = &copy->blocks[i];
+    block->instructions = (int*)copy_items(
+        block->instructions, block->instruction_count, sizeof(int));
+    block->instruction_capacity = block->instruction_count;
+    block->predecessors = (int*)copy_items(
+        block->predecessors, block->predecessor_count, sizeof(int));
+    block->predecessor_capacity = block->predecessor_count;
+    block->dominator_children = (int*)copy_items(
+        block->dominator_children, block->dominator_child_count, sizeof(int));
+  }
+  copy->reverse_postorder = (int*)copy_items(
+      source->reverse_postorder, source->reachable_block_count, sizeof(int));
+}
+
+int find_ssa_function(const ssa_function* functions, int count,
+                      const ssa_instruction* call) {
+  for (int i = 0; i < count; i++) {
+    if (functions[i].name_length == call->symbol_length &&
+        strncmp(functions[i].name, call->symbol,
+                (size_t)call->symbol_length) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int is_ssa_main(const ssa_function* function) {
+  return function->name_length == (int)strlen("main") &&
+         strncmp(function->name, "main", strlen("main")) == 0;
+}
+
+int new_ssa_block(ssa_function* function) {
+  if (function->block_count == function->block_capacity) {
+    function->block_capacity = next_capacity(function->block_capacity);
+    ssa_block* new_blocks = (ssa_block*)realloc(
+        function->blocks, sizeof(ssa_block) * (size_t)function->block_capacity);
+    if (new_blocks == NULL) {
+      error_and_exit("realloc failed");
+    }
+    function->blocks = new_blocks;
+  }
+  ssa_block* block = &function->blocks[function->block_count];
+  memset(block, 0, sizeof(*block));
+  block->immediate_dominator = -1;
+  block->dominator_depth = -1;
+  return function->block_count++;
+}
+
+void add_ssa_edge(ssa_function* function, int from, int to) {
+  ssa_block* source = &function->blocks[from];
+  if (source->successor_count == 2) {
+    error_and_exit("Error: A block has at most two successors\n");
+  }
+  source->successors[source->successor_count++] = to;
+  ssa_block* target = &function->blocks[to];
+  push_int(&target->predecessors, &target->predecessor_count,
+           &target->predecessor_capacity, from);
+}
+
+static int new_instruction(ssa_function* function, ssa_opcode opcode) {
+  if (function->instruction_count == function->instruction_capacity) {
+    function->instruction_capacity =
+        next_capacity(function->instruction_capacity);
+    ssa_instruction* new_instructions = (ssa_instruction*)realloc(
+        function->instructions,
+        sizeof(ssa_instruction) * (size_t)function->instruction_capacity);
+    if (new_instructions == NULL) {
+      error_and_exit("realloc failed");
+    }
+    function->instructions = new_instructions;
+  }
+  ssa_instruction* instruction =
+      &function->instructions[function->instruction_count];
+  memset(instruction, 0, sizeof(*instruction));
+  instruction->opcode = opcode;
+  instruction->block = -1;
+  instruction->index = -1;
+  return function->instruction_count++;
+}
+
+int add_ssa_instruction(ssa_function* function, int block, ssa_opcode opcode,
+                        ssa_operand first, ssa_operand second) {
+  int instruction = new_instruction(function, opcode);
+  if (first.kind != SSA_OPERAND_NONE) {
+    add_ssa_operand(function, instruction, first);
+  }
+  if (second.kind != SSA_OPERAND_NONE) {
+    add_ssa_operand(function, instruction, second);
+  }
+  ssa_block* target = &function->blocks[block];
+  push_int(&target->instructions, &target->instruction_count,
+           &target->instruction_capacity, instruction);
+  function->instructions[instruction].block = block;
+  return instruction;
+}
+
+int insert_ssa_instruction(ssa_function* function, int block, int position,
+                           ssa_opcode opcode) {
+  int instruction = new_instruction(function, opcode);
+  ssa_block* target = &function->blocks[block];
+  push_int(&target->instructions, &target->instruction_count,
+           &target->instruction_capacity, instruction);
+  memmove(&target->instructions[position + 1],
+          &target->instructions[position],
+          sizeof(int) * (size_t)(target->instruction_count - 1 - position));
+  target->instructions[position] = instruction;
+  function->instructions[instruction].block = block;
+  return instruction;
+}
+
+void add_ssa_operand(ssa_function* function, int instruction,
+                     ssa_operand operand) {
+  ssa_instruction* target = &function->instructions[instruction];
+  if (target->operand_count == target->operand_capacity) {
+    target->operand_capacity = next_capacity(target->operand_capacity);
+    ssa_operand* new_operands = (ssa_operand*)realloc(
+        target->operands,
+        sizeof(ssa_operand) * (size_t)target->operand_capacity);
+    if (new_operands == NULL) {
+      error_and_exit("realloc failed");
+    }
+    target->operands = new_operands;
+  }
+  target->operands[target->operand_count++] = operand;
+}
+
+// Marks an instruction removed without touching its block's list.
+static void drop_instruction(ssa_function* function, int instruction) {
+  function->instructions[instruction].block = -1;
+  function->instructions[instruction].operand_count = 0;
+}
+
+// Takes an instruction out of its block's list, leaving it otherwise intact.
+static void unlink_instruction(ssa_function* function, int instruction) {
+  ssa_block* block =
+      &function->blocks[function->instructions[instruction].block];
+  int kept = 0;
+  for (int i = 0; i < block->instruction_count; i++) {
+    if (block->instructions[i] != instruction) {
+      block->instructions[kept++] = block->instructions[i];
+    }
+  }
+  block->instruction_count = kept;
+}
+
+void remove_ssa_instruction(ssa_function* function, int instruction) {
+  if (function->instructions[instruction].block < 0) {
+    return;
+  }
+  unlink_instruction(function, instruction);
+  drop_instruction(function, instruction);
+}
+
+void move_ssa_instruction(ssa_function* function, int instruction, int block,
+                          int position) {
+  unlink_instruction(function, instruction);
+  ssa_block* target = &function->blocks[block];
+  push_int(&target->instructions, &target->instruction_count,
+           &target->instruction_capacity, instruction);
+  memmove(&target->instructions[position + 1],
+          &target->instructions[position],
+          sizeof(int) * (size_t)(target->instruction_count - 1 - position));
+  target->instructions[position] = instruction;
+  function->instructions[instruction].block = block;
+}
+
+ssa_operand ssa_none(void) {
+  ssa_operand operand;
+  operand.kind = SSA_OPERAND_NONE;
+  operand.value = 0;
+  return operand;
+}
+
+ssa_operand ssa_value(int instruction) {
+  ssa_operand operand;
+  operand.kind = SSA_OPERAND_VALUE;
+  operand.value = instruction;
+  return operand;
+}
+
+ssa_operand ssa_constant(int value) {
+  ssa_operand operand;
+  operand.kind = SSA_OPERAND_CONSTANT;
+  operand.value = value;
+  return operand;
+}
+
+// ───── Building From the AST ─────
+
+typedef struct ssa_builder {
+  ssa_function* function;
+  int block;  // Block new instructions are appended to.
+} ssa_builder;
+
+static int emit(ssa_builder* builder, ssa_opcode opcode, ssa_operand first,
+                ssa_operand second) {
+  return add_ssa_instruction(builder->function, builder->block, opcode, first,
+                             second);
+}
+
+static int is_terminator(ssa_opcode opcode) {
+  return opcode == SSA_JUMP || opcode == SSA_BRANCH || opcode == SSA_RETURN;
+}
+
+static int is_terminated(const ssa_function* function, int block) {
+  const ssa_block* target = &function->blocks[block];
+  return target->instruction_count > 0 &&
+         is_terminator(
+             function->instructions[target->instructions
+                                        [target->instruction_count - 1]]
+                 .opcode);
+}
+
+static void jump_to(ssa_builder* builder, int target) {
+  if (!is_terminated(builder->function, builder->block)) {
+    emit(builder, SSA_JUMP, ssa_none(), ssa_none());
+    add_ssa_edge(builder->function, builder->block, target);
+  }
+}
+
+static ssa_opcode get_binary_opcode(TokenType operator) {
+  switch (operator) {
+    case TOKEN_PLUS:
+      return SSA_ADD;
+    case TOKEN_MINUS:
+      return SSA_SUB;
+    case TOKEN_STAR:
+      return SSA_MUL;
+    case TOKEN_SLASH:
+      return SSA_DIV;
+    case TOKEN_PERCENT:
+      return SSA_MOD;
+    case TOKEN_EQ:
+      return SSA_EQ;
+    case TOKEN_NEQ:
+      return SSA_NE;
+    case TOKEN_LT:
+      return SSA_LT;
+    case TOKEN_GT:
+      return SSA_GT;
+    case TOKEN_LEQ:
+      return SSA_LE;
+    case TOKEN_GEQ:
+      return SSA_GE;
+    default:
+      (void)fprintf(stderr, "Error: Unsupported operator '%s'\n",
+                    token_type_to_string(operator));
+      error_and_exit("");
+      return SSA_ADD;
+  }
+}
+
+static ssa_operand build_expression(ssa_builder* builder, ast_node* node);
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static int build_call(ssa_builder* builder, ast_node* node) {
+  int argument_count = node->as.function_call.param_count;
+  ssa_operand* arguments = (ssa_operand*)checked_malloc(
+      sizeof(ssa_operand) * (size_t)argument_count);
+  for (int i = 0; i < argument_count; i++) {
+    arguments[i] =
+        build_expression(builder, node->as.function_call.parameters[i]);
+  }
+  int call = emit(builder, SSA_CALL, ssa_none(), ssa_none());
+  ssa_instruction* instruction = &builder->function->instructions[call];
+  instruction->symbol = node->as.function_call.name->lexeme;
+  instruction->symbol_length = node->as.function_call.name->length;
+  for (int i = 0; i < argument_count; i++) {
+    add_ssa_operand(builder->function, call, arguments[i]);
+  }
+  free(arguments);
+  return call;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static ssa_operand build_expression(ssa_builder* builder, ast_node* node) {
+  switch (node->type) {
+    case AST_INT_LITERAL:
+      return ssa_constant(node->as.int_literal.int_literal);
+    case AST_VARIABLE: {
+      int load = emit(builder, SSA_LOAD, ssa_none(), ssa_none());
+      builder->function->instructions[load].index = node->slot;
+      return ssa_value(load);
+    }
+    case AST_BINARY: {
+      ssa_operand left = build_expression(builder, node->as.binary.left);
+      ssa_operand right = build_expression(builder, node->as.binary.right);
+      return ssa_value(emit(
+          builder, get_binary_opcode(node->as.binary._operator), left, right));
+    }
+    case AST_UNARY:
+      if (node->as.unary._operator == '-') {
+        ssa_operand operand = build_expression(builder, node->as.unary.operand);
+        return ssa_value(emit(builder, SSA_SUB, ssa_constant(0), operand));
+      }
+      error_and_exit("Error: Unsupported unary operator\n");
+      return ssa_none();
+    case AST_FUNCTION_CALL:
+      return ssa_value(build_call(builder, node));
+    default:
+      error_and_exit("Error: Unsupported expression\n");
+      return ssa_none();
+  }
+}
+
+static void store_slot(ssa_builder* builder, int slot, ssa_operand value) {
+  int store = emit(builder, SSA_STORE, value, ssa_none());
+  builder->function->instructions[store].index = slot;
+}
+
+static void build_statement(ssa_builder* builder, ast_node* node);
+
+// Ends the current block with a conditional branch whose true edge goes to
+// a new block, and continues there. The false edge is added by the caller
+// once its target exists, so blocks are numbered in source order.
+static int branch_to_new_block(ssa_builder* builder, ssa_operand condition) {
+  int branch_block = builder->block;
+  emit(builder, SSA_BRANCH, condition, ssa_none());
+  builder->block = new_ssa_block(builder->function);
+  add_ssa_edge(builder->function, branch_block, builder->block);
+  return branch_block;
+}
+
+// Builds an if statement together with the else-if and else statements
+// that follow it in the same block. Returns how many statements it used.
+// NOLINTNEXTLINE(misc-no-recursion)
+static int build_if_chain(ssa_builder* builder, ast_node** statements,
+                          int count) {
+  ssa_function* function = builder->function;
+  int* arm_ends = (int*)checked_malloc(sizeof(int) * ((size_t)count + 1));
+  int arm_end_count = 0;
+  int used = 0;
+  int has_else = 0;
+  while (used < count && !has_else) {
+    ast_node* arm = statements[used];
+    if (used > 0 && arm->type != AST_ELSE_IF_STATEMENT &&
+        arm->type != AST_ELSE_STATEMENT) {
+      break;
+    }
+    used++;
+    if (arm->type == AST_ELSE_STATEMENT) {
+      has_else = 1;
+    } else {
+      ssa_operand condition =
+          build_expression(builder, arm->as.if_elif_else_statement.condition);
+      int branch_block = branch_to_new_block(builder, condition);
+      build_statement(builder, arm->as.if_elif_else_statement.body);
+      arm_ends[arm_end_count++] = builder->block;
+      builder->block = new_ssa_block(function);
+      add_ssa_edge(function, branch_block, builder->block);
+      continue;
+    }
+    build_statement(builder, arm->as.if_elif_else_statement.body);
+  }
+  arm_ends[arm_end_count++] = builder->block;
+
+  int join = new_ssa_block(function);
+  for (int i = 0; i < arm_end_count; i++) {
+    builder->block = arm_ends[i];
+    jump_to(builder, join);
+  }
+  builder->block = join;
+  free(arm_ends);
+  return used;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static void build_while(ssa_builder* builder, ast_node* node) {
+  ssa_function* function = builder->function;
+  int header = new_ssa_block(function);
+  jump_to(builder, header);
+  builder->block = header;
+  ssa_operand condition =
+      build_expression(builder, node->as.while_statement.condition);
+  branch_to_new_block(builder, condition);
+  build_statement(builder, node->as.while_statement.body);
+  jump_to(builder, header);
+  int exit = new_ssa_block(function);
+  add_ssa_edge(function, header, exit);
+  builder->block = exit;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+static void build_statement(ssa_builder* builder, ast_node* node) {
+  if (node == NULL) {
+    return;
+  }
+  switch (node->type) {
+    case AST_DECLARATION: {
+      ssa_operand value =
+          build_expression(builder, node->as.declaration.expression);
+      store_slot(builder, node->as.declaration.variable->slot, value);
+      break;
+    }
+    case AST_FUNCTION_CALL:
+      build_call(builder, node);
+      break;
+    case AST_RETURN: {
+      ssa_operand value = ssa_none();
+      if (node->as._return.expression != NULL) {
+        value = build_expression(builder, node->as._return.expression);
+      }
+      emit(builder, SSA_RETURN, value, ssa_none());
+      // Anything after the return lands in a block nothing jumps to.
+      builder->block = new_ssa_block(builder->function);
+      break;
+    }
+    case AST_WHILE_STATEMENT:
+      build_while(builder, node);
+      break;
+    case AST_IF_STATEMENT:
+      build_if_chain(builder, &node, 1);
+      break;
+    case AST_ELSE_IF_STATEMENT:
+    case AST_ELSE_STATEMENT:
+      error_and_exit("Error: else without a matching if\n");
+      break;
+    case AST_BLOCK:
+      for (int i = 0; i < node->as.block.count;) {
+        ast_node* statement = node->as.block.statements[i];
+        if (statement != NULL && statement->type == AST_IF_STATEMENT) {
+          i += build_if_chain(builder, &node->as.block.statements[i],
+                              node->as.block.count - i);
+        } else {
+          build_statement(builder, statement);
+          i++;
+        }
+      }
+      break;
+    default:
+      // Bare declarations need no code; a load before any store reads 0.
+      break;
+  }
+}
+
+void build_ssa_function(ast_node* node, ssa_function* function) {
+  if (node->type != AST_FUNCTION_DECLARATION) {
+    error_and_exit("Error: Not a function node\n");
+  }
+  if (node->as.function.slot_count < 0) {
+    resolve_function_variables(node);
+  }
+  init_ssa_function(function, node->as.function.name->lexeme,
+                    node->as.function.name->length);
+  function->parameter_count = node->as.function.param_count;
+  function->slot_count = node->as.function.slot_count;
+
+  ssa_builder builder;
+  builder.function = function;
+  builder.block = 0;
+  for (int i = 0; i < node->as.function.param_count; i++) {
+    int parameter = emit(&builder, SSA_PARAMETER, ssa_none(), ssa_none());
+    function->instructions[parameter].index = i;
+    store_slot(&builder, node->as.function.parameters[i]->slot,
+               ssa_value(parameter));
+  }
+  build_statement(&builder, node->as.function.statements);
+  // Falling off the end returns nothing in particular.
+  if (!is_terminated(function, builder.block)) {
+    emit(&builder, SSA_RETURN, ssa_none(), ssa_none());
+  }
+}
+
+// ───── Control Flow and Dominators ─────
+
+// Removes the phi inputs for predecessor position `position` of a block.
+static void remove_phi_inputs(ssa_function* function, int block,
+                              int position) {
+  const ssa_block* target = &function->blocks[block];
+  for (int i = 0; i < target->instruction_count; i++) {
+    ssa_instruction* phi = &function->instructions[target->instructions[i]];
+    if (phi->opcode != SSA_PHI) {
+      break;
+    }
+    memmove(&phi->operands[position], &phi->operands[position + 1],
+            sizeof(ssa_operand) *
+                (size_t)(phi->operand_count - 1 - position));
+    phi->operand_count--;
+  }
+}
+
+void remove_ssa_edge(ssa_function* function, int from, int to) {
+  ssa_block* source = &function->blocks[from];
+  for (int i = 0; i < source->successor_count; i++) {
+    if (source->successors[i] == to) {
+      if (i == 0 && source->successor_count == 2) {
+        source->successors[0] = source->successors[1];
+      }
+      source->successor_count--;
+      break;
+    }
+  }
+  ssa_block* target = &function->blocks[to];
+  for (int i = 0; i < target->predecessor_count; i++) {
+    if (target->predecessors[i] == from) {
+      remove_phi_inputs(function, to, i);
+      memmove(&target->predecessors[i], &target->predecessors[i + 1],
+              sizeof(int) * (size_t)(target->predecessor_count - 1 - i));
+      target->predecessor_count--;
+      return;
+    }
+  }
+}
+
+void merge_ssa_blocks(ssa_function* function, int first, int second) {
+  ssa_block* head = &function->blocks[first];
+  remove_ssa_instruction(function,
+                         head->instructions[head->instruction_count - 1]);
+  ssa_block* tail = &function->blocks[second];
+  for (int i = 0; i < tail->instruction_count; i++) {
+    int instruction = tail->instructions[i];
+    push_int(&head->instructions, &head->instruction_count,
+             &head->instruction_capacity, instruction);
+    function->instructions[instruction].block = first;
+  }
+  tail->instruction_count = 0;
+
+  head->successor_count = tail->successor_count;
+  for (int i = 0; i < tail->successor_count; i++) {
+    int successor = tail->successors[i];
+    head->successors[i] = successor;
+    ssa_block* next = &function->blocks[successor];
+    for (int j = 0; j < next->predecessor_count; j++) {
+      if (next->predecessors[j] == second) {
+        next->predecessors[j] = first;
+        break;
+      }
+    }
+  }
+  tail->successor_count = 0;
+  tail->predecessor_count = 0;
+}
+
+int split_ssa_block(ssa_function* function, int block, int position) {
+  int tail_number = new_ssa_block(function);
+  ssa_block* head = &function->blocks[block];
+  ssa_block* tail = &function->blocks[tail_number];
+  for (int i = position; i < head->instruction_count; i++) {
+    int instruction = head->instructions[i];
+    push_int(&tail->instructions, &tail->instruction_count,
+             &tail->instruction_capacity, instruction);
+    function->instructions[instruction].block = tail_number;
+  }
+  head->instruction_count = position;
+
+  tail->successor_count = head->successor_count;
+  for (int i = 0; i < head->successor_count; i++) {
+    int successor = head->successors[i];
+    tail->successors[i] = successor;
+    ssa_block* next = &function->blocks[successor];
+    for (int j = 0; j < next->predecessor_count; j++) {
+      if (next->predecessors[j] == block) {
+        next->predecessors[j] = tail_number;
+        break;
+      }
+    }
+  }
+  head->successor_count = 0;
+  return tail_number;
+}
+
+static unsigned char* find_reachable_blocks(const ssa_function* function) {
+  unsigned char* reachable =
+      (unsigned char*)checked_malloc((size_t)function->block_count);
+  memset(reachable, 0, (size_t)function->block_count);
+  int* stack = (int*)checked_malloc(sizeof(int) *
+                                    ((size_t)function->block_count + 1));
+  int depth = 0;
+  stack[depth++] = 0;
+  reachable[0] = 1;
+  while (depth > 0) {
+    const ssa_block* block = &function->blocks[stack[--depth]];
+    for (int i = 0; i < block->successor_count; i++) {
+      int successor = block->successors[i];
+      if (!reachable[successor]) {
+        reachable[successor] = 1;
+        stack[depth++] = successor;
+      }
+    }
+  }
+  free(stack);
+  return reachable;
+}
+
+void remove_unreachable_ssa_blocks(ssa_function* function) {
+  unsigned char* reachable = find_reachable_blocks(function);
+  int* renumbered =
+      (int*)checked_malloc(sizeof(int) * (size_t)function->block_count);
+  int kept = 0;
+  for (int i = 0; i < function->block_count; i++) {
+    renumbered[i] = reachable[i] ? kept++ : -1;
+  }
+
+  for (int i = 0; i < function->block_count; i++) {
+    ssa_block* block = &function->blocks[i];
+    if (!reachable[i]) {
+      for (int j = 0; j < block->instruction_count; j++) {
+        drop_instruction(function, block->instructions[j]);
+      }
+      free_block(block);
+      continue;
+    }
+    // Edges from removed blocks go away along with their phi inputs.
+    for (int j = block->predecessor_count - 1; j >= 0; j--) {
+      if (!reachable[block->predecessors[j]]) {
+        remove_phi_inputs(function, i, j);
+        memmove(&block->predecessors[j], &block->predecessors[j + 1],
+                sizeof(int) * (size_t)(block->predecessor_count - 1 - j));
+        block->predecessor_count--;
+      }
+    }
+  }
+
+  for (int i = 0; i < function->block_count; i++) {
+    if (!reachable[i]) {
+      continue;
+    }
+    ssa_block* block = &function->blocks[i];
+    for (int j = 0; j < block->predecessor_count; j++) {
+      block->predecessors[j] = renumbered[block->predecessors[j]];
+    }
+    for (int j = 0; j < block->successor_count; j++) {
+      block->successors[j] = renumbered[block->successors[j]];
+    }
+    for (int j = 0; j < block->instruction_count; j++) {
+      function->instructions[block->instructions[j]].block = renumbered[i];
+    }
+    function->blocks[renumbered[i]] = *block;
+  }
+  function->block_count = kept;
+  free(renumbered);
+  free(reachable);
+}
+
+void reorder_ssa_blocks(ssa_function* function, const int* order) {
+  int* renumbered =
+      (int*)checked_malloc(sizeof(int) * (size_t)function->block_count);
+  ssa_block* blocks = (ssa_block*)checked_malloc(
+      sizeof(ssa_block) * (size_t)function->block_capacity);
+  for (int i = 0; i < function->block_count; i++) {
+    renumbered[order[i]] = i;
+    blocks[i] = function->blocks[order[i]];
+  }
+  for (int i = 0; i < function->block_count; i++) {
+    ssa_block* block = &blocks[i];
+    for (int j = 0; j < block->predecessor_count; j++) {
+      block->predecessors[j] = renumbered[block->predecessors[j]];
+    }
+    for (int j = 0; j < block->successor_count; j++) {
+      block->successors[j] = renumbered[block->successors[j]];
+    }
+    for (int j = 0; j < block->instruction_count; j++) {
+      function->instructions[block->instructions[j]].block = i;
+    }
+  }
+  free(function->blocks);
+  function->blocks = blocks;
+  free(renumbered);
+}
+
+// Numbers the reachable blocks in postorder with an explicit DFS stack.
+static int compute_postorder(const ssa_function* function, int* postorder) {
+  int* stack = (int*)checked_malloc(sizeof(int) *
+                                    ((size_t)function->block_count + 1));
+  int* next_edge =
+      (int*)checked_malloc(sizeof(int) * (size_t)function->block_count);
+  unsigned char* visited =
+      (unsigned char*)checked_malloc((size_t)function->block_count);
+  memset(visited, 0, (size_t)function->block_count);
+  int count = 0;
+  int depth = 0;
+  stack[depth++] = 0;
+  next_edge[0] = 0;
+  visited[0] = 1;
+  while (depth > 0) {
+    int block = stack[depth - 1];
+    const ssa_block* current = &function->blocks[block];
+    if (next_edge[block] < current->successor_count) {
+      int successor = current->successors[next_edge[block]++];
+      if (!visited[successor]) {
+        visited[successor] = 1;
+        next_edge[successor] = 0;
+        stack[depth++] = successor;
+      }
+    } else {
+      postorder[count++] = block;
+      depth--;
+    }
+  }
+  free(stack);
+  free(next_edge);
+  free(visited);
+  return count;
+}
+
+static int intersect(const int* dominator, const int* order, int first,
+                     int second) {
+  while (first != second) {
+    while (order[first] > order[second]) {
+      first = dominator[first];
+    }
+    while (order[second] > order[first]) {
+      second = dominator[second];
+    }
+  }
+  return first;
+}
+
+void compute_ssa_dominators(ssa_function* function) {
+  int count = function->block_count;
+  int* postorder = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  int reachable_count = compute_postorder(function, postorder);
+
+  free(function->reverse_postorder);
+  function->reverse_postorder =
+      (int*)checked_malloc(sizeof(int) * (size_t)count);
+  function->reachable_block_count = reachable_count;
+  // order[] is each block's reverse postorder position, or -1.
+  int* order = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  int* dominator = (int*)checked_malloc(sizeof(int) * (size_t)count);
+  for (int i = 0; i < count; i++) {
+    order[i] = -1;
+    dominator[i] = -1;
+  }
+  for (int i = 0; i < reachable_count; i++) {
+    int block = postorder[reachable_count - 1 - i];
+    function->reverse_postorder[i] = block;
+    order[block] = i;
+  }
+  free(postorder);
+
+  dominator[0] = 0;
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int i = 1; i < reachable_count; i++) {
+      int block = function->reverse_postorder[i];
+      const ssa_block* current = &function->blocks[block];
+      int new_dominator = -1;
+      for (int j = 0; j < current->predecessor_count; j++) {
+        int predecessor = current->predecessors[j];
+        if (dominator[predecessor] < 0) {
+          continue;
+        }
+        new_dominator =
+            new_dominator < 0
+                ? predecessor
+                : intersect(dominator, order, predecessor, new_dominator);
+      }
+      if (dominator[block] != new_dominator) {
+        dominator[block] = new_dominator;
+        changed = 1;
+      }
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    ssa_block* block = &function->blocks[i];
+    block->immediate_dominator = i == 0 ? -1 : dominator[i];
+    free(block->dominator_children);
+    block->dominator_children = NULL;
+    block->dominator_child_count = 0;
+    block->dominator_depth = -1;
+  }
+  for (int i = 1; i < reachable_count; i++) {
+    int block = function->reverse_postorder[i];
+    function->blocks[dominator[block]].dominator_child_count++;
+  }
+  for (int i = 0; i < count; i++) {
+    ssa_block* block = &function->blocks[i];
+    if (block->dominator_child_count > 0) {
+      block->dominator_children = (int*)checked_malloc(
+          sizeof(int) * (size_t)block->dominator_child_count);
+      block->dominator_child_count = 0;
+    }
+  }
+  // Reverse postorder visits every parent before its children.
+  function->blocks[0].dominator_depth = 0;
+  for (int i = 1; i < reachable_count; i++) {
+    int block = function->reverse_postorder[i];
+    ssa_block* parent = &function->blocks[dominator[block]];
+    function->blocks[block].dominator_depth = parent->dominator_depth + 1;
+    parent->dominator_children[parent->dominator_child_count++] = block;
+  }
+  free(order);
+  free(dominator);
+}
+
+int ssa_block_dominates(const ssa_function* function, int dominator,
+                        int block) {
+  int dominator_depth = function->blocks[dominator].dominator_depth;
+  if (dominator_depth < 0 || function->blocks[block].dominator_depth < 0) {
+    return dominator == block;
+  }
+  while (function->blocks[block].dominator_depth > dominator_depth) {
+    block = function->blocks[block].immediate_dominator;
+  }
+  return block == dominator;
+}
+
+// ───── Promotion (mem2reg) ─────
+
+typedef struct block_list {
+  int* items;
+  int count;
+  int capacity;
+} block_list;
+
+// Dominance frontiers (Cooper, Harvey and Kennedy): walk up from each
+// predecessor of a join until reaching the join's immediate dominator.
+static block_list* compute_dominance_frontiers(const ssa_function* function) {
+  block_list* frontiers = (block_list*)checked_malloc(
+      sizeof(block_list) * (size_t)function->block_count);
+  memset(frontiers, 0, sizeof(block_list) * (size_t)function->block_count);
+  for (int i = 0; i < function->block_count; i++) {
+    const ssa_block* block = &function->blocks[i];
+    if (block->predecessor_count < 2) {
+      continue;
+    }
+    for (int j = 0; j < block->predecessor_count; j++) {
+      int runner = block->predecessors[j];
+      while (runner >= 0 && runner != block->immediate_dominator) {
+        block_list* frontier = &frontiers[runner];
+        if (frontier->count == 0 || frontier->items[frontier->count - 1] != i) {
+          push_int(&frontier->items, &frontier->count, &frontier->capacity, i);
+        }
+        runner = function->blocks[runner].immediate_dominator;
+      }
+    }
+  }
+  return frontiers;
+}
+
+// Slots live on entry to each block, one byte per (block, slot) pair. A
+// slot is live where some path reads it before storing to it.
+static unsigned char* compute_live_slots(const ssa_function* function) {
+  size_t slots = (size_t)function->slot_count;
+  size_t size = (size_t)function->block_count * slots;
+  unsigned char* live_in = (unsigned char*)checked_malloc(size);
+  unsigned char* upward = (unsigned char*)checked_malloc(size);
+  unsigned char* stored = (unsigned char*)checked_malloc(size);
+  memset(live_in, 0, size);
+  memset(upward, 0, size);
+  memset(stored, 0, size);
+  for (int i = 0; i < function->block_count; i++) {
+    const ssa_block* block = &function->blocks[i];
+    for (int j = 0; j < block->instruction_count; j++) {
+      const ssa_instruction* instruction =
+          &function->instructions[block->instructions[j]];
+      size_t cell = ((size_t)i * slots) + (size_t)instruction->index;
+      if (instruction->opcode == SSA_LOAD && !stored[cell]) {
+        upward[cell] = 1;
+      } else if (instruction->opcode == SSA_STORE) {
+        stored[cell] = 1;
+      }
+    }
+  }
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int i = function->block_count - 1; i >= 0; i--) {
+      const ssa_block* block = &function->blocks[i];
+      for (size_t slot = 0; slot < slots; slot++) {
+        size_t cell = ((size_t)i * slots) + slot;
+        unsigned char live = upward[cell];
+        for (int j = 0; j < block->successor_count && !live; j++) {
+          live = !stored[cell] &&
+                 live_in[((size_t)block->successors[j] * slots) + slot];
+        }
+        if (live && !live_in[cell]) {
+          live_in[cell] = 1;
+          changed = 1;
+        }
+      }
+    }
+  }
+  free(upward);
+  free(stored);
+  return live_in;
+}
+
+// Places phis for one slot at the iterated dominance frontier of its
+// stores, wherever the slot is live.
+static void place_phis(ssa_function* function, int slot,
+                       const block_list* frontiers,
+                       const unsigned char* live_in) {
+  int count = function->block_count;
+  unsigned char* has_phi = (unsigned char*)checked_malloc((size_t)count);
+  unsigned char* queued = (unsigned char*)checked_malloc((size_t)count);
+  memset(has_phi, 0, (size_t)count);
+  memset(queued, 0, (size_t)count);
+  block_list worklist = {NULL, 0, 0};
+  for (int i = 0; i < count; i++) {
+    const ssa_block* block = &function->blocks[i];
+    for (int j = 0; j < block->instruction_count; j++) {
+      const ssa_instruction* instruction =
+          &function->instructions[block->instructions[j]];
+      if (instruction->opcode == SSA_STORE && instruction->index == slot) {
+        queued[i] = 1;
+        push_int(&worklist.items, &worklist.count, &worklist.capacity, i);
+        break;
+      }
+    }
+  }
+  while (worklist.count > 0) {
+    int block = worklist.items[--worklist.count];
+    const block_list* frontier = &frontiers[block];
+    for (int i = 0; i < frontier->count; i++) {
+      int join = frontier->items[i];
+      if (has_phi[join] ||
+          !live_in[((size_t)join * (size_t)function->slot_count) +
+                   (size_t)slot]) {
+        continue;
+      }
+      has_phi[join] = 1;
+      int phi = insert_ssa_instruction(function, join, 0, SSA_PHI);
+      function->instructions[phi].index = slot;
+      for (int j = 0; j < function->blocks[join].predecessor_count; j++) {
+        add_ssa_operand(function, phi, ssa_constant(0));
+      }
+      if (!queued[join]) {
+        queued[join] = 1;
+        push_int(&worklist.items, &worklist.count, &worklist.capacity, join);
+      }
+    }
+  }
+  free(worklist.items);
+  free(has_phi);
+  free(queued);
+}
+
+typedef struct renamer {
+  ssa_function* function;
+  ssa_operand* current;      // Reaching value of each slot.
+  ssa_operand* replacement;  // What each removed load is replaced by.
+} renamer;
+
+static void fill_successor_phis(renamer* state, int block) {
+  ssa_function* function = state->function;
+  const ssa_block* current = &function->blocks[block];
+  for (int i = 0; i < current->successor_count; i++) {
+    const ssa_block* successor = &function->blocks[current->successors[i]];
+    for (int j = 0; j < successor->predecessor_count; j++) {
+      if (successor->predecessors[j] != block) {
+        continue;
+      }
+      for (int k = 0; k < successor->instruction_count; k++) {
+        ssa_instruction* phi =
+            &function->instructions[successor->instructions[k]];
+        if (phi->opcode != SSA_PHI) {
+          break;
+        }
+        phi->operands[j] = state->current[phi->index];
+      }
+    }
+  }
+}
+
+// Renames one block and then its dominator-tree children, which see the
+// values reaching the end of this block.
+// NOLINTNEXTLINE(misc-no-recursion)
+static void rename_block(renamer* state, int block) {
+  ssa_function* function = state->function;
+  size_t current_size = sizeof(ssa_operand) * (size_t)function->slot_count;
+  ssa_operand* saved = (ssa_operand*)checked_malloc(current_size);
+  memcpy(saved, state->current, current_size);
+
+  ssa_block* current = &function->blocks[block];
+  int kept = 0;
+  for (int i = 0; i < current->instruction_count; i++) {
+    int id = current->instructions[i];
+    ssa_instruction* instruction = &function->instructions[id];
+    for (int j = 0; j < instruction->operand_count; j++) {
+      ssa_operand* operand = &instruction->operands[j];
+      if (instruction->opcode != SSA_PHI &&
+          operand->kind == SSA_OPERAND_VALUE &&
+          state->replacement[operand->value].kind != SSA_OPERAND_NONE) {
+        *operand = state->replacement[operand->value];
+      }
+    }
+    if (instruction->opcode == SSA_LOAD) {
+      state->replacement[id] = state->current[instruction->index];
+      drop_instruction(function, id);
+      continue;
+    }
+    if (instruction->opcode == SSA_STORE) {
+      state->current[instruction->index] = instruction->operands[0];
+      drop_instruction(function, id);
+      continue;
+    }
+    if (instruction->opcode == SSA_PHI) {
+      state->current[instruction->index] = ssa_value(id);
+    }
+    current->instructions[kept++] = id;
+  }
+  current->instruction_count = kept;
+
+  fill_successor_phis(state, block);
+  for (int i = 0; i < current->dominator_child_count; i++) {
+    rename_block(state, current->dominator_children[i]);
+  }
+  memcpy(state->current, saved, current_size);
+  free(saved);
+}
+
+void promote_ssa_locals(ssa_function* function) {
+  remove_unreachable_ssa_blocks(function);
+  compute_ssa_dominators(function);
+  if (function->slot_count > 0) {
+    block_list* frontiers = compute_dominance_frontiers(function);
+    unsigned char* live_in = compute_live_slots(function);
+    for (int slot = 0; slot < function->slot_count; slot++) {
+      place_phis(function, slot, frontiers, live_in);
+    }
+    for (int i = 0; i < function->block_count; i++) {
+      free(frontiers[i].items);
+    }
+    free(frontiers);
+    free(live_in);
+  }
+
+  renamer state;
+  state.function = function;
+  state.current = (ssa_operand*)checked_malloc(
+      sizeof(ssa_operand) * (size_t)function->slot_count);
+  for (int slot = 0; slot < function->slot_count; slot++) {
+    state.current[slot] = ssa_constant(0);
+  }
+  state.replacement = (ssa_operand*)checked_malloc(
+      sizeof(ssa_operand) * (size_t)function->instruction_count);
+  for (int i = 0; i < function->instruction_count; i++) {
+    state.replacement[i] = ssa_none();
+  }
+  rename_block(&state, 0);
+  free(state.current);
+  free(state.replacement);
+}
+
+// ───── Values and Uses ─────
+
+int ssa_can_speculate(const ssa_instruction* instruction) {
+  switch (instruction->opcode) {
+    case SSA_ADD:
+    case SSA_SUB:
+    case SSA_MUL:
+    case SSA_EQ:
+    case SSA_NE:
+    case SSA_LT:
+    case SSA_GT:
+    case SSA_LE:
+    case SSA_GE:
+    case SSA_SELECT:
+      return 1;
+    case SSA_DIV:
+    case SSA_MOD:
+      return !ssa_may_trap(instruction);
+    default:
+      return 0;
+  }
+}
+
+int ssa_may_trap(const ssa_instruction* instruction) {
+  if (instruction->opcode != SSA_DIV && instruction->opcode != SSA_MOD) {
+    return 0;
+  }
+  // x / 0 and INT_MIN / -1 trap, so only other constants are safe.
+  ssa_operand divisor = instruction->operands[1];
+  return divisor.kind != SSA_OPERAND_CONSTANT || divisor.value == 0 ||
+         divisor.value == -1;
+}
+
+int fold_ssa_binary(ssa_opcode opcode, int left, int right, int* result) {
+  switch (opcode) {
+    case SSA_ADD:
+      *result = (int)((uint32_t)left + (uint32_t)right);
+      return 1;
+    case SSA_SUB:
+      *result = (int)((uint32_t)left - (uint32_t)right);
+      return 1;
+    case SSA_MUL:
+      *result = (int)((uint32_t)left * (uint32_t)right);
+      return 1;
+    case SSA_DIV:
+    case SSA_MOD:
+      if (right == 0 || (left == INT_MIN && right == -1)) {
+        return 0;
+      }
+      *result = opcode == SSA_DIV ? left / right : left % right;
+      return 1;
+    case SSA_EQ:
+      *result = left == right;
+      return 1;
+    case SSA_NE:
+      *result = left != right;
+      return 1;
+    case SSA_LT:
+      *result = left < right;
+      return 1;
+    case SSA_GT:
+      *result = left > right;
+      return 1;
+    case SSA_LE:
+      *result = left <= right;
+      return 1;
+    case SSA_GE:
+      *result = left >= right;
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+int ssa_defines_value(const ssa_instruction* instruction) {
+  switch (instruction->opcode) {
+    case SSA_STORE:
+    case SSA_JUMP:
+    case SSA_BRANCH:
+    case SSA_RETURN:
+      return 0;
+    default:
+      return 1;
+  }
+}
+
+ssa_use_list* build_ssa_use_lists(const ssa_function* function) {
+  size_t size = sizeof(ssa_use_list) * (size_t)function->instruction_count;
+  ssa_use_list* lists = (ssa_use_list*)checked_malloc(size);
+  memset(lists, 0, size);
+  for (int i = 0; i < function->instruction_count; i++) {
+    const ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block < 0) {
+      continue;
+    }
+    for (int j = 0; j < instruction->operand_count; j++) {
+      if (instruction->operands[j].kind != SSA_OPERAND_VALUE) {
+        continue;
+      }
+      ssa_use_list* list = &lists[instruction->operands[j].value];
+      if (list->count == list->capacity) {
+        list->capacity = next_capacity(list->capacity);
+        ssa_use* new_uses = (ssa_use*)realloc(
+            list->uses, sizeof(ssa_use) * (size_t)list->capacity);
+        if (new_uses == NULL) {
+          error_and_exit("realloc failed");
+        }
+        list->uses = new_uses;
+      }
+      list->uses[list->count].instruction = i;
+      list->uses[list->count].operand = j;
+      list->count++;
+    }
+  }
+  return lists;
+}
+
+void free_ssa_use_lists(ssa_use_list* lists, int count) {
+  for (int i = 0; i < count; i++) {
+    free(lists[i].uses);
+  }
+  free(lists);
+}
+
+void replace_ssa_uses(ssa_function* function, int value,
+                      ssa_operand replacement) {
+  for (int i = 0; i < function->instruction_count; i++) {
+    ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block < 0) {
+      continue;
+    }
+    for (int j = 0; j < instruction->operand_count; j++) {
+      if (instruction->operands[j].kind == SSA_OPERAND_VALUE &&
+          instruction->operands[j].value == value) {
+        instruction->operands[j] = replacement;
+      }
+    }
+  }
+}
+
+static int expected_successors(ssa_opcode opcode) {
+  switch (opcode) {
+    case SSA_JUMP:
+      return 1;
+    case SSA_BRANCH:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+static int has_predecessor(const ssa_block* block, int predecessor) {
+  for (int i = 0; i < block->predecessor_count; i++) {
+    if (block->predecessors[i] == predecessor) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Checks that a read in `block` at `position` sees a dominating definition.
+// A position past the end stands for the end of the block.
+static int is_available(const ssa_function* function, const int* positions,
+                        ssa_operand operand, int block, int position) {
+  if (operand.kind != SSA_OPERAND_VALUE) {
+    return 1;
+  }
+  if (operand.value < 0 || operand.value >= function->instruction_count) {
+    return 0;
+  }
+  const ssa_instruction* definition = &function->instructions[operand.value];
+  if (definition->block < 0 || !ssa_defines_value(definition)) {
+    return 0;
+  }
+  if (definition->block == block) {
+    return positions[operand.value] < position;
+  }
+  return ssa_block_dominates(function, definition->block, block);
+}
+
+static int verify_block(const ssa_function* function, const int* positions,
+                        int block_number) {
+  const ssa_block* block = &function->blocks[block_number];
+  if (block->instruction_count == 0) {
+    return 0;
+  }
+  for (int i = 0; i < block->successor_count; i++) {
+    if (!has_predecessor(&function->blocks[block->successors[i]],
+                         block_number)) {
+      return 0;
+    }
+  }
+  int phis_done = 0;
+  for (int i = 0; i < block->instruction_count; i++) {
+    int id = block->instructions[i];
+    const ssa_instruction* instruction = &function->instructions[id];
+    int last = i == block->instruction_count - 1;
+    if (instruction->block != block_number ||
+        is_terminator(instruction->opcode) != last ||
+        instruction->opcode == SSA_LOAD || instruction->opcode == SSA_STORE) {
+      return 0;
+    }
+    if (last &&
+        expected_successors(instruction->opcode) != block->successor_count) {
+      return 0;
+    }
+    if (instruction->opcode != SSA_PHI) {
+      phis_done = 1;
+      for (int j = 0; j < instruction->operand_count; j++) {
+        if (!is_available(function, positions, instruction->operands[j],
+                          block_number, i)) {
+          return 0;
+        }
+      }
+      continue;
+    }
+    if (phis_done || instruction->operand_count != block->predecessor_count) {
+      return 0;
+    }
+    for (int j = 0; j < instruction->operand_count; j++) {
+      if (!is_available(function, positions, instruction->operands[j],
+                        block->predecessors[j], INT_MAX)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+int verify_ssa_function(const ssa_function* function) {
+  int* positions = (int*)checked_malloc(sizeof(int) *
+                                        (size_t)function->instruction_count);
+  for (int i = 0; i < function->block_count; i++) {
+    const ssa_block* block = &function->blocks[i];
+    for (int j = 0; j < block->instruction_count; j++) {
+      positions[block->instructions[j]] = j;
+    }
+  }
+  int valid = 1;
+  for (int i = 0; i < function->block_count && valid; i++) {
+    valid = verify_block(function, positions, i);
+  }
+  free(positions);
+  return valid;
+}
+
+// ───── Output ─────
+
+static void print_operand(FILE* output, ssa_operand operand) {
+  if (operand.kind == SSA_OPERAND_VALUE) {
+    (void)fprintf(output, "v%d", operand.value);
+  } else if (operand.kind == SSA_OPERAND_CONSTANT) {
+    (void)fprintf(output, "%d", operand.value);
+  }
+}
+
+static void print_instruction(FILE* output, const ssa_function* function,
+                              int id) {
+  const ssa_instruction* instruction = &function->instructions[id];
+  const ssa_block* block = &function->blocks[instruction->block];
+  (void)fprintf(output, "        ");
+  if (ssa_defines_value(instruction)) {
+    (void)fprintf(output, "v%d = ", id);
+  }
+  (void)fprintf(output, "%s", opcode_names[instruction->opcode]);
+  switch (instruction->opcode) {
+    case SSA_PARAMETER:
+      (void)fprintf(output, " %d", instruction->index);
+      break;
+    case SSA_LOAD:
+    case SSA_STORE:
+      (void)fprintf(output, " s%d", instruction->index);
+      break;
+    case SSA_CALL:
+      (void)fprintf(output, " %.*s", instruction->symbol_length,
+                    instruction->symbol);
+      break;
+    default:
+      break;
+  }
+  for (int i = 0; i < instruction->operand_count; i++) {
+    (void)fprintf(output, "%s", i == 0 && instruction->opcode != SSA_STORE &&
+                                        instruction->opcode != SSA_CALL
+                                    ? " "
+                                    : ", ");
+    if (instruction->opcode == SSA_PHI) {
+      (void)fprintf(output, "[");
+      print_operand(output, instruction->operands[i]);
+      (void)fprintf(output, ", b%d]", block->predecessors[i]);
+    } else {
+      print_operand(output, instruction->operands[i]);
+    }
+  }
+  for (int i = 0; i < expected_successors(instruction->opcode); i++) {
+    (void)fprintf(output, "%sb%d",
+                  i == 0 && instruction->operand_count == 0 ? " " : ", ",
+                  block->successors[i]);
+  }
+  (void)fprintf(output, "\n");
+}
+
+void print_ssa_function(FILE* output, const ssa_function* function) {
+  (void)fprintf(output, "%.*s:\n", function->name_length, function->name);
+  for (int i = 0; i < function->block_count; i++) {
+    const ssa_block* block = &function->blocks[i];
+    (void)fprintf(output, "b%d:\n", i);
+    for (int j = 0; j < block->instruction_count; j++) {
+      print_instruction(output, function, block->instructions[j]);
+    }
+  }
+}
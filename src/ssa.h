@@ -0,0 +1,560 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "parser.h"
+
+typedef enum {
+  SSA_PARAMETER,  // Incoming argument number `index`.
+  SSA_ADD,
+  SSA_SUB,
+  SSA_MUL,
+  SSA_DIV,
+  SSA_MOD,
+  SSA_EQ,  // Comparisons give 1 when they hold and 0 otherwise.
+  SSA_NE,
+  SSA_LT,
+  SSA_GT,
+  SSA_LE,
+  SSA_GE,
+  SSA_SELECT,  // Operand 1 if operand 0 is nonzero, else operand 2.
+  SSA_CALL,    // Calls `symbol` with the operands as arguments.
+  SSA_PHI,     // One operand per predecessor, in predecessor order.
+  SSA_LOAD,    // Reads local slot `index` (before promotion only).
+  SSA_STORE,   // Writes operand 0 to local slot `index` (before promotion).
+  SSA_JUMP,    // Ends a block; continues at successors[0].
+  SSA_BRANCH,  // Ends a block; successors[0] if operand 0 is nonzero, else
+               // successors[1].
+  SSA_RETURN,  // Ends a block; returns operand 0 if there is one.
+} ssa_opcode;
+
+typedef enum {
+  SSA_OPERAND_NONE,
+  SSA_OPERAND_VALUE,     // The result of instruction `value`.
+  SSA_OPERAND_CONSTANT,  // The integer `value`.
+} ssa_operand_kind;
+
+typedef struct ssa_operand {
+  ssa_operand_kind kind;
+  int value;
+} ssa_operand;
+
+// Instructions are numbered by their position in the function's array, and
+// an instruction's number doubles as the name of the value it defines.
+typedef struct ssa_instruction {
+  ssa_opcode opcode;
+  int block;  // Block holding the instruction, or -1 once removed.
+  int index;  // PARAMETER position, or LOAD/STORE/PHI local slot.
+  const char* symbol;  // CALL target (not null-terminated).
+  int symbol_length;
+  ssa_operand* operands;
+  int operand_count;
+  int operand_capacity;
+} ssa_instruction;
+
+typedef struct ssa_block {
+  int* instructions;  // In execution order; phis first, terminator last.
+  int instruction_count;
+  int instruction_capacity;
+  int* predecessors;
+  int predecessor_count;
+  int predecessor_capacity;
+  int successors[2];
+  int successor_count;
+  // Filled in by compute_ssa_dominators:
+  int immediate_dominator;  // -1 for the entry and unreachable blocks.
+  int* dominator_children;
+  int dominator_child_count;
+  int dominator_depth;  // 0 for the entry block.
+} ssa_block;
+
+typedef struct ssa_function {
+  const char* name;
+  int name_length;
+  char* owned_name;  // Heap copy `name` points to when it was made up, else
+                     // NULL. Freed with the function.
+  int parameter_count;
+  int slot_count;  // Local slots from the resolver.
+  ssa_instruction* instructions;
+  int instruction_count;
+  int instruction_capacity;
+  ssa_block* blocks;  // blocks[0] is the entry.
+  int block_count;
+  int block_capacity;
+  // Reachable blocks in reverse postorder, from compute_ssa_dominators.
+  int* reverse_postorder;
+  int reachable_block_count;
+} ssa_function;
+
+// One read of a value: operand `operand` of instruction `instruction`.
+typedef struct ssa_use {
+  int instruction;
+  int operand;
+} ssa_use;
+
+typedef struct ssa_use_list {
+  ssa_use* uses;
+  int count;
+  int capacity;
+} ssa_use_list;
+
+// ───── Construction ─────
+
+/*
+Initializes an SSA function with just an empty entry block.
+
+Args:
+  function: Function to initialize.
+  name: Function name (not null-terminated).
+  name_length: Length of the name.
+
+Returns:
+  void
+*/
+void init_ssa_function(ssa_function* function, const char* name,
+                       int name_length);
+
+/*
+Releases everything an SSA function owns.
+
+Args:
+  function: Function to free.
+
+Returns:
+  void
+*/
+void free_ssa_function(ssa_function* function);
+
+/*
+Makes an independent copy of a function. Instructions and blocks keep their
+numbers, and the copy shares the original's name until it is given its own.
+
+Args:
+  source: Function to copy.
+  copy: Output function; free it with free_ssa_function.
+
+Returns:
+  void
+*/
+void copy_ssa_function(const ssa_function* source, ssa_function* copy);
+
+/*
+Finds the function a call names.
+
+Args:
+  functions: Every function of the program.
+  count: Number of functions.
+  call: SSA_CALL instruction.
+
+Returns:
+  The callee's index in functions, or -1 if it is not one of them.
+*/
+int find_ssa_function(const ssa_function* functions, int count,
+                      const ssa_instruction* call);
+
+/*
+Checks whether a function is main, which is called from outside the
+program and so must keep its signature.
+
+Args:
+  function: Function to check.
+
+Returns:
+  1 if the function is named main, 0 otherwise.
+*/
+int is_ssa_main(const ssa_function* function);
+
+/*
+Appends a new empty block.
+
+Args:
+  function: Function to add the block to.
+
+Returns:
+  The new block's number.
+*/
+int new_ssa_block(ssa_function* function);
+
+/*
+Adds a control-flow edge, recording it on both ends.
+
+Args:
+  function: Function holding both blocks.
+  from: Block the edge leaves.
+  to: Block the edge enters.
+
+Returns:
+  void
+*/
+void add_ssa_edge(ssa_function* function, int from, int to);
+
+/*
+Appends an instruction to the end of a block.
+
+Args:
+  function: Function to add to.
+  block: Block to append to.
+  opcode: Instruction opcode.
+  first: First operand (SSA_OPERAND_NONE if unused).
+  second: Second operand (SSA_OPERAND_NONE if unused).
+
+Returns:
+  The new instruction's number.
+*/
+int add_ssa_instruction(ssa_function* function, int block, ssa_opcode opcode,
+                        ssa_operand first, ssa_operand second);
+
+/*
+Inserts an instruction with no operands at a position inside a block.
+
+Args:
+  function: Function to add to.
+  block: Block to insert into.
+  position: Index in the block's instruction list to insert before.
+  opcode: Instruction opcode.
+
+Returns:
+  The new instruction's number.
+*/
+int insert_ssa_instruction(ssa_function* function, int block, int position,
+                           ssa_opcode opcode);
+
+/*
+Appends an operand to an instruction, such as a call argument or phi input.
+
+Args:
+  function: Function holding the instruction.
+  instruction: Instruction number.
+  operand: Operand to append.
+
+Returns:
+  void
+*/
+void add_ssa_operand(ssa_function* function, int instruction,
+                     ssa_operand operand);
+
+/*
+Takes an instruction out of its block. Its number stays reserved, and its
+block becomes -1.
+
+Args:
+  function: Function holding the instruction.
+  instruction: Instruction number.
+
+Returns:
+  void
+*/
+void remove_ssa_instruction(ssa_function* function, int instruction);
+
+/*
+Moves an instruction to a position inside another (or the same) block. It
+keeps its number, so its operands and every read of its value stay as they
+are.
+
+Args:
+  function: Function holding the instruction.
+  instruction: Instruction number.
+  block: Block to move it to.
+  position: Index in the block's instruction list, counted after the
+            instruction is taken out of its old place, to insert before.
+
+Returns:
+  void
+*/
+void move_ssa_instruction(ssa_function* function, int instruction, int block,
+                          int position);
+
+/*
+Builds an operand reading an instruction's result.
+
+Args:
+  instruction: Defining instruction number.
+
+Returns:
+  The operand.
+*/
+ssa_operand ssa_value(int instruction);
+
+/*
+Builds a constant operand.
+
+Args:
+  value: The integer.
+
+Returns:
+  The operand.
+*/
+ssa_operand ssa_constant(int value);
+
+/*
+Returns an operand with no content.
+
+Returns:
+  The operand.
+*/
+ssa_operand ssa_none(void);
+
+// ───── Building From the AST ─────
+
+/*
+Translates a function's AST into SSA over memory locals.
+
+Every local and parameter lives in its resolver slot: reads become
+SSA_LOAD, assignments SSA_STORE, and only expression temporaries are SSA
+values. if/else-if/else chains and while loops become blocks joined by
+branches, and statements after a return go into a block no edge reaches.
+Run promote_ssa_locals afterwards to get real SSA form. Resolves the
+function's variables first if that has not happened yet.
+
+Args:
+  node: AST_FUNCTION_DECLARATION node.
+  function: Uninitialized SSA function to fill in.
+
+Returns:
+  void
+*/
+void build_ssa_function(ast_node* node, ssa_function* function);
+
+/*
+Promotes every local slot to SSA values (mem2reg).
+
+Drops unreachable blocks, computes dominators and dominance frontiers,
+places a phi wherever a slot is live and two of its definitions meet
+(pruned SSA), then walks the dominator tree renaming loads to the reaching
+store's value. All loads and stores are gone afterwards. A slot read before
+any store on some path reads as 0.
+
+Args:
+  function: Function from build_ssa_function.
+
+Returns:
+  void
+*/
+void promote_ssa_locals(ssa_function* function);
+
+// ───── Control Flow and Dominators ─────
+
+/*
+Removes one control-flow edge from both ends, along with the phi inputs in
+`to` that flowed along it. The caller fixes up `from`'s terminator.
+
+Args:
+  function: Function holding both blocks.
+  from: Block the edge leaves.
+  to: Block the edge enters.
+
+Returns:
+  void
+*/
+void remove_ssa_edge(ssa_function* function, int from, int to);
+
+/*
+Appends a block to its only predecessor when that predecessor jumps
+straight to it. The predecessor's jump is dropped and it takes over the
+block's instructions and successors; the block is left empty with no edges,
+for remove_unreachable_ssa_blocks to delete. The block must have no phis.
+
+Args:
+  function: Function holding both blocks.
+  first: Block ending in a jump to second and nothing else.
+  second: Block whose only predecessor is first.
+
+Returns:
+  void
+*/
+void merge_ssa_blocks(ssa_function* function, int first, int second);
+
+/*
+Splits a block in two. The instructions from `position` on, terminator
+included, move to a new block that also takes over the successors; the
+original block is left with no terminator and no successors.
+
+Args:
+  function: Function holding the block.
+  block: Block to split.
+  position: Index of the first instruction to move.
+
+Returns:
+  The new block's number.
+*/
+int split_ssa_block(ssa_function* function, int block, int position);
+
+/*
+Deletes the blocks no path from the entry reaches and renumbers the rest,
+keeping their order.
+
+Args:
+  function: Function to clean up.
+
+Returns:
+  void
+*/
+void remove_unreachable_ssa_blocks(ssa_function* function);
+
+/*
+Renumbers the blocks so they come in a given order, which is the order
+lowering lays them out in. Recompute the dominators afterwards.
+
+Args:
+  function: Function to reorder.
+  order: The old number of the block to put at each position; a
+         permutation of every block, starting with the entry (0).
+
+Returns:
+  void
+*/
+void reorder_ssa_blocks(ssa_function* function, const int* order);
+
+/*
+Computes the dominator tree (Cooper, Harvey and Kennedy).
+
+Fills in reverse_postorder and, for each block, its immediate dominator,
+dominator-tree children and depth. Rerun after changing the CFG.
+
+Args:
+  function: Function to analyze.
+
+Returns:
+  void
+*/
+void compute_ssa_dominators(ssa_function* function);
+
+/*
+Checks whether one block dominates another. Needs compute_ssa_dominators.
+
+Args:
+  function: Function holding both blocks.
+  dominator: Candidate dominating block.
+  block: Block to test.
+
+Returns:
+  1 if every path from the entry to block passes through dominator
+  (including dominator == block), 0 otherwise.
+*/
+int ssa_block_dominates(const ssa_function* function, int dominator,
+                        int block);
+
+// ───── Values and Uses ─────
+
+/*
+Checks whether an instruction can run where the original program would not
+have run it: it has no side effects and cannot trap.
+
+Args:
+  instruction: Instruction to inspect.
+
+Returns:
+  1 for arithmetic, comparisons and selects, except division and modulo by
+  anything but a constant other than 0 and -1; 0 otherwise.
+*/
+int ssa_can_speculate(const ssa_instruction* instruction);
+
+/*
+Checks whether an instruction can trap at run time: a division or modulo
+whose divisor is not known to be a constant other than 0 and -1, since x / 0
+and INT_MIN / -1 fault in idiv.
+
+Args:
+  instruction: Instruction to inspect.
+
+Returns:
+  1 if the instruction may trap, 0 otherwise.
+*/
+int ssa_may_trap(const ssa_instruction* instruction);
+
+/*
+Evaluates an arithmetic or comparison opcode on two constants, with 32-bit
+wrapping semantics. The AST folder, value numbering and compile-time
+evaluation all go through it, so they agree on what wraps and what traps.
+
+Args:
+  opcode: SSA_ADD through SSA_GE.
+  left: First operand.
+  right: Second operand.
+  result: Set to the value when the function returns 1.
+
+Returns:
+  1 on success, or 0 for any other opcode and for division or modulo by
+  zero or INT_MIN / -1, which are left to trap at run time.
+*/
+int fold_ssa_binary(ssa_opcode opcode, int left, int right, int* result);
+
+/*
+Checks whether an instruction produces a value other instructions can read.
+
+Args:
+  instruction: Instruction to inspect.
+
+Returns:
+  1 for arithmetic, comparisons, parameters, calls, phis and loads, 0 for
+  stores and terminators.
+*/
+int ssa_defines_value(const ssa_instruction* instruction);
+
+/*
+Builds the def-use chains: for every instruction, the operands that read
+its value.
+
+Args:
+  function: Function to scan.
+
+Returns:
+  Heap-allocated array of instruction_count lists; release it with
+  free_ssa_use_lists.
+*/
+ssa_use_list* build_ssa_use_lists(const ssa_function* function);
+
+/*
+Releases lists from build_ssa_use_lists.
+
+Args:
+  lists: Lists to free.
+  count: Number of lists (the function's instruction_count).
+
+Returns:
+  void
+*/
+void free_ssa_use_lists(ssa_use_list* lists, int count);
+
+/*
+Rewrites every read of a value to read another operand instead.
+
+Args:
+  function: Function to rewrite.
+  value: Instruction whose value is replaced.
+  replacement: Operand to read instead.
+
+Returns:
+  void
+*/
+void replace_ssa_uses(ssa_function* function, int value,
+                      ssa_operand replacement);
+
+/*
+Checks the SSA invariants: every block ends in exactly one terminator
+matching its successors, phis come first with one input per predecessor,
+and every value read is defined by an instruction that dominates the read
+(for a phi input, the end of the matching predecessor). Needs
+compute_ssa_dominators.
+
+Args:
+  function: Function to check.
+
+Returns:
+  1 if the function is well formed, 0 otherwise.
+*/
+int verify_ssa_function(const ssa_function* function);
+
+// ───── Output ─────
+
+/*
+Prints an SSA function block by block, for debugging.
+
+Args:
+  output: Stream to print to.
+  function: Function to print.
+
+Returns:
+  void
+*/
+void print_ssa_function(FILE* output, const ssa_function* function);
@@ -0,0 +1,107 @@
+/*
+ * Tail Recursion
+ * Rewrites self-recursive tail calls on the SSA form as loops.
+ */
+
+#include "tail.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "codegen.h"
+#include "ssa.h"
+
+// Returns the self call a block ends with just before returning its
+// result, or -1.
+static int find_tail_recursion(const ssa_function* function, int block) {
+  const ssa_block* current = &function->blocks[block];
+  if (current->instruction_count < 2) {
+    return -1;
+  }
+  int call = current->instructions[current->instruction_count - 2];
+  const ssa_instruction* candidate = &function->instructions[call];
+  const ssa_instruction* terminator =
+      &function->instructions[current->instructions[current->instruction_count -
+                                                    1]];
+  if (candidate->opcode != SSA_CALL ||
+      candidate->symbol_length != function->name_length ||
+      strncmp(candidate->symbol, function->name,
+              (size_t)function->name_length) != 0 ||
+      candidate->operand_count != function->parameter_count) {
+    return -1;
+  }
+  if (terminator->opcode != SSA_RETURN || terminator->operand_count != 1 ||
+      terminator->operands[0].kind != SSA_OPERAND_VALUE ||
+      terminator->operands[0].value != call) {
+    return -1;
+  }
+  return call;
+}
+
+// Splits the entry block after its parameters and gives every parameter a
+// phi in the new loop header. Fills phis[index] for each parameter still
+// present and returns the header.
+static int add_loop_header(ssa_function* function, int* phis) {
+  const ssa_block* entry = &function->blocks[0];
+  int parameter_end = 0;
+  while (parameter_end < entry->instruction_count &&
+         function->instructions[entry->instructions[parameter_end]].opcode ==
+             SSA_PARAMETER) {
+    parameter_end++;
+  }
+  int header = split_ssa_block(function, 0, parameter_end);
+  add_ssa_instruction(function, 0, SSA_JUMP, ssa_none(), ssa_none());
+  add_ssa_edge(function, 0, header);
+
+  for (int i = 0; i < function->parameter_count; i++) {
+    phis[i] = -1;
+  }
+  for (int i = 0; i < parameter_end; i++) {
+    int parameter = function->blocks[0].instructions[i];
+    int phi = insert_ssa_instruction(function, header, i, SSA_PHI);
+    // Redirect the parameter's reads first so the phi keeps its own input.
+    replace_ssa_uses(function, parameter, ssa_value(phi));
+    add_ssa_operand(function, phi, ssa_value(parameter));
+    phis[function->instructions[parameter].index] = phi;
+  }
+  return header;
+}
+
+void eliminate_tail_recursion(ssa_function* function) {
+  int* calls =
+      (int*)checked_malloc(sizeof(int) * (size_t)function->block_count);
+  int call_count = 0;
+  for (int b = 0; b < function->block_count; b++) {
+    int call = find_tail_recursion(function, b);
+    if (call >= 0) {
+      calls[call_count++] = call;
+    }
+  }
+  if (call_count == 0) {
+    free(calls);
+    return;
+  }
+
+  int* phis = (int*)checked_malloc(sizeof(int) *
+                                   ((size_t)function->parameter_count + 1));
+  int header = add_loop_header(function, phis);
+  for (int i = 0; i < call_count; i++) {
+    // The block may have moved into the header if the call was in the entry.
+    int block = function->instructions[calls[i]].block;
+    const ssa_block* current = &function->blocks[block];
+    int terminator = current->instructions[current->instruction_count - 1];
+    for (int j = 0; j < function->parameter_count; j++) {
+      if (phis[j] >= 0) {
+        add_ssa_operand(function, phis[j],
+                        function->instructions[calls[i]].operands[j]);
+      }
+    }
+    remove_ssa_instruction(function, terminator);
+    remove_ssa_instruction(function, calls[i]);
+    add_ssa_instruction(function, block, SSA_JUMP, ssa_none(), ssa_none());
+    add_ssa_edge(function, block, header);
+  }
+  free(phis);
+  free(calls);
+  compute_ssa_dominators(function);
+}
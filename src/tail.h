@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ssa.h"
+
+/*
+Turns self-recursive tail calls into loops.
+
+A call to the function itself whose result is returned right away becomes a
+jump back to a loop header placed just after the parameters. Each parameter
+gets a phi in that header merging its incoming argument with the arguments
+of every such call, so the recursion runs in constant stack. Other calls
+are left alone. Recomputes the dominators when anything changes.
+
+Args:
+  function: Function with its locals promoted.
+
+Returns:
+  void
+*/
+void eliminate_tail_recursion(ssa_function* function);
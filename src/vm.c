@@ -0,0 +1,315 @@
+/*
+ * VM
+ * A register-based virtual machine that interprets the bytecode.
+ */
+
+#include "vm.h"
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "lexer.h"
+
+#ifndef VM_COMPUTED_GOTO
+#ifdef __GNUC__
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+#endif
+
+// Each handler is a label; VM_NEXT jumps to the next instruction's handler
+// directly, or goes back around the switch without computed goto.
+#if VM_COMPUTED_GOTO
+#define VM_CASE(opcode) opcode##_HANDLER:
+#define VM_NEXT() goto *handlers[*pc]
+#else
+#define VM_CASE(opcode) case opcode:
+#define VM_NEXT() continue
+#endif
+
+enum { INITIAL_REGISTER_CAPACITY = 1024, INITIAL_FRAME_CAPACITY = 64 };
+
+// Where to pick up again in the caller once a call returns.
+typedef struct vm_frame {
+  const int* code;  // The caller's code, which its jumps are relative to.
+  const int* return_pc;
+  size_t base;  // Stack index of the caller's register 0.
+  int result;   // Caller register that receives the return value.
+} vm_frame;
+
+// ───── Helpers ─────
+
+// Grows an array so it holds at least `needed` items.
+static void* reserve(void* items, size_t* capacity, size_t needed,
+                     size_t item_size) {
+  if (needed <= *capacity) {
+    return items;
+  }
+  size_t new_capacity = *capacity * 2;
+  if (new_capacity < needed) {
+    new_capacity = needed;
+  }
+  void* new_items = realloc(items, new_capacity * item_size);
+  if (new_items == NULL) {
+    error_and_exit("Error: Out of memory for the VM stack\n");
+  }
+  *capacity = new_capacity;
+  return new_items;
+}
+
+static int wrap(unsigned int value) { return (int)value; }
+
+// Fails where idiv traps: on a zero divisor and on INT_MIN / -1, whose
+// quotient does not fit.
+static void check_division(int dividend, int divisor) {
+  if (divisor == 0) {
+    error_and_exit("Error: Division by zero\n");
+  }
+  if (dividend == INT_MIN && divisor == -1) {
+    error_and_exit("Error: Division overflow\n");
+  }
+}
+
+static int divide(int dividend, int divisor) {
+  check_division(dividend, divisor);
+  return dividend / divisor;
+}
+
+static int modulo(int dividend, int divisor) {
+  check_division(dividend, divisor);
+  return dividend % divisor;
+}
+
+// ───── Interpreter ─────
+
+#if VM_COMPUTED_GOTO
+// Label addresses and computed goto are GNU extensions.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+int run_bytecode_program(const bytecode_program* program) {
+  if (program->main_function < 0) {
+    error_and_exit("Error: No main function to run\n");
+  }
+#if VM_COMPUTED_GOTO
+  static const void* const handlers[BYTECODE_OPCODE_COUNT] = {
+      [BYTECODE_CONSTANT] = &&BYTECODE_CONSTANT_HANDLER,
+      [BYTECODE_MOVE] = &&BYTECODE_MOVE_HANDLER,
+      [BYTECODE_ADD] = &&BYTECODE_ADD_HANDLER,
+      [BYTECODE_SUB] = &&BYTECODE_SUB_HANDLER,
+      [BYTECODE_MUL] = &&BYTECODE_MUL_HANDLER,
+      [BYTECODE_DIV] = &&BYTECODE_DIV_HANDLER,
+      [BYTECODE_MOD] = &&BYTECODE_MOD_HANDLER,
+      [BYTECODE_EQ] = &&BYTECODE_EQ_HANDLER,
+      [BYTECODE_NE] = &&BYTECODE_NE_HANDLER,
+      [BYTECODE_LT] = &&BYTECODE_LT_HANDLER,
+      [BYTECODE_GT] = &&BYTECODE_GT_HANDLER,
+      [BYTECODE_LE] = &&BYTECODE_LE_HANDLER,
+      [BYTECODE_GE] = &&BYTECODE_GE_HANDLER,
+      [BYTECODE_NEGATE] = &&BYTECODE_NEGATE_HANDLER,
+      [BYTECODE_ADD_CONSTANT] = &&BYTECODE_ADD_CONSTANT_HANDLER,
+      [BYTECODE_JUMP] = &&BYTECODE_JUMP_HANDLER,
+      [BYTECODE_JUMP_IF_ZERO] = &&BYTECODE_JUMP_IF_ZERO_HANDLER,
+      [BYTECODE_JUMP_IF_NONZERO] = &&BYTECODE_JUMP_IF_NONZERO_HANDLER,
+      [BYTECODE_JUMP_IF_EQ] = &&BYTECODE_JUMP_IF_EQ_HANDLER,
+      [BYTECODE_JUMP_IF_NE] = &&BYTECODE_JUMP_IF_NE_HANDLER,
+      [BYTECODE_JUMP_IF_LT] = &&BYTECODE_JUMP_IF_LT_HANDLER,
+      [BYTECODE_JUMP_IF_GT] = &&BYTECODE_JUMP_IF_GT_HANDLER,
+      [BYTECODE_JUMP_IF_LE] = &&BYTECODE_JUMP_IF_LE_HANDLER,
+      [BYTECODE_JUMP_IF_GE] = &&BYTECODE_JUMP_IF_GE_HANDLER,
+      [BYTECODE_CALL] = &&BYTECODE_CALL_HANDLER,
+      [BYTECODE_RETURN] = &&BYTECODE_RETURN_HANDLER,
+  };
+#endif
+
+  const bytecode_function* entry = &program->functions[program->main_function];
+  size_t register_capacity = INITIAL_REGISTER_CAPACITY;
+  if (register_capacity < (size_t)entry->register_count) {
+    register_capacity = (size_t)entry->register_count;
+  }
+  int* stack = (int*)calloc(register_capacity, sizeof(int));
+  size_t frame_capacity = INITIAL_FRAME_CAPACITY;
+  vm_frame* frames = (vm_frame*)malloc(sizeof(vm_frame) * frame_capacity);
+  if (stack == NULL || frames == NULL) {
+    error_and_exit("malloc failed");
+  }
+  size_t frame_count = 0;
+
+  size_t base = 0;
+  int* r = stack;  // The running function's registers.
+  const int* code = entry->code;
+  const int* pc = code;
+  int result = 0;
+
+#if VM_COMPUTED_GOTO
+  VM_NEXT();
+#else
+  for (;;) {
+    switch (*pc) {
+#endif
+  VM_CASE(BYTECODE_CONSTANT) {
+    r[pc[1]] = pc[2];
+    pc += 3;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_MOVE) {
+    r[pc[1]] = r[pc[2]];
+    pc += 3;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_ADD) {
+    r[pc[1]] = wrap((unsigned int)r[pc[2]] + (unsigned int)r[pc[3]]);
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_SUB) {
+    r[pc[1]] = wrap((unsigned int)r[pc[2]] - (unsigned int)r[pc[3]]);
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_MUL) {
+    r[pc[1]] = wrap((unsigned int)r[pc[2]] * (unsigned int)r[pc[3]]);
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_DIV) {
+    r[pc[1]] = divide(r[pc[2]], r[pc[3]]);
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_MOD) {
+    r[pc[1]] = modulo(r[pc[2]], r[pc[3]]);
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_EQ) {
+    r[pc[1]] = r[pc[2]] == r[pc[3]];
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_NE) {
+    r[pc[1]] = r[pc[2]] != r[pc[3]];
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_LT) {
+    r[pc[1]] = r[pc[2]] < r[pc[3]];
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_GT) {
+    r[pc[1]] = r[pc[2]] > r[pc[3]];
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_LE) {
+    r[pc[1]] = r[pc[2]] <= r[pc[3]];
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_GE) {
+    r[pc[1]] = r[pc[2]] >= r[pc[3]];
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_NEGATE) {
+    r[pc[1]] = wrap(0U - (unsigned int)r[pc[2]]);
+    pc += 3;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_ADD_CONSTANT) {
+    r[pc[1]] = wrap((unsigned int)r[pc[2]] + (unsigned int)pc[3]);
+    pc += 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP) {
+    pc = code + pc[1];
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_ZERO) {
+    pc = r[pc[1]] == 0 ? code + pc[2] : pc + 3;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_NONZERO) {
+    pc = r[pc[1]] != 0 ? code + pc[2] : pc + 3;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_EQ) {
+    pc = r[pc[1]] == r[pc[2]] ? code + pc[3] : pc + 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_NE) {
+    pc = r[pc[1]] != r[pc[2]] ? code + pc[3] : pc + 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_LT) {
+    pc = r[pc[1]] < r[pc[2]] ? code + pc[3] : pc + 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_GT) {
+    pc = r[pc[1]] > r[pc[2]] ? code + pc[3] : pc + 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_LE) {
+    pc = r[pc[1]] <= r[pc[2]] ? code + pc[3] : pc + 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_JUMP_IF_GE) {
+    pc = r[pc[1]] >= r[pc[2]] ? code + pc[3] : pc + 4;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_CALL) {
+    const bytecode_function* callee = &program->functions[pc[2]];
+    frames = (vm_frame*)reserve(frames, &frame_capacity, frame_count + 1,
+                                sizeof(vm_frame));
+    frames[frame_count].code = code;
+    frames[frame_count].return_pc = pc + 5;
+    frames[frame_count].base = base;
+    frames[frame_count].result = pc[1];
+    frame_count++;
+    base += (size_t)pc[3];
+    stack = (int*)reserve(stack, &register_capacity,
+                          base + (size_t)callee->register_count, sizeof(int));
+    r = stack + base;
+    memset(r + callee->parameter_count, 0,
+           sizeof(int) *
+               (size_t)(callee->register_count - callee->parameter_count));
+    code = callee->code;
+    pc = code;
+    VM_NEXT();
+  }
+  VM_CASE(BYTECODE_RETURN) {
+    int value = r[pc[1]];
+    if (frame_count == 0) {
+      result = value;
+      goto finished;
+    }
+    const vm_frame* frame = &frames[--frame_count];
+    base = frame->base;
+    r = stack + base;
+    r[frame->result] = value;
+    code = frame->code;
+    pc = frame->return_pc;
+    VM_NEXT();
+  }
+#if !VM_COMPUTED_GOTO
+      default:
+        error_and_exit("Error: Invalid bytecode\n");
+    }
+  }
+#endif
+
+finished:
+  free(stack);
+  free(frames);
+  return result;
+}
+
+#if VM_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "bytecode.h"
+
+/*
+Runs a bytecode program's main function and returns its result.
+
+Each handler ends by dispatching the next instruction itself. With GCC or
+Clang that is an indirect jump through a table of label addresses
+(computed goto); other compilers, or building with VM_COMPUTED_GOTO set to
+0, use a switch in a loop instead. Registers live on one stack that grows
+as calls nest, and a call's frame starts at its arguments, so nothing is
+copied to pass them. Arithmetic wraps at 32 bits like the native code.
+Exits if the program has no main, divides by zero or divides INT_MIN by
+-1, the cases where the native idiv traps.
+
+Args:
+  program: Program from compile_bytecode_program.
+
+Returns:
+  The value main returned.
+*/
+int run_bytecode_program(const bytecode_program* program);
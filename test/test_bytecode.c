@@ -0,0 +1,85 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include <limits.h>
+
+#include "../src/bytecode.h"
+#include "../src/vm.h"
+#include "test_helpers.h"
+
+// Parse a file and compile all of its functions to bytecode
+static void compile_path(const char* path, bytecode_program* program) {
+  ast_node** ast = parse_path(path);
+  int function_count = 0;
+  while (ast[function_count] != NULL) {
+    function_count++;
+  }
+  compile_bytecode_program(ast, function_count, program);
+}
+
+// Count the instructions in a function with a given opcode
+static int count_opcode(const bytecode_function* function,
+                        bytecode_opcode opcode) {
+  int count = 0;
+  for (int pc = 0; pc < function->code_size;) {
+    bytecode_opcode current = (bytecode_opcode)function->code[pc];
+    if (current == opcode) {
+      count++;
+    }
+    pc += 1 + get_bytecode_operand_count(current);
+  }
+  return count;
+}
+
+// Test 1: Comparisons in conditions and constant adds are fused
+Test(bytecode, superinstructions) {
+  bytecode_program program;
+  compile_path(CMAKE_SOURCE_DIR "/test/test_inputs/bytecode_inputs/loops.c",
+               &program);
+  cr_assert_eq(program.function_count, 2);
+  cr_expect_eq(program.main_function, 1);
+
+  const bytecode_function* classify = &program.functions[0];
+  cr_expect_eq(classify->parameter_count, 2);
+  // i == n and i > n each skip their arm when false; i < limit loops back.
+  cr_expect_eq(count_opcode(classify, BYTECODE_JUMP_IF_NE), 1);
+  cr_expect_eq(count_opcode(classify, BYTECODE_JUMP_IF_LE), 1);
+  cr_expect_eq(count_opcode(classify, BYTECODE_JUMP_IF_LT), 1);
+  cr_expect_eq(count_opcode(classify, BYTECODE_EQ), 0);
+  cr_expect_eq(count_opcode(classify, BYTECODE_LT), 0);
+  cr_expect_eq(count_opcode(classify, BYTECODE_JUMP_IF_ZERO), 0);
+  // total + 100, total - 2 and i + 1.
+  cr_expect_eq(count_opcode(classify, BYTECODE_ADD_CONSTANT), 3);
+  // Variables are read in place, never copied.
+  cr_expect_eq(count_opcode(classify, BYTECODE_MOVE), 0);
+  free_bytecode_program(&program);
+}
+
+// Test 2: Loops and if chains run to the right result
+Test(bytecode, runs_control_flow) {
+  bytecode_program program;
+  compile_path(CMAKE_SOURCE_DIR "/test/test_inputs/bytecode_inputs/loops.c",
+               &program);
+  cr_expect_eq(run_bytecode_program(&program), 104);
+  free_bytecode_program(&program);
+}
+
+// Test 3: Calls pass arguments in place and arithmetic wraps at 32 bits
+Test(bytecode, calls_and_wrapping) {
+  bytecode_program program;
+  compile_path(CMAKE_SOURCE_DIR "/test/test_inputs/bytecode_inputs/calls.c",
+               &program);
+  // fib(10) + INT_MAX + (-17 % 5) wraps around to INT_MIN + 52.
+  cr_expect_eq(run_bytecode_program(&program), INT_MIN + 52);
+  free_bytecode_program(&program);
+}
+
+// Test 4: Recursion a million calls deep grows the register stack
+Test(bytecode, deep_recursion) {
+  bytecode_program program;
+  compile_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/tail_calls.c",
+      &program);
+  cr_expect_eq(run_bytecode_program(&program), 1000008);
+  free_bytecode_program(&program);
+}
+// NOLINTEND(misc-include-cleaner)
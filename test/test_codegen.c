@@ -119,23 +119,18 @@ Test(codegen, return_binary_expression) {
   print_instructions(&list);
 
   int found6 = 0;
-  int found2 = 0;
   int foundAdd = 0;
   for (int i = 0; i < list.instruction_count; i++) {
-    if (strstr(list.instructions[i], "mov     edx, 2")) {
-      found2 = 1;
-    }
     if (strstr(list.instructions[i], "mov     eax, 6")) {
       found6 = 1;
     }
-    if (strstr(list.instructions[i], "add     eax, edx")) {
+    if (strstr(list.instructions[i], "add     eax, 2")) {
       foundAdd = 1;
     }
   }
 
   cr_expect(found6, "Expected: mov eax, 6");
-  cr_expect(found2, "Expected: mov edx, 2");
-  cr_expect(foundAdd, "Expected: add eax, edx");
+  cr_expect(foundAdd, "Expected: add eax, 2");
 
   free(src);
   free(toks);
@@ -163,10 +158,11 @@ Test(codegen, function_call) {
     if (strstr(list.instructions[i], "call    test")) {
       foundCall = 1;
     }
-    if (strstr(list.instructions[i], "mov     edi, eax")) {
+    // Literal arguments load straight into their registers.
+    if (strstr(list.instructions[i], "mov     edi, 1")) {
       foundEdi = 1;
     }
-    if (strstr(list.instructions[i], "mov     esi, eax")) {
+    if (strstr(list.instructions[i], "mov     esi, 2")) {
       foundEsi = 1;
     }
   }
@@ -201,13 +197,13 @@ Test(codegen, var_decl_initialization) {
     if (strstr(ins, "mov     eax, 5")) {
       foundMov5 = 1;
     }
-    if (strstr(ins, "mov     DWORD PTR [rbp-4]")) {
+    if (strstr(ins, "mov     DWORD PTR [rsp-4]")) {
       foundStore = 1;
     }
   }
 
   cr_expect(foundMov5, "Expected: mov     eax, 5");
-  cr_expect(foundStore, "Expected: mov     DWORD PTR [rbp-4], eax");
+  cr_expect(foundStore, "Expected: mov     DWORD PTR [rsp-4], eax");
 
   free(src);
   free(toks);
@@ -228,25 +224,20 @@ Test(codegen, multiplication) {
   list_of_ast_function_nodes_to_x86(ast, &list, numFns);
   print_instructions(&list);
 
-  int foundMov3 = 0;
   int foundMov7 = 0;
   int foundImul = 0;
   for (int i = 0; i < list.instruction_count; i++) {
     const char* ins = list.instructions[i];
-    if (strstr(ins, "mov     edx, 3")) {
-      foundMov3 = 1;
-    }
     if (strstr(ins, "mov     eax, 7")) {
       foundMov7 = 1;
     }
-    if (strstr(ins, "imul     eax, edx")) {
+    if (strstr(ins, "imul    eax, 3")) {
       foundImul = 1;
     }
   }
 
   cr_expect(foundMov7, "Expected: mov     eax, 7");
-  cr_expect(foundMov3, "Expected: mov     edx, 3");
-  cr_expect(foundImul, "Expected: imul    eax, edx");
+  cr_expect(foundImul, "Expected: imul    eax, 3");
 
   free(src);
   free(toks);
@@ -269,23 +260,29 @@ Test(codegen, division) {
 
   int foundMov2 = 0;
   int foundMov10 = 0;
+  int foundCdq = 0;
   int foundIdiv = 0;
   for (int i = 0; i < list.instruction_count; i++) {
     const char* ins = list.instructions[i];
-    if (strstr(ins, "mov     edx, 2")) {
+    if (strstr(ins, "mov     ecx, 2")) {
       foundMov2 = 1;
     }
     if (strstr(ins, "mov     eax, 10")) {
       foundMov10 = 1;
     }
-    if (strstr(ins, "idiv     eax, edx")) {
+    if (strstr(ins, "cdq")) {
+      foundCdq = 1;
+    }
+    if (strstr(ins, "idiv    ecx")) {
       foundIdiv = 1;
     }
   }
 
+  // idiv has no immediate form, and edx receives the sign of eax.
   cr_expect(foundMov10, "Expected: mov     eax, 10");
-  cr_expect(foundMov2, "Expected: mov     edx, 2");
-  cr_expect(foundIdiv, "Expected: idiv    eax, edx");
+  cr_expect(foundMov2, "Expected: mov     ecx, 2");
+  cr_expect(foundCdq, "Expected: cdq");
+  cr_expect(foundIdiv, "Expected: idiv    ecx");
 
   free(src);
   free(toks);
@@ -381,17 +378,258 @@ Test(codegen, decl_and_return) {
     if (strstr(ins, "mov     eax, 9")) {
       foundMov9 = 1;
     }
-    if (strstr(ins, "mov     DWORD PTR [rbp-4]")) {
+    if (strstr(ins, "mov     DWORD PTR [rsp-4]")) {
       foundStoreX = 1;
     }
-    if (strstr(ins, "mov     eax, DWORD PTR [rbp-4]")) {
+    if (strstr(ins, "mov     eax, DWORD PTR [rsp-4]")) {
       foundLoadX = 1;
     }
   }
 
   cr_expect(foundMov9, "Expected: mov     eax, 9");
-  cr_expect(foundStoreX, "Expected: mov     DWORD PTR [rbp-4], eax");
-  cr_expect(foundLoadX, "Expected: mov     eax, DWORD PTR [rbp-4]");
+  cr_expect(foundStoreX, "Expected: mov     DWORD PTR [rsp-4], eax");
+  cr_expect(foundLoadX, "Expected: mov     eax, DWORD PTR [rsp-4]");
+
+  free(src);
+  free(toks);
+}
+
+static char* copy_name(const char* name) {
+  char* copy = malloc(strlen(name) + 1);
+  cr_assert_not_null(copy);
+  strcpy(copy, name);
+  return copy;
+}
+
+// Test 10: Inner scopes shadow outer variables and restore them on pop
+Test(codegen, memory_scopes) {
+  memory mem;
+  init_memory(&mem);
+
+  add_variable_to_memory(&mem, copy_name("x"));
+  add_variable_to_memory(&mem, copy_name("y"));
+  cr_expect_eq(get_variable_memory_location(&mem, "x", 1), -4);
+  cr_expect_eq(get_variable_memory_location(&mem, "y", 1), -8);
+
+  push_memory_scope(&mem);
+  add_variable_to_memory(&mem, copy_name("x"));
+  add_variable_to_memory(&mem, copy_name("z"));
+  cr_expect_eq(get_variable_memory_location(&mem, "x", 1), -12);
+  cr_expect_eq(get_variable_memory_location(&mem, "z", 1), -16);
+  cr_expect_eq(get_variable_memory_location(&mem, "y", 1), -8);
+  pop_memory_scope(&mem);
+
+  cr_expect_eq(get_variable_memory_location(&mem, "x", 1), -4);
+  cr_expect_eq(get_variable_memory_location(&mem, "z", 1), -1);
+
+  // Freed slots are reused by the next declaration in the outer scope.
+  add_variable_to_memory(&mem, copy_name("w"));
+  cr_expect_eq(get_variable_memory_location(&mem, "w", 1), -12);
+
+  free_memory(&mem);
+}
+
+enum { MANY_VARIABLES = 2000, NAME_BUFFER_SIZE = 16 };
+
+// Test 11: Lookups stay correct as the table grows past its initial size
+Test(codegen, memory_many_variables) {
+  memory mem;
+  init_memory(&mem);
+
+  char name[NAME_BUFFER_SIZE];
+  for (int i = 0; i < MANY_VARIABLES; i++) {
+    (void)snprintf(name, sizeof(name), "t%d", i);
+    add_variable_to_memory(&mem, copy_name(name));
+  }
+  for (int i = 0; i < MANY_VARIABLES; i++) {
+    (void)snprintf(name, sizeof(name), "t%d", i);
+    cr_expect_eq(get_variable_memory_location(&mem, name, (int)strlen(name)),
+                 -4 * (i + 1));
+  }
+  cr_expect_eq(get_variable_memory_location(&mem, "t", 1), -1);
+
+  free_memory(&mem);
+}
+
+// Test 12: The resolver binds slots once, reusing slots of closed scopes
+Test(codegen, resolve_slots) {
+  char* src = read_file(CMAKE_SOURCE_DIR
+                        "/test/test_inputs/codegen_inputs/resolve_slots.c");
+  int tokc = 0;
+  Token* toks = lex_all(src, &tokc);
+  ast_node** ast = parse_file(toks, tokc);
+  cr_assert_not_null(ast);
+
+  int numFns = ast_count(ast);
+  resolve_variables(ast, numFns);
+
+  ast_node* body = ast[0]->as.function.statements;
+  ast_node* decl_a = body->as.block.statements[0];
+  ast_node* decl_b = body->as.block.statements[1];
+  ast_node* if_body =
+      body->as.block.statements[2]->as.if_elif_else_statement.body;
+  ast_node* decl_c = if_body->as.block.statements[0];
+  ast_node* decl_d = body->as.block.statements[3];
+  ast_node* ret = body->as.block.statements[4];
+
+  cr_expect_eq(decl_a->as.declaration.variable->slot, 0);
+  cr_expect_eq(decl_b->as.declaration.variable->slot, 1);
+  cr_expect_eq(decl_b->as.declaration.expression->as.binary.left->slot, 0);
+  cr_expect_eq(decl_c->as.declaration.variable->slot, 2);
+  cr_expect_eq(decl_c->as.declaration.expression->slot, 1);
+  // c's scope is closed, so d reuses its slot.
+  cr_expect_eq(decl_d->as.declaration.variable->slot, 2);
+  cr_expect_eq(ret->as._return.expression->slot, 2);
+  cr_expect_eq(ast[0]->as.function.slot_count, 3);
+
+  list_of_x86_instructions list;
+  init_list_of_instructions(&list);
+  list_of_ast_function_nodes_to_x86(ast, &list, numFns);
+
+  int foundLoadD = 0;
+  for (int i = 0; i < list.instruction_count; i++) {
+    if (strstr(list.instructions[i], "mov     eax, DWORD PTR [rsp-12]")) {
+      foundLoadD = 1;
+    }
+  }
+  cr_expect(foundLoadD, "Expected: mov     eax, DWORD PTR [rsp-12]");
+
+  free(src);
+  free(toks);
+}
+
+// Test 13: Leaf functions use the red zone; callers get an aligned frame
+Test(codegen, leaf_and_call_frames) {
+  char* src =
+      read_file(CMAKE_SOURCE_DIR "/test/test_inputs/codegen_inputs/frames.c");
+  int tokc = 0;
+  Token* toks = lex_all(src, &tokc);
+  ast_node** ast = parse_file(toks, tokc);
+  cr_assert_not_null(ast);
+
+  list_of_x86_instructions list;
+  init_list_of_instructions(&list);
+  list_of_ast_function_nodes_to_x86(ast, &list, ast_count(ast));
+
+  int inMain = 0;
+  int leafPushes = 0;
+  int leafRedZoneStore = 0;
+  int mainPush = 0;
+  int mainFrame = 0;
+  int mainRestore = 0;
+  for (int i = 0; i < list.instruction_count; i++) {
+    const char* ins = list.instructions[i];
+    if (strcmp(ins, "main:") == 0) {
+      inMain = 1;
+    }
+    if (!inMain) {
+      leafPushes += strstr(ins, "push") != NULL;
+      leafRedZoneStore |= strstr(ins, "DWORD PTR [rsp-12], eax") != NULL;
+    } else {
+      mainPush |= strstr(ins, "push    rbp") != NULL;
+      mainFrame |= strstr(ins, "sub     rsp, 16") != NULL;
+      mainRestore |= strstr(ins, "mov     rsp, rbp") != NULL;
+    }
+  }
+
+  cr_expect_eq(leafPushes, 0, "Expected no prologue in the leaf function");
+  cr_expect(leafRedZoneStore, "Expected: mov     DWORD PTR [rsp-12], eax");
+  cr_expect(mainPush, "Expected: push    rbp in main");
+  // Two 4-byte slots round up to one 16-byte aligned frame.
+  cr_expect(mainFrame, "Expected: sub     rsp, 16 in main");
+  cr_expect(mainRestore, "Expected: mov     rsp, rbp in main");
+
+  free(src);
+  free(toks);
+}
+
+// Test 14: The operand needing more registers is evaluated first
+Test(codegen, sethi_ullman_order) {
+  char* src = read_file(CMAKE_SOURCE_DIR
+                        "/test/test_inputs/codegen_inputs/register_need.c");
+  int tokc = 0;
+  Token* toks = lex_all(src, &tokc);
+  ast_node** ast = parse_file(toks, tokc);
+  cr_assert_not_null(ast);
+
+  list_of_x86_instructions list;
+  init_list_of_instructions(&list);
+  list_of_ast_function_nodes_to_x86(ast, &list, ast_count(ast));
+
+  // a + (b * (c - d)): the right side needs two registers and the left one,
+  // so the right goes first and the whole expression fits in eax and ecx.
+  const char* expected[] = {
+      "        mov     ecx, DWORD PTR [rsp-8]",
+      "        mov     eax, DWORD PTR [rsp-12]",
+      "        sub     eax, DWORD PTR [rsp-16]",
+      "        imul    ecx, eax",
+      "        mov     eax, DWORD PTR [rsp-4]",
+      "        add     eax, ecx",
+      "        mov     DWORD PTR [rsp-20], eax",
+  };
+  int expected_count = (int)(sizeof(expected) / sizeof(expected[0]));
+  int start = -1;
+  for (int i = 0; i < list.instruction_count; i++) {
+    if (strcmp(list.instructions[i], expected[0]) == 0) {
+      start = i;
+      break;
+    }
+  }
+  cr_assert_geq(start, 0, "Expected: %s", expected[0]);
+  cr_assert_leq(start + expected_count, list.instruction_count);
+  for (int i = 0; i < expected_count; i++) {
+    cr_expect_str_eq(list.instructions[start + i], expected[i]);
+  }
+
+  free(src);
+  free(toks);
+}
+
+// Test 15: Branch conditions compare right before the jump, and loops test
+// at the bottom
+Test(codegen, fused_compare_and_branch) {
+  char* src = read_file(CMAKE_SOURCE_DIR
+                        "/test/test_inputs/codegen_inputs/branches.c");
+  int tokc = 0;
+  Token* toks = lex_all(src, &tokc);
+  ast_node** ast = parse_file(toks, tokc);
+  cr_assert_not_null(ast);
+
+  list_of_x86_instructions list;
+  init_list_of_instructions(&list);
+  list_of_ast_function_nodes_to_x86(ast, &list, ast_count(ast));
+
+  // Only `below`, a comparison used as a value, is materialized with setcc.
+  int set_count = 0;
+  for (int i = 0; i < list.instruction_count; i++) {
+    if (strncmp(list.instructions[i], "        set", 11) == 0) {
+      set_count++;
+    }
+  }
+  cr_expect_eq(set_count, 1, "Expected one setcc, got %d", set_count);
+
+  const char* expected[] = {
+      ".Lclassify_1:",
+      "        mov     eax, DWORD PTR [rsp-4]",
+      "        cmp     eax, DWORD PTR [rsp-8]",
+      "        jg      .Lclassify_0",
+      "        mov     eax, DWORD PTR [rsp-12]",
+      "        test    eax, eax",
+      "        je      .Lclassify_2",
+  };
+  int expected_count = (int)(sizeof(expected) / sizeof(expected[0]));
+  int start = -1;
+  for (int i = 0; i < list.instruction_count; i++) {
+    if (strcmp(list.instructions[i], expected[0]) == 0) {
+      start = i;
+      break;
+    }
+  }
+  cr_assert_geq(start, 0, "Expected: %s", expected[0]);
+  cr_assert_leq(start + expected_count, list.instruction_count);
+  for (int i = 0; i < expected_count; i++) {
+    cr_expect_str_eq(list.instructions[start + i], expected[i]);
+  }
 
   free(src);
   free(toks);
@@ -251,5 +251,427 @@ Test(compiler, full_system_func_params) {
   cr_expect_eq(result, 5, "Expected return 5 from binary");
 }
 
+// Test 6: -O1 register-allocated build of the same program
+Test(compiler, full_system_func_params_O1) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/func_params_call.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O1"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  cr_expect_eq(result, 5, "Expected return 5 from binary");
+}
+
+// Test 7: -O2 graph-coloring build of the same program
+Test(compiler, full_system_func_params_O2) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/func_params_call.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O2"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  cr_expect_eq(result, 5, "Expected return 5 from binary");
+}
+
+// Test 8: -O1 build with constant multiplies, divides and remainders
+Test(compiler, full_system_strength_reduction_O1) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/strength_reduction.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O1"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  // 23 / 7 + 23 % 8 + 23 * 9
+  cr_expect_eq(result, 217, "Expected return 217 from binary");
+}
+
+// Test 9: -O0 build evaluating operands that are themselves expressions
+Test(compiler, full_system_nested_expression) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/nested_expression.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  // Operators group to the right: 6 * (4 - (6 - 4 * 2))
+  cr_expect_eq(result, 36, "Expected return 36 from binary");
+}
+
+// Test 10: -O1 build of a loop around an if/else-if/else chain
+Test(compiler, full_system_control_flow_O1) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/control_flow.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O1"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  // 0 + 1 + 2, then + 10 at i == 3, then - 1 for i = 4..9
+  cr_expect_eq(result, 7, "Expected return 7 from binary");
+}
+
+// Test 11: -O2 build of the same program
+Test(compiler, full_system_control_flow_O2) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/control_flow.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O2"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  cr_expect_eq(result, 7, "Expected return 7 from binary");
+}
+
+// Test 12: Tail calls and tail recursion run a million deep in constant stack
+Test(compiler, full_system_tail_calls) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/tail_calls.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O2"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  // 1000007 % 256 from count, plus 1 from is_even.
+  cr_expect_eq(result, 72, "Expected return 72 from binary");
+}
+
+// Test 13: -O0 build with calls on both sides of an operator
+Test(compiler, full_system_call_operands) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/call_operands.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  // c = 14 - (6 % 4) = 12, d = 7 * (3 - 12 / 3) = -7
+  cr_expect_eq(result, 5, "Expected return 5 from binary");
+}
+
+// Test 14: -O0 build of the loop around an if/else-if/else chain
+Test(compiler, full_system_control_flow) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/control_flow.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  cr_expect_eq(result, 7, "Expected return 7 from binary");
+}
+
+// Test 15: -O1 build where short ifs become conditional moves
+Test(compiler, full_system_selects_O1) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/selects.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O1"), 0, "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+  cr_expect_eq(system("grep -q cmov chat.s"), 0, "Expected a cmov");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  // The absolute differences sum to 25, and the larger of 25 and 30 is 30.
+  cr_expect_eq(result, 55, "Expected return 55 from binary");
+}
+
+// Test 16: -O2 build with loop unrolling
+Test(compiler, full_system_unroll_loops) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/unroll.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O2 -funroll-loops"), 0,
+               "Compiler run failed");
+  cr_assert(access("chat.s", F_OK) == 0, "chat.s not generated");
+
+  cr_assert_eq(system("as -o abcd.o chat.s"), 0, "as failed");
+  cr_assert_eq(system("ld -o abcd abcd.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  // s = 0 + 1 + 2 + 3 = 6 and t = 3 * (0 + ... + 22) = 759, so 765 % 256
+  cr_expect_eq(result, 253, "Expected return 253 from binary");
+}
+
+// Test 17: Object file written by the built-in encoder, linked without as
+Test(compiler, full_system_object_output) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/strength_reduction.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  (void)remove("chat.o");
+  cr_assert_eq(system("./compiler_main -O2 -c"), 0, "Compiler run failed");
+  cr_assert(access("chat.o", F_OK) == 0, "chat.o not generated");
+
+  cr_assert_eq(system("ld -o abcd chat.o"), 0, "ld failed");
+  int result = run_and_get_exit("./abcd");
+  cr_expect_eq(result, 217, "Expected return 217 from binary");
+
+  // The unoptimized build divides with cdq and idiv instead of shifts.
+  cr_assert_eq(system("./compiler_main -O0 -c"), 0, "Compiler run failed");
+  cr_assert_eq(system("ld -o abcd chat.o"), 0, "ld failed");
+  result = run_and_get_exit("./abcd");
+  cr_expect_eq(result, 217, "Expected return 217 from binary");
+}
+
+// Test 18: -static writes a runnable executable without as or ld
+Test(compiler, full_system_static_executable) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/strength_reduction.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  (void)remove("chat");
+  cr_assert_eq(system("./compiler_main -O2 -static"), 0,
+               "Compiler run failed");
+  cr_assert(access("chat", X_OK) == 0, "chat not generated as executable");
+
+  int result = run_and_get_exit("./chat");
+  cr_expect_eq(result, 217, "Expected return 217 from binary");
+}
+
+// Test 19: --run calls main in memory and exits with its result
+Test(compiler, full_system_jit_run) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/strength_reduction.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  int result = run_and_get_exit("./compiler_main -O2 --run > /dev/null");
+  cr_expect_eq(result, 217, "Expected main to return 217");
+  result = run_and_get_exit("./compiler_main -O0 --run > /dev/null");
+  cr_expect_eq(result, 217, "Expected main to return 217");
+}
+
+// Test 20: --interpret runs main on the bytecode virtual machine
+Test(compiler, full_system_bytecode_interpreter) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/control_flow.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  int result = run_and_get_exit("./compiler_main --interpret > /dev/null");
+  cr_expect_eq(result, 7, "Expected main to return 7");
+  result = run_and_get_exit("./compiler_main -O1 --interpret > /dev/null");
+  cr_expect_eq(result, 7, "Expected main to return 7");
+}
+
+// Test 21: Calls with constant arguments are evaluated while compiling
+Test(compiler, full_system_constant_calls) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/constant_calls.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O2 > /dev/null"), 0,
+               "Compiler run failed");
+  // fib(10) is 55 and test(1, 2) is 11, both worked out at compile time.
+  cr_expect_eq(system("grep -A2 '^main:' chat.s | grep -q 'eax, 66'"), 0,
+               "Expected main to return the constant 66");
+  cr_assert_eq(system("./compiler_main -O2 -static > /dev/null"), 0,
+               "Compiler run failed");
+  int result = run_and_get_exit("./chat");
+  cr_expect_eq(result, 66, "Expected return 66 from binary");
+}
+
+// Test 22: Copies specialized on a mode flag replace the generic calls
+Test(compiler, full_system_specialization) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/specialize.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O1 -fno-inline > /dev/null"), 0,
+               "Compiler run failed");
+  cr_expect_eq(system("grep -q 'call    apply\\.1' chat.s"), 0,
+               "Expected main to call a specialized copy");
+  cr_assert_eq(system("./compiler_main -O1 -fno-inline -static > /dev/null"),
+               0, "Compiler run failed");
+  // Each trip adds i and subtracts 3 * i, so s = -380, which exits as 132.
+  int result = run_and_get_exit("./chat");
+  cr_expect_eq(result, 132, "Expected return 132 from binary");
+}
+
+// Test 23: A seventh argument is rejected at every level, not miscompiled
+Test(compiler, full_system_too_many_arguments) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/too_many_arguments.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_expect_neq(system("./compiler_main -O0 > /dev/null 2>&1"), 0,
+                "Expected -O0 to reject seven arguments");
+  cr_expect_neq(system("./compiler_main -O1 > /dev/null 2>&1"), 0,
+                "Expected -O1 to reject seven arguments");
+}
+
+// Test 24: -fdump-ssa prints every function's final SSA, copies included
+Test(compiler, full_system_dump_ssa) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/specialize.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(
+      system("./compiler_main -O1 -fno-inline -fdump-ssa > /dev/null "
+             "2> dump.txt"),
+      0, "Compiler run failed");
+  cr_expect_eq(system("grep -q '^main:' dump.txt"), 0,
+               "Expected the SSA of main");
+  cr_expect_eq(system("grep -q '^apply\\.1:' dump.txt"), 0,
+               "Expected the SSA of the specialized copy");
+}
+
+// Test 25: -fdump-lir prints each function's LIR after allocation
+Test(compiler, full_system_dump_lir) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/func_params_call.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  cr_assert_eq(system("./compiler_main -O2 -fdump-lir > /dev/null 2> dump.txt"),
+               0, "Compiler run failed");
+  cr_expect_eq(system("grep -q '^main:' dump.txt"), 0,
+               "Expected the LIR of main");
+  cr_expect_eq(system("grep -q 'ret' dump.txt"), 0,
+               "Expected a return in the LIR");
+}
+
+// Test 26: -fdump-bytecode prints the program before the VM runs it
+Test(compiler, full_system_dump_bytecode) {
+  copy_file(CMAKE_SOURCE_DIR "/test/test_inputs/compiler_inputs/control_flow.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  int result = run_and_get_exit(
+      "./compiler_main --interpret -fdump-bytecode > /dev/null 2> dump.txt");
+  cr_expect_eq(result, 7, "Expected main to return 7");
+  cr_expect_eq(system("grep -q '^main (' dump.txt"), 0,
+               "Expected the bytecode of main");
+}
+
+// Test 27: INT_MIN / -1 traps at every level and on the VM instead of
+// wrapping
+Test(compiler, full_system_int_min_divide) {
+  copy_file(CMAKE_SOURCE_DIR
+            "/test/test_inputs/compiler_inputs/int_min_divide.c",
+            "test.txt");
+
+  char cmd[COMMAND_BUFFER_SIZE];
+  (void)snprintf(cmd, sizeof(cmd), "gcc %s/src/*.c -o compiler_main",
+                 CMAKE_SOURCE_DIR);
+  cr_assert_eq(system(cmd), 0, "Failed to compile compiler");
+  const char* levels[] = {"-O0", "-O1", "-O2"};
+  for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+    (void)snprintf(cmd, sizeof(cmd), "./compiler_main %s -static > /dev/null",
+                   levels[i]);
+    cr_assert_eq(system(cmd), 0, "Compiler run failed at %s", levels[i]);
+    // A wrapped INT_MIN would exit with 0.
+    cr_expect_neq(run_and_get_exit("./chat"), 0, "Expected a trap at %s",
+                  levels[i]);
+  }
+  cr_expect_neq(
+      run_and_get_exit("./compiler_main --interpret > /dev/null 2>&1"), 0,
+      "Expected the VM to fail too");
+}
+
 // NOLINTEND(cert-env33-c, concurrency-mt-unsafe)
 // NOLINTEND(misc-include-cleaner)
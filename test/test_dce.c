@@ -0,0 +1,72 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "test_helpers.h"
+
+// Build a function's SSA form and remove its dead code
+static void build_optimized(ast_node* node, ssa_function* function) {
+  build_promoted_ssa(node, function);
+  eliminate_dead_ssa_code(function);
+}
+
+// Test 1: Unused arithmetic and copies of parameters are removed
+Test(dce, unused_values) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/dce_inputs/dead_code.c");
+
+  ssa_function function;
+  build_optimized(ast[0], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_MUL), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_ADD), 0);
+  // Only a is read, by the return.
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PARAMETER), 1);
+  expect_valid_and_free(&function);
+}
+
+// Test 2: A call whose result is unused still happens
+Test(dce, calls_kept) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/dce_inputs/dead_code.c");
+
+  ssa_function function;
+  build_optimized(ast[1], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_CALL), 1);
+  free_ssa_function(&function);
+}
+
+// Test 3: A branch on a constant drops its dead arm, leaving one block
+Test(dce, constant_branch) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/dce_inputs/dead_code.c");
+
+  ssa_function function;
+  build_optimized(ast[2], &function);
+  cr_expect_eq(function.block_count, 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_ADD), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 0);
+  expect_valid_and_free(&function);
+}
+
+// Test 4: A loop variable only the loop itself reads is removed
+Test(dce, dead_loop_variable) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/dce_inputs/dead_code.c");
+
+  ssa_function function;
+  build_optimized(ast[3], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_ADD), 1);
+  expect_valid_and_free(&function);
+}
+
+// Test 5: Division that can trap stays, division by a safe constant goes
+Test(dce, trapping_division) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/dce_inputs/dead_code.c");
+
+  ssa_function function;
+  build_optimized(ast[4], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_DIV), 1);
+  free_ssa_function(&function);
+}
+// NOLINTEND(misc-include-cleaner)
@@ -0,0 +1,214 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+// NOLINTBEGIN(cert-env33-c, concurrency-mt-unsafe)
+// these are just for the system calls
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/codegen.h"
+#include "../src/encode.h"
+#include "../src/jit.h"
+#include "../src/object.h"
+
+// Build an instruction list from string literals
+static void build_list(list_of_x86_instructions* list,
+                       const char* const* lines, int count) {
+  init_list_of_instructions(list);
+  for (int i = 0; i < count; i++) {
+    add_instruction(list, (char*)lines[i]);
+  }
+}
+
+// Encode a single instruction and check its bytes
+static void expect_encoding(const char* line, const unsigned char* bytes,
+                            int length) {
+  list_of_x86_instructions list;
+  build_list(&list, &line, 1);
+  x86_code code;
+  encode_x86_instructions(&list, &code);
+  cr_assert_eq(code.size, length, "'%s': expected %d bytes, got %d", line,
+               length, code.size);
+  for (int i = 0; i < length; i++) {
+    cr_expect_eq(code.bytes[i], bytes[i], "'%s': byte %d is %02x, not %02x",
+                 line, i, code.bytes[i], bytes[i]);
+  }
+  free_x86_code(&code);
+}
+
+// Test 1: Registers, immediates and the ModRM, SIB and REX forms
+Test(encode, instruction_forms) {
+  const unsigned char mov_immediate[] = {0xB8, 0x05, 0x00, 0x00, 0x00};
+  expect_encoding("        mov     eax, 5", mov_immediate, 5);
+  const unsigned char store[] = {0x89, 0x7D, 0xFC};
+  expect_encoding("        mov     DWORD PTR [rbp-4], edi", store, 3);
+  const unsigned char add_small[] = {0x41, 0x83, 0xC0, 0x01};
+  expect_encoding("        add     r8d, 1", add_small, 4);
+  const unsigned char sub_wide[] = {0x48, 0x81, 0xEC, 0xC8, 0x00, 0x00, 0x00};
+  expect_encoding("        sub     rsp, 200", sub_wide, 7);
+  const unsigned char indexed[] = {0x44, 0x8D, 0x54, 0x88, 0x08};
+  expect_encoding("        lea     r10d, [rax+rcx*4+8]", indexed, 5);
+  const unsigned char stack[] = {0x8B, 0x44, 0x24, 0xFC};
+  expect_encoding("        mov     eax, DWORD PTR [rsp-4]", stack, 4);
+  const unsigned char r13_base[] = {0x41, 0x8B, 0x45, 0x00};
+  expect_encoding("        mov     eax, DWORD PTR [r13]", r13_base, 4);
+  const unsigned char multiply[] = {0x6B, 0xC1, 0x64};
+  expect_encoding("        imul    eax, ecx, 100", multiply, 3);
+  const unsigned char set_byte[] = {0x40, 0x0F, 0x94, 0xC6};
+  expect_encoding("        sete    sil", set_byte, 4);
+  const unsigned char select[] = {0x41, 0x0F, 0x4C, 0xC1};
+  expect_encoding("        cmovl   eax, r9d", select, 4);
+  const unsigned char push[] = {0x41, 0x54};
+  expect_encoding("        push    r12", push, 2);
+  const unsigned char shift[] = {0x41, 0xD1, 0xFB};
+  expect_encoding("        sar     r11d, 1", shift, 3);
+  const unsigned char exchange[] = {0x41, 0x92};
+  expect_encoding("        xchg    eax, r10d", exchange, 2);
+}
+
+// Test 2: Jumps are short when the target is near and long otherwise
+Test(encode, jump_relaxation) {
+  enum { FILLER = 30, LINE_COUNT = FILLER + 4 };
+  const char* lines[LINE_COUNT];
+  lines[0] = ".Lf_0:";
+  lines[1] = "        jne     .Lf_0";
+  lines[2] = "        jmp     .Lf_1";
+  for (int i = 0; i < FILLER; i++) {
+    lines[3 + i] = "        mov     eax, 5";
+  }
+  lines[LINE_COUNT - 1] = ".Lf_1:";
+  list_of_x86_instructions list;
+  build_list(&list, lines, LINE_COUNT);
+  x86_code code;
+  encode_x86_instructions(&list, &code);
+
+  // jne back to the start fits in 8 bits; the jmp over 150 bytes does not.
+  cr_expect_eq(code.bytes[0], 0x75);
+  cr_expect_eq(code.bytes[1], 0xFE);
+  cr_expect_eq(code.bytes[2], 0xE9);
+  cr_expect_eq(code.bytes[3], FILLER * 5);
+  cr_expect_eq(code.size, 2 + 5 + FILLER * 5);
+  cr_expect_eq(code.relocation_count, 0);
+  free_x86_code(&code);
+}
+
+// Test 3: Calls to defined symbols are resolved, others get relocations
+Test(encode, call_relocations) {
+  const char* const lines[] = {
+      ".global _start", "_start:", "        call    main",
+      "        call    helper", "main:", "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, lines, 6);
+  x86_code code;
+  encode_x86_instructions(&list, &code);
+
+  cr_assert_eq(code.size, 11);
+  cr_expect_eq(code.bytes[0], 0xE8);
+  cr_expect_eq(code.bytes[1], 5);  // Over the second call to main.
+  cr_assert_eq(code.relocation_count, 1);
+  cr_expect_eq(code.relocations[0].offset, 6);
+  int helper = find_x86_symbol(&code, "helper");
+  cr_assert_geq(helper, 0);
+  cr_expect_eq(code.relocations[0].symbol, helper);
+  cr_expect_eq(code.symbols[helper].offset, -1);
+  int start = find_x86_symbol(&code, "_start");
+  cr_expect(code.symbols[start].global);
+  cr_expect_eq(code.symbols[find_x86_symbol(&code, "main")].offset, 10);
+  free_x86_code(&code);
+}
+
+// Test 4: The object file links and runs
+Test(encode, object_file_links) {
+  const char* const lines[] = {
+      ".intel_syntax noprefix",
+      ".global _start",
+      ".text",
+      "_start:",
+      "    call main",
+      "    mov rdi, rax       # syscall: exit",
+      "    mov rax, 60        # exit code 0",
+      "    syscall",
+      "main:",
+      "        mov     eax, 40",
+      "        add     eax, 2",
+      "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, lines, 12);
+  x86_code code;
+  encode_x86_instructions(&list, &code);
+  write_elf_object(&code, "encode_test.o");
+  free_x86_code(&code);
+
+  cr_assert_eq(system("ld -o encode_test encode_test.o"), 0,
+               "Linking failed");
+  int status = system("./encode_test");
+  cr_assert(WIFEXITED(status));
+  cr_expect_eq(WEXITSTATUS(status), 42);
+}
+
+// Test 5: The executable runs without a separate link step
+Test(encode, executable_runs) {
+  const char* const lines[] = {
+      ".global _start",
+      "_start:",
+      "    call main",
+      "    mov rdi, rax",
+      "    mov rax, 60",
+      "    syscall",
+      "main:",
+      "        mov     eax, 40",
+      "        add     eax, 2",
+      "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, lines, 10);
+  x86_code code;
+  encode_x86_instructions(&list, &code);
+  (void)remove("encode_test");
+  write_elf_executable(&code, "encode_test");
+  free_x86_code(&code);
+
+  int status = system("./encode_test");
+  cr_assert(WIFEXITED(status));
+  cr_expect_eq(WEXITSTATUS(status), 42);
+}
+
+// Test 6: main runs in memory and the perf map names it
+Test(encode, jit_runs_main) {
+  enum { PATH_SIZE = 64, MAP_SIZE = 256 };
+  const char* const lines[] = {
+      "helper:",
+      "        mov     eax, 40",
+      "        ret",
+      "main:",
+      "        call    helper",
+      "        add     eax, 2",
+      "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, lines, 7);
+  x86_code code;
+  encode_x86_instructions(&list, &code);
+  cr_expect_eq(run_x86_code(&code), 42);
+  free_x86_code(&code);
+
+  char path[PATH_SIZE];
+  (void)snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+  FILE* map = fopen(path, "re");
+  cr_assert_not_null(map, "Perf map not written");
+  char contents[MAP_SIZE] = {0};
+  (void)fread(contents, 1, sizeof(contents) - 1, map);
+  (void)fclose(map);
+  (void)remove(path);
+  cr_expect_not_null(strstr(contents, " 6 helper\n"));
+  cr_expect_not_null(strstr(contents, " 9 main\n"));
+}
+
+// NOLINTEND(cert-env33-c, concurrency-mt-unsafe)
+// NOLINTEND(misc-include-cleaner)
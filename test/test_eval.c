@@ -0,0 +1,78 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "../src/eval.h"
+#include "test_helpers.h"
+
+enum { FUNCTION_COUNT = 9 };
+
+// Build every function in the inputs file and evaluate with a given limit
+static void build_program(ssa_function* functions, int step_limit) {
+  build_cleaned_program(
+      CMAKE_SOURCE_DIR "/test/test_inputs/eval_inputs/calls.c", functions,
+      FUNCTION_COUNT);
+  evaluate_constant_calls(functions, FUNCTION_COUNT, step_limit);
+}
+
+// Test 1: A call with constant arguments is replaced by its result
+Test(eval, constant_call) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_EVAL_STEP_LIMIT);
+  ssa_operand returned = get_returned(&functions[1]);
+  cr_expect_eq(count_ssa_opcode(&functions[1], SSA_CALL), 0);
+  cr_expect_eq(returned.kind, SSA_OPERAND_CONSTANT);
+  cr_expect_eq(returned.value, 120);
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 2: Recursion deeper than the depth limit is left as a call
+Test(eval, depth_limit) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_EVAL_STEP_LIMIT);
+  cr_expect_eq(count_ssa_opcode(&functions[2], SSA_CALL), 1);
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 3: A loop that outlasts the step limit is left as a call
+Test(eval, step_limit) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_EVAL_STEP_LIMIT);
+  cr_expect_eq(count_ssa_opcode(&functions[4], SSA_CALL), 1);
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 4: Division by zero traps at run time, so it is not evaluated
+Test(eval, division_by_zero) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_EVAL_STEP_LIMIT);
+  cr_expect_eq(count_ssa_opcode(&functions[6], SSA_CALL), 1);
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 5: An argument every caller passes the same constant becomes a
+// constant in the callee
+Test(eval, constant_argument) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_EVAL_STEP_LIMIT);
+  cr_expect_eq(count_ssa_opcode(&functions[8], SSA_CALL), 2);
+  int constant_multiplies = 0;
+  for (int i = 0; i < functions[7].instruction_count; i++) {
+    const ssa_instruction* instruction = &functions[7].instructions[i];
+    if (instruction->block >= 0 && instruction->opcode == SSA_MUL &&
+        instruction->operands[1].kind == SSA_OPERAND_CONSTANT &&
+        instruction->operands[1].value == 4) {
+      constant_multiplies++;
+    }
+  }
+  cr_expect_eq(constant_multiplies, 1);
+  cr_expect(verify_ssa_function(&functions[7]));
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 6: A step limit of 0 turns evaluation off
+Test(eval, disabled) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, 0);
+  cr_expect_eq(count_ssa_opcode(&functions[1], SSA_CALL), 1);
+  free_program(functions, FUNCTION_COUNT);
+}
+// NOLINTEND(misc-include-cleaner)
@@ -7,12 +7,8 @@ _start:
     mov rax, 60        # exit code 0
     syscall
 main:
-        push    rbp
-        mov     rbp, rsp
-        mov     edx, 2
         mov     eax, 6
-        add     eax, edx
-        mov     DWORD PTR [rbp-4], eax
-        mov     eax, DWORD PTR [rbp-4]
-        pop     rbp
+        add     eax, 2
+        mov     DWORD PTR [rsp-4], eax
+        mov     eax, DWORD PTR [rsp-4]
         ret
@@ -7,26 +7,22 @@ _start:
     mov rax, 60        # exit code 0
     syscall
 foo:
-        push    rbp
-        mov     rbp, rsp
-        mov     DWORD PTR [rbp-4], edi
-        mov     DWORD PTR [rbp-8], esi
-        mov     edx, DWORD PTR [rbp-8]
-        mov     eax, DWORD PTR [rbp-4]
-        add     eax, edx
-        mov     DWORD PTR [rbp-12], eax
-        mov     eax, DWORD PTR [rbp-12]
-        pop     rbp
+        mov     DWORD PTR [rsp-4], edi
+        mov     DWORD PTR [rsp-8], esi
+        mov     eax, DWORD PTR [rsp-4]
+        add     eax, DWORD PTR [rsp-8]
+        mov     DWORD PTR [rsp-12], eax
+        mov     eax, DWORD PTR [rsp-12]
         ret
 main:
         push    rbp
         mov     rbp, rsp
-        mov     eax, 2
-        mov     edi, eax
-        mov     eax, 3
-        mov     esi, eax
+        sub     rsp, 16
+        mov     edi, 2
+        mov     esi, 3
         call    foo
         mov     DWORD PTR [rbp-4], eax
         mov     eax, DWORD PTR [rbp-4]
+        mov     rsp, rbp
         pop     rbp
         ret
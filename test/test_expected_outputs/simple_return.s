@@ -7,8 +7,5 @@ _start:
     mov rax, 60        # exit code 0
     syscall
 main:
-        push    rbp
-        mov     rbp, rsp
         mov     eax, 3
-        pop     rbp
         ret
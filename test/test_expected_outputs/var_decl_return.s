@@ -7,10 +7,7 @@ _start:
     mov rax, 60        # exit code 0
     syscall
 main:
-        push    rbp
-        mov     rbp, rsp
         mov     eax, 5
-        mov     DWORD PTR [rbp-4], eax
-        mov     eax, DWORD PTR [rbp-4]
-        pop     rbp
+        mov     DWORD PTR [rsp-4], eax
+        mov     eax, DWORD PTR [rsp-4]
         ret
@@ -0,0 +1,77 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include <limits.h>
+
+#include "../src/codegen.h"
+#include "../src/fold.h"
+#include "test_helpers.h"
+
+// Parse a file, resolve its variables and fold every function
+static ast_node** parse_and_fold(const char* path) {
+  ast_node** ast = parse_path(path);
+  int count = 0;
+  while (ast[count] != NULL) {
+    count++;
+  }
+  resolve_variables(ast, count);
+  fold_constants(ast, count);
+  return ast;
+}
+
+// Return the i-th statement of a function body
+static ast_node* statement(ast_node* function, int index) {
+  return function->as.function.statements->as.block.statements[index];
+}
+
+static void assert_literal(ast_node* node, int value) {
+  cr_assert_eq(node->type, AST_INT_LITERAL);
+  cr_assert_eq(node->as.int_literal.int_literal, value);
+}
+
+
+// Test 1: Constant subtrees fold with 32-bit wrapping; traps are kept
+Test(fold, constant_arithmetic) {
+  ast_node** ast = parse_and_fold(
+      CMAKE_SOURCE_DIR "/test/test_inputs/fold_inputs/constant_arithmetic.c");
+  assert_literal(statement(ast[0], 0)->as.declaration.expression, INT_MIN);
+  cr_assert_eq(statement(ast[0], 1)->as.declaration.expression->type,
+               AST_BINARY);
+  assert_literal(statement(ast[0], 2)->as._return.expression, 31);
+}
+
+// Test 2: Constant initializers flow into later statements
+Test(fold, propagation) {
+  ast_node** ast = parse_and_fold(
+      CMAKE_SOURCE_DIR "/test/test_inputs/fold_inputs/propagation.c");
+  // a * 2 + 1 groups as a * (2 + 1).
+  assert_literal(statement(ast[0], 1)->as.declaration.expression, 12);
+  assert_literal(statement(ast[0], 2)->as._return.expression, 12);
+}
+
+// Test 3: Identities simplify, but calls are never dropped
+Test(fold, identities) {
+  ast_node** ast = parse_and_fold(
+      CMAKE_SOURCE_DIR "/test/test_inputs/fold_inputs/identities.c");
+  ast_node* first = statement(ast[0], 0)->as.declaration.expression;
+  cr_assert_eq(first->type, AST_VARIABLE);
+  cr_assert_eq(first->slot, 0);
+  assert_literal(statement(ast[0], 1)->as.declaration.expression, 0);
+  cr_assert_eq(statement(ast[0], 2)->as.declaration.expression->type,
+               AST_BINARY);
+  assert_literal(statement(ast[0], 3)->as._return.expression, 0);
+}
+
+// Test 4: Variables assigned in a loop are not treated as constants
+Test(fold, loop_assignment) {
+  ast_node** ast = parse_and_fold(
+      CMAKE_SOURCE_DIR "/test/test_inputs/fold_inputs/loop_assignment.c");
+  ast_node* condition = statement(ast[0], 2)->as.while_statement.condition;
+  cr_assert_eq(condition->as.binary.left->type, AST_VARIABLE);
+  assert_literal(condition->as.binary.right, 3);
+
+  ast_node* result = statement(ast[0], 3)->as._return.expression;
+  cr_assert_eq(result->as.binary.left->type, AST_VARIABLE);
+  assert_literal(result->as.binary.right, 3);
+}
+
+// NOLINTEND(misc-include-cleaner)
@@ -0,0 +1,71 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "test_helpers.h"
+
+// Build a function's SSA form and number its values
+static void build_numbered(ast_node* node, ssa_function* function) {
+  build_promoted_ssa(node, function);
+  number_ssa_values(function);
+}
+
+// Test 1: A repeated expression is computed once
+Test(gvn, repeated_expression) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/gvn_inputs/redundant.c");
+
+  ssa_function function;
+  build_numbered(ast[0], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_MUL), 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_ADD), 1);
+  expect_valid_and_free(&function);
+}
+
+// Test 2: Swapped operands of commutative operators and comparisons match
+Test(gvn, canonical_operands) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/gvn_inputs/redundant.c");
+
+  ssa_function function;
+  build_numbered(ast[1], &function);
+  // a + b once, plus the two adds in the return.
+  cr_expect_eq(count_ssa_opcode(&function, SSA_ADD), 3);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_LT) +
+                   count_ssa_opcode(&function, SSA_GT),
+               1);
+  expect_valid_and_free(&function);
+}
+
+// Test 3: Both arms of an if reuse a product computed before it
+Test(gvn, dominating_value) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/gvn_inputs/redundant.c");
+
+  ssa_function function;
+  build_numbered(ast[2], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_MUL), 1);
+  expect_valid_and_free(&function);
+}
+
+// Test 4: Neither arm of an if dominates the other, so both keep theirs
+Test(gvn, sibling_scopes) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/gvn_inputs/redundant.c");
+
+  ssa_function function;
+  build_numbered(ast[3], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_MUL), 2);
+  expect_valid_and_free(&function);
+}
+
+// Test 5: Constants promoted out of locals fold, but division by zero stays
+Test(gvn, constant_folding) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/gvn_inputs/redundant.c");
+
+  ssa_function function;
+  build_numbered(ast[4], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_MUL), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_DIV), 1);
+  expect_valid_and_free(&function);
+}
+// NOLINTEND(misc-include-cleaner)
@@ -0,0 +1,152 @@
+#pragma once
+
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include <criterion/criterion.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/dce.h"
+#include "../src/gvn.h"
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "../src/ssa.h"
+
+// Setup shared by the suites that parse an inputs file. Each suite's own
+// build_* helper adds the passes it tests on top of these.
+
+// Read a file into a null-terminated buffer
+static inline char* read_file(const char* path) {
+  FILE* file = fopen(path, "re");
+  cr_assert_neq(file, NULL, "Could not open %s", path);
+  cr_assert_eq(fseek(file, 0, SEEK_END), 0, "Failed to seek to end of file: %s",
+               path);
+  long tmp = ftell(file);
+  cr_assert(tmp >= 0, "ftell failed on %s", path);
+  cr_assert_eq(fseek(file, 0, SEEK_SET), 0,
+               "Failed to seek back to start of file: %s", path);
+  size_t len = (size_t)tmp;
+  char* buf = malloc(len + 1);
+  cr_assert_neq(buf, NULL, "Alloc failed");
+  cr_assert_eq(fread(buf, 1, len, file), len, "Failed to read full file: %s",
+               path);
+  buf[len] = '\0';
+  cr_assert_eq(fclose(file), 0, "Failed to close file: %s", path);
+  return buf;
+}
+
+enum { CAPACITY = 128 };
+// tokenize entire source into a dynamically sized array of Tokens
+static inline Token* lex_all(const char* src, int* out_count) {
+  Lexer lex;
+  init_lexer(&lex, src);
+
+  int capacity = CAPACITY;
+  int count = 0;
+  Token* toks = malloc(sizeof(Token) * (size_t)capacity);
+  cr_assert_not_null(toks);
+
+  Token tok;
+  do {
+    tok = get_next_token(&lex);
+
+    if (count >= capacity) {
+      capacity *= 2;
+      size_t new_size = sizeof(Token) * (size_t)capacity;
+      Token* tmp = realloc(toks, new_size);
+      cr_assert_not_null(tmp, "Could not realloc token buffer to %zu bytes",
+                         new_size);
+      toks = tmp;
+    }
+
+    toks[count++] = tok;
+  } while (tok.type != TOKEN_EOF);
+
+  *out_count = count;
+  return toks;
+}
+
+// Parse a file and return its function nodes
+static inline ast_node** parse_path(const char* path) {
+  char* src = read_file(path);
+  int tokc = 0;
+  Token* toks = lex_all(src, &tokc);
+  ast_node** ast = parse_file(toks, tokc);
+  cr_assert_not_null(ast);
+  return ast;
+}
+
+// ───── SSA Setup ─────
+
+// Build a function's SSA form with its locals promoted
+static inline void build_promoted_ssa(ast_node* node, ssa_function* function) {
+  build_ssa_function(node, function);
+  promote_ssa_locals(function);
+}
+
+// Build every function in an inputs file, promoted and cleaned up as the
+// driver leaves them before its whole-program passes
+static inline void build_cleaned_program(const char* path,
+                                         ssa_function* functions, int count) {
+  ast_node** ast = parse_path(path);
+  for (int i = 0; i < count; i++) {
+    cr_assert_not_null(ast[i]);
+    build_promoted_ssa(ast[i], &functions[i]);
+    number_ssa_values(&functions[i]);
+    eliminate_dead_ssa_code(&functions[i]);
+  }
+}
+
+// Check that a function is still well formed, then free it
+static inline void expect_valid_and_free(ssa_function* function) {
+  cr_expect(verify_ssa_function(function), "%.*s is not valid SSA",
+            function->name_length, function->name);
+  free_ssa_function(function);
+}
+
+// ───── SSA Queries ─────
+
+// Count the live instructions with a given opcode
+static inline int count_ssa_opcode(const ssa_function* function,
+                                   ssa_opcode opcode) {
+  int count = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    if (function->instructions[i].block >= 0 &&
+        function->instructions[i].opcode == opcode) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Return the index of the first live instruction with a given opcode, or -1
+static inline int find_ssa_opcode(const ssa_function* function,
+                                  ssa_opcode opcode) {
+  for (int i = 0; i < function->instruction_count; i++) {
+    if (function->instructions[i].block >= 0 &&
+        function->instructions[i].opcode == opcode) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Return the operand of the function's first live return
+static inline ssa_operand get_returned(const ssa_function* function) {
+  for (int i = 0; i < function->instruction_count; i++) {
+    const ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block >= 0 && instruction->opcode == SSA_RETURN) {
+      return instruction->operands[0];
+    }
+  }
+  return ssa_none();
+}
+
+// Free every function a suite built
+static inline void free_program(ssa_function* functions, int count) {
+  for (int i = 0; i < count; i++) {
+    free_ssa_function(&functions[i]);
+  }
+}
+
+// NOLINTEND(misc-include-cleaner)
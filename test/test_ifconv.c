@@ -0,0 +1,59 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "../src/ifconv.h"
+#include "test_helpers.h"
+
+// Build a function's SSA form and convert its branches to selects
+static void build_converted(ast_node* node, ssa_function* function) {
+  build_promoted_ssa(node, function);
+  convert_ssa_branches_to_selects(function);
+}
+
+// Test 1: An if without an else (a triangle) becomes a select
+Test(ifconv, triangle) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ifconv_inputs/select.c");
+
+  ssa_function function;
+  build_converted(ast[0], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_SELECT), 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 0);
+  expect_valid_and_free(&function);
+}
+
+// Test 2: An if with an else (a diamond) becomes a select
+Test(ifconv, diamond) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ifconv_inputs/select.c");
+
+  ssa_function function;
+  build_converted(ast[1], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_SELECT), 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 0);
+  expect_valid_and_free(&function);
+}
+
+// Test 3: A call is never speculated
+Test(ifconv, call_stays_behind_branch) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ifconv_inputs/select.c");
+
+  ssa_function function;
+  build_converted(ast[2], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_SELECT), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 1);
+  free_ssa_function(&function);
+}
+
+// Test 4: An arm with more work than the limit keeps its branch
+Test(ifconv, arm_over_limit) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ifconv_inputs/select.c");
+
+  ssa_function function;
+  build_converted(ast[3], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_SELECT), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 1);
+  free_ssa_function(&function);
+}
+// NOLINTEND(misc-include-cleaner)
@@ -0,0 +1,62 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "../src/inline.h"
+#include "test_helpers.h"
+
+enum { FUNCTION_COUNT = 7 };
+
+// Build every function in the inputs file and inline with a given limit
+static void build_program(ssa_function* functions, int limit) {
+  build_cleaned_program(
+      CMAKE_SOURCE_DIR "/test/test_inputs/inline_inputs/calls.c", functions,
+      FUNCTION_COUNT);
+  inline_ssa_functions(functions, FUNCTION_COUNT, limit);
+}
+
+// Test 1: A small callee is copied into its caller in place of the call
+Test(inline, small_callee) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_INLINE_LIMIT);
+  cr_expect_eq(count_ssa_opcode(&functions[1], SSA_CALL), 0);
+  cr_expect_eq(count_ssa_opcode(&functions[1], SSA_ADD), 1);
+  cr_expect(verify_ssa_function(&functions[1]));
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 2: Constant arguments fold through the inlined body
+Test(inline, constant_arguments) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_INLINE_LIMIT);
+  ssa_operand returned = get_returned(&functions[2]);
+  cr_expect_eq(returned.kind, SSA_OPERAND_CONSTANT);
+  cr_expect_eq(returned.value, 5);
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 3: Recursive functions are never inlined
+Test(inline, recursive_callee) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_INLINE_LIMIT);
+  cr_expect_eq(count_ssa_opcode(&functions[3], SSA_CALL), 1);
+  cr_expect_eq(count_ssa_opcode(&functions[4], SSA_CALL), 1);
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 4: Callees above the limit are left as calls
+Test(inline, size_limit) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, 1);
+  cr_expect_eq(count_ssa_opcode(&functions[1], SSA_CALL), 1);
+  free_program(functions, FUNCTION_COUNT);
+}
+
+// Test 5: A callee with several returns merges them with a phi
+Test(inline, several_returns) {
+  ssa_function functions[FUNCTION_COUNT];
+  build_program(functions, DEFAULT_INLINE_LIMIT);
+  cr_expect_eq(count_ssa_opcode(&functions[6], SSA_CALL), 0);
+  cr_expect_eq(count_ssa_opcode(&functions[6], SSA_PHI), 1);
+  cr_expect(verify_ssa_function(&functions[6]));
+  free_program(functions, FUNCTION_COUNT);
+}
+// NOLINTEND(misc-include-cleaner)
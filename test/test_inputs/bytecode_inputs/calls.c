@@ -0,0 +1,22 @@
+int add3(int a, int b, int c) {
+  return a + b + c;
+}
+int fib(int n) {
+  if (n < 2) {
+    return n;
+  }
+  int a = n - 1;
+  int b = n - 2;
+  return fib(a) + fib(b);
+}
+int main() {
+  int big = 2147483647;
+  int wrapped = big + 1;
+  int m = 0 - 17;
+  int r = m % 5;
+  int f = fib(10);
+  int s = add3(f, big, r);
+  int back = wrapped - 1;
+  int same = back - big;
+  return s + same;
+}
@@ -0,0 +1,20 @@
+int classify(int n, int limit) {
+  int total = 0;
+  int i = 0;
+  while (i < limit) {
+    if (i == n) {
+      total = total + 100;
+    } else if (i > n) {
+      total = total - 2;
+    } else {
+      total = total + i;
+    }
+    i = i + 1;
+  }
+  return total;
+}
+int main() {
+  int a = classify(5, 12);
+  int b = classify(20, 4);
+  return a + b;
+}
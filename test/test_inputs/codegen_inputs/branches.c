@@ -0,0 +1,12 @@
+int classify(int a, int b) {
+  int below = a < b;
+  while (a > b) {
+    a = a - 1;
+  }
+  if (below) {
+    return 1;
+  } else if (a == b) {
+    return 2;
+  }
+  return 3;
+}
@@ -0,0 +1,10 @@
+int leaf(int a, int b) {
+  int c = a + b;
+  return c;
+}
+
+int main() {
+  int x = 1;
+  int y = leaf(x, 2);
+  return y;
+}
@@ -0,0 +1,8 @@
+int main() {
+  int a = 1;
+  int b = 2;
+  int c = 3;
+  int d = 4;
+  int x = a + b * c - d;
+  return x;
+}
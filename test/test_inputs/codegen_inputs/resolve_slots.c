@@ -0,0 +1,9 @@
+int main() {
+  int a = 1;
+  int b = a + 2;
+  if (b) {
+    int c = b;
+  }
+  int d = 4;
+  return d;
+}
@@ -0,0 +1,12 @@
+int twice(int x) {
+  int y = x * 2;
+  return y;
+}
+
+int main() {
+  int a = 7;
+  int b = 3;
+  int c = twice(a) - twice(b) % 4;
+  int d = a * b - c / b;
+  return c + d;
+}
@@ -0,0 +1,22 @@
+int fib(int n) {
+  if (n < 2) {
+    return n;
+  }
+  int a = n - 1;
+  int b = n - 2;
+  return fib(a) + fib(b);
+}
+
+int test(int arg1, int arg2) {
+  int retValue = 12 - arg1;
+  int noUseValue = arg2;
+  return retValue;
+}
+
+int main() {
+  int var1 = 32 - 1;
+  int var2 = 32 - var1;
+  int f = fib(10);
+  int t = test(var2, 2);
+  return f + t;
+}
@@ -0,0 +1,19 @@
+int f(int n, int m) {
+  int s = 0;
+  int i = 0;
+  while (i < n) {
+    if (i == m) {
+      s = s + 10;
+    } else if (i > m) {
+      s = s - 1;
+    } else {
+      s = s + i;
+    }
+    i = i + 1;
+  }
+  return s;
+}
+int main() {
+  int x = f(10, 3);
+  return x;
+}
@@ -0,0 +1,10 @@
+int divide(int x) {
+  int m = 0 - 1;
+  return x / m;
+}
+
+int main() {
+  int y = 0 - 2147483647;
+  int x = y - 1;
+  return divide(x);
+}
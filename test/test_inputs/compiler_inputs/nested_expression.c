@@ -0,0 +1,5 @@
+int main() {
+  int a = 6;
+  int b = 4;
+  return a * b - a - b * 2;
+}
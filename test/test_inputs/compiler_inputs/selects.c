@@ -0,0 +1,19 @@
+int main() {
+  int s = 0;
+  int i = 0;
+  while (i < 10) {
+    int d = i - 5;
+    if (d < 0) {
+      d = 0 - d;
+    }
+    s = s + d;
+    i = i + 1;
+  }
+  int m = 0;
+  if (s > 30) {
+    m = s;
+  } else {
+    m = 30;
+  }
+  return m + s;
+}
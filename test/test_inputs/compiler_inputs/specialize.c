@@ -0,0 +1,24 @@
+int apply(int mode, int a, int b) {
+  if (mode == 0) {
+    return a + b;
+  }
+  if (mode == 1) {
+    return a - b;
+  }
+  if (mode == 2) {
+    return a * b;
+  }
+  return a % b;
+}
+
+int main() {
+  int s = 0;
+  int i = 0;
+  while (i < 20) {
+    s = apply(0, s, i);
+    int t = apply(2, i, 3);
+    s = apply(1, s, t);
+    i = i + 1;
+  }
+  return s;
+}
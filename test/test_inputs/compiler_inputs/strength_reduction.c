@@ -0,0 +1,10 @@
+int mix(int x) {
+  int q = x / 7;
+  int r = x % 8;
+  int m = x * 9;
+  return q + r + m;
+}
+
+int main() {
+  return mix(23);
+}
@@ -0,0 +1,30 @@
+int count(int n, int acc) {
+  if (n == 0) {
+    return acc;
+  }
+  int m = n - 1;
+  int a = acc + 1;
+  return count(m, a);
+}
+
+int is_even(int n) {
+  if (n == 0) {
+    return 1;
+  }
+  int m = n - 1;
+  return is_odd(m);
+}
+
+int is_odd(int n) {
+  if (n == 0) {
+    return 0;
+  }
+  int m = n - 1;
+  return is_even(m);
+}
+
+int main() {
+  int c = count(1000000, 7);
+  int e = is_even(1000000);
+  return c + e;
+}
@@ -0,0 +1,7 @@
+int seven(int a, int b, int c, int d, int e, int f, int g) {
+  return a + b + c + d + e + f + g;
+}
+
+int main() {
+  return seven(1, 2, 3, 4, 5, 6, 7);
+}
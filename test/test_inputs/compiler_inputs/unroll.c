@@ -0,0 +1,17 @@
+int main() {
+  int s = 0;
+  int i = 0;
+  while (i < 4) {
+    s = s + i;
+    i = i + 1;
+  }
+  int n = s + 17;
+  int t = 0;
+  int j = 0;
+  while (j < n) {
+    int k = j * 3;
+    t = t + k;
+    j = j + 1;
+  }
+  return t + s;
+}
@@ -0,0 +1,34 @@
+int unused(int a, int b) {
+  int t = a * b;
+  int u = t + 1;
+  int noUseValue = b;
+  return a;
+}
+
+int keep(int a) {
+  int t = unused(a, 2);
+  return a;
+}
+
+int fixed(int x) {
+  if (0) {
+    x = x + 1;
+  }
+  return x;
+}
+
+int counter(int n) {
+  int i = 0;
+  int j = 0;
+  while (i < n) {
+    j = j + 2;
+    i = i + 1;
+  }
+  return i;
+}
+
+int trap(int a) {
+  int t = a / 0;
+  int u = a / 4;
+  return a;
+}
@@ -0,0 +1,43 @@
+int fact(int n) {
+  if (n < 2) {
+    return 1;
+  }
+  int m = n - 1;
+  return n * fact(m);
+}
+
+int main() {
+  return fact(5);
+}
+
+int deep() {
+  return fact(100);
+}
+
+int spin(int n) {
+  while (n > 0) {
+    n = n + 1;
+  }
+  return n;
+}
+
+int spins() {
+  return spin(1);
+}
+
+int divide(int a, int b) {
+  return a / b;
+}
+
+int divides() {
+  return divide(1, 0);
+}
+
+int scale(int x, int k) {
+  return x * k;
+}
+
+int usescale(int y) {
+  int s = scale(y, 4);
+  return scale(s, 4);
+}
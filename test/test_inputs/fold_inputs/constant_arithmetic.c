@@ -0,0 +1,5 @@
+int main() {
+  int big = 2147483647 + 1;
+  int trap = 7 / 0;
+  return 32 - 1;
+}
@@ -0,0 +1,6 @@
+int f(int x, int y) {
+  int a = x * 1 + 0;
+  int b = y - y;
+  int c = f(x, y) * 0;
+  return x * 0;
+}
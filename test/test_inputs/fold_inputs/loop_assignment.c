@@ -0,0 +1,8 @@
+int main() {
+  int i = 0;
+  int limit = 3;
+  while (i < limit) {
+    i = i + 1;
+  }
+  return i + limit;
+}
@@ -0,0 +1,5 @@
+int main() {
+  int a = 4;
+  int b = a * 2 + 1;
+  return b;
+}
@@ -0,0 +1,40 @@
+int repeat(int a, int b, int c) {
+  int x = a * b + c;
+  int y = a * b + c;
+  return x - y;
+}
+
+int swap(int a, int b) {
+  int x = a + b;
+  int y = b + a;
+  int p = a < b;
+  int q = b > a;
+  return x * y + p + q;
+}
+
+int dominated(int a, int b) {
+  int x = a * b;
+  if (a < b) {
+    x = x + a * b;
+  } else {
+    x = x - a * b;
+  }
+  return x;
+}
+
+int siblings(int a, int b) {
+  int x = 0;
+  if (a < b) {
+    x = a * b;
+  } else {
+    x = a * b + 1;
+  }
+  return x;
+}
+
+int constants(int a) {
+  int k = 4;
+  int m = k * 5;
+  int z = 7 / 0;
+  return a + m + z;
+}
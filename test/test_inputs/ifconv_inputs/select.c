@@ -0,0 +1,32 @@
+int clamp(int x) {
+  if (x < 0) {
+    x = 0;
+  }
+  return x;
+}
+
+int max(int a, int b) {
+  int m = 0;
+  if (a > b) {
+    m = a;
+  } else {
+    m = b;
+  }
+  return m;
+}
+
+int twice(int x) {
+  int y = x;
+  if (x > 10) {
+    y = twice(x);
+  }
+  return y;
+}
+
+int mix(int x, int y) {
+  int z = y;
+  if (x > y) {
+    z = x * 3 + y * 5 - x * y + 7;
+  }
+  return z;
+}
@@ -0,0 +1,34 @@
+int add(int a, int b) {
+  return a + b;
+}
+
+int use(int x) {
+  return add(x, 3);
+}
+
+int main() {
+  return add(2, 3);
+}
+
+int fact(int n) {
+  if (n < 2) {
+    return 1;
+  }
+  int m = n - 1;
+  return n * fact(m);
+}
+
+int callfact(int n) {
+  return fact(n);
+}
+
+int pick(int a) {
+  if (a < 0) {
+    return 0;
+  }
+  return a;
+}
+
+int usepick(int b) {
+  return pick(b) + 1;
+}
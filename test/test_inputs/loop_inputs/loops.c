@@ -0,0 +1,53 @@
+int scaled(int n, int m) {
+  int s = 0;
+  int i = 0;
+  while (i < 100) {
+    int a = n * m;
+    int b = i * 12;
+    s = s + a + b;
+    i = i + 1;
+  }
+  return s;
+}
+
+int divided(int n, int m) {
+  int s = 0;
+  int i = 0;
+  while (i < n) {
+    int q = n / m;
+    s = s + q;
+    i = i + 1;
+  }
+  return s;
+}
+
+int counted(int n) {
+  int s = 0;
+  int i = 0;
+  while (i < 100) {
+    int b = i * 4;
+    s = s + b + i;
+    i = i + 1;
+  }
+  return s;
+}
+
+int constant_trips() {
+  int s = 0;
+  int i = 0;
+  while (i < 5) {
+    s = s + i;
+    i = i + 1;
+  }
+  return s;
+}
+
+int variable_trips(int n) {
+  int s = 0;
+  int i = 0;
+  while (i < n) {
+    s = s + i;
+    i = i + 1;
+  }
+  return s;
+}
@@ -0,0 +1,11 @@
+int sum_except(int n, int m) {
+  int s = 0;
+  int i = 0;
+  while (i < n) {
+    if (i != m) {
+      s = s + i;
+    }
+    i = i + 1;
+  }
+  return s;
+}
@@ -0,0 +1,6 @@
+int combine(int a, int b) {
+  int c = a + 5;
+  int d = a + b * 4;
+  int e = b * 1000003;
+  return c + d + e + b;
+}
@@ -0,0 +1,21 @@
+int scale(int x) {
+  int a = x * 8;
+  int b = x * 10;
+  int c = 45 * x;
+  return a + b + c;
+}
+
+int divide(int x) {
+  int q = x / 7;
+  int r = x % 16;
+  return q + r;
+}
+
+int by_zero(int x) {
+  return x / 0;
+}
+
+int by_minus_one(int x) {
+  int m = 0 - 1;
+  return x / m + x % m;
+}
@@ -0,0 +1,7 @@
+int other(int a, int b) {
+  return a - b;
+}
+
+int wrap(int x) {
+  return other(x, 1);
+}
@@ -0,0 +1,14 @@
+int sq(int x) {
+  return x * x;
+}
+int f(int a, int b, int c, int d, int e, int g) {
+  int s = sq(a);
+  int t = sq(g);
+  return s + t + b + c + d + e;
+}
+int main() {
+  int x = 2;
+  int y = f(x, 3, 4, 5, 6, 7);
+  int z = sq(y);
+  return z / 100;
+}
@@ -0,0 +1,18 @@
+int pressure(int x) {
+  int a = x + 1;
+  int b = x + 2;
+  int c = x + 3;
+  int d = x + 4;
+  int e = x + 5;
+  int f = x + 6;
+  int g = x + 7;
+  int h = x + 8;
+  int i = x + 9;
+  int j = x + 10;
+  int k = x + 11;
+  int l = x + 12;
+  int m = x + 13;
+  int n = x + 14;
+  int o = x + 15;
+  return a + b + c + d + e + f + g + h + i + j + k + l + m + n + o;
+}
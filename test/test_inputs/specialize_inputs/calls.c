@@ -0,0 +1,39 @@
+int apply(int mode, int a, int b) {
+  if (mode == 0) {
+    return a + b;
+  }
+  if (mode == 1) {
+    return a - b;
+  }
+  return a * b;
+}
+
+int use(int x, int y) {
+  int a = apply(0, x, y);
+  int b = apply(0, y, x);
+  int c = apply(1, x, y);
+  return a + b + c;
+}
+
+int scale(int x, int k) {
+  return x * k;
+}
+
+int usescale(int y) {
+  return scale(y, 3);
+}
+
+int fact(int n, int mode) {
+  if (n < 2) {
+    return 1;
+  }
+  int m = n - 1;
+  if (mode == 0) {
+    return n * fact(m, mode);
+  }
+  return n + fact(m, mode);
+}
+
+int usefact(int n) {
+  return fact(n, 0);
+}
@@ -0,0 +1,41 @@
+int sum(int a, int b) {
+  int c = a + b;
+  int d = c * 2;
+  return d - a;
+}
+
+int pick(int x) {
+  int y = 0;
+  if (x < 5) {
+    y = 1;
+  } else {
+    y = 2;
+  }
+  return y;
+}
+
+int count(int n) {
+  int i = 0;
+  int s = 0;
+  while (i < n) {
+    s = s + i;
+    i = i + 1;
+  }
+  return s;
+}
+
+int early(int x) {
+  return x;
+  x = 5;
+  return x;
+}
+
+int dead(int x) {
+  int t = 0;
+  if (x) {
+    t = 1;
+  } else {
+    t = 2;
+  }
+  return x;
+}
@@ -0,0 +1,20 @@
+int sum(int n, int acc) {
+  if (n == 0) {
+    return acc;
+  }
+  int m = n - 1;
+  int a = acc + n;
+  return sum(m, a);
+}
+
+int fact(int n) {
+  if (n < 2) {
+    return 1;
+  }
+  int m = n - 1;
+  return n * fact(m);
+}
+
+int spin(int n) {
+  return spin(n);
+}
@@ -0,0 +1,123 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "../src/loop.h"
+#include "test_helpers.h"
+
+// Build a function's SSA form and optimize its loops
+static void build_optimized(ast_node* node, ssa_function* function) {
+  build_promoted_ssa(node, function);
+  number_ssa_values(function);
+  optimize_ssa_loops(function);
+  eliminate_dead_ssa_code(function);
+}
+
+// Build a function's SSA form, optimize its loops and unroll them
+static void build_unrolled(ast_node* node, ssa_function* function,
+                           int factor) {
+  build_optimized(node, function);
+  unroll_ssa_loops(function, factor);
+  number_ssa_values(function);
+  eliminate_dead_ssa_code(function);
+}
+
+// Test 1: An invariant product moves out of the loop into the entry block
+Test(loop, hoist_invariant) {
+  ast_node** ast =
+      parse_path(CMAKE_SOURCE_DIR "/test/test_inputs/loop_inputs/loops.c");
+
+  ssa_function function;
+  build_optimized(ast[0], &function);
+  int multiply = find_ssa_opcode(&function, SSA_MUL);
+  cr_assert_geq(multiply, 0);
+  cr_expect_eq(function.instructions[multiply].block, 0);
+  expect_valid_and_free(&function);
+}
+
+// Test 2: i * 12 becomes a running sum, and the exit test moves onto it
+Test(loop, strength_reduction_and_test_replacement) {
+  ast_node** ast =
+      parse_path(CMAKE_SOURCE_DIR "/test/test_inputs/loop_inputs/loops.c");
+
+  ssa_function function;
+  build_optimized(ast[0], &function);
+  // Only the hoisted n * m is left.
+  cr_expect_eq(count_ssa_opcode(&function, SSA_MUL), 1);
+  // The running sum and s; i is dead once the test reads i * 12.
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 2);
+  int test = find_ssa_opcode(&function, SSA_LT);
+  cr_assert_geq(test, 0);
+  cr_expect_eq(function.instructions[test].operands[1].kind,
+               SSA_OPERAND_CONSTANT);
+  cr_expect_eq(function.instructions[test].operands[1].value, 1200);
+  expect_valid_and_free(&function);
+}
+
+// Test 3: A division that may trap stays inside the loop
+Test(loop, division_not_hoisted) {
+  ast_node** ast =
+      parse_path(CMAKE_SOURCE_DIR "/test/test_inputs/loop_inputs/loops.c");
+
+  ssa_function function;
+  build_optimized(ast[1], &function);
+  int divide = find_ssa_opcode(&function, SSA_DIV);
+  cr_assert_geq(divide, 0);
+  cr_expect_neq(function.instructions[divide].block, 0);
+  free_ssa_function(&function);
+}
+
+// Test 4: The test stays on i while the body still reads i itself
+Test(loop, test_kept_when_counter_used) {
+  ast_node** ast =
+      parse_path(CMAKE_SOURCE_DIR "/test/test_inputs/loop_inputs/loops.c");
+
+  ssa_function function;
+  build_optimized(ast[2], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_MUL), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 3);
+  int test = find_ssa_opcode(&function, SSA_LT);
+  cr_assert_geq(test, 0);
+  cr_expect_eq(function.instructions[test].operands[1].value, 100);
+  expect_valid_and_free(&function);
+}
+// Test 5: A loop with a known small trip count disappears entirely
+Test(loop, full_unroll) {
+  ast_node** ast =
+      parse_path(CMAKE_SOURCE_DIR "/test/test_inputs/loop_inputs/loops.c");
+
+  ssa_function function;
+  build_unrolled(ast[3], &function, DEFAULT_UNROLL_FACTOR);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 0);
+  int result = find_ssa_opcode(&function, SSA_RETURN);
+  cr_assert_geq(result, 0);
+  cr_expect_eq(function.instructions[result].operands[0].kind,
+               SSA_OPERAND_CONSTANT);
+  cr_expect_eq(function.instructions[result].operands[0].value, 10);
+  expect_valid_and_free(&function);
+}
+
+// Test 6: A loop bounded by a parameter gets an unrolled copy in front of
+// the original, which runs the remaining trips
+Test(loop, partial_unroll) {
+  ast_node** ast =
+      parse_path(CMAKE_SOURCE_DIR "/test/test_inputs/loop_inputs/loops.c");
+
+  ssa_function function;
+  build_unrolled(ast[4], &function, DEFAULT_UNROLL_FACTOR);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 2);
+  // Each copy of the body adds to s and to i.
+  cr_expect_eq(count_ssa_opcode(&function, SSA_ADD),
+               2 * (DEFAULT_UNROLL_FACTOR + 1));
+  expect_valid_and_free(&function);
+}
+
+// Test 7: A factor of 1 leaves loops with unknown trip counts alone
+Test(loop, unroll_factor_one) {
+  ast_node** ast =
+      parse_path(CMAKE_SOURCE_DIR "/test/test_inputs/loop_inputs/loops.c");
+
+  ssa_function function;
+  build_unrolled(ast[4], &function, 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_BRANCH), 1);
+  free_ssa_function(&function);
+}
+// NOLINTEND(misc-include-cleaner)
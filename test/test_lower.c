@@ -0,0 +1,191 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include <string.h>
+
+#include "../src/codegen.h"
+#include "../src/fold.h"
+#include "../src/lir.h"
+#include "../src/lower.h"
+#include "../src/regalloc.h"
+#include "test_helpers.h"
+
+// Count the instructions with a given opcode
+static int count_opcode(const lir_function* function, lir_opcode opcode) {
+  int count = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    if (function->instructions[i].opcode == opcode) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Test 1: Constant multipliers become shifts and lea chains
+Test(lower, multiply_by_constants) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/lower_inputs/strength_reduction.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[0], &function);
+  cr_expect_eq(count_opcode(&function, LIR_IMUL), 0);
+  // x * 10 is a lea and a shift and 45 * x two leas. x * 8 is only read
+  // by the final add, so it folds into that add's lea.
+  cr_expect_eq(count_opcode(&function, LIR_SHL), 1);
+  cr_expect_eq(count_opcode(&function, LIR_LEA), 4);
+  free_lir_function(&function);
+}
+
+// Test 2: Constant divisors avoid idiv, and the result survives allocation
+Test(lower, divide_by_constants) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/lower_inputs/strength_reduction.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[1], &function);
+  cr_expect_eq(count_opcode(&function, LIR_IDIV), 0);
+  // Only x / 7 needs the multiply-high; x % 16 is shifts.
+  cr_expect_eq(count_opcode(&function, LIR_IMUL_HIGH), 1);
+  allocate_registers_linear_scan(&function);
+  for (int i = 0; i < function.instruction_count; i++) {
+    const lir_instruction* instr = &function.instructions[i];
+    for (int j = 0; j < instr->operand_count; j++) {
+      cr_assert(instr->operands[j].kind == LIR_OPERAND_IMMEDIATE ||
+                    !is_lir_virtual_register(instr->operands[j].reg),
+                "Instruction %d still uses a virtual register", i);
+    }
+  }
+  free_lir_function(&function);
+}
+
+// Test 3: Division by zero is left to idiv so it still traps
+Test(lower, divide_by_zero) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/lower_inputs/strength_reduction.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[2], &function);
+  cr_expect_eq(count_opcode(&function, LIR_IDIV), 1);
+  free_lir_function(&function);
+}
+
+// Test 4: Literal operands are used as immediates, not loaded first
+Test(lower, immediate_operands) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/lower_inputs/operand_folding.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[0], &function);
+  for (int i = 0; i < function.instruction_count; i++) {
+    const lir_instruction* instr = &function.instructions[i];
+    cr_expect(instr->opcode != LIR_MOV ||
+                  instr->operands[1].kind != LIR_OPERAND_IMMEDIATE,
+              "Instruction %d loads a literal into a register", i);
+  }
+  // a + b * 4 is a single scaled lea.
+  cr_expect_eq(count_opcode(&function, LIR_LEA), 1);
+  cr_expect_eq(count_opcode(&function, LIR_SHL), 0);
+  free_lir_function(&function);
+}
+
+// Test 5: A copy followed by add or imul is emitted in three-operand form
+Test(lower, three_operand_forms) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/lower_inputs/operand_folding.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[0], &function);
+  allocate_registers_linear_scan(&function);
+
+  list_of_x86_instructions list;
+  init_list_of_instructions(&list);
+  lir_function_to_x86(&function, &list);
+
+  int lea_with_displacement = 0;
+  int three_operand_imul = 0;
+  for (int i = 0; i < list.instruction_count; i++) {
+    const char* line = list.instructions[i];
+    if (strstr(line, "lea ") != NULL && strstr(line, "+5]") != NULL) {
+      lea_with_displacement++;
+    } else if (strstr(line, "imul ") != NULL &&
+               strstr(line, ", 1000003") != NULL &&
+               strchr(strchr(line, ',') + 1, ',') != NULL) {
+      three_operand_imul++;
+    }
+  }
+  cr_expect_eq(lea_with_displacement, 1);
+  cr_expect_eq(three_operand_imul, 1);
+  free_lir_function(&function);
+}
+
+// Test 6: Returning a call's result jumps to the callee after the epilogue
+Test(lower, tail_call) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/lower_inputs/tail_call.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[1], &function);
+  cr_expect_eq(count_opcode(&function, LIR_TAIL_CALL), 1);
+  cr_expect_eq(count_opcode(&function, LIR_CALL), 0);
+  cr_expect_eq(count_opcode(&function, LIR_RET), 0);
+  allocate_registers_linear_scan(&function);
+
+  list_of_x86_instructions list;
+  init_list_of_instructions(&list);
+  lir_function_to_x86(&function, &list);
+  const char* last = list.instructions[list.instruction_count - 1];
+  cr_expect(strstr(last, "jmp") != NULL && strstr(last, "other") != NULL,
+            "Expected the function to end in jmp other, got %s", last);
+  free_lir_function(&function);
+}
+
+// Test 7: Branches compare right before the jump, and the loop test sits at
+// the bottom
+Test(lower, fused_loop_branch) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/lower_inputs/loop_branch.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[0], &function);
+  cr_expect_eq(count_opcode(&function, LIR_SETCC), 0);
+  cr_expect_eq(count_opcode(&function, LIR_JCC), 2);
+  int last_jump = -1;
+  for (int i = 0; i < function.instruction_count; i++) {
+    if (function.instructions[i].opcode == LIR_JCC) {
+      cr_expect_eq(function.instructions[i - 1].opcode, LIR_CMP,
+                   "Expected cmp right before jcc %d", i);
+      last_jump = i;
+    }
+  }
+  cr_assert_geq(last_jump, 0);
+  // The loop test comes last and jumps back up to the body.
+  int target = -1;
+  for (int i = 0; i < function.instruction_count; i++) {
+    if (function.instructions[i].opcode == LIR_LABEL &&
+        function.instructions[i].operands[0].value ==
+            function.instructions[last_jump].operands[0].value) {
+      target = i;
+    }
+  }
+  cr_expect(target >= 0 && target < last_jump,
+            "Expected the loop test to branch backwards");
+  cr_expect_eq(function.instructions[last_jump + 2].opcode, LIR_RET);
+  free_lir_function(&function);
+}
+
+enum { FOLDED_FUNCTION_COUNT = 4 };
+
+// Test 8: Division by -1 is left to idiv so INT_MIN / -1 traps as at -O0
+Test(lower, divide_by_minus_one) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/lower_inputs/strength_reduction.c");
+
+  resolve_variables(ast, FOLDED_FUNCTION_COUNT);
+  fold_constants(ast, FOLDED_FUNCTION_COUNT);
+
+  lir_function function;
+  lower_function_to_lir(ast[3], &function);
+  cr_expect_eq(count_opcode(&function, LIR_IDIV), 2);
+  cr_expect_eq(count_opcode(&function, LIR_NEG), 0);
+  free_lir_function(&function);
+}
+// NOLINTEND(misc-include-cleaner)
@@ -0,0 +1,131 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/codegen.h"
+#include "../src/peephole.h"
+
+// Build an instruction list from string literals
+static void build_list(list_of_x86_instructions* list,
+                       const char* const* lines, int count) {
+  init_list_of_instructions(list);
+  for (int i = 0; i < count; i++) {
+    add_instruction(list, (char*)lines[i]);
+  }
+}
+
+// Check that the list matches the expected lines exactly
+static void expect_lines(const list_of_x86_instructions* list,
+                         const char* const* lines, int count) {
+  cr_assert_eq(list->instruction_count, count, "Expected %d lines, got %d",
+               count, list->instruction_count);
+  for (int i = 0; i < count; i++) {
+    cr_expect_str_eq(list->instructions[i], lines[i]);
+  }
+}
+
+// Test 1: A reload right after a store is dropped
+Test(peephole, store_load) {
+  const char* const input[] = {
+      "        mov     DWORD PTR [rbp-4], ecx",
+      "        mov     ecx, DWORD PTR [rbp-4]",
+      "        mov     eax, ecx",
+      "        ret",
+  };
+  const char* const expected[] = {
+      "        mov     DWORD PTR [rbp-4], ecx",
+      "        mov     eax, ecx",
+      "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, input, 4);
+  cr_expect_gt(optimize_peephole(&list), 0);
+  expect_lines(&list, expected, 3);
+}
+
+// Test 2: Copies are forwarded and dead moves dropped only when the register
+// dies
+Test(peephole, copy_forwarding) {
+  const char* const input[] = {
+      "        mov     r10d, 7",   "        add     eax, r10d",
+      "        mov     r11d, esi", "        mov     edi, r11d",
+      "        call    f",         "        mov     r11d, esi",
+      "        mov     edi, r11d", "        add     eax, r11d",
+      "        ret",
+  };
+  const char* const expected[] = {
+      "        add     eax, 7",        "        mov     edi, esi",
+      "        call    f",             "        mov     r11d, esi",
+      "        add     eax, r11d",     "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, input, 9);
+  optimize_peephole(&list);
+  expect_lines(&list, expected, 6);
+}
+
+// Test 3: Zeroing uses xor unless the flags are still needed
+Test(peephole, zero_with_xor) {
+  const char* const input[] = {
+      "        mov     eax, 0",
+      "        cmp     ecx, edx",
+      "        mov     eax, 0",
+      "        sete    al",
+      "        ret",
+  };
+  const char* const expected[] = {
+      "        cmp     ecx, edx",
+      "        mov     eax, 0",
+      "        sete    al",
+      "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, input, 5);
+  optimize_peephole(&list);
+  expect_lines(&list, expected, 4);
+
+  const char* const zero[] = {"        mov     eax, 0", "        ret"};
+  const char* const zero_expected[] = {"        xor     eax, eax",
+                                       "        ret"};
+  build_list(&list, zero, 2);
+  optimize_peephole(&list);
+  expect_lines(&list, zero_expected, 2);
+}
+
+// Test 4: Labels end a window and branches keep registers alive
+Test(peephole, labels_and_branches) {
+  const char* const input[] = {
+      "        mov     DWORD PTR [rbp-4], eax",
+      ".L1:",
+      "        mov     eax, DWORD PTR [rbp-4]",
+      "        mov     ecx, 5",
+      "        jmp     .L1",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, input, 5);
+  cr_expect_eq(optimize_peephole(&list), 0);
+  expect_lines(&list, input, 5);
+}
+
+// Test 5: Comparing a register with zero becomes test
+Test(peephole, compare_with_zero) {
+  const char* const input[] = {
+      "        cmp     ecx, 0",
+      "        jne     .L1",
+      "        ret",
+  };
+  const char* const expected[] = {
+      "        test    ecx, ecx",
+      "        jne     .L1",
+      "        ret",
+  };
+  list_of_x86_instructions list;
+  build_list(&list, input, 3);
+  cr_expect_gt(optimize_peephole(&list), 0);
+  expect_lines(&list, expected, 3);
+}
+// NOLINTEND(misc-include-cleaner)
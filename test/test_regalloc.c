@@ -0,0 +1,181 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include <string.h>
+
+#include "../src/codegen.h"
+#include "../src/lir.h"
+#include "../src/lower.h"
+#include "../src/regalloc.h"
+#include "test_helpers.h"
+
+// Check that allocation left no virtual registers and only legal operands
+static void assert_allocated(const lir_function* function) {
+  for (int i = 0; i < function->instruction_count; i++) {
+    const lir_instruction* instr = &function->instructions[i];
+    int memory_operands = 0;
+    for (int j = 0; j < 2; j++) {
+      const lir_operand* operand = &instr->operands[j];
+      if (operand->kind == LIR_OPERAND_REGISTER ||
+          operand->kind == LIR_OPERAND_MEMORY) {
+        cr_assert(!is_lir_virtual_register(operand->reg),
+                  "Instruction %d still uses a virtual register", i);
+      }
+      memory_operands += operand->kind == LIR_OPERAND_MEMORY;
+    }
+    cr_assert(memory_operands < 2, "Instruction %d has two memory operands",
+              i);
+  }
+}
+
+// Test 1: Intervals follow the use/def positions of straight-line code
+Test(regalloc, live_intervals) {
+  lir_function function;
+  init_lir_function(&function, "f", 1);
+  int first = new_lir_register(&function);
+  int second = new_lir_register(&function);
+  add_lir_instruction(&function, LIR_MOV, lir_register(first),
+                      lir_immediate(1));  // 0
+  add_lir_instruction(&function, LIR_MOV, lir_register(second),
+                      lir_immediate(2));  // 1
+  add_lir_instruction(&function, LIR_ADD, lir_register(second),
+                      lir_register(first));  // 2
+  add_lir_instruction(&function, LIR_MOV, lir_register(LIR_RAX),
+                      lir_register(second));  // 3
+  add_lir_instruction(&function, LIR_RET, lir_none(), lir_none());
+
+  int count = 0;
+  live_interval* intervals = compute_live_intervals(&function, &count);
+  cr_assert_eq(count, 2);
+  cr_assert_eq(intervals[0].reg, first);
+  cr_assert_eq(intervals[0].start, 1);
+  cr_assert_eq(intervals[0].end, 4);
+  cr_assert_eq(intervals[1].reg, second);
+  cr_assert_eq(intervals[1].start, 3);
+  cr_assert_eq(intervals[1].end, 6);
+  cr_assert_eq(intervals[1].hint, LIR_RAX);
+  free(intervals);
+
+  allocate_registers_linear_scan(&function);
+  assert_allocated(&function);
+  // Both values are live at the add, so they need different registers.
+  cr_assert_neq(function.instructions[2].operands[0].reg,
+                function.instructions[2].operands[1].reg);
+  cr_assert_eq(function.spill_slot_count, 0);
+  free_lir_function(&function);
+}
+
+// Test 2: Values live across a call go to callee-saved registers
+Test(regalloc, live_across_call) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/regalloc_inputs/live_across_call.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[1], &function);
+  allocate_registers_linear_scan(&function);
+  assert_allocated(&function);
+
+  // b, c, d and e survive both calls to sq.
+  cr_assert_neq(function.callee_saved_used, 0U);
+  cr_assert_eq(function.callee_saved_used & (1U << LIR_RAX), 0U);
+  free_lir_function(&function);
+}
+
+// Test 3: More live values than registers forces spills
+Test(regalloc, register_pressure_spills) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/regalloc_inputs/register_pressure.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[0], &function);
+  allocate_registers_linear_scan(&function);
+  assert_allocated(&function);
+  cr_assert_gt(function.spill_slot_count, 0);
+  free_lir_function(&function);
+}
+
+// Test 4: Emitted code keeps rsp 16-byte aligned and restores saves
+Test(regalloc, emitted_frame) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/regalloc_inputs/register_pressure.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[0], &function);
+  allocate_registers_linear_scan(&function);
+
+  list_of_x86_instructions list;
+  init_list_of_instructions(&list);
+  lir_function_to_x86(&function, &list);
+
+  int pushes = 0;
+  int pops = 0;
+  int frame = 0;
+  for (int i = 0; i < list.instruction_count; i++) {
+    const char* line = list.instructions[i];
+    if (strstr(line, "push ") != NULL) {
+      pushes++;
+    } else if (strstr(line, "pop ") != NULL) {
+      pops++;
+    } else if (strstr(line, "sub     rsp, ") != NULL) {
+      frame = atoi(strstr(line, ", ") + 2);
+    }
+  }
+  cr_assert_eq(pushes, pops);
+  // Return address plus pushes plus frame must be a multiple of 16.
+  cr_assert_eq((8 + (8 * pushes) + frame) % 16, 0);
+  free_lir_function(&function);
+}
+
+// Count register-to-register moves that survive to the output
+static int count_copies(const lir_function* function) {
+  int copies = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    const lir_instruction* instr = &function->instructions[i];
+    if (instr->opcode == LIR_MOV &&
+        instr->operands[0].kind == LIR_OPERAND_REGISTER &&
+        instr->operands[1].kind == LIR_OPERAND_REGISTER &&
+        instr->operands[0].reg != instr->operands[1].reg) {
+      copies++;
+    }
+  }
+  return copies;
+}
+
+// Test 5: Graph coloring spills under pressure and leaves legal code
+Test(regalloc, graph_coloring_pressure) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/regalloc_inputs/register_pressure.c");
+
+  lir_function function;
+  lower_function_to_lir(ast[0], &function);
+  allocate_registers_graph_coloring(&function);
+  assert_allocated(&function);
+  cr_assert_gt(function.spill_slot_count, 0);
+  free_lir_function(&function);
+}
+
+// Test 6: Coalescing removes at least as many copies as linear scan's hints
+Test(regalloc, graph_coloring_coalesces_moves) {
+  ast_node** ast = parse_path(
+      CMAKE_SOURCE_DIR "/test/test_inputs/regalloc_inputs/live_across_call.c");
+
+  lir_function scanned;
+  lower_function_to_lir(ast[1], &scanned);
+  allocate_registers_linear_scan(&scanned);
+
+  lir_function colored;
+  lower_function_to_lir(ast[1], &colored);
+  allocate_registers_graph_coloring(&colored);
+  assert_allocated(&colored);
+
+  cr_assert_leq(count_copies(&colored), count_copies(&scanned));
+  // sq(x) squares its argument in place and returns it through eax.
+  lir_function square;
+  lower_function_to_lir(ast[0], &square);
+  allocate_registers_graph_coloring(&square);
+  cr_assert_leq(count_copies(&square), 1);
+  free_lir_function(&scanned);
+  free_lir_function(&colored);
+  free_lir_function(&square);
+}
+
+// NOLINTEND(misc-include-cleaner)
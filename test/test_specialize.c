@@ -0,0 +1,98 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include <string.h>
+
+#include "../src/specialize.h"
+#include "test_helpers.h"
+
+enum { FUNCTION_COUNT = 6 };
+
+// Build every function in the inputs file and specialize with a threshold.
+// Returns the number of functions afterwards.
+static int build_program(ssa_function** functions, int threshold) {
+  *functions = (ssa_function*)malloc(sizeof(ssa_function) * FUNCTION_COUNT);
+  cr_assert_not_null(*functions);
+  build_cleaned_program(
+      CMAKE_SOURCE_DIR "/test/test_inputs/specialize_inputs/calls.c",
+      *functions, FUNCTION_COUNT);
+  return specialize_ssa_functions(functions, FUNCTION_COUNT, threshold);
+}
+
+// Count the live calls to a given name, and check how many arguments they
+// pass
+static int count_calls(const ssa_function* function, const char* name,
+                       int argument_count) {
+  int count = 0;
+  for (int i = 0; i < function->instruction_count; i++) {
+    const ssa_instruction* instruction = &function->instructions[i];
+    if (instruction->block >= 0 && instruction->opcode == SSA_CALL &&
+        instruction->symbol_length == (int)strlen(name) &&
+        strncmp(instruction->symbol, name, strlen(name)) == 0) {
+      cr_expect_eq(instruction->operand_count, argument_count);
+      count++;
+    }
+  }
+  return count;
+}
+
+static int has_name(const ssa_function* function, const char* name) {
+  return function->name_length == (int)strlen(name) &&
+         strncmp(function->name, name, strlen(name)) == 0;
+}
+
+// Test 1: Calls passing the same mode flag share a copy without its branches
+Test(specialize, mode_flag) {
+  ssa_function* functions = NULL;
+  int count = build_program(&functions, DEFAULT_SPECIALIZE_THRESHOLD);
+  cr_assert_eq(count, FUNCTION_COUNT + 3);
+  cr_expect(has_name(&functions[6], "apply.1"));
+  cr_expect(has_name(&functions[7], "apply.2"));
+  cr_expect_eq(count_calls(&functions[1], "apply.1", 2), 2);
+  cr_expect_eq(count_calls(&functions[1], "apply.2", 2), 1);
+  cr_expect_eq(count_calls(&functions[1], "apply", 3), 0);
+  cr_expect_eq(functions[6].parameter_count, 2);
+  cr_expect_eq(count_ssa_opcode(&functions[6], SSA_BRANCH), 0);
+  cr_expect_eq(count_ssa_opcode(&functions[6], SSA_ADD), 1);
+  cr_expect(verify_ssa_function(&functions[6]));
+  cr_expect_eq(count_ssa_opcode(&functions[7], SSA_SUB), 1);
+  cr_expect(verify_ssa_function(&functions[7]));
+  free_program(functions, count);
+  free(functions);
+}
+
+// Test 2: A copy that saves too little is not kept
+Test(specialize, small_saving) {
+  ssa_function* functions = NULL;
+  int count = build_program(&functions, DEFAULT_SPECIALIZE_THRESHOLD);
+  cr_expect_eq(count_calls(&functions[3], "scale", 2), 1);
+  for (int i = 0; i < count; i++) {
+    cr_expect(!has_name(&functions[i], "scale.1"));
+  }
+  free_program(functions, count);
+  free(functions);
+}
+
+// Test 3: A recursive copy calls itself
+Test(specialize, recursive_callee) {
+  ssa_function* functions = NULL;
+  int count = build_program(&functions, DEFAULT_SPECIALIZE_THRESHOLD);
+  cr_assert_eq(count, FUNCTION_COUNT + 3);
+  cr_expect(has_name(&functions[8], "fact.1"));
+  cr_expect_eq(count_calls(&functions[5], "fact.1", 1), 1);
+  cr_expect_eq(count_calls(&functions[8], "fact.1", 1), 1);
+  cr_expect_eq(count_calls(&functions[8], "fact", 2), 0);
+  cr_expect(verify_ssa_function(&functions[8]));
+  free_program(functions, count);
+  free(functions);
+}
+
+// Test 4: A threshold of 0 turns specialization off
+Test(specialize, disabled) {
+  ssa_function* functions = NULL;
+  int count = build_program(&functions, 0);
+  cr_expect_eq(count, FUNCTION_COUNT);
+  cr_expect_eq(count_calls(&functions[1], "apply", 3), 3);
+  free_program(functions, count);
+  free(functions);
+}
+// NOLINTEND(misc-include-cleaner)
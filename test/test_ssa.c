@@ -0,0 +1,95 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "test_helpers.h"
+
+// Build a function's SSA form with its locals promoted
+static void build_promoted(ast_node* node, ssa_function* function) {
+  build_promoted_ssa(node, function);
+  compute_ssa_dominators(function);
+}
+
+// Test 1: Straight-line code promotes to values in a single block
+Test(ssa, straight_line) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ssa_inputs/control_flow.c");
+
+  ssa_function function;
+  build_promoted(ast[0], &function);
+  cr_expect_eq(function.block_count, 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_LOAD), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_STORE), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 0);
+  expect_valid_and_free(&function);
+}
+
+// Test 2: An if/else merges its two assignments with a phi in the join
+Test(ssa, if_else_phi) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ssa_inputs/control_flow.c");
+
+  ssa_function function;
+  build_promoted(ast[1], &function);
+  cr_assert_eq(count_ssa_opcode(&function, SSA_PHI), 1);
+  const ssa_instruction* phi =
+      &function.instructions[find_ssa_opcode(&function, SSA_PHI)];
+  cr_expect_eq(phi->operand_count, 2);
+  cr_expect_eq(function.blocks[phi->block].predecessor_count, 2);
+  cr_expect_eq(function.blocks[phi->block].immediate_dominator, 0);
+  expect_valid_and_free(&function);
+}
+
+// Test 3: A while loop gets a phi per loop-carried local in its header
+Test(ssa, while_loop_phis) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ssa_inputs/control_flow.c");
+
+  ssa_function function;
+  build_promoted(ast[2], &function);
+  cr_assert_eq(count_ssa_opcode(&function, SSA_PHI), 2);
+  int header = function.instructions[find_ssa_opcode(&function, SSA_PHI)].block;
+  cr_expect_eq(function.blocks[header].predecessor_count, 2);
+  int body = function.blocks[header].successors[0];
+  cr_expect(ssa_block_dominates(&function, header, body));
+  cr_expect(!ssa_block_dominates(&function, body, header));
+  expect_valid_and_free(&function);
+}
+
+// Test 4: Use lists find every read of a parameter
+Test(ssa, use_lists) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ssa_inputs/control_flow.c");
+
+  ssa_function function;
+  build_promoted(ast[0], &function);
+  ssa_use_list* uses = build_ssa_use_lists(&function);
+  int first = find_ssa_opcode(&function, SSA_PARAMETER);
+  cr_assert_geq(first, 0);
+  // a is read by a + b and by d - a.
+  cr_expect_eq(uses[first].count, 2);
+  free_ssa_use_lists(uses, function.instruction_count);
+  free_ssa_function(&function);
+}
+
+// Test 5: Code after a return is dropped with its unreachable block
+Test(ssa, unreachable_code) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ssa_inputs/control_flow.c");
+
+  ssa_function function;
+  build_promoted(ast[3], &function);
+  cr_expect_eq(function.block_count, 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_RETURN), 1);
+  expect_valid_and_free(&function);
+}
+
+// Test 6: A local that is dead at the join gets no phi
+Test(ssa, pruned_phi) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/ssa_inputs/control_flow.c");
+
+  ssa_function function;
+  build_promoted(ast[4], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 0);
+  expect_valid_and_free(&function);
+}
+// NOLINTEND(misc-include-cleaner)
@@ -0,0 +1,48 @@
+// NOLINTBEGIN(misc-include-cleaner)
+// we checked to make sure only criterion related warnings were left
+#include "../src/tail.h"
+#include "test_helpers.h"
+
+// Build a function's SSA form and turn its tail recursion into a loop
+static void build_looped(ast_node* node, ssa_function* function) {
+  build_promoted_ssa(node, function);
+  eliminate_tail_recursion(function);
+}
+
+// Test 1: An accumulator-style tail call becomes a loop over both parameters
+Test(tail, accumulator_loop) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/tail_inputs/recursion.c");
+
+  ssa_function function;
+  build_looped(ast[0], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_CALL), 0);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 2);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_RETURN), 1);
+  expect_valid_and_free(&function);
+}
+
+// Test 2: A call whose result is still used afterwards is not a tail call
+Test(tail, non_tail_call) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/tail_inputs/recursion.c");
+
+  ssa_function function;
+  build_looped(ast[1], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_CALL), 1);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_PHI), 0);
+  free_ssa_function(&function);
+}
+
+// Test 3: A tail call in the entry block loops back past the parameters
+Test(tail, entry_block_call) {
+  ast_node** ast = parse_path(CMAKE_SOURCE_DIR
+                              "/test/test_inputs/tail_inputs/recursion.c");
+
+  ssa_function function;
+  build_looped(ast[2], &function);
+  cr_expect_eq(count_ssa_opcode(&function, SSA_CALL), 0);
+  cr_expect_eq(function.blocks[0].successor_count, 1);
+  expect_valid_and_free(&function);
+}
+// NOLINTEND(misc-include-cleaner)